@@ -0,0 +1,57 @@
+/*
+ * Predecoded PRG ROM instructions for instruction stepping
+ *
+ * Instructions are decoded a basic block at a time (up to and including the
+ * next branch, jump, return or BRK) the first time they're executed and kept
+ * per 16 KiB PRG bank, keyed by their offset into the bank. PRG ROM never
+ * changes so entries stay valid for the whole run, only the cpu page to bank
+ * lookup is dropped when a mapper remaps PRG (cpu_map_pages()).
+ *
+ * Pages that aren't PRG ROM (RAM, PRG RAM, I/O) are never cached, code
+ * running from there is always fetched from memory so self modifying code
+ * keeps working.
+ */
+#ifndef __BLOCK_CACHE__
+#define __BLOCK_CACHE__
+
+#include "block_cache_fwd.h"
+#include "cart_fwd.h"
+#include "cpu_fwd.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BLOCK_CACHE_BANK_SIZE (16U * 1024U) // smallest PRG bank the mappers switch
+#define BLOCK_CACHE_PAGE_COUNT 256U // one lookup per cpu page (CPU_PAGE_COUNT)
+
+struct DecodedInstruction {
+	uint8_t opcode;
+	uint8_t operand_lo;
+	uint8_t operand_hi;
+	uint8_t length; // 0 until decoded
+	bool ends_block;
+};
+
+struct BlockCache {
+	const uint8_t* prg_rom;
+	size_t prg_rom_size;
+	size_t bank_count;
+	struct DecodedInstruction** banks; // BLOCK_CACHE_BANK_SIZE entries each, allocated on first use
+	const struct DecodedInstruction* page[BLOCK_CACHE_PAGE_COUNT]; // NULL until looked up or not PRG ROM
+	// next instruction of the block being run, so it needs no lookup
+	const struct DecodedInstruction* next;
+	uint16_t next_pc;
+};
+
+BlockCache* block_cache_allocator(void);
+int block_cache_init(BlockCache* cache, const CartMemory* prg_rom);
+/* Decoded instruction at the cpu's PC, NULL if the PC isn't in PRG ROM
+ * (or the opcode is illegal). Decodes the rest of the block on a miss
+ */
+const struct DecodedInstruction* block_cache_next(BlockCache* cache, const Cpu6502* cpu);
+/* Called when cpu pages are remapped */
+void block_cache_unmap_pages(BlockCache* cache, unsigned first_page, unsigned page_count);
+void block_cache_free(BlockCache* cache);
+
+#endif /* __BLOCK_CACHE__ */
@@ -0,0 +1,8 @@
+#ifndef __BLOCK_CACHE_FWD__
+#define __BLOCK_CACHE_FWD__
+
+// Ensure forward declerations come before other includes
+typedef struct BlockCache BlockCache;
+struct DecodedInstruction;
+
+#endif /* __BLOCK_CACHE_FWD__ */
@@ -10,6 +10,7 @@
 #include "ppu_fwd.h"
 #include "mappers.h"
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -38,6 +39,7 @@ struct Cartridge {
 	CartMemory trainer; // Trainer data (depends on mapper if used or not)
 	CartMemory chr_rom; // CHR data, sprite and background pattern tables sent to PPU
 	CartMemory chr_ram;
+	struct ChrRow* chr_rows; // chr_rom (or chr_ram) predecoded for the ppu, see ppu.h
 	bool non_volatile_mem; // battery and other types of non-volatile memory
 };
 
@@ -47,5 +49,9 @@ struct Cartridge {
 Cartridge* cart_allocator(void);
 int cart_init(Cartridge* cart);
 int parse_nes_cart_file(Cartridge* cart, const char* filename, Cpu6502* cpu, Ppu2C02* ppu);
+/* Same as above but from a .nes image already in memory (the image is copied),
+ * name is only used to log the cart info, NULL skips the logging
+ */
+int parse_nes_cart_data(Cartridge* cart, const uint8_t* rom, size_t rom_size, const char* name, Cpu6502* cpu, Ppu2C02* ppu);
 
 #endif /* __CART__ */
@@ -0,0 +1,74 @@
+/*
+ * libcnes: embedding API for the cNES core
+ *
+ * Each handle is a complete console (see nes.h), any number of them can be
+ * created in one process. The core is linked against the null video
+ * backend so nothing here needs SDL, frames are read back through
+ * cnes_framebuffer() instead.
+ */
+#ifndef __LIBCNES__
+#define __LIBCNES__
+
+#include "nes_fwd.h"
+#include "rewind.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CNES_FRAME_WIDTH  256U
+#define CNES_FRAME_HEIGHT 240U
+
+/* Controller button masks for cnes_set_input() */
+#define CNES_BUTTON_A      0x01U
+#define CNES_BUTTON_B      0x02U
+#define CNES_BUTTON_SELECT 0x04U
+#define CNES_BUTTON_START  0x08U
+#define CNES_BUTTON_UP     0x10U
+#define CNES_BUTTON_DOWN   0x20U
+#define CNES_BUTTON_LEFT   0x40U
+#define CNES_BUTTON_RIGHT  0x80U
+
+/* Returns a powered on console with no cart inserted, NULL on failure */
+Nes* cnes_create(void);
+/* Inserts a .nes image (copied, the caller keeps ownership of rom) and resets
+ * the console, returns non-zero if the image can't be loaded
+ */
+int cnes_load_rom_from_memory(Nes* nes, const uint8_t* rom, size_t size);
+/* Runs until the PPU finishes the current frame, returns the cpu cycles run */
+unsigned long cnes_run_frame(Nes* nes);
+/* Runs for a fixed number of cpu cycles */
+void cnes_run_cycles(Nes* nes, unsigned long cycles);
+/* Sets the buttons held on a controller port (0 = player 1, 1 = player 2) */
+void cnes_set_input(Nes* nes, unsigned port, uint8_t buttons);
+/* CNES_FRAME_WIDTH x CNES_FRAME_HEIGHT ARGB8888 pixels, valid until cnes_destroy() */
+const uint32_t* cnes_framebuffer(const Nes* nes);
+void cnes_destroy(Nes* nes);
+
+/* Save states, see save_state.h. A state can be loaded into any console
+ * running the same ROM (including the one that saved it)
+ */
+size_t cnes_save_state_size(const Nes* nes);
+size_t cnes_save_state(const Nes* nes, uint8_t* buffer, size_t buffer_size);
+int cnes_load_state(Nes* nes, const uint8_t* buffer, size_t buffer_size);
+
+/* Rewind, see rewind.h. Push once per cnes_run_frame() and the last
+ * max_frames frames (as many as fit in memory_budget bytes) can be stepped
+ * back through, e.g. 64 MiB and 3600 frames for 60 seconds
+ */
+RewindBuffer* cnes_rewind_create(const Nes* nes, size_t memory_budget, unsigned max_frames);
+int cnes_rewind_push(RewindBuffer* rb, const Nes* nes);
+/* Returns the number of frames rewound (clamped to the oldest one kept), -1 if none are */
+int cnes_rewind(RewindBuffer* rb, Nes* nes, unsigned frames_back);
+void cnes_rewind_destroy(RewindBuffer* rb);
+
+/* Binary cpu trace, see trace.h. The trace keeps the last max_records
+ * instructions executed while it is attached, attach/detach (NULL) at any
+ * time. Loading a ROM detaches it. Dump a flushed file with cnes-tracedump
+ */
+CpuTrace* cnes_trace_create(const Nes* nes, size_t max_records);
+void cnes_trace_attach(Nes* nes, CpuTrace* trace);
+int cnes_trace_flush(const CpuTrace* trace, const char* filename);
+void cnes_trace_destroy(CpuTrace* trace);
+
+#endif /* __LIBCNES__ */
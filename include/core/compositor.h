@@ -0,0 +1,34 @@
+/*
+ * Scanline compositor
+ *
+ * Combines a whole scanline of BG and sprite pixels into ARGB8888 output:
+ * sprite vs BG priority, transparency and the palette RAM lookup. Pixels are
+ * given as palette RAM offsets so the lookup is into a 32 entry table of
+ * colours, built once per scanline.
+ *
+ * Built with AVX2 (make AVX2=1) 32 pixels are done at a time, the lookup
+ * being byte shuffles of the colour table. x86-64 hosts otherwise use SSE2
+ * to pick between the BG and sprite pixels 16 at a time and look the colours
+ * up one by one, other hosts use the scalar version.
+ */
+#ifndef __COMPOSITOR__
+#define __COMPOSITOR__
+
+#include <stdint.h>
+
+#define COMPOSITOR_WIDTH 256U
+#define COMPOSITOR_COLOURS 32U // palette RAM entries
+
+// Sprite line entries (Ppu2C02 sprite_line), palette RAM offset and priority
+#define SPRITE_LINE_OFFSET 0x1F // 0x10-0x1F, 0 if transparent
+#define SPRITE_LINE_BEHIND 0x20 // sprite is behind the BG
+
+/* bg:      palette RAM offset of each BG pixel (0x00-0x0F), 0 if transparent
+ * sprite:  sprite line entry of each pixel (see above)
+ * colours: ARGB colour of each palette RAM entry
+ */
+void composite_scanline(uint32_t* out, const uint8_t* bg, const uint8_t* sprite, const uint32_t* colours);
+// Same as above a pixel at a time, what the SIMD versions are tested against
+void composite_scanline_scalar(uint32_t* out, const uint8_t* bg, const uint8_t* sprite, const uint32_t* colours);
+
+#endif /* __COMPOSITOR__ */
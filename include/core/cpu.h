@@ -9,6 +9,11 @@
 #include "cpu_ppu_interface_fwd.h"
 #include "cart_fwd.h"
 #include "cpu_mapper_interface_fwd.h"
+#include "ppu_fwd.h"
+#include "gui_fwd.h"
+#include "trace_fwd.h"
+#include "block_cache_fwd.h"
+#include "jit_fwd.h"
 
 #include <stdint.h>
 #include <stdbool.h>
@@ -18,6 +23,8 @@
 #endif /* KiB*/
 
 #define CPU_MEMORY_SIZE  64 * KiB // Total memory available to the CPU
+#define CPU_PAGE_SIZE    256U     // Granularity of the CPU memory map
+#define CPU_PAGE_COUNT   256U
 
 /* Status_Flags
  * Bits : 7 ----------> 0
@@ -80,6 +87,18 @@ typedef enum {
 	POST_EXECUTE,
 } InstructionStates;
 
+// What the last completed "instruction" was, for the trace logger
+typedef enum {
+	TRACE_OPCODE,
+	TRACE_IRQ,
+	TRACE_NMI,
+	TRACE_DMA,
+} CpuTraceEvent;
+
+/* I/O handlers for pages of the memory map that can't be accessed directly */
+typedef uint8_t (*CpuPageRead)(Cpu6502* cpu, uint16_t addr);
+typedef void (*CpuPageWrite)(Cpu6502* cpu, uint16_t addr, uint8_t val);
+
 struct Cpu6502 {
 	// Memory mapped I/O
 	CpuPpuShare* cpu_ppu_io;
@@ -93,10 +112,18 @@ struct Cpu6502 {
 	uint8_t P; // Program status register
 	uint16_t PC; // Program counter (instruction pointer)
 	uint8_t stack;
-	unsigned cycle; // Helper variable, logs how many cpu cycles have elapsed
+	uint64_t cycle; // cpu cycles since power up, the master clock (in ppu dots) is 3x this
 	// Memory
 	uint8_t mem[CPU_MEMORY_SIZE];
 
+	// Memory map, one entry per 256 byte page (addr >> 8)
+	// RAM/ROM pages point to host memory and are accessed directly, a NULL
+	// entry means the access goes through that page's I/O handler instead
+	uint8_t* read_page[CPU_PAGE_COUNT];
+	uint8_t* write_page[CPU_PAGE_COUNT];
+	CpuPageRead read_handler[CPU_PAGE_COUNT];
+	CpuPageWrite write_handler[CPU_PAGE_COUNT];
+
 	// Bus signals
 	uint16_t address_bus;
 	uint16_t data_bus;
@@ -116,7 +143,9 @@ struct Cpu6502 {
 	bool delay_nmi;  // only true when enabling NMI via $2000 during VBlank
 	bool cpu_ignore_fetch_on_nmi;
 
-	// Instruction trace logger
+	// Instruction trace logger, the strings are only filled in by
+	// set_cpu_disassembler_trace() (never while executing)
+	CpuTraceEvent trace_event;
 	char instruction[18]; // complete instruction e.g. LDA $2000
 	char end[10]; // ending of the instruction e.g. #$2000
 	char append_int[20]; // conversion for int to char
@@ -125,6 +154,9 @@ struct Cpu6502 {
 	unsigned controller_latch; // latch signal for controller shift register
 	uint8_t player_1_controller;
 	uint8_t player_2_controller;
+	unsigned player_1_clock_pulse; // next button bit returned by $4016
+	unsigned player_2_clock_pulse; // next button bit returned by $4017
+
 
 	InstructionStates instruction_state;
 	AddressMode address_mode;
@@ -136,9 +168,26 @@ struct Cpu6502 {
 	uint8_t old_P;
 	uint16_t old_PC;
 	int old_stack;
-	unsigned old_cycle;
+	uint64_t old_cycle;
 	bool process_interrupt;
 	bool trigger_trace_logger;
+
+	// Instruction stepping, see cpu_step_instruction()
+	Ppu2C02* ppu;  // NULL unless attached via cpu_attach_ppu()
+	Sdl2DisplayOutputs* cnes_windows;
+	uint64_t ppu_synced_cycle; // cpu cycle the ppu has been clocked up to
+	uint64_t ppu_deadline_cycle; // the ppu is left behind until the cpu gets here
+	bool stepping; // true while a whole instruction is run in one call
+
+	// Binary trace, every fetched opcode is recorded when set (see trace.h)
+	CpuTrace* trace;
+
+	// Predecoded PRG ROM for instruction stepping (see block_cache.h)
+	BlockCache* block_cache;
+	const struct DecodedInstruction* decoded; // instruction being stepped, NULL if fetched from memory
+
+	// Recompiled PRG ROM blocks for instruction stepping (see jit.h)
+	Jit* jit;
 };
 
 struct InstructionDetails {
@@ -146,6 +195,7 @@ struct InstructionDetails {
 	void (*decode_opcode)(Cpu6502* cpu);
 	void (*execute_opcode)(Cpu6502* cpu);
 	const uint8_t max_cycles;
+	const AddressMode address_mode; // operand layout for disassembling raw bytes, see trace.c
 };
 extern struct InstructionDetails isa_info[256];
 
@@ -153,8 +203,53 @@ Cpu6502* cpu_allocator(void);
 int cpu_init(Cpu6502* cpu, uint16_t pc, CpuPpuShare* cp, CpuMapperShare* cm);
 
 void clock_cpu(Cpu6502* cpu);
+/* clock_cpu() with the attached ppu (see cpu_attach_ppu()) left to lag
+ * behind, it is caught up in bulk when the cpu accesses something the ppu
+ * can see or reaches the next point the ppu could signal the cpu (VBlank,
+ * NMI, a buffered write landing) or end the frame. Same results as calling
+ * clock_cpu() then clock_ppu() 3 times
+ */
+void clock_cpu_and_ppu(Cpu6502* cpu);
+/* Catches the attached ppu up to the cpu, for frontends that look at the ppu
+ * between clock_cpu_and_ppu()/cpu_step_instruction() calls
+ */
+void cpu_sync_ppu(Cpu6502* cpu);
+/* Alternative to clock_cpu(), runs a complete instruction (or NMI/DMA) and
+ * returns the number of cpu cycles it took. If a ppu is attached it is only
+ * caught up (3 dots per cpu cycle) before accesses that it can observe,
+ * e.g. $2000-$3FFF, $4014, $4016/7 and mapper registers, and when the cpu
+ * reaches the next ppu deadline as clock_cpu_and_ppu() does. So don't clock
+ * the ppu separately when using this
+ */
+unsigned cpu_step_instruction(Cpu6502* cpu);
+void cpu_attach_ppu(Cpu6502* cpu, Ppu2C02* ppu, Sdl2DisplayOutputs* cnes_windows);
+/* Records every instruction into trace (see trace.h) until detached by passing NULL,
+ * can be switched at any time
+ */
+void cpu_attach_trace(Cpu6502* cpu, CpuTrace* trace);
+/* cpu_step_instruction() takes PRG ROM instructions from block_cache instead
+ * of fetching them, pass NULL to detach
+ */
+void cpu_attach_block_cache(Cpu6502* cpu, BlockCache* block_cache);
+/* cpu_step_instruction() runs hot PRG ROM blocks through jit while the ppu
+ * has nothing for the cpu to observe, pass NULL to detach
+ */
+void cpu_attach_jit(Cpu6502* cpu, Jit* jit);
+/* Opcode plus operand bytes */
+unsigned cpu_instruction_length(uint8_t opcode);
+/* true if cpu_step_instruction() runs opcode through a fused handler (built
+ * with CNES_FUSED_CPU), otherwise it falls back to the isa_info functions
+ */
+bool cpu_fused_opcode(uint8_t opcode);
 extern void (*hardware_interrupts[3])(Cpu6502* cpu); // used for unit tests of DMA/IRQ/NMI (non opcode interrupts)
 
+// Memory map
+void cpu_default_memory_map(Cpu6502* cpu);
+void cpu_map_pages(Cpu6502* cpu, uint16_t addr, unsigned size
+                  , uint8_t* read_mem, uint8_t* write_mem);
+void cpu_map_io_pages(Cpu6502* cpu, uint16_t addr, unsigned size
+                     , CpuPageRead read_handler, CpuPageWrite write_handler);
+
 // Helper functions
 void init_pc(Cpu6502* cpu); /* Set PC via reset vector */
 uint8_t cpu_generic_read(Cpu6502* cpu, enum CpuMemType mem_type
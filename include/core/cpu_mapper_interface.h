@@ -5,6 +5,7 @@
 #include "cart_fwd.h"
 
 #include <stdbool.h>
+#include <stdint.h>
 
 
 // Shared mapper/cpu struct
@@ -25,6 +26,11 @@ struct CpuMapperShare {
 	bool prg_high_bank_fixed; // Bank $C000 to $FFFF is fixed
 
 	bool enable_prg_ram;
+
+	// MMC1 serial port: 5 writes shift a value into one of its registers
+	unsigned mmc1_write_count;
+	unsigned mmc1_shift_reg;
+	uint64_t mmc1_write_cycle; // cpu cycle of the last write, adjacent writes are ignored
 };
 
 CpuMapperShare* cpu_mapper_allocator(void);
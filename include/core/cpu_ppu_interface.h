@@ -4,6 +4,7 @@
 #include "cpu_fwd.h"
 #include "ppu.h" // need full header for enum used in cpu/ppu struct
 #include "cpu_ppu_interface_fwd.h"
+#include "events.h"
 
 #include <stdbool.h>
 #include <inttypes.h>
@@ -37,9 +38,9 @@ struct CpuPpuShare {
 	// Is set on (SL/PPU_CYC) 239/340, 240/0 and 240/1
 	bool nmi_lookahead;
 
-	// more cpu/ppu synchronisation
-	bool buffer_write;
-	unsigned buffer_counter;
+	// more cpu/ppu synchronisation, vblank/NMI, buffered writes and OAM DMA
+	// are scheduled on the master clock instead of being counted down
+	EventQueue events;
 	unsigned buffer_address;
 	uint8_t buffer_value;
 
@@ -0,0 +1,49 @@
+#ifndef __EVENTS__
+#define __EVENTS__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Master clock timestamps count PPU dots since power up, a CPU cycle is 3
+ * dots so cpu cycle N ends on dot 3 * N. Events are kept in timestamp order,
+ * events due on the same dot are handled in the order of the enum below
+ */
+typedef enum {
+	EVENT_PPU_MASK_EARLY, // $2001 BG enable/disable seen by the odd frame skip
+	EVENT_PPU_WRITE,      // buffered PPU register write lands
+	EVENT_VBLANK,         // VBlank flag set, dot 0 of the NMI scanline
+	EVENT_NMI,            // NMI asserted (if enabled), dot 1 of the NMI scanline
+	EVENT_DMA_DONE,       // last cycle of an OAM DMA, the CPU resumes after it
+	EVENT_MAPPER_IRQ,     // reserved for mapper IRQ counters, none schedule it yet
+	EVENT_COUNT
+} EventType;
+
+#define EVENT_NEVER UINT64_MAX
+
+// events handled by clock_ppu(), the rest belong to the cpu
+#define PPU_EVENTS ((1u << EVENT_PPU_MASK_EARLY) | (1u << EVENT_PPU_WRITE) \
+                   | (1u << EVENT_VBLANK) | (1u << EVENT_NMI))
+
+typedef struct EventQueue {
+	uint64_t now;  // dots the ppu has been clocked for
+	uint64_t next; // earliest scheduled event, EVENT_NEVER if none
+	uint64_t when[EVENT_COUNT];
+} EventQueue;
+
+void events_init(EventQueue* q);
+void events_schedule(EventQueue* q, EventType type, uint64_t when);
+void events_cancel(EventQueue* q, EventType type);
+// Removes and returns the earliest event (in mask) due by timestamp, -1 if none
+int events_pop(EventQueue* q, uint64_t timestamp, unsigned mask);
+
+static inline bool events_pending(const EventQueue* q, EventType type)
+{
+	return q->when[type] != EVENT_NEVER;
+}
+
+static inline bool events_due(const EventQueue* q, uint64_t timestamp)
+{
+	return q->next <= timestamp;
+}
+
+#endif /* __EVENTS__ */
@@ -1,7 +1,6 @@
 #ifndef __NES_GUI__
 #define __NES_GUI__
 
-#include "SDL2/SDL.h"
 #include "gui_fwd.h"
 
 #include <stdint.h>
@@ -9,10 +8,16 @@
 #define DEFAULT_HEIGHT 240U
 #define DEFAULT_WIDTH  256U
 
+// Opaque SDL handles, only gui.c needs the SDL headers
+// which lets the core be built against a null video backend (gui_null.c)
+struct SDL_Window;
+struct SDL_Renderer;
+struct SDL_Texture;
+
 struct Sdl2Display {
-	SDL_Window* window;
-	SDL_Renderer* renderer;
-	SDL_Texture* framebuffer;
+	struct SDL_Window* window;
+	struct SDL_Renderer* renderer;
+	struct SDL_Texture* framebuffer;
 
 	uint32_t window_id;
 };
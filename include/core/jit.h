@@ -0,0 +1,80 @@
+/*
+ * x86-64 recompiler for PRG ROM basic blocks (instruction stepping only)
+ *
+ * Blocks cpu_step_instruction() keeps landing on are translated to host code
+ * once they are hot. A block stops before anything it can't translate (BRK,
+ * RTI) and before any static access to an I/O page, indexed/indirect
+ * accesses that land on an I/O page at run time leave the block before that
+ * instruction so the interpreter runs it. Compiled code never touches the
+ * ppu, mapper or controllers, blocks are only run when the ppu can't raise
+ * an NMI or finish a frame before they end (see cpu_step_instruction()), so
+ * catching the ppu up afterwards gives the same result as stepping.
+ *
+ * Registers, memory, the cycle count (isa_info[].max_cycles plus page
+ * crosses and taken branches), the data bus and the opcode are left exactly
+ * as the interpreter leaves them. The decoder scratch (address_bus,
+ * target_addr, addr_lo etc.) isn't kept, it is rewritten by every decode.
+ *
+ * Only PRG ROM is compiled, code running from RAM (self modifying or not)
+ * stays on the interpreter. With verify set each block run is replayed on
+ * the interpreter with a shadow copy of the cpu and any difference reported.
+ */
+#ifndef __JIT__
+#define __JIT__
+
+#include "jit_fwd.h"
+#include "cart_fwd.h"
+#include "cpu_fwd.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define JIT_HOT_RUNS 16U // runs of a block's first instruction before it is compiled
+#define JIT_MAX_BLOCK_INSTRUCTIONS 32U
+#define JIT_MAX_BLOCK_PAGES 2U // cpu pages a block's instructions may span
+#define JIT_ARENA_SIZE (4U * 1024U * 1024U) // flushed when full
+#define JIT_MAX_BLOCK_CODE (16U * 1024U) // host code of the biggest possible block
+
+// returns the number of instructions run, 0 if it left before the first one
+typedef unsigned (*JitBlockCode)(Cpu6502* cpu);
+
+struct JitBlock {
+	JitBlockCode code; // NULL if the first instruction can't be compiled
+	uint16_t pc; // cpu address the block was compiled for
+	uint16_t max_cycles; // worst case, page crosses and taken branches included
+	unsigned first_page;
+	unsigned page_count;
+	const uint8_t* pages[JIT_MAX_BLOCK_PAGES]; // PRG ROM mapped when compiled
+};
+
+struct Jit {
+	const uint8_t* prg_rom;
+	size_t prg_rom_size;
+	struct JitBlock** blocks; // one per PRG ROM byte, NULL until compiled
+	uint8_t* heat; // runs per PRG ROM byte, counts up to hot_runs
+	unsigned hot_runs;
+
+	uint8_t* arena; // executable memory
+	size_t arena_used;
+
+	bool verify;
+	Cpu6502* shadow; // interpreter copy of the cpu when verifying
+	uint8_t (*shadow_pages)[256]; // private copies of writable pages outside cpu->mem
+
+	unsigned long blocks_compiled;
+	unsigned long long instructions; // run from compiled blocks
+	unsigned long mismatches; // verify only
+};
+
+/* False if there is no backend for the host, jit_init() then fails */
+bool jit_supported(void);
+Jit* jit_allocator(void);
+int jit_init(Jit* jit, const CartMemory* prg_rom, bool verify);
+/* Runs the block at the cpu's PC if it is compiled and its worst case fits
+ * in cycle_budget, returns the number of instructions run (0 = step it)
+ */
+unsigned jit_run(Jit* jit, Cpu6502* cpu, unsigned cycle_budget);
+void jit_free(Jit* jit);
+
+#endif /* __JIT__ */
@@ -0,0 +1,8 @@
+#ifndef __JIT_FWD__
+#define __JIT_FWD__
+
+// Ensure forward declerations come before other includes
+typedef struct Jit Jit;
+struct JitBlock;
+
+#endif /* __JIT_FWD__ */
@@ -0,0 +1,56 @@
+/*
+ * Input movies: controller state recorded once per frame from power on,
+ * played back by feeding the controllers at the same frame boundaries.
+ *
+ * Only changes in input are stored (frame index + both controllers) so a
+ * movie of someone holding right for a minute is a handful of bytes. The
+ * file records a hash of the cart's ROM data, a movie can't be played back
+ * on a different game. Nothing here needs SDL.
+ */
+#ifndef __NES_MOVIE__
+#define __NES_MOVIE__
+
+#include "nes_fwd.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MOVIE_VERSION 1U
+
+typedef struct InputMovie InputMovie;
+
+struct MovieInput {
+	uint32_t frame; // first frame these buttons are held for
+	uint8_t player_1;
+	uint8_t player_2;
+};
+
+struct InputMovie {
+	struct MovieInput* inputs;
+	size_t input_count;
+	size_t input_capacity;
+	uint32_t frame_count; // frames recorded
+	uint32_t rom_hash;
+
+	// playback position
+	uint32_t play_frame;
+	size_t next_input;
+};
+
+InputMovie* movie_allocator(void);
+/* Starts an empty movie for the cart the console is running */
+int movie_init(InputMovie* movie, const Nes* nes);
+/* Call at the start of every frame (power on counts as the start of frame 0):
+ * records the controllers as they are now
+ */
+int movie_record_frame(InputMovie* movie, const Nes* nes);
+/* Call at the start of every frame: sets the controllers for this frame,
+ * returns 1 (controllers released) once the movie has run out
+ */
+int movie_play_frame(InputMovie* movie, Nes* nes);
+int movie_save(const InputMovie* movie, const char* filename);
+/* Loads a movie for playback from frame 0, fails if it was recorded on another game */
+int movie_load(InputMovie* movie, const char* filename, const Nes* nes);
+void movie_free(InputMovie* movie);
+
+#endif /* __NES_MOVIE__ */
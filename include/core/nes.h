@@ -0,0 +1,36 @@
+/*
+ * A single NES console, owns every unit (cart, cpu, ppu and the structs
+ * they share). None of the units keep static or global state so any
+ * number of consoles can be run side by side in one process.
+ */
+#ifndef __NES_CONSOLE__
+#define __NES_CONSOLE__
+
+#include "nes_fwd.h"
+#include "cart_fwd.h"
+#include "cpu_fwd.h"
+#include "ppu_fwd.h"
+#include "cpu_ppu_interface_fwd.h"
+#include "cpu_mapper_interface_fwd.h"
+#include "gui.h" // need full header for the display outputs held by value
+
+
+struct Nes {
+	Cartridge* cart;
+	CpuMapperShare* cpu_mapper;
+	CpuPpuShare* cpu_ppu;
+	Cpu6502* cpu;
+	Ppu2C02* ppu;
+	Sdl2DisplayOutputs cnes_windows;
+};
+
+/* Allocates the console and all of its units, NULL if any allocation fails */
+Nes* nes_allocator(void);
+/* Initialises the units and wires them together (screens are left to the caller) */
+int nes_init(Nes* nes);
+/* Loads a .nes file and resets the cpu to the cart's reset vector */
+int nes_load_cart(Nes* nes, const char* filename);
+/* Frees the cart data, the units and the console itself */
+void nes_free(Nes* nes);
+
+#endif /* __NES_CONSOLE__ */
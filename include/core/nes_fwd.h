@@ -0,0 +1,7 @@
+#ifndef __NES_FWD__
+#define __NES_FWD__
+
+// Ensure forward declerations come before other includes
+typedef struct Nes Nes;
+
+#endif /* __NES_FWD__ */
@@ -34,6 +34,62 @@ typedef enum PpuNametableMirroringType {
 } PpuNametableMirroringType;
 
 
+/* What clock_ppu() does on a dot, looked up by scanline and cycle (see
+ * ppu_dot_actions()). Whether an action runs can still depend on ppu_mask,
+ * fine x or the rendering period, those are checked when it runs
+ */
+enum PpuDotAction {
+	// NMI, VBlank and ppu_status
+	DOT_CLEAR_SPRITE_HIT   = 1U << 0,  // pre-render dot 0
+	DOT_CLEAR_STATUS_FLAGS = 1U << 1,  // pre-render dot 1, VBlank, sprite hit and overflow
+	DOT_CLEAR_STATUS       = 1U << 2,  // scanline 240 dot 339
+	DOT_NMI_LOOKAHEAD      = 1U << 3,  // scanline 240 dot 340
+	// Output
+	DOT_PIXEL              = 1U << 4,  // visible dots 1-256
+	DOT_FRAME_DONE         = 1U << 5,  // scanline 240 dot 0
+	// Background
+	DOT_BG_AT_RELOAD       = 1U << 6,  // reload the attribute shift regs if fine x is on a tile edge
+	DOT_BG_AT_FILL         = 1U << 7,  // dots 322 and 330
+	DOT_BG_NT_FETCH        = 1U << 8,
+	DOT_BG_AT_FETCH        = 1U << 9,
+	DOT_BG_PT_LO_FETCH     = 1U << 10,
+	DOT_BG_PT_HI_FETCH     = 1U << 11,
+	DOT_BG_SHIFT_RELOAD    = 1U << 12, // latches into the upper byte of the shift regs
+	DOT_BG_SHIFT_PREFETCH  = 1U << 13, // shift the 1st prefetched tile down, load the 2nd
+	DOT_HORZ_COPY          = 1U << 14, // dot 257, horizontal bits of t to v
+	DOT_VERT_COPY          = 1U << 15, // pre-render dots 280-304, vertical bits of t to v
+	DOT_INC_HORZ           = 1U << 16,
+	DOT_INC_VERT           = 1U << 17,
+	// Sprites
+	DOT_SPRITE_OAM_CLEAR   = 1U << 18, // visible dots 1-64
+	DOT_SPRITE_EVAL        = 1U << 19, // visible dots 65-256
+	DOT_SPRITE_ADDR        = 1U << 20, // visible dots 257-320, 8 dots per sprite
+	DOT_SPRITE_AT_FETCH    = 1U << 21,
+	DOT_SPRITE_X_FETCH     = 1U << 22,
+	DOT_SPRITE_PT_LO_FETCH = 1U << 23,
+	DOT_SPRITE_PT_HI_FETCH = 1U << 24,
+	DOT_SPRITE_BLANK       = 1U << 25, // missing sprites are transparent
+	DOT_SPRITE_RESET       = 1U << 26, // every pre-render dot
+	DOT_SPRITE_ZERO_RESET  = 1U << 27, // pre-render dot 1
+};
+
+#define DOT_BG_ACTIONS (DOT_BG_AT_RELOAD | DOT_BG_AT_FILL | DOT_BG_NT_FETCH | DOT_BG_AT_FETCH \
+                        | DOT_BG_PT_LO_FETCH | DOT_BG_PT_HI_FETCH | DOT_BG_SHIFT_RELOAD \
+                        | DOT_BG_SHIFT_PREFETCH | DOT_HORZ_COPY | DOT_VERT_COPY)
+#define DOT_SPRITE_FETCH_ACTIONS (DOT_SPRITE_ADDR | DOT_SPRITE_AT_FETCH | DOT_SPRITE_X_FETCH \
+                                  | DOT_SPRITE_PT_LO_FETCH | DOT_SPRITE_PT_HI_FETCH | DOT_SPRITE_BLANK)
+#define DOT_STATUS_ACTIONS (DOT_CLEAR_SPRITE_HIT | DOT_CLEAR_STATUS_FLAGS | DOT_CLEAR_STATUS \
+                            | DOT_NMI_LOOKAHEAD)
+
+/* One row of a CHR tile predecoded from its two bitplanes, 8 packed 2 bit
+ * colour indices with the leftmost pixel in bits 0-1 (flipped holds the
+ * row mirrored for horizontally flipped sprites)
+ */
+struct ChrRow {
+	uint16_t normal;
+	uint16_t flipped;
+};
+
 // Non-mirrored memory mapping of ppu vram
 struct PpuMemoryMap {
 	uint8_t* pattern_table_0k; // vram: 0x0000 to 0x0FFF
@@ -49,6 +105,12 @@ struct PpuMemoryMap {
 	uint8_t (*nametable_1)[0x0400];
 	uint8_t (*nametable_2)[0x0400];
 	uint8_t (*nametable_3)[0x0400];
+
+	// Predecoded rows of the cart's CHR data, the pattern tables point into
+	// chr_data (NULL if there's no cache, the rows are decoded as needed)
+	const uint8_t* chr_data;
+	uint32_t chr_size;
+	struct ChrRow* chr_rows;
 };
 
 struct BackgroundRenderingInternals {
@@ -100,6 +162,8 @@ struct Ppu2C02 {
 	uint8_t sprite_pt_lo_shift_reg[8];
 	uint8_t sprite_pt_hi_shift_reg[8];
 	uint8_t sprite_x_counter[8]; // X pos of sprite (decremented every 8 cycles
+	int oam_y_byte_offset; // Sprite overflow bug, byte of OAM read as the Y pos
+	int sprite_y_offset; // Y offset of the sprite being fetched (cycles 257-320)
 
 	// BACKROUND
 	uint16_t vram_addr; // VRAM address - LoopyV (v)
@@ -122,6 +186,16 @@ struct Ppu2C02 {
 	int l_sl;
 	int l_cl;
 
+	// Scanline BG fast path, see render_bg_scanline()
+	uint64_t unobserved_until; // master clock dot the cpu next looks at the ppu (set when catching up)
+	bool bg_line_ready; // bg_line holds this scanline's BG pixels
+	uint8_t bg_line[256]; // palette RAM offset of each BG pixel, 0 for the backdrop
+
+	// Per scanline sprite pixels, see render_sprite_line()
+	bool sprite_line_ready; // sprite_line holds this scanline's sprites
+	uint16_t sprite_line_first; // dot it was rendered from, the sprite registers are still as they were then
+	uint8_t sprite_line[256]; // sprite line entry (compositor.h) of each pixel
+
 	uint32_t scanline; // Pre-render = 261, visible = 0-239, post-render 240-260
 	uint32_t nmi_start; // Scanline in which NMI starts, set value depending on NTSC or PAL
 	const uint32_t nmi_end; // Scanline in which NMI end
@@ -129,8 +203,14 @@ struct Ppu2C02 {
 	uint16_t old_cycle;
 	uint32_t old_scanline;
 	bool odd_frame;
-};
+	unsigned warmup_count; // Steps of the power-up VBL warm-up sequence done
 
+	// Output framebuffers (ARGB8888), pixels is filled a pixel at a time
+	// during the visible scanlines, nt_pixels backs the nametable viewer
+	// Keep these last, save states stop at pixels (see save_state.c)
+	uint32_t pixels[256 * 240];
+	uint32_t nt_pixels[512 * 480];
+};
 
 /* Initialise Function */
 Ppu2C02* ppu_allocator(void);
@@ -147,6 +227,14 @@ uint16_t nametable_y_offset_address(const unsigned coarse_y);
 void write_to_ppu_vram(struct PpuMemoryMap* mem, unsigned addr, uint8_t data);
 uint8_t read_from_ppu_vram(const struct PpuMemoryMap* mem, unsigned addr);
 
+/* CHR tile row cache, rows holds size / 2 entries (a row per 16 bit plane
+ * pair), writes to CHR RAM through write_to_ppu_vram() keep it up to date
+ */
+void ppu_decode_chr(struct ChrRow* rows, const uint8_t* chr_data, uint32_t size);
+void ppu_attach_chr_rows(struct PpuMemoryMap* mem, const uint8_t* chr_data, uint32_t size, struct ChrRow* rows);
+// Row of the tile at pattern table address addr (the lo bitplane byte)
+struct ChrRow ppu_chr_row(const struct PpuMemoryMap* mem, unsigned addr);
+
 void inc_vert_scroll(CpuPpuShare* cpu_ppu_io);
 void inc_horz_scroll(CpuPpuShare* cpu_ppu_io);
 
@@ -183,10 +271,26 @@ bool sprite_is_front_priority(const Ppu2C02* ppu, unsigned scanline_sprite_index
 
 void get_bkg_pixel(Ppu2C02* ppu, uint8_t* colour_ref);
 void get_sprite_pixel(Ppu2C02* ppu, uint8_t* colour_ref);
+void render_sprite_line(Ppu2C02* p, unsigned first); // sprite_line from the dot first
 void get_pixel(struct CurrentPixel* current_pixel, bool sprite_in_front_of_bkg);
 
 
 void clock_ppu(Ppu2C02* p, Cpu6502* cpu, Sdl2DisplayOutputs* cnes_windows);
+// Bitmask of enum PpuDotAction, scanline 0-261 and cycle 0-340
+uint32_t ppu_dot_actions(unsigned scanline, unsigned cycle);
+/* Dots the ppu can run before it next raises anything the cpu polls
+ * (NMI lookahead/pending, status clear), 0 if one is due now
+ */
+unsigned ppu_quiet_dots(const Ppu2C02* p);
+/* Dots from the current one where clock_ppu() would only move the counters
+ * on (and output backdrop pixels while rendering is off): VBlank after the
+ * NMI window and frames with BG and sprites disabled. Stops short of the
+ * next event (e.g. a buffered register write), sprite 0 hit, the status/NMI
+ * dots and the odd frame skip
+ */
+unsigned ppu_idle_dots(const Ppu2C02* p);
+// Same as calling clock_ppu() dots times, dots must be <= ppu_idle_dots()
+void ppu_skip_idle_dots(Ppu2C02* p, unsigned dots);
 
 
 #endif /* __NES_PPU__ */
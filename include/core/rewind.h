@@ -0,0 +1,66 @@
+/*
+ * Rewind: a fixed size ring of per-frame save states
+ *
+ * Every frame is stored as the XOR of its save state with the previous
+ * frame's, run length encoded (most of the machine doesn't change frame to
+ * frame so the XOR is mostly zeros). Every keyframe_interval frames a whole
+ * state is stored (RLE'd) instead. Restoring a frame costs at most one
+ * keyframe decode plus keyframe_interval - 1 deltas, stepping back a single
+ * frame from the newest costs one delta. Once the ring is full the oldest
+ * frames are dropped.
+ */
+#ifndef __NES_REWIND__
+#define __NES_REWIND__
+
+#include "nes_fwd.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define REWIND_DEFAULT_KEYFRAME_INTERVAL 8U
+
+typedef struct RewindBuffer RewindBuffer;
+
+struct RewindFrame {
+	size_t offset; // into the ring's data
+	size_t size;
+	bool keyframe;
+};
+
+struct RewindBuffer {
+	uint8_t* data; // encoded frames, used as a ring
+	size_t data_size;
+	size_t write_pos;
+
+	struct RewindFrame* frames; // ring of frames, oldest first
+	unsigned max_frames;
+	unsigned first;
+	unsigned count;
+	unsigned keyframe_interval;
+	unsigned since_keyframe; // frames pushed since the newest keyframe
+
+	size_t state_size;
+	uint8_t* head_state; // newest frame's state, decoded
+	uint8_t* work_state;
+	uint8_t* encode_buffer; // worst case encoded frame
+	size_t encode_buffer_size;
+};
+
+RewindBuffer* rewind_buffer_allocator(void);
+/* memory_budget is the size of the encoded frame ring, e.g. 64 MiB for
+ * 60 seconds (max_frames = 3600), console must have its cart loaded
+ */
+int rewind_buffer_init(RewindBuffer* rb, const Nes* nes, size_t memory_budget
+                      , unsigned max_frames, unsigned keyframe_interval);
+/* Stores the console's current state as the newest frame */
+int rewind_buffer_push(RewindBuffer* rb, const Nes* nes);
+/* Loads the frame pushed frames_back frames before the newest (0 = newest)
+ * and drops every newer frame, returns the number of frames rewound or -1
+ * if there is nothing to rewind to. Clamps to the oldest frame.
+ */
+int rewind_buffer_restore(RewindBuffer* rb, Nes* nes, unsigned frames_back);
+unsigned rewind_buffer_frame_count(const RewindBuffer* rb);
+void rewind_buffer_free(RewindBuffer* rb);
+
+#endif /* __NES_REWIND__ */
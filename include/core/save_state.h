@@ -0,0 +1,29 @@
+/*
+ * Whole machine save states (cpu, ppu, cpu/ppu and cpu/mapper shared state,
+ * PRG RAM and CHR RAM), captured to and restored from a flat buffer.
+ *
+ * Structs are copied as raw bytes, the header records the format version and
+ * each struct's size so states from an incompatible build are rejected.
+ * Pointers are never stored, anything pointing into emulated memory (cpu
+ * memory map pages, ppu pattern tables/nametables) is saved as an offset and
+ * re-linked on load. A state can only be loaded into a console running the
+ * same cart.
+ */
+#ifndef __NES_SAVE_STATE__
+#define __NES_SAVE_STATE__
+
+#include "nes_fwd.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SAVE_STATE_VERSION 1U
+
+/* Size of the buffer needed by nes_save_state() for the currently loaded cart */
+size_t nes_save_state_size(const Nes* nes);
+/* Returns the number of bytes written, 0 if the buffer is too small or the state can't be captured */
+size_t nes_save_state(const Nes* nes, uint8_t* buffer, size_t buffer_size);
+/* Returns non-zero (leaving the console untouched) if the state doesn't match this build or cart */
+int nes_load_state(Nes* nes, const uint8_t* buffer, size_t buffer_size);
+
+#endif /* __NES_SAVE_STATE__ */
@@ -0,0 +1,78 @@
+/*
+ * Binary CPU trace: a fixed size ring of instruction records
+ *
+ * When a trace is attached to the cpu (cpu_attach_trace()) every opcode fetch
+ * stores one fixed size record, no formatting or I/O happens while the
+ * emulator runs. Once full the oldest records are overwritten, so the ring
+ * always holds the last max_records instructions. cpu_trace_flush() writes
+ * the ring to a file which cnes-tracedump turns into nestest style text.
+ */
+#ifndef __NES_TRACE__
+#define __NES_TRACE__
+
+#include "trace_fwd.h"
+#include "cpu_fwd.h"
+#include "ppu_fwd.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRACE_VERSION 1U
+#define TRACE_DEFAULT_MAX_RECORDS (1U << 20) // 24 MiB, ~1.7 seconds of emulation
+#define TRACE_LINE_SIZE 128U // enough for any cpu_trace_format_record() line
+
+/* One instruction, the cpu state is from before it executed (like nestest.log) */
+struct TraceRecord {
+	uint64_t cpu_cycle; // cycle the opcode fetch started on
+	uint16_t pc;
+	uint16_t ppu_dot;
+	uint16_t scanline;
+	uint8_t opcode;
+	uint8_t operand_lo; // bytes following the opcode, 0 if they're in I/O space
+	uint8_t operand_hi;
+	uint8_t A;
+	uint8_t X;
+	uint8_t Y;
+	uint8_t P;
+	uint8_t SP;
+	uint8_t reserved[2];
+};
+
+struct CpuTrace {
+	struct TraceRecord* records;
+	size_t max_records; // power of two
+	uint64_t count; // records ever written, the newest is at (count - 1) & (max_records - 1)
+	const Ppu2C02* ppu; // source of the dot/scanline, may be NULL
+};
+
+CpuTrace* cpu_trace_allocator(void);
+/* max_records is rounded up to a power of two */
+int cpu_trace_init(CpuTrace* trace, size_t max_records, const Ppu2C02* ppu);
+/* Called on an opcode fetch, before the PC is incremented */
+void cpu_trace_record(CpuTrace* trace, const Cpu6502* cpu);
+/* Number of records held, at most max_records */
+size_t cpu_trace_count(const CpuTrace* trace);
+/* index 0 is the oldest record held */
+const struct TraceRecord* cpu_trace_get(const CpuTrace* trace, size_t index);
+void cpu_trace_clear(CpuTrace* trace);
+/* Writes the held records, oldest first, through a shared mapping of filename
+ * Records are in host byte order, read them back on the same kind of host
+ */
+int cpu_trace_flush(const CpuTrace* trace, const char* filename);
+/* nestest.log style line (without a newline), e.g.
+ * C000  4C F5 C5  JMP $C5F5                       A:00 X:00 Y:00 P:24 SP:FD PPU:  0, 21 CYC:7
+ */
+void cpu_trace_format_record(const struct TraceRecord* record, char* line, size_t size);
+void cpu_trace_free(CpuTrace* trace);
+
+/* Trace files written by cpu_trace_flush() */
+struct TraceFileHeader {
+	char magic[4]; // "CNTR"
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t reserved;
+	uint64_t record_count;
+};
+extern const char trace_file_magic[4];
+
+#endif /* __NES_TRACE__ */
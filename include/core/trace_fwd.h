@@ -0,0 +1,7 @@
+#ifndef __TRACE_FWD__
+#define __TRACE_FWD__
+
+// Ensure forward declerations come before other includes
+typedef struct CpuTrace CpuTrace;
+
+#endif /* __TRACE_FWD__ */
@@ -0,0 +1,535 @@
+/* Benchmark suite: fixed workloads run headlessly, results printed as JSON
+ *
+ * The workloads are small ROM images built in memory so the numbers don't
+ * depend on what games happen to be lying around. A ROM (plus an input
+ * movie) can be added on the command line. Each workload is run with the
+ * whole console clocked in lockstep and, where it makes sense, with only the
+ * CPU clocked (PPU stubbed out) or only the PPU clocked.
+ */
+
+#include "cnes.h"
+#include "nes.h"
+#include "cart.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "movie.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define DEFAULT_BENCH_FRAMES 300UL
+#define PPU_DOTS_PER_FRAME (341UL * 262UL)
+#define PRG_BANK_SIZE (16 * KiB)
+#define CHR_BANK_SIZE (8 * KiB)
+
+enum BenchVariant {
+	FULL,     // cpu and ppu in lockstep, as cnes-headless runs
+	CPU_ONLY, // ppu is never clocked
+	PPU_ONLY, // cpu is never clocked (after a warm up with both)
+};
+
+static const char* variant_names[] = {"full", "cpu_only", "ppu_only"};
+
+struct BenchRom {
+	const char* name;
+	uint8_t* image;
+	size_t size;
+	InputMovie* movie;
+	bool cpu_only;
+	bool ppu_only;
+};
+
+struct BenchResult {
+	unsigned long frames;
+	unsigned long cpu_cycles;
+	unsigned long instructions;
+	double seconds;
+};
+
+
+static void bench_usuage(const char* program_name)
+{
+	fprintf(stderr, "\nUSAGE: %s [options]\n", program_name);
+	fprintf(stderr, "OPTIONS:\n");
+	fprintf(stderr, "\t-h\n\tShows all the possible command-line options\n\n");
+	fprintf(stderr, "\t-f FRAMES\n\tEmulated frames per workload (default %lu)\n\n", DEFAULT_BENCH_FRAMES);
+	fprintf(stderr, "\t-o FILE\n\tAlso benchmark the provided .nes file\n\n");
+	fprintf(stderr, "\t-p MOVIE\n\tPlay back MOVIE on the file given with -o\n\n");
+	fprintf(stderr, "\t-l LABEL\n\tLabel stored in the results (e.g. a commit hash)\n");
+}
+
+static uint8_t* make_ines_image(unsigned prg_banks, unsigned chr_banks, unsigned mapper, size_t* size)
+{
+	*size = 16 + prg_banks * PRG_BANK_SIZE + chr_banks * CHR_BANK_SIZE;
+	uint8_t* image = calloc(1, *size);
+	if (!image) {
+		fprintf(stderr, "Failed to allocate enough memory for a bench ROM\n");
+		return NULL;
+	}
+
+	const uint8_t header[16] = {'N', 'E', 'S', 0x1A, prg_banks, chr_banks
+	                           , ((mapper & 0x0F) << 4) | 0x01, mapper & 0xF0};
+	memcpy(image, header, sizeof(header));
+
+	// some non-blank tiles
+	uint8_t* chr = &image[16 + prg_banks * PRG_BANK_SIZE];
+	for (size_t i = 0; i < chr_banks * CHR_BANK_SIZE; i++) {
+		chr[i] = ((i * 37) ^ (i >> 3) ^ ((i >> 12) * 91)) & 0xFF;
+	}
+
+	return image;
+}
+
+// code goes at $C000 in the last PRG bank, reset and NMI vectors point at reset/nmi
+static void place_program(uint8_t* image, unsigned prg_banks, const uint8_t* code, size_t code_size
+                         , uint16_t reset, uint16_t nmi)
+{
+	uint8_t* last_bank = &image[16 + (prg_banks - 1) * PRG_BANK_SIZE];
+	memcpy(last_bank, code, code_size);
+	last_bank[0x3FFA] = nmi & 0xFF;
+	last_bank[0x3FFB] = nmi >> 8;
+	last_bank[0x3FFC] = reset & 0xFF;
+	last_bank[0x3FFD] = reset >> 8;
+	last_bank[0x3FFE] = nmi & 0xFF;
+	last_bank[0x3FFF] = nmi >> 8;
+}
+
+/* CPU bound: rendering stays off, loads/adds/stores over a page of RAM forever */
+static uint8_t* build_cpu_loop_rom(size_t* size)
+{
+	const uint8_t program[] = {
+		0xA2, 0x00,       // C000: LDX #$00
+		0xBD, 0x00, 0x02, // C002: LDA $0200,X
+		0x18,             // C005: CLC
+		0x69, 0x03,       // C006: ADC #$03
+		0x9D, 0x00, 0x02, // C008: STA $0200,X
+		0x45, 0x00,       // C00B: EOR $00
+		0x85, 0x00,       // C00D: STA $00
+		0xE8,             // C00F: INX
+		0xD0, 0xF0,       // C010: BNE $C002
+		0xE6, 0x01,       // C012: INC $01
+		0x4C, 0x00, 0xC0, // C014: JMP $C000
+		0x40,             // C017: RTI
+	};
+	uint8_t* image = make_ines_image(1, 1, 0, size);
+	if (image) {
+		place_program(image, 1, program, sizeof(program), 0xC000, 0xC017);
+	}
+
+	return image;
+}
+
+/* Rendering heavy: full nametable, background + 64 sprites, the NMI does an
+ * OAM DMA and scrolls every frame, the main loop idles
+ */
+static uint8_t* build_render_rom(size_t* size)
+{
+	const uint8_t program[] = {
+		0x78,             // C000: SEI
+		0xA2, 0xFF,       // C001: LDX #$FF
+		0x9A,             // C003: TXS
+		0x2C, 0x02, 0x20, // C004: BIT $2002
+		0x10, 0xFB,       // C007: BPL $C004
+		0x2C, 0x02, 0x20, // C009: BIT $2002
+		0x10, 0xFB,       // C00C: BPL $C009
+		0xA9, 0x20,       // C00E: LDA #$20
+		0x8D, 0x06, 0x20, // C010: STA $2006
+		0xA9, 0x00,       // C013: LDA #$00
+		0x8D, 0x06, 0x20, // C015: STA $2006
+		0xA0, 0x04,       // C018: LDY #$04
+		0xA2, 0x00,       // C01A: LDX #$00
+		0x8A,             // C01C: TXA
+		0x8D, 0x07, 0x20, // C01D: STA $2007
+		0xE8,             // C020: INX
+		0xD0, 0xF9,       // C021: BNE $C01C
+		0x88,             // C023: DEY
+		0xD0, 0xF6,       // C024: BNE $C01C
+		0xA2, 0x00,       // C026: LDX #$00
+		0x8A,             // C028: TXA
+		0x9D, 0x00, 0x02, // C029: STA $0200,X
+		0xE8,             // C02C: INX
+		0xD0, 0xF9,       // C02D: BNE $C028
+		0xA9, 0x3F,       // C02F: LDA #$3F
+		0x8D, 0x06, 0x20, // C031: STA $2006
+		0xA9, 0x00,       // C034: LDA #$00
+		0x8D, 0x06, 0x20, // C036: STA $2006
+		0xA2, 0x00,       // C039: LDX #$00
+		0x8E, 0x07, 0x20, // C03B: STX $2007
+		0xE8,             // C03E: INX
+		0xE0, 0x20,       // C03F: CPX #$20
+		0xD0, 0xF8,       // C041: BNE $C03B
+		0xA9, 0x80,       // C043: LDA #$80
+		0x8D, 0x00, 0x20, // C045: STA $2000
+		0xA9, 0x1E,       // C048: LDA #$1E
+		0x8D, 0x01, 0x20, // C04A: STA $2001
+		0x4C, 0x4D, 0xC0, // C04D: JMP $C04D
+		0x48,             // C050: PHA (NMI)
+		0xA9, 0x00,       // C051: LDA #$00
+		0x8D, 0x03, 0x20, // C053: STA $2003
+		0xA9, 0x02,       // C056: LDA #$02
+		0x8D, 0x14, 0x40, // C058: STA $4014
+		0xE6, 0x10,       // C05B: INC $10
+		0xA5, 0x10,       // C05D: LDA $10
+		0x8D, 0x05, 0x20, // C05F: STA $2005
+		0x8D, 0x05, 0x20, // C062: STA $2005
+		0x68,             // C065: PLA
+		0x40,             // C066: RTI
+	};
+	uint8_t* image = make_ines_image(1, 1, 0, size);
+	if (image) {
+		place_program(image, 1, program, sizeof(program), 0xC000, 0xC050);
+	}
+
+	return image;
+}
+
+/* MMC1 bank switch heavy: 128 KiB PRG, 32 KiB CHR, every pass of the main
+ * loop switches the $8000 PRG bank and CHR bank through the serial port and
+ * reads from the new bank
+ */
+static uint8_t* build_mmc1_rom(size_t* size)
+{
+	const uint8_t program[] = {
+		0x78,             // C000: SEI
+		0xD8,             // C001: CLD
+		0xA2, 0xFF,       // C002: LDX #$FF
+		0x9A,             // C004: TXS
+		0xA9, 0x80,       // C005: LDA #$80
+		0x8D, 0x00, 0x80, // C007: STA $8000 (reset the shift register)
+		0xA9, 0x0E,       // C00A: LDA #$0E (fix the last bank at $C000)
+		0x8D, 0x00, 0x80, // C00C: STA $8000
+		0x4A,             // C00F: LSR
+		0x8D, 0x00, 0x80, // C010: STA $8000
+		0x4A,             // C013: LSR
+		0x8D, 0x00, 0x80, // C014: STA $8000
+		0x4A,             // C017: LSR
+		0x8D, 0x00, 0x80, // C018: STA $8000
+		0x4A,             // C01B: LSR
+		0x8D, 0x00, 0x80, // C01C: STA $8000
+		0xE6, 0x10,       // C01F: INC $10
+		0xA5, 0x10,       // C021: LDA $10
+		0x29, 0x07,       // C023: AND #$07
+		0x8D, 0x00, 0xE0, // C025: STA $E000 (PRG bank)
+		0x4A,             // C028: LSR
+		0x8D, 0x00, 0xE0, // C029: STA $E000
+		0x4A,             // C02C: LSR
+		0x8D, 0x00, 0xE0, // C02D: STA $E000
+		0x4A,             // C030: LSR
+		0x8D, 0x00, 0xE0, // C031: STA $E000
+		0x4A,             // C034: LSR
+		0x8D, 0x00, 0xE0, // C035: STA $E000
+		0xAD, 0x00, 0x80, // C038: LDA $8000
+		0xA6, 0x10,       // C03B: LDX $10
+		0x9D, 0x00, 0x03, // C03D: STA $0300,X
+		0xA5, 0x10,       // C040: LDA $10
+		0x8D, 0x00, 0xA0, // C042: STA $A000 (CHR bank)
+		0x4A,             // C045: LSR
+		0x8D, 0x00, 0xA0, // C046: STA $A000
+		0x4A,             // C049: LSR
+		0x8D, 0x00, 0xA0, // C04A: STA $A000
+		0x4A,             // C04D: LSR
+		0x8D, 0x00, 0xA0, // C04E: STA $A000
+		0x4A,             // C051: LSR
+		0x8D, 0x00, 0xA0, // C052: STA $A000
+		0x4C, 0x1F, 0xC0, // C055: JMP $C01F
+		0x40,             // C058: RTI
+	};
+	const unsigned prg_banks = 8;
+	uint8_t* image = make_ines_image(prg_banks, 4, 1, size);
+	if (image) {
+		// tag each bank so the reads differ
+		for (unsigned bank = 0; bank < prg_banks - 1; bank++) {
+			memset(&image[16 + bank * PRG_BANK_SIZE], bank, PRG_BANK_SIZE);
+		}
+		place_program(image, prg_banks, program, sizeof(program), 0xC000, 0xC058);
+	}
+
+	return image;
+}
+
+static uint8_t* read_rom_file(const char* filename, size_t* size)
+{
+	FILE* file = fopen(filename, "rb");
+	if (!file) {
+		fprintf(stderr, "Unable to open %s\n", filename);
+		return NULL;
+	}
+
+	uint8_t* image = NULL;
+	if (!fseek(file, 0, SEEK_END)) {
+		long file_size = ftell(file);
+		if (file_size > 0 && !fseek(file, 0, SEEK_SET)) {
+			image = malloc(file_size);
+			if (image && fread(image, file_size, 1, file) != 1) {
+				free(image);
+				image = NULL;
+			}
+			*size = file_size;
+		}
+	}
+	if (!image) {
+		fprintf(stderr, "Failed to read %s\n", filename);
+	}
+	fclose(file);
+
+	return image;
+}
+
+static int run_bench(const struct BenchRom* rom, enum BenchVariant variant
+                    , unsigned long frames, struct BenchResult* result)
+{
+	memset(result, 0, sizeof(*result));
+
+	Nes* nes = cnes_create();
+	if (!nes || cnes_load_rom_from_memory(nes, rom->image, rom->size)) {
+		fprintf(stderr, "Failed to load bench workload %s\n", rom->name);
+		cnes_destroy(nes);
+		return -1;
+	}
+	Cpu6502* cpu = nes->cpu;
+	Ppu2C02* ppu = nes->ppu;
+
+	if (variant == PPU_ONLY) {
+		// let the program switch rendering on and fill vram first
+		for (int i = 0; i < 10; i++) {
+			cnes_run_frame(nes);
+		}
+	}
+	if (variant != FULL) {
+		// the units are clocked on their own, stop clock_cpu() catching the ppu up
+		cpu_sync_ppu(cpu);
+		cpu_attach_ppu(cpu, NULL, NULL);
+	}
+
+	InputMovie* movie = rom->movie;
+	if (movie) {
+		movie->play_frame = 0;
+		movie->next_input = 0;
+		movie_play_frame(movie, nes);
+	}
+
+	cpu->trigger_trace_logger = false;
+	uint64_t start_cycle = cpu->cycle;
+	unsigned long cpu_cycles_per_frame = PPU_DOTS_PER_FRAME / 3;
+	bool last_odd_frame = ppu->odd_frame;
+	clock_t start = clock();
+	while (result->frames < frames) {
+		switch (variant) {
+		case FULL:
+			clock_cpu_and_ppu(cpu); // 3 : 1 PPU to CPU ratio
+			break;
+		case CPU_ONLY:
+			clock_cpu(cpu);
+			// no ppu to end the frame, count a frame's worth of cpu cycles
+			if ((cpu->cycle - start_cycle) >= (result->frames + 1) * cpu_cycles_per_frame) {
+				++result->frames;
+			}
+			break;
+		case PPU_ONLY:
+			clock_ppu(ppu, cpu, &nes->cnes_windows);
+			break;
+		}
+
+		if (cpu->trigger_trace_logger) {
+			cpu->trigger_trace_logger = false;
+			++result->instructions;
+		}
+
+		// odd_frame flips once per frame (at the end of the pre-render scanline)
+		if (ppu->odd_frame != last_odd_frame) {
+			last_odd_frame = ppu->odd_frame;
+			++result->frames;
+			if (movie) {
+				movie_play_frame(movie, nes);
+			}
+		}
+	}
+	result->seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+	result->cpu_cycles = cpu->cycle - start_cycle;
+
+	cnes_destroy(nes);
+
+	return 0;
+}
+
+/* Prints str as a quoted JSON string, the label and ROM path come from the
+ * command line and can hold anything
+ */
+static void print_json_string(const char* str)
+{
+	putchar('"');
+	for (const unsigned char* c = (const unsigned char*) str; *c; c++) {
+		switch (*c) {
+		case '"':  fputs("\\\"", stdout); break;
+		case '\\': fputs("\\\\", stdout); break;
+		case '\n': fputs("\\n", stdout); break;
+		case '\r': fputs("\\r", stdout); break;
+		case '\t': fputs("\\t", stdout); break;
+		default:
+			if (*c < 0x20) {
+				printf("\\u%04x", *c); // other control characters
+			} else {
+				putchar(*c);
+			}
+			break;
+		}
+	}
+	putchar('"');
+}
+
+static void print_result_start(const char* name, enum BenchVariant variant, bool first)
+{
+	printf("%s\n    {\"workload\": ", first ? "" : ",");
+	print_json_string(name);
+	printf(", \"variant\": \"%s\", ", variant_names[variant]);
+}
+
+// A workload that didn't run gets a row without any numbers to compare
+static void print_error_result(const char* name, enum BenchVariant variant, bool first)
+{
+	print_result_start(name, variant, first);
+	printf("\"error\": \"failed to load\"}");
+}
+
+static void print_result(const char* name, enum BenchVariant variant, const struct BenchResult* result, bool first)
+{
+	double seconds = result->seconds > 0.0 ? result->seconds : 1e-9;
+
+	print_result_start(name, variant, first);
+	printf("\"frames\": %lu, \"cpu_cycles\": %lu, \"instructions\": %lu, \"seconds\": %.6f, "
+	      , result->frames, result->cpu_cycles, result->instructions, result->seconds);
+	printf("\"ns_per_frame\": %.1f, \"frames_per_sec\": %.2f, \"instructions_per_sec\": %.0f}"
+	      , result->frames ? seconds * 1e9 / result->frames : 0.0
+	      , result->frames / seconds, result->instructions / seconds);
+}
+
+int main(int argc, char** argv)
+{
+	int ret = -1;
+
+	const char* program_name = "cnes-bench";
+	const char* rom_filename = NULL;
+	const char* movie_filename = NULL;
+	const char* label = "";
+	unsigned long frames = DEFAULT_BENCH_FRAMES;
+	bool help = false;
+
+	// process command line arguments
+	while ((argc > 1) && (argv[1][0] == '-')) {
+		// make sure -x isn't the same as -xxxxxxx (where x is any command line option)
+		if (strlen(argv[1]) > 2) {
+			fprintf(stderr, "Command line option must be a single character when using the '-' option\n");
+			help = true;
+			break;
+		}
+
+		if (argv[1][1] != 'h' && argc < 3) {
+			fprintf(stderr, "Option -%c needs an argument\n", argv[1][1]);
+			help = true;
+			break;
+		}
+
+		switch (argv[1][1]) {
+		case 'h': // h - display help message
+			help = true;
+			break;
+		case 'f': // f - frames per workload
+			frames = strtoul(argv[2], NULL, 10);
+			--argc;
+			++argv;
+			break;
+		case 'o': // o - extra workload from a file
+			rom_filename = argv[2];
+			--argc;
+			++argv;
+			break;
+		case 'p': // p - movie to play on the extra workload
+			movie_filename = argv[2];
+			--argc;
+			++argv;
+			break;
+		case 'l': // l - label for the results
+			label = argv[2];
+			--argc;
+			++argv;
+			break;
+		}
+		// increment argv and decrement argc
+		--argc;
+		++argv;
+	}
+
+	if (help || !frames || (movie_filename && !rom_filename)) {
+		bench_usuage(program_name);
+		goto early_return;
+	}
+
+	struct BenchRom roms[4] = {
+		{.name = "cpu_loop", .cpu_only = true},
+		{.name = "render", .ppu_only = true},
+		{.name = "mmc1_bank_switch", .cpu_only = true},
+		{.name = rom_filename, .cpu_only = true, .ppu_only = true},
+	};
+	roms[0].image = build_cpu_loop_rom(&roms[0].size);
+	roms[1].image = build_render_rom(&roms[1].size);
+	roms[2].image = build_mmc1_rom(&roms[2].size);
+	unsigned rom_count = 3;
+	if (rom_filename) {
+		roms[3].image = read_rom_file(rom_filename, &roms[3].size);
+		rom_count = 4;
+	}
+	for (unsigned i = 0; i < rom_count; i++) {
+		if (!roms[i].image) {
+			goto program_exit;
+		}
+	}
+
+	if (movie_filename) {
+		// the movie is checked against the ROM it was recorded on
+		Nes* nes = cnes_create();
+		roms[3].movie = movie_allocator();
+		if (!nes || !roms[3].movie || cnes_load_rom_from_memory(nes, roms[3].image, roms[3].size)
+		   || movie_load(roms[3].movie, movie_filename, nes)) {
+			cnes_destroy(nes);
+			goto program_exit;
+		}
+		cnes_destroy(nes);
+	}
+
+	printf("{\n  \"label\": ");
+	print_json_string(label);
+	printf(",\n  \"frames_per_workload\": %lu,\n  \"results\": [", frames);
+	bool first = true;
+	bool failed = false;
+	for (unsigned i = 0; i < rom_count; i++) {
+		for (enum BenchVariant variant = FULL; variant <= PPU_ONLY; variant++) {
+			if ((variant == CPU_ONLY && !roms[i].cpu_only) || (variant == PPU_ONLY && !roms[i].ppu_only)) {
+				continue;
+			}
+			struct BenchResult result;
+			if (run_bench(&roms[i], variant, frames, &result)) {
+				print_error_result(roms[i].name, variant, first);
+				failed = true;
+			} else {
+				print_result(roms[i].name, variant, &result, first);
+			}
+			fflush(stdout);
+			first = false;
+		}
+	}
+	printf("\n  ]\n}\n");
+
+	ret = failed ? -1 : 0;
+
+program_exit:
+	for (unsigned i = 0; i < 4; i++) {
+		free(roms[i].image);
+		movie_free(roms[i].movie);
+	}
+
+early_return:
+	return ret;
+}
@@ -0,0 +1,159 @@
+#include "block_cache.h"
+#include "cart.h"
+#include "cpu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// control flow leaves the block after these
+static bool ends_block(uint8_t opcode)
+{
+	switch (opcode) {
+	case 0x00: // BRK
+	case 0x20: // JSR
+	case 0x40: // RTI
+	case 0x4C: // JMP abs
+	case 0x60: // RTS
+	case 0x6C: // JMP ind
+		return true;
+	default:
+		return isa_info[opcode].address_mode == REL; // branches
+	}
+}
+
+BlockCache* block_cache_allocator(void)
+{
+	BlockCache* cache = calloc(1, sizeof(BlockCache));
+	if (!cache) {
+		fprintf(stderr, "Failed to allocate enough memory for BlockCache\n");
+	}
+
+	return cache;
+}
+
+int block_cache_init(BlockCache* cache, const CartMemory* prg_rom)
+{
+	cache->prg_rom = prg_rom->data;
+	cache->prg_rom_size = prg_rom->size;
+	cache->bank_count = (prg_rom->size + BLOCK_CACHE_BANK_SIZE - 1) / BLOCK_CACHE_BANK_SIZE;
+	cache->banks = calloc(cache->bank_count ? cache->bank_count : 1, sizeof(struct DecodedInstruction*));
+	if (!cache->banks) {
+		fprintf(stderr, "Failed to allocate enough memory for the block cache\n");
+		return -1;
+	}
+	block_cache_unmap_pages(cache, 0, BLOCK_CACHE_PAGE_COUNT);
+
+	return 0;
+}
+
+// entries of the PRG ROM page mapped at a cpu page, NULL if it's not PRG ROM
+static const struct DecodedInstruction* map_page(BlockCache* cache, const Cpu6502* cpu, unsigned page)
+{
+	const uint8_t* mem = cpu->read_page[page];
+	if (!mem || cpu->write_page[page] || (mem < cache->prg_rom)
+	    || (mem >= cache->prg_rom + cache->prg_rom_size)) {
+		return NULL;
+	}
+
+	size_t offset = mem - cache->prg_rom;
+	struct DecodedInstruction** bank = &cache->banks[offset / BLOCK_CACHE_BANK_SIZE];
+	if (!*bank) {
+		*bank = calloc(BLOCK_CACHE_BANK_SIZE, sizeof(struct DecodedInstruction));
+		if (!*bank) {
+			fprintf(stderr, "Failed to allocate enough memory for a block cache bank\n");
+			return NULL;
+		}
+	}
+
+	return &(*bank)[offset % BLOCK_CACHE_BANK_SIZE];
+}
+
+// decode from offset until the end of the block, stops early at a decoded instruction
+static void decode_block(BlockCache* cache, size_t offset)
+{
+	struct DecodedInstruction* bank = cache->banks[offset / BLOCK_CACHE_BANK_SIZE];
+	size_t bank_end = (offset / BLOCK_CACHE_BANK_SIZE + 1) * BLOCK_CACHE_BANK_SIZE;
+	if (bank_end > cache->prg_rom_size) {
+		bank_end = cache->prg_rom_size;
+	}
+
+	while (1) {
+		struct DecodedInstruction* instruction = &bank[offset % BLOCK_CACHE_BANK_SIZE];
+		uint8_t opcode = cache->prg_rom[offset];
+		unsigned length = cpu_instruction_length(opcode);
+
+		// the next bank may not be mapped after this one, leave those to read_from_cpu()
+		if (instruction->length || !isa_info[opcode].max_cycles || (offset + length > bank_end)) {
+			break;
+		}
+		instruction->opcode = opcode;
+		instruction->operand_lo = length > 1 ? cache->prg_rom[offset + 1] : 0;
+		instruction->operand_hi = length > 2 ? cache->prg_rom[offset + 2] : 0;
+		instruction->length = length;
+		instruction->ends_block = ends_block(opcode) || (offset + length == bank_end);
+		if (instruction->ends_block) {
+			break;
+		}
+		offset += length;
+	}
+}
+
+const struct DecodedInstruction* block_cache_next(BlockCache* cache, const Cpu6502* cpu)
+{
+	uint16_t pc = cpu->PC;
+	const struct DecodedInstruction* instruction = cache->next;
+
+	if (!instruction || (cache->next_pc != pc) || !instruction->length) {
+		const struct DecodedInstruction* page = cache->page[pc >> 8];
+		if (!page) {
+			page = map_page(cache, cpu, pc >> 8);
+			if (!page) {
+				cache->next = NULL;
+				return NULL;
+			}
+			cache->page[pc >> 8] = page;
+		}
+
+		instruction = &page[pc & 0xFF];
+		if (!instruction->length) {
+			decode_block(cache, cpu->read_page[pc >> 8] + (pc & 0xFF) - cache->prg_rom);
+			if (!instruction->length) {
+				cache->next = NULL;
+				return NULL;
+			}
+		}
+	}
+
+	// the rest of the block follows on in the same bank
+	if (instruction->ends_block) {
+		cache->next = NULL;
+	} else {
+		cache->next = instruction + instruction->length;
+		cache->next_pc = pc + instruction->length;
+	}
+
+	return instruction;
+}
+
+void block_cache_unmap_pages(BlockCache* cache, unsigned first_page, unsigned page_count)
+{
+	for (unsigned i = first_page; i < first_page + page_count; i++) {
+		cache->page[i] = NULL;
+	}
+	cache->next = NULL;
+}
+
+void block_cache_free(BlockCache* cache)
+{
+	if (cache) {
+		if (cache->banks) {
+			for (size_t i = 0; i < cache->bank_count; i++) {
+				free(cache->banks[i]);
+			}
+		}
+		free(cache->banks);
+	}
+	free(cache);
+}
@@ -51,6 +51,7 @@ int cart_init(Cartridge* cart)
 
 	cart->chr_rom.data = NULL;
 	cart->chr_ram.data = NULL;
+	cart->chr_rows = NULL;
 	cart->prg_rom.data = NULL;
 	cart->trainer.data = NULL;
 
@@ -63,8 +64,6 @@ static void log_cart_info(const Cartridge* cart, const char* filename, const Cpu
 
 int parse_nes_cart_file(Cartridge* cart, const char* filename, Cpu6502* cpu, Ppu2C02* ppu)
 {
-	uint8_t header[16];
-	uint8_t mapper;
 	long file_size;
 
 	FILE* rom = fopen(filename, "rb");
@@ -87,10 +86,54 @@ int parse_nes_cart_file(Cartridge* cart, const char* filename, Cpu6502* cpu, Ppu
 		return 8;
 	}
 
+	uint8_t* rom_data = malloc(file_size);
+	if (!rom_data) {
+		fclose(rom);
+		return 8;
+	}
+
+	if (fread(rom_data, 1, file_size, rom) != (size_t) file_size) {
+		fprintf(stderr, "Error: unable to read ROM file.\n");
+		free(rom_data);
+		fclose(rom);
+		return 8;
+	}
+	fclose(rom);
+
+	int ret = parse_nes_cart_data(cart, rom_data, file_size, filename, cpu, ppu);
+	free(rom_data);
+
+	return ret;
+}
+
+/* Copies size bytes from the ROM image into dest, advancing the read offset */
+static int read_rom_bytes(uint8_t* dest, size_t size, const uint8_t* rom, size_t rom_size, size_t* offset)
+{
+	if (rom_size - *offset < size) {
+		fprintf(stderr, "Error: ROM image is truncated.\n");
+		return 8;
+	}
+	memcpy(dest, &rom[*offset], size);
+	*offset += size;
+
+	return 0;
+}
+
+int parse_nes_cart_data(Cartridge* cart, const uint8_t* rom, size_t rom_size, const char* name, Cpu6502* cpu, Ppu2C02* ppu)
+{
+	uint8_t header[16];
+	uint8_t mapper;
+	size_t offset = 0;
+
+	// minimum file size is a headerless .nes file w/ only a 16 KiB PRG ROM
+	if (rom_size < (16 * KiB - 1)) {
+		fprintf(stderr, "Error: input file is too small.\n");
+		return 8;
+	}
+
 	/* loading first 16 bytes of .nes file into header */
-	if (fread(header, 1, 16, rom) != 16) {
+	if (read_rom_bytes(header, 16, rom, rom_size, &offset)) {
 		fprintf(stderr, "Error: unable to read ROM header.\n");
-		fclose(rom);
 		return 8;
 	}
 
@@ -108,7 +151,6 @@ int parse_nes_cart_file(Cartridge* cart, const char* filename, Cpu6502* cpu, Ppu
 
 	if (cart->header == HEADERLESS) {
 		fprintf(stderr, "Error: unrecognised header, requires an offline database.\n");
-		fclose(rom);
 		return 8;
 	}
 
@@ -189,46 +231,60 @@ int parse_nes_cart_file(Cartridge* cart, const char* filename, Cpu6502* cpu, Ppu
 		}
 	}
 
-	log_cart_info(cart, filename, cpu, ppu, &header[0]);
+	if (name) {
+		log_cart_info(cart, name, cpu, ppu, &header[0]);
+	}
 
 	/* Load trainer into member variable */
 	if (cart->trainer.size) {
 		cart->trainer.data = malloc(cart->trainer.size);
 		if (!cart->trainer.data) {
-			fclose(rom);
 			return 8;
 		}
-		fread(cart->trainer.data, 1, 512, rom); // size is always 512 bytes if present
+		// size is always 512 bytes if present
+		if (read_rom_bytes(cart->trainer.data, 512, rom, rom_size, &offset)) {
+			return 8;
+		}
 	}
 
 	/* Loading data into PRG_ROM */
 	cart->prg_rom.data = malloc(cart->prg_rom.size);
 	if (!cart->prg_rom.data) {
-		fclose(rom);
 		return 8;
 	}
-	fread(cart->prg_rom.data, 1, cart->prg_rom.size, rom);
+	if (read_rom_bytes(cart->prg_rom.data, cart->prg_rom.size, rom, rom_size, &offset)) {
+		return 8;
+	}
 
 	/* Loading data into chr_rom */
 	if (cart->chr_rom.size) {
 		cart->chr_rom.data = malloc(cart->chr_rom.size);
 		if (!cart->chr_rom.data) {
-			fclose(rom);
 			return 8;
 		}
-		fread(cart->chr_rom.data, 1, cart->chr_rom.size, rom);
+		if (read_rom_bytes(cart->chr_rom.data, cart->chr_rom.size, rom, rom_size, &offset)) {
+			return 8;
+		}
 	}
 
 	/* Allocate any CHR RAM here too */
 	if (cart->chr_ram.size) {
 		cart->chr_ram.data = calloc(cart->chr_ram.size, sizeof(uint8_t));
 		if (!cart->chr_ram.data) {
-			fclose(rom);
 			return 8;
 		}
 	}
 
-	fclose(rom);
+	/* Predecode the CHR tile rows, CHR RAM starts out blank */
+	CartMemory* chr = cart->chr_rom.size ? &cart->chr_rom : &cart->chr_ram;
+	if (chr->size) {
+		cart->chr_rows = malloc((chr->size / 2) * sizeof(struct ChrRow));
+		if (!cart->chr_rows) {
+			return 8;
+		}
+		ppu_decode_chr(cart->chr_rows, chr->data, chr->size);
+	}
+	ppu_attach_chr_rows(&ppu->vram, chr->data, chr->size, cart->chr_rows);
 
 	/* Mapper select */
 	init_mapper(cart, cpu, ppu);
@@ -0,0 +1,183 @@
+#include "cnes.h"
+#include "nes.h"
+#include "save_state.h"
+#include "rewind.h"
+#include "trace.h"
+#include "cart.h"
+#include "cpu.h"
+#include "ppu.h"
+
+#include <stdlib.h>
+
+
+static void clock_all_units(Nes* nes)
+{
+	// 3 : 1 PPU to CPU ratio, the attached ppu catches up when it has to
+	clock_cpu_and_ppu(nes->cpu);
+}
+
+/* The ppu is attached from power on, clock_all_units() only clocks it
+ * through the cpu so a console with no ROM (or a failed load) still runs
+ */
+static int power_on(Nes* nes)
+{
+	if (nes_init(nes)) {
+		return -1;
+	}
+	cpu_attach_ppu(nes->cpu, nes->ppu, &nes->cnes_windows);
+
+	return 0;
+}
+
+Nes* cnes_create(void)
+{
+	Nes* nes = nes_allocator();
+	if (!nes) {
+		return NULL;
+	}
+
+	if (power_on(nes)) {
+		nes_free(nes);
+		return NULL;
+	}
+
+	return nes;
+}
+
+int cnes_load_rom_from_memory(Nes* nes, const uint8_t* rom, size_t size)
+{
+	// drop any previous cart and start from a freshly powered on console
+	free(nes->cart->chr_rom.data);
+	free(nes->cart->chr_ram.data);
+	free(nes->cart->chr_rows);
+	free(nes->cart->prg_rom.data);
+	free(nes->cart->trainer.data);
+	if (power_on(nes)) {
+		return -1;
+	}
+
+	if (parse_nes_cart_data(nes->cart, rom, size, NULL, nes->cpu, nes->ppu)) {
+		return -1;
+	}
+
+	init_pc(nes->cpu); // Initialise PC to reset vector
+	update_cpu_info(nes->cpu);
+	cpu_attach_ppu(nes->cpu, nes->ppu, &nes->cnes_windows); // in step with the reset cpu
+
+	return 0;
+}
+
+unsigned long cnes_run_frame(Nes* nes)
+{
+	uint64_t start_cycle = nes->cpu->cycle;
+
+	// odd_frame flips once per frame (at the end of the pre-render scanline)
+	bool odd_frame = nes->ppu->odd_frame;
+	while (nes->ppu->odd_frame == odd_frame) {
+		clock_all_units(nes);
+	}
+
+	return nes->cpu->cycle - start_cycle;
+}
+
+void cnes_run_cycles(Nes* nes, unsigned long cycles)
+{
+	for (unsigned long i = 0; i < cycles; i++) {
+		clock_all_units(nes);
+	}
+	cpu_sync_ppu(nes->cpu); // callers look at the ppu afterwards
+}
+
+void cnes_set_input(Nes* nes, unsigned port, uint8_t buttons)
+{
+	if (port == 0) {
+		nes->cpu->player_1_controller = buttons;
+	} else if (port == 1) {
+		nes->cpu->player_2_controller = buttons;
+	}
+}
+
+const uint32_t* cnes_framebuffer(const Nes* nes)
+{
+	return nes->ppu->pixels;
+}
+
+void cnes_destroy(Nes* nes)
+{
+	nes_free(nes);
+}
+
+size_t cnes_save_state_size(const Nes* nes)
+{
+	return nes_save_state_size(nes);
+}
+
+size_t cnes_save_state(const Nes* nes, uint8_t* buffer, size_t buffer_size)
+{
+	return nes_save_state(nes, buffer, buffer_size);
+}
+
+int cnes_load_state(Nes* nes, const uint8_t* buffer, size_t buffer_size)
+{
+	return nes_load_state(nes, buffer, buffer_size);
+}
+
+RewindBuffer* cnes_rewind_create(const Nes* nes, size_t memory_budget, unsigned max_frames)
+{
+	RewindBuffer* rb = rewind_buffer_allocator();
+	if (!rb) {
+		return NULL;
+	}
+
+	if (rewind_buffer_init(rb, nes, memory_budget, max_frames, REWIND_DEFAULT_KEYFRAME_INTERVAL)) {
+		rewind_buffer_free(rb);
+		return NULL;
+	}
+
+	return rb;
+}
+
+int cnes_rewind_push(RewindBuffer* rb, const Nes* nes)
+{
+	return rewind_buffer_push(rb, nes);
+}
+
+int cnes_rewind(RewindBuffer* rb, Nes* nes, unsigned frames_back)
+{
+	return rewind_buffer_restore(rb, nes, frames_back);
+}
+
+void cnes_rewind_destroy(RewindBuffer* rb)
+{
+	rewind_buffer_free(rb);
+}
+
+CpuTrace* cnes_trace_create(const Nes* nes, size_t max_records)
+{
+	CpuTrace* trace = cpu_trace_allocator();
+	if (!trace) {
+		return NULL;
+	}
+
+	if (cpu_trace_init(trace, max_records, nes->ppu)) {
+		cpu_trace_free(trace);
+		return NULL;
+	}
+
+	return trace;
+}
+
+void cnes_trace_attach(Nes* nes, CpuTrace* trace)
+{
+	cpu_attach_trace(nes->cpu, trace);
+}
+
+int cnes_trace_flush(const CpuTrace* trace, const char* filename)
+{
+	return cpu_trace_flush(trace, filename);
+}
+
+void cnes_trace_destroy(CpuTrace* trace)
+{
+	cpu_trace_free(trace);
+}
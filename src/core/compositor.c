@@ -0,0 +1,129 @@
+#include "compositor.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Opaque sprite pixels win unless they're behind an opaque BG pixel, if both
+ * are transparent the BG's offset (0, the backdrop colour) is used
+ */
+static inline uint8_t composite_pixel(uint8_t bg, uint8_t sprite)
+{
+	uint8_t sprite_offset = sprite & SPRITE_LINE_OFFSET;
+	return (sprite_offset && (!bg || !(sprite & SPRITE_LINE_BEHIND))) ? sprite_offset : bg;
+}
+
+void composite_scanline_scalar(uint32_t* out, const uint8_t* bg, const uint8_t* sprite, const uint32_t* colours)
+{
+	for (unsigned x = 0; x < COMPOSITOR_WIDTH; x++) {
+		out[x] = colours[composite_pixel(bg[x], sprite[x])];
+	}
+}
+
+#if defined(__AVX2__)
+// One byte of every colour, 16 entries per 128 bit lane as vpshufb only
+// shuffles within a lane, lo holds entries 0-15 and hi 16-31
+struct ColourPlane {
+	__m256i lo;
+	__m256i hi;
+};
+
+static struct ColourPlane colour_plane(const uint32_t* colours, unsigned byte)
+{
+	uint8_t plane[COMPOSITOR_COLOURS];
+	for (unsigned i = 0; i < COMPOSITOR_COLOURS; i++) {
+		plane[i] = (uint8_t) (colours[i] >> (8 * byte));
+	}
+
+	struct ColourPlane p;
+	p.lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) &plane[0]));
+	p.hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) &plane[16]));
+	return p;
+}
+
+static inline __m256i lookup_plane(const struct ColourPlane* p, __m256i offset, __m256i use_hi)
+{
+	return _mm256_blendv_epi8(_mm256_shuffle_epi8(p->lo, offset), _mm256_shuffle_epi8(p->hi, offset), use_hi);
+}
+
+void composite_scanline(uint32_t* out, const uint8_t* bg, const uint8_t* sprite, const uint32_t* colours)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i hi_bit = _mm256_set1_epi8(0x10);
+	const __m256i offset_bits = _mm256_set1_epi8(SPRITE_LINE_OFFSET);
+	const __m256i behind_bit = _mm256_set1_epi8(SPRITE_LINE_BEHIND);
+	struct ColourPlane planes[4];
+	for (unsigned byte = 0; byte < 4; byte++) {
+		planes[byte] = colour_plane(colours, byte);
+	}
+
+	for (unsigned x = 0; x < COMPOSITOR_WIDTH; x += 32) {
+		__m256i b = _mm256_loadu_si256((const __m256i*) &bg[x]);
+		__m256i entry = _mm256_loadu_si256((const __m256i*) &sprite[x]);
+		__m256i s = _mm256_and_si256(entry, offset_bits);
+		__m256i behind = _mm256_and_si256(entry, behind_bit);
+
+		// sprite where it's opaque and either the BG is transparent or it's in front
+		__m256i bg_clear = _mm256_cmpeq_epi8(b, zero);
+		__m256i in_front = _mm256_cmpeq_epi8(behind, zero);
+		__m256i use_sprite = _mm256_andnot_si256(_mm256_cmpeq_epi8(s, zero), _mm256_or_si256(bg_clear, in_front));
+		__m256i offset = _mm256_blendv_epi8(b, s, use_sprite);
+
+		// palette lookup a byte of the colour at a time
+		__m256i use_hi = _mm256_cmpeq_epi8(_mm256_and_si256(offset, hi_bit), hi_bit);
+		__m256i blue = lookup_plane(&planes[0], offset, use_hi);
+		__m256i green = lookup_plane(&planes[1], offset, use_hi);
+		__m256i red = lookup_plane(&planes[2], offset, use_hi);
+		__m256i alpha = lookup_plane(&planes[3], offset, use_hi);
+
+		// interleave back into ARGB, unpacking works per lane so the lanes
+		// (pixels 0-15 and 16-31) are put back in order on the way out
+		__m256i bg_lo = _mm256_unpacklo_epi8(blue, green);
+		__m256i bg_hi = _mm256_unpackhi_epi8(blue, green);
+		__m256i ra_lo = _mm256_unpacklo_epi8(red, alpha);
+		__m256i ra_hi = _mm256_unpackhi_epi8(red, alpha);
+		__m256i px_0 = _mm256_unpacklo_epi16(bg_lo, ra_lo); // 0-3, 16-19
+		__m256i px_4 = _mm256_unpackhi_epi16(bg_lo, ra_lo); // 4-7, 20-23
+		__m256i px_8 = _mm256_unpacklo_epi16(bg_hi, ra_hi); // 8-11, 24-27
+		__m256i px_12 = _mm256_unpackhi_epi16(bg_hi, ra_hi); // 12-15, 28-31
+		_mm256_storeu_si256((__m256i*) &out[x], _mm256_permute2x128_si256(px_0, px_4, 0x20));
+		_mm256_storeu_si256((__m256i*) &out[x + 8], _mm256_permute2x128_si256(px_8, px_12, 0x20));
+		_mm256_storeu_si256((__m256i*) &out[x + 16], _mm256_permute2x128_si256(px_0, px_4, 0x31));
+		_mm256_storeu_si256((__m256i*) &out[x + 24], _mm256_permute2x128_si256(px_8, px_12, 0x31));
+	}
+}
+#elif defined(__SSE2__)
+void composite_scanline(uint32_t* out, const uint8_t* bg, const uint8_t* sprite, const uint32_t* colours)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i offset_bits = _mm_set1_epi8(SPRITE_LINE_OFFSET);
+	const __m128i behind_bit = _mm_set1_epi8(SPRITE_LINE_BEHIND);
+	uint8_t offsets[16];
+
+	for (unsigned x = 0; x < COMPOSITOR_WIDTH; x += 16) {
+		__m128i b = _mm_loadu_si128((const __m128i*) &bg[x]);
+		__m128i entry = _mm_loadu_si128((const __m128i*) &sprite[x]);
+		__m128i s = _mm_and_si128(entry, offset_bits);
+		__m128i behind = _mm_and_si128(entry, behind_bit);
+
+		// sprite where it's opaque and either the BG is transparent or it's in front
+		__m128i bg_clear = _mm_cmpeq_epi8(b, zero);
+		__m128i in_front = _mm_cmpeq_epi8(behind, zero);
+		__m128i use_sprite = _mm_andnot_si128(_mm_cmpeq_epi8(s, zero), _mm_or_si128(bg_clear, in_front));
+		__m128i offset = _mm_or_si128(_mm_and_si128(use_sprite, s), _mm_andnot_si128(use_sprite, b));
+		_mm_storeu_si128((__m128i*) offsets, offset);
+
+		// no byte shuffles before SSSE3, the table lookup stays scalar
+		for (unsigned i = 0; i < 16; i++) {
+			out[x + i] = colours[offsets[i]];
+		}
+	}
+}
+#else
+void composite_scanline(uint32_t* out, const uint8_t* bg, const uint8_t* sprite, const uint32_t* colours)
+{
+	composite_scanline_scalar(out, bg, sprite, colours);
+}
+#endif
@@ -7,8 +7,13 @@
 #include "cpu_mapper_interface.h"
 #include "mappers.h"
 #include "cpu_ppu_interface.h"
+#include "trace.h"
+#include "block_cache.h"
+#include "jit.h"
 #include "bits_and_bytes.h"
 
+#include <inttypes.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -33,7 +38,21 @@ static void write_4016(uint8_t data, Cpu6502* cpu);
 static unsigned read_4016(Cpu6502* cpu);
 static unsigned read_4017(Cpu6502* cpu);
 static void fetch_opcode(Cpu6502* cpu);
+static void latch_data_bus(Cpu6502* cpu, uint8_t data, enum DataBusType data_type);
+static void catch_up_ppu(Cpu6502* cpu, uint64_t target_cycle);
+static inline void sync_ppu_at_deadline(Cpu6502* cpu, uint64_t target_cycle);
+static void sync_ppu_before_access(Cpu6502* cpu);
+static unsigned quiet_cpu_cycles(const Cpu6502* cpu);
+static bool decode_next_cycle(Cpu6502* cpu);
+static bool cpu_jammed(const Cpu6502* cpu);
+static void step_decoded_instruction(Cpu6502* cpu);
+#ifdef CNES_FUSED_CPU
+static void step_fused_instruction(Cpu6502* cpu);
+#endif
+static void check_ignore_nmi(Cpu6502* cpu);
+static void poll_interrupts(Cpu6502* cpu);
 static bool fixed_cycles_on_store(const Cpu6502* cpu);
+static bool branch_not_taken(const Cpu6502* cpu);
 static bool page_cross_occurs(const unsigned low_byte, const unsigned offset);
 static void update_flag_z(Cpu6502* cpu, uint8_t result);
 static void update_flag_n(Cpu6502* cpu, uint8_t result);
@@ -90,6 +109,10 @@ static void execute_LSR(Cpu6502* cpu);
 static void execute_ORA(Cpu6502* cpu);
 static void execute_ROL(Cpu6502* cpu);
 static void execute_ROR(Cpu6502* cpu);
+static uint8_t shift_ASL(Cpu6502* cpu, uint8_t operand);
+static uint8_t shift_LSR(Cpu6502* cpu, uint8_t operand);
+static uint8_t shift_ROL(Cpu6502* cpu, uint8_t operand);
+static uint8_t shift_ROR(Cpu6502* cpu, uint8_t operand);
 static void execute_BCC(Cpu6502* cpu);
 static void execute_BCS(Cpu6502* cpu);
 static void execute_BEQ(Cpu6502* cpu);
@@ -123,277 +146,277 @@ static void execute_NMI(Cpu6502* cpu);
 static void execute_DMA(Cpu6502* cpu);
 
 struct InstructionDetails isa_info[256] = {
-	/* 0x00 */ {"BRK", decode_SPECIAL,         execute_BRK, 7 },
-	/* 0x01 */ {"ORA", decode_INDX_read_store, execute_ORA, 6 },
-	/* 0x02 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x03 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x04 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x05 */ {"ORA", decode_ZP_read_store,   execute_ORA, 3 },
-	/* 0x06 */ {"ASL", decode_ZP_rmw,          execute_ASL, 5 },
-	/* 0x07 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x08 */ {"PHP", decode_PUSH,            execute_PHP, 3 },
-	/* 0x09 */ {"ORA", decode_IMM_read,        execute_ORA, 2 },
-	/* 0x0A */ {"ASL", decode_ACC,             execute_ASL, 2 },
-	/* 0x0B */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x0C */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x0D */ {"ORA", decode_ABS_read_store,  execute_ORA, 4 },
-	/* 0x0E */ {"ASL", decode_ABS_rmw,         execute_ASL, 6 },
-	/* 0x0F */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0x10 */ {"BPL", decode_Bxx,             execute_BPL, 4 },
-	/* 0x11 */ {"ORA", decode_INDY_read_store, execute_ORA, 6 },
-	/* 0x12 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x13 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x14 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x15 */ {"ORA", decode_ZPX_read_store,  execute_ORA, 4 },
-	/* 0x16 */ {"ASL", decode_ZPX_rmw,         execute_ASL, 6 },
-	/* 0x17 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x18 */ {"CLC", decode_IMP,             execute_CLC, 2 },
-	/* 0x19 */ {"ORA", decode_ABSY_read_store, execute_ORA, 5 },
-	/* 0x1A */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x1B */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x1C */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x1D */ {"ORA", decode_ABSX_read_store, execute_ORA, 5 },
-	/* 0x1E */ {"ASL", decode_ABSX_rmw,        execute_ASL, 7 },
-	/* 0x1F */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0x20 */ {"JSR", decode_SPECIAL,         execute_JSR, 6 },
-	/* 0x21 */ {"AND", decode_INDX_read_store, execute_AND, 6 },
-	/* 0x22 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x23 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x24 */ {"BIT", decode_ZP_read_store,   execute_BIT, 3 },
-	/* 0x25 */ {"AND", decode_ZP_read_store,   execute_AND, 3 },
-	/* 0x26 */ {"ROL", decode_ZP_rmw,          execute_ROL, 5 },
-	/* 0x27 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x28 */ {"PLP", decode_PULL,            execute_PLP, 4 },
-	/* 0x29 */ {"AND", decode_IMM_read,        execute_AND, 2 },
-	/* 0x2A */ {"ROL", decode_ACC,             execute_ROL, 2 },
-	/* 0x2B */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x2C */ {"BIT", decode_ABS_read_store,  execute_BIT, 4 },
-	/* 0x2D */ {"AND", decode_ABS_read_store,  execute_AND, 4 },
-	/* 0x2E */ {"ROL", decode_ABS_rmw,         execute_ROL, 6 },
-	/* 0x2F */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0x30 */ {"BMI", decode_Bxx,             execute_BMI, 4 },
-	/* 0x31 */ {"AND", decode_INDY_read_store, execute_AND, 6 },
-	/* 0x32 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x33 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x34 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x35 */ {"AND", decode_ZPX_read_store,  execute_AND, 4 },
-	/* 0x36 */ {"ROL", decode_ZPX_rmw,         execute_ROL, 6 },
-	/* 0x37 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x38 */ {"SEC", decode_IMP,             execute_SEC, 2 },
-	/* 0x39 */ {"AND", decode_ABSY_read_store, execute_AND, 5 },
-	/* 0x3A */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x3B */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x3C */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x3D */ {"AND", decode_ABSX_read_store, execute_AND, 5 },
-	/* 0x3E */ {"ROL", decode_ABSX_rmw,        execute_ROL, 7 },
-	/* 0x3F */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0x40 */ {"RTI", decode_SPECIAL,         execute_RTI, 6 },
-	/* 0x41 */ {"EOR", decode_INDX_read_store, execute_EOR, 6 },
-	/* 0x42 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x43 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x44 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x45 */ {"EOR", decode_ZP_read_store,   execute_EOR, 3 },
-	/* 0x46 */ {"LSR", decode_ZP_rmw,          execute_LSR, 5 },
-	/* 0x47 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x48 */ {"PHA", decode_PUSH,            execute_PHA, 3 },
-	/* 0x49 */ {"EOR", decode_IMM_read,        execute_EOR, 2 },
-	/* 0x4A */ {"LSR", decode_ACC,             execute_LSR, 2 },
-	/* 0x4B */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x4C */ {"JMP", decode_ABS_JMP,         execute_JMP, 3 },
-	/* 0x4D */ {"EOR", decode_ABS_read_store,  execute_EOR, 4 },
-	/* 0x4E */ {"LSR", decode_ABS_rmw,         execute_LSR, 6 },
-	/* 0x4F */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0x50 */ {"BVC", decode_Bxx,             execute_BVC, 4 },
-	/* 0x51 */ {"EOR", decode_INDY_read_store, execute_EOR, 6 },
-	/* 0x52 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x53 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x54 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x55 */ {"EOR", decode_ZPX_read_store,  execute_EOR, 4 },
-	/* 0x56 */ {"LSR", decode_ZPX_rmw,         execute_LSR, 6 },
-	/* 0x57 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x58 */ {"CLI", decode_IMP,             execute_CLI, 2 },
-	/* 0x59 */ {"EOR", decode_ABSY_read_store, execute_EOR, 5 },
-	/* 0x5A */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x5B */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x5C */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x5D */ {"EOR", decode_ABSX_read_store, execute_EOR, 5 },
-	/* 0x5E */ {"LSR", decode_ABSX_rmw,        execute_LSR, 7 },
-	/* 0x5F */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0x60 */ {"RTS", decode_RTS,             execute_RTS, 6 },
-	/* 0x61 */ {"ADC", decode_INDX_read_store, execute_ADC, 6 },
-	/* 0x62 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x63 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x64 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x65 */ {"ADC", decode_ZP_read_store,   execute_ADC, 3 },
-	/* 0x66 */ {"ROR", decode_ZP_rmw,          execute_ROR, 5 },
-	/* 0x67 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x68 */ {"PLA", decode_PULL,            execute_PLA, 4 },
-	/* 0x69 */ {"ADC", decode_IMM_read,        execute_ADC, 2 },
-	/* 0x6A */ {"ROR", decode_ACC,             execute_ROR, 2 },
-	/* 0x6B */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x6C */ {"JMP", decode_IND_JMP,         execute_JMP, 5 },
-	/* 0x6D */ {"ADC", decode_ABS_read_store,  execute_ADC, 4 },
-	/* 0x6E */ {"ROR", decode_ABS_rmw,         execute_ROR, 6 },
-	/* 0x6F */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0x70 */ {"BVS", decode_Bxx,             execute_BVS, 4 },
-	/* 0x71 */ {"ADC", decode_INDY_read_store, execute_ADC, 6 },
-	/* 0x72 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x73 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x74 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x75 */ {"ADC", decode_ZPX_read_store,  execute_ADC, 4 },
-	/* 0x76 */ {"ROR", decode_ZPX_rmw,         execute_ROR, 6 },
-	/* 0x77 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x78 */ {"SEI", decode_IMP,             execute_SEI, 2 },
-	/* 0x79 */ {"ADC", decode_ABSY_read_store, execute_ADC, 5 },
-	/* 0x7A */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x7B */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x7C */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x7D */ {"ADC", decode_ABSX_read_store, execute_ADC, 5 },
-	/* 0x7E */ {"ROR", decode_ABSX_rmw,        execute_ROR, 7 },
-	/* 0x7F */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0x80 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x81 */ {"STA", decode_INDX_read_store, execute_STA, 6 },
-	/* 0x82 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x83 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x84 */ {"STY", decode_ZP_read_store,   execute_STY, 3 },
-	/* 0x85 */ {"STA", decode_ZP_read_store,   execute_STA, 3 },
-	/* 0x86 */ {"STX", decode_ZP_read_store,   execute_STX, 3 },
-	/* 0x87 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x88 */ {"DEY", decode_IMP,             execute_DEY, 2 },
-	/* 0x89 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x8A */ {"TXA", decode_IMP,             execute_TXA, 2 },
-	/* 0x8B */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x8C */ {"STY", decode_ABS_read_store,  execute_STY, 4 },
-	/* 0x8D */ {"STA", decode_ABS_read_store,  execute_STA, 4 },
-	/* 0x8E */ {"STX", decode_ABS_read_store,  execute_STX, 4 },
-	/* 0x8F */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0x90 */ {"BCC", decode_Bxx,             execute_BCC, 4 },
-	/* 0x91 */ {"STA", decode_INDY_read_store, execute_STA, 6 },
-	/* 0x92 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x93 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x94 */ {"STY", decode_ZPX_read_store,  execute_STY, 4 },
-	/* 0x95 */ {"STA", decode_ZPX_read_store,  execute_STA, 4 },
-	/* 0x96 */ {"STX", decode_ZPY_read_store,  execute_STX, 4 },
-	/* 0x97 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x98 */ {"TYA", decode_IMP,             execute_TYA, 2 },
-	/* 0x99 */ {"STA", decode_ABSY_read_store, execute_STA, 5 },
-	/* 0x9A */ {"TXS", decode_IMP,             execute_TXS, 2 },
-	/* 0x9B */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x9C */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x9D */ {"STA", decode_ABSX_read_store, execute_STA, 5 },
-	/* 0x9E */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0x9F */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0xA0 */ {"LDY", decode_IMM_read,        execute_LDY, 2 },
-	/* 0xA1 */ {"LDA", decode_INDX_read_store, execute_LDA, 6 },
-	/* 0xA2 */ {"LDX", decode_IMM_read,        execute_LDX, 2 },
-	/* 0xA3 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xA4 */ {"LDY", decode_ZP_read_store,   execute_LDY, 3 },
-	/* 0xA5 */ {"LDA", decode_ZP_read_store,   execute_LDA, 3 },
-	/* 0xA6 */ {"LDX", decode_ZP_read_store,   execute_LDX, 3 },
-	/* 0xA7 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xA8 */ {"TAY", decode_IMP,             execute_TAY, 2 },
-	/* 0xA9 */ {"LDA", decode_IMM_read,        execute_LDA, 2 },
-	/* 0xAA */ {"TAX", decode_IMP,             execute_TAX, 2 },
-	/* 0xAB */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xAC */ {"LDY", decode_ABS_read_store,  execute_LDY, 4 },
-	/* 0xAD */ {"LDA", decode_ABS_read_store,  execute_LDA, 4 },
-	/* 0xAE */ {"LDX", decode_ABS_read_store,  execute_LDX, 4 },
-	/* 0xAF */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0xB0 */ {"BCS", decode_Bxx,             execute_BCS, 4 },
-	/* 0xB1 */ {"LDA", decode_INDY_read_store, execute_LDA, 6 },
-	/* 0xB2 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xB3 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xB4 */ {"LDY", decode_ZPX_read_store,  execute_LDY, 4 },
-	/* 0xB5 */ {"LDA", decode_ZPX_read_store,  execute_LDA, 4 },
-	/* 0xB6 */ {"LDX", decode_ZPY_read_store,  execute_LDX, 4 },
-	/* 0xB7 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xB8 */ {"CLV", decode_IMP,             execute_CLV, 2 },
-	/* 0xB9 */ {"LDA", decode_ABSY_read_store, execute_LDA, 5 },
-	/* 0xBA */ {"TSX", decode_IMP,             execute_TSX, 2 },
-	/* 0xBB */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xBC */ {"LDY", decode_ABSX_read_store, execute_LDY, 5 },
-	/* 0xBD */ {"LDA", decode_ABSX_read_store, execute_LDA, 5 },
-	/* 0xBE */ {"LDX", decode_ABSY_read_store, execute_LDX, 5 },
-	/* 0xBF */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0xC0 */ {"CPY", decode_IMM_read,        execute_CPY, 2 },
-	/* 0xC1 */ {"CMP", decode_INDX_read_store, execute_CMP, 6 },
-	/* 0xC2 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xC3 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xC4 */ {"CPY", decode_ZP_read_store,   execute_CPY, 3 },
-	/* 0xC5 */ {"CMP", decode_ZP_read_store,   execute_CMP, 3 },
-	/* 0xC6 */ {"DEC", decode_ZP_rmw,          execute_DEC, 5 },
-	/* 0xC7 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xC8 */ {"INY", decode_IMP,             execute_INY, 2 },
-	/* 0xC9 */ {"CMP", decode_IMM_read,        execute_CMP, 2 },
-	/* 0xCA */ {"DEX", decode_IMP,             execute_DEX, 2 },
-	/* 0xCB */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xCC */ {"CPY", decode_ABS_read_store,  execute_CPY, 4 },
-	/* 0xCD */ {"CMP", decode_ABS_read_store,  execute_CMP, 4 },
-	/* 0xCE */ {"DEC", decode_ABS_rmw,         execute_DEC, 6 },
-	/* 0xCF */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0xD0 */ {"BNE", decode_Bxx,             execute_BNE, 4 },
-	/* 0xD1 */ {"CMP", decode_INDY_read_store, execute_CMP, 6 },
-	/* 0xD2 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xD3 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xD4 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xD5 */ {"CMP", decode_ZPX_read_store,  execute_CMP, 4 },
-	/* 0xD6 */ {"DEC", decode_ZPX_rmw,         execute_DEC, 6 },
-	/* 0xD7 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xD8 */ {"CLD", decode_IMP,             execute_CLD, 2 },
-	/* 0xD9 */ {"CMP", decode_ABSY_read_store, execute_CMP, 5 },
-	/* 0xDA */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xDB */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xDC */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xDD */ {"CMP", decode_ABSX_read_store, execute_CMP, 5 },
-	/* 0xDE */ {"DEC", decode_ABSX_rmw,        execute_DEC, 7 },
-	/* 0xDF */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0xE0 */ {"CPX", decode_IMM_read,        execute_CPX, 2 },
-	/* 0xE1 */ {"SBC", decode_INDX_read_store, execute_SBC, 6 },
-	/* 0xE2 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xE3 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xE4 */ {"CPX", decode_ZP_read_store,   execute_CPX, 3 },
-	/* 0xE5 */ {"SBC", decode_ZP_read_store,   execute_SBC, 3 },
-	/* 0xE6 */ {"INC", decode_ZP_rmw,          execute_INC, 5 },
-	/* 0xE7 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xE8 */ {"INX", decode_IMP,             execute_INX, 2 },
-	/* 0xE9 */ {"SBC", decode_IMM_read,        execute_SBC, 2 },
-	/* 0xEA */ {"NOP", decode_IMP,             execute_NOP, 2 },
-	/* 0xEB */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xEC */ {"CPX", decode_ABS_read_store,  execute_CPX, 4 },
-	/* 0xED */ {"SBC", decode_ABS_read_store,  execute_SBC, 4 },
-	/* 0xEE */ {"INC", decode_ABS_rmw,         execute_INC, 6 },
-	/* 0xEF */ {"",    bad_op_code,            bad_op_code, 0 },
-
-	/* 0xF0 */ {"BEQ", decode_Bxx,             execute_BEQ, 4 },
-	/* 0xF1 */ {"SBC", decode_INDY_read_store, execute_SBC, 6 },
-	/* 0xF2 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xF3 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xF4 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xF5 */ {"SBC", decode_ZPX_read_store,  execute_SBC, 4 },
-	/* 0xF6 */ {"INC", decode_ZPX_rmw,         execute_INC, 6 },
-	/* 0xF7 */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xF8 */ {"SED", decode_IMP,             execute_SED, 2 },
-	/* 0xF9 */ {"SBC", decode_ABSY_read_store, execute_SBC, 5 },
-	/* 0xFA */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xFB */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xFC */ {"",    bad_op_code,            bad_op_code, 0 },
-	/* 0xFD */ {"SBC", decode_ABSX_read_store, execute_SBC, 5 },
-	/* 0xFE */ {"INC", decode_ABSX_rmw,        execute_INC, 7 },
-	/* 0xFF */ {"",    bad_op_code,            bad_op_code, 0 }
+	/* 0x00 */ {"BRK", decode_SPECIAL,         execute_BRK, 7, SPECIAL },
+	/* 0x01 */ {"ORA", decode_INDX_read_store, execute_ORA, 6, INDX    },
+	/* 0x02 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x03 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x04 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x05 */ {"ORA", decode_ZP_read_store,   execute_ORA, 3, ZP      },
+	/* 0x06 */ {"ASL", decode_ZP_rmw,          execute_ASL, 5, ZP      },
+	/* 0x07 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x08 */ {"PHP", decode_PUSH,            execute_PHP, 3, IMP     },
+	/* 0x09 */ {"ORA", decode_IMM_read,        execute_ORA, 2, IMM     },
+	/* 0x0A */ {"ASL", decode_ACC,             execute_ASL, 2, ACC     },
+	/* 0x0B */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x0C */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x0D */ {"ORA", decode_ABS_read_store,  execute_ORA, 4, ABS     },
+	/* 0x0E */ {"ASL", decode_ABS_rmw,         execute_ASL, 6, ABS     },
+	/* 0x0F */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0x10 */ {"BPL", decode_Bxx,             execute_BPL, 4, REL     },
+	/* 0x11 */ {"ORA", decode_INDY_read_store, execute_ORA, 6, INDY    },
+	/* 0x12 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x13 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x14 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x15 */ {"ORA", decode_ZPX_read_store,  execute_ORA, 4, ZPX     },
+	/* 0x16 */ {"ASL", decode_ZPX_rmw,         execute_ASL, 6, ZPX     },
+	/* 0x17 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x18 */ {"CLC", decode_IMP,             execute_CLC, 2, IMP     },
+	/* 0x19 */ {"ORA", decode_ABSY_read_store, execute_ORA, 5, ABSY    },
+	/* 0x1A */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x1B */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x1C */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x1D */ {"ORA", decode_ABSX_read_store, execute_ORA, 5, ABSX    },
+	/* 0x1E */ {"ASL", decode_ABSX_rmw,        execute_ASL, 7, ABSX    },
+	/* 0x1F */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0x20 */ {"JSR", decode_SPECIAL,         execute_JSR, 6, ABS     },
+	/* 0x21 */ {"AND", decode_INDX_read_store, execute_AND, 6, INDX    },
+	/* 0x22 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x23 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x24 */ {"BIT", decode_ZP_read_store,   execute_BIT, 3, ZP      },
+	/* 0x25 */ {"AND", decode_ZP_read_store,   execute_AND, 3, ZP      },
+	/* 0x26 */ {"ROL", decode_ZP_rmw,          execute_ROL, 5, ZP      },
+	/* 0x27 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x28 */ {"PLP", decode_PULL,            execute_PLP, 4, IMP     },
+	/* 0x29 */ {"AND", decode_IMM_read,        execute_AND, 2, IMM     },
+	/* 0x2A */ {"ROL", decode_ACC,             execute_ROL, 2, ACC     },
+	/* 0x2B */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x2C */ {"BIT", decode_ABS_read_store,  execute_BIT, 4, ABS     },
+	/* 0x2D */ {"AND", decode_ABS_read_store,  execute_AND, 4, ABS     },
+	/* 0x2E */ {"ROL", decode_ABS_rmw,         execute_ROL, 6, ABS     },
+	/* 0x2F */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0x30 */ {"BMI", decode_Bxx,             execute_BMI, 4, REL     },
+	/* 0x31 */ {"AND", decode_INDY_read_store, execute_AND, 6, INDY    },
+	/* 0x32 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x33 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x34 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x35 */ {"AND", decode_ZPX_read_store,  execute_AND, 4, ZPX     },
+	/* 0x36 */ {"ROL", decode_ZPX_rmw,         execute_ROL, 6, ZPX     },
+	/* 0x37 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x38 */ {"SEC", decode_IMP,             execute_SEC, 2, IMP     },
+	/* 0x39 */ {"AND", decode_ABSY_read_store, execute_AND, 5, ABSY    },
+	/* 0x3A */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x3B */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x3C */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x3D */ {"AND", decode_ABSX_read_store, execute_AND, 5, ABSX    },
+	/* 0x3E */ {"ROL", decode_ABSX_rmw,        execute_ROL, 7, ABSX    },
+	/* 0x3F */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0x40 */ {"RTI", decode_SPECIAL,         execute_RTI, 6, SPECIAL },
+	/* 0x41 */ {"EOR", decode_INDX_read_store, execute_EOR, 6, INDX    },
+	/* 0x42 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x43 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x44 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x45 */ {"EOR", decode_ZP_read_store,   execute_EOR, 3, ZP      },
+	/* 0x46 */ {"LSR", decode_ZP_rmw,          execute_LSR, 5, ZP      },
+	/* 0x47 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x48 */ {"PHA", decode_PUSH,            execute_PHA, 3, IMP     },
+	/* 0x49 */ {"EOR", decode_IMM_read,        execute_EOR, 2, IMM     },
+	/* 0x4A */ {"LSR", decode_ACC,             execute_LSR, 2, ACC     },
+	/* 0x4B */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x4C */ {"JMP", decode_ABS_JMP,         execute_JMP, 3, ABS     },
+	/* 0x4D */ {"EOR", decode_ABS_read_store,  execute_EOR, 4, ABS     },
+	/* 0x4E */ {"LSR", decode_ABS_rmw,         execute_LSR, 6, ABS     },
+	/* 0x4F */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0x50 */ {"BVC", decode_Bxx,             execute_BVC, 4, REL     },
+	/* 0x51 */ {"EOR", decode_INDY_read_store, execute_EOR, 6, INDY    },
+	/* 0x52 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x53 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x54 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x55 */ {"EOR", decode_ZPX_read_store,  execute_EOR, 4, ZPX     },
+	/* 0x56 */ {"LSR", decode_ZPX_rmw,         execute_LSR, 6, ZPX     },
+	/* 0x57 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x58 */ {"CLI", decode_IMP,             execute_CLI, 2, IMP     },
+	/* 0x59 */ {"EOR", decode_ABSY_read_store, execute_EOR, 5, ABSY    },
+	/* 0x5A */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x5B */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x5C */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x5D */ {"EOR", decode_ABSX_read_store, execute_EOR, 5, ABSX    },
+	/* 0x5E */ {"LSR", decode_ABSX_rmw,        execute_LSR, 7, ABSX    },
+	/* 0x5F */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0x60 */ {"RTS", decode_RTS,             execute_RTS, 6, IMP     },
+	/* 0x61 */ {"ADC", decode_INDX_read_store, execute_ADC, 6, INDX    },
+	/* 0x62 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x63 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x64 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x65 */ {"ADC", decode_ZP_read_store,   execute_ADC, 3, ZP      },
+	/* 0x66 */ {"ROR", decode_ZP_rmw,          execute_ROR, 5, ZP      },
+	/* 0x67 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x68 */ {"PLA", decode_PULL,            execute_PLA, 4, IMP     },
+	/* 0x69 */ {"ADC", decode_IMM_read,        execute_ADC, 2, IMM     },
+	/* 0x6A */ {"ROR", decode_ACC,             execute_ROR, 2, ACC     },
+	/* 0x6B */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x6C */ {"JMP", decode_IND_JMP,         execute_JMP, 5, IND     },
+	/* 0x6D */ {"ADC", decode_ABS_read_store,  execute_ADC, 4, ABS     },
+	/* 0x6E */ {"ROR", decode_ABS_rmw,         execute_ROR, 6, ABS     },
+	/* 0x6F */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0x70 */ {"BVS", decode_Bxx,             execute_BVS, 4, REL     },
+	/* 0x71 */ {"ADC", decode_INDY_read_store, execute_ADC, 6, INDY    },
+	/* 0x72 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x73 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x74 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x75 */ {"ADC", decode_ZPX_read_store,  execute_ADC, 4, ZPX     },
+	/* 0x76 */ {"ROR", decode_ZPX_rmw,         execute_ROR, 6, ZPX     },
+	/* 0x77 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x78 */ {"SEI", decode_IMP,             execute_SEI, 2, IMP     },
+	/* 0x79 */ {"ADC", decode_ABSY_read_store, execute_ADC, 5, ABSY    },
+	/* 0x7A */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x7B */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x7C */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x7D */ {"ADC", decode_ABSX_read_store, execute_ADC, 5, ABSX    },
+	/* 0x7E */ {"ROR", decode_ABSX_rmw,        execute_ROR, 7, ABSX    },
+	/* 0x7F */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0x80 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x81 */ {"STA", decode_INDX_read_store, execute_STA, 6, INDX    },
+	/* 0x82 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x83 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x84 */ {"STY", decode_ZP_read_store,   execute_STY, 3, ZP      },
+	/* 0x85 */ {"STA", decode_ZP_read_store,   execute_STA, 3, ZP      },
+	/* 0x86 */ {"STX", decode_ZP_read_store,   execute_STX, 3, ZP      },
+	/* 0x87 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x88 */ {"DEY", decode_IMP,             execute_DEY, 2, IMP     },
+	/* 0x89 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x8A */ {"TXA", decode_IMP,             execute_TXA, 2, IMP     },
+	/* 0x8B */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x8C */ {"STY", decode_ABS_read_store,  execute_STY, 4, ABS     },
+	/* 0x8D */ {"STA", decode_ABS_read_store,  execute_STA, 4, ABS     },
+	/* 0x8E */ {"STX", decode_ABS_read_store,  execute_STX, 4, ABS     },
+	/* 0x8F */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0x90 */ {"BCC", decode_Bxx,             execute_BCC, 4, REL     },
+	/* 0x91 */ {"STA", decode_INDY_read_store, execute_STA, 6, INDY    },
+	/* 0x92 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x93 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x94 */ {"STY", decode_ZPX_read_store,  execute_STY, 4, ZPX     },
+	/* 0x95 */ {"STA", decode_ZPX_read_store,  execute_STA, 4, ZPX     },
+	/* 0x96 */ {"STX", decode_ZPY_read_store,  execute_STX, 4, ZPY     },
+	/* 0x97 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x98 */ {"TYA", decode_IMP,             execute_TYA, 2, IMP     },
+	/* 0x99 */ {"STA", decode_ABSY_read_store, execute_STA, 5, ABSY    },
+	/* 0x9A */ {"TXS", decode_IMP,             execute_TXS, 2, IMP     },
+	/* 0x9B */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x9C */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x9D */ {"STA", decode_ABSX_read_store, execute_STA, 5, ABSX    },
+	/* 0x9E */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0x9F */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0xA0 */ {"LDY", decode_IMM_read,        execute_LDY, 2, IMM     },
+	/* 0xA1 */ {"LDA", decode_INDX_read_store, execute_LDA, 6, INDX    },
+	/* 0xA2 */ {"LDX", decode_IMM_read,        execute_LDX, 2, IMM     },
+	/* 0xA3 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xA4 */ {"LDY", decode_ZP_read_store,   execute_LDY, 3, ZP      },
+	/* 0xA5 */ {"LDA", decode_ZP_read_store,   execute_LDA, 3, ZP      },
+	/* 0xA6 */ {"LDX", decode_ZP_read_store,   execute_LDX, 3, ZP      },
+	/* 0xA7 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xA8 */ {"TAY", decode_IMP,             execute_TAY, 2, IMP     },
+	/* 0xA9 */ {"LDA", decode_IMM_read,        execute_LDA, 2, IMM     },
+	/* 0xAA */ {"TAX", decode_IMP,             execute_TAX, 2, IMP     },
+	/* 0xAB */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xAC */ {"LDY", decode_ABS_read_store,  execute_LDY, 4, ABS     },
+	/* 0xAD */ {"LDA", decode_ABS_read_store,  execute_LDA, 4, ABS     },
+	/* 0xAE */ {"LDX", decode_ABS_read_store,  execute_LDX, 4, ABS     },
+	/* 0xAF */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0xB0 */ {"BCS", decode_Bxx,             execute_BCS, 4, REL     },
+	/* 0xB1 */ {"LDA", decode_INDY_read_store, execute_LDA, 6, INDY    },
+	/* 0xB2 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xB3 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xB4 */ {"LDY", decode_ZPX_read_store,  execute_LDY, 4, ZPX     },
+	/* 0xB5 */ {"LDA", decode_ZPX_read_store,  execute_LDA, 4, ZPX     },
+	/* 0xB6 */ {"LDX", decode_ZPY_read_store,  execute_LDX, 4, ZPY     },
+	/* 0xB7 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xB8 */ {"CLV", decode_IMP,             execute_CLV, 2, IMP     },
+	/* 0xB9 */ {"LDA", decode_ABSY_read_store, execute_LDA, 5, ABSY    },
+	/* 0xBA */ {"TSX", decode_IMP,             execute_TSX, 2, IMP     },
+	/* 0xBB */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xBC */ {"LDY", decode_ABSX_read_store, execute_LDY, 5, ABSX    },
+	/* 0xBD */ {"LDA", decode_ABSX_read_store, execute_LDA, 5, ABSX    },
+	/* 0xBE */ {"LDX", decode_ABSY_read_store, execute_LDX, 5, ABSY    },
+	/* 0xBF */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0xC0 */ {"CPY", decode_IMM_read,        execute_CPY, 2, IMM     },
+	/* 0xC1 */ {"CMP", decode_INDX_read_store, execute_CMP, 6, INDX    },
+	/* 0xC2 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xC3 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xC4 */ {"CPY", decode_ZP_read_store,   execute_CPY, 3, ZP      },
+	/* 0xC5 */ {"CMP", decode_ZP_read_store,   execute_CMP, 3, ZP      },
+	/* 0xC6 */ {"DEC", decode_ZP_rmw,          execute_DEC, 5, ZP      },
+	/* 0xC7 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xC8 */ {"INY", decode_IMP,             execute_INY, 2, IMP     },
+	/* 0xC9 */ {"CMP", decode_IMM_read,        execute_CMP, 2, IMM     },
+	/* 0xCA */ {"DEX", decode_IMP,             execute_DEX, 2, IMP     },
+	/* 0xCB */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xCC */ {"CPY", decode_ABS_read_store,  execute_CPY, 4, ABS     },
+	/* 0xCD */ {"CMP", decode_ABS_read_store,  execute_CMP, 4, ABS     },
+	/* 0xCE */ {"DEC", decode_ABS_rmw,         execute_DEC, 6, ABS     },
+	/* 0xCF */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0xD0 */ {"BNE", decode_Bxx,             execute_BNE, 4, REL     },
+	/* 0xD1 */ {"CMP", decode_INDY_read_store, execute_CMP, 6, INDY    },
+	/* 0xD2 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xD3 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xD4 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xD5 */ {"CMP", decode_ZPX_read_store,  execute_CMP, 4, ZPX     },
+	/* 0xD6 */ {"DEC", decode_ZPX_rmw,         execute_DEC, 6, ZPX     },
+	/* 0xD7 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xD8 */ {"CLD", decode_IMP,             execute_CLD, 2, IMP     },
+	/* 0xD9 */ {"CMP", decode_ABSY_read_store, execute_CMP, 5, ABSY    },
+	/* 0xDA */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xDB */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xDC */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xDD */ {"CMP", decode_ABSX_read_store, execute_CMP, 5, ABSX    },
+	/* 0xDE */ {"DEC", decode_ABSX_rmw,        execute_DEC, 7, ABSX    },
+	/* 0xDF */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0xE0 */ {"CPX", decode_IMM_read,        execute_CPX, 2, IMM     },
+	/* 0xE1 */ {"SBC", decode_INDX_read_store, execute_SBC, 6, INDX    },
+	/* 0xE2 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xE3 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xE4 */ {"CPX", decode_ZP_read_store,   execute_CPX, 3, ZP      },
+	/* 0xE5 */ {"SBC", decode_ZP_read_store,   execute_SBC, 3, ZP      },
+	/* 0xE6 */ {"INC", decode_ZP_rmw,          execute_INC, 5, ZP      },
+	/* 0xE7 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xE8 */ {"INX", decode_IMP,             execute_INX, 2, IMP     },
+	/* 0xE9 */ {"SBC", decode_IMM_read,        execute_SBC, 2, IMM     },
+	/* 0xEA */ {"NOP", decode_IMP,             execute_NOP, 2, IMP     },
+	/* 0xEB */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xEC */ {"CPX", decode_ABS_read_store,  execute_CPX, 4, ABS     },
+	/* 0xED */ {"SBC", decode_ABS_read_store,  execute_SBC, 4, ABS     },
+	/* 0xEE */ {"INC", decode_ABS_rmw,         execute_INC, 6, ABS     },
+	/* 0xEF */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+
+	/* 0xF0 */ {"BEQ", decode_Bxx,             execute_BEQ, 4, REL     },
+	/* 0xF1 */ {"SBC", decode_INDY_read_store, execute_SBC, 6, INDY    },
+	/* 0xF2 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xF3 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xF4 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xF5 */ {"SBC", decode_ZPX_read_store,  execute_SBC, 4, ZPX     },
+	/* 0xF6 */ {"INC", decode_ZPX_rmw,         execute_INC, 6, ZPX     },
+	/* 0xF7 */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xF8 */ {"SED", decode_IMP,             execute_SED, 2, IMP     },
+	/* 0xF9 */ {"SBC", decode_ABSY_read_store, execute_SBC, 5, ABSY    },
+	/* 0xFA */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xFB */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xFC */ {"",    bad_op_code,            bad_op_code, 0, IMP     },
+	/* 0xFD */ {"SBC", decode_ABSX_read_store, execute_SBC, 5, ABSX    },
+	/* 0xFE */ {"INC", decode_ABSX_rmw,        execute_INC, 7, ABSX    },
+	/* 0xFF */ {"",    bad_op_code,            bad_op_code, 0, IMP     }
 };
 
 void (*hardware_interrupts[3])(Cpu6502* cpu) = {
@@ -403,10 +426,13 @@ void (*hardware_interrupts[3])(Cpu6502* cpu) = {
 
 Cpu6502* cpu_allocator(void)
 {
-	Cpu6502* cpu = malloc(sizeof(Cpu6502));
+	Cpu6502* cpu = calloc(1, sizeof(Cpu6502));
 	if (!cpu) {
 		fprintf(stderr, "Failed to allocate enough memory for CPU\n");
+		return cpu;
 	}
+	cpu_default_memory_map(cpu);
+
 	return cpu; // either returns a valid or NULL pointer
 }
 
@@ -427,6 +453,7 @@ int cpu_init(Cpu6502* cpu, uint16_t pc_init, CpuPpuShare* cp, CpuMapperShare* cm
 	cpu->Y = 0;
 	cpu->old_cycle = 0;
 	cpu->instruction_state = FETCH;
+	cpu->trace_event = TRACE_OPCODE;
 	cpu->instruction_cycles_remaining = 51; // initial value doesn't matter as LUT will set it after first instruction is read
 
 	cpu->delay_nmi = false;
@@ -436,8 +463,21 @@ int cpu_init(Cpu6502* cpu, uint16_t pc_init, CpuPpuShare* cp, CpuMapperShare* cm
 	cpu->controller_latch = 0;
 	cpu->player_1_controller = 0;
 	cpu->player_2_controller = 0;
+	cpu->player_1_clock_pulse = 0;
+	cpu->player_2_clock_pulse = 0;
+
+	cpu->ppu = NULL;
+	cpu->cnes_windows = NULL;
+	cpu->ppu_synced_cycle = 0;
+	cpu->ppu_deadline_cycle = 0;
+	cpu->stepping = false;
+	cpu->trace = NULL;
+	cpu->block_cache = NULL;
+	cpu->jit = NULL;
+	cpu->decoded = NULL;
 
 	memset(cpu->mem, 0, CPU_MEMORY_SIZE); // Zero out memory
+	cpu_default_memory_map(cpu);
 
 	return_code = 0;
 
@@ -485,22 +525,12 @@ uint8_t cpu_generic_read(Cpu6502* cpu, enum CpuMemType mem_type
 
 uint8_t read_from_cpu(Cpu6502* cpu, uint16_t addr)
 {
-	unsigned read;
-	if (addr < (ADDR_RAM_END + 1)) { // read from RAM (non-mirrored)
-		read = cpu->mem[addr & RAM_NON_MIRROR_MASK];
-	} else if (addr < (ADDR_PPU_REG_END + 1)) { // read from PPU registers (non-mirrored)
-		read = read_ppu_reg(addr & PPU_REG_NON_MIRROR_MASK, cpu);
-	} else if (addr == ADDR_JOY1) {
-		read = read_4016(cpu);
-	} else if (addr == ADDR_JOY2) {
-		read = read_4017(cpu);
-	} else if (addr >= ADDR_MAPPER_START) {
-		read = mapper_read(cpu, addr);
-	} else {
-		read = cpu->mem[addr]; /* catch-all */
+	const uint8_t* page = cpu->read_page[addr >> 8];
+	if (page) { // RAM/ROM
+		return page[addr & 0xFF];
 	}
 
-	return read;
+	return cpu->read_handler[addr >> 8](cpu, addr);
 }
 
 uint8_t read_ppu_reg(const uint16_t addr, Cpu6502* cpu)
@@ -539,7 +569,11 @@ void set_address_bus(Cpu6502* cpu, uint16_t target_address)
 
 void set_data_bus_via_read(Cpu6502* cpu, uint16_t target_address, enum DataBusType data_type)
 {
-	uint8_t data = read_from_cpu(cpu, target_address);
+	latch_data_bus(cpu, read_from_cpu(cpu, target_address), data_type);
+}
+
+static void latch_data_bus(Cpu6502* cpu, uint8_t data, enum DataBusType data_type)
+{
 	cpu->data_bus = data;
 
 	// Set internal signals too
@@ -597,22 +631,127 @@ void cpu_generic_write(Cpu6502* cpu, enum CpuMemType mem_type
 
 void write_to_cpu(Cpu6502* cpu, uint16_t addr, uint8_t val)
 {
-	if (addr < (ADDR_RAM_END + 1)) { // write to RAM (non-mirrored)
-		cpu->mem[addr & RAM_NON_MIRROR_MASK] = val;
-	} else if (addr < (ADDR_PPU_REG_END + 1)) { // write to PPU registers (non-mirrored)
-		delay_write_ppu_reg(addr & PPU_REG_NON_MIRROR_MASK, val, cpu);
-		cpu->mem[addr & PPU_REG_NON_MIRROR_MASK] = val;
-	} else if (addr == ADDR_OAM_DMA) {
+	uint8_t* page = cpu->write_page[addr >> 8];
+	if (page) { // RAM
+		page[addr & 0xFF] = val;
+		return;
+	}
+
+	cpu->write_handler[addr >> 8](cpu, addr, val);
+}
+
+/* Memory map
+ *
+ * The address space is split into 256 byte pages, on an access the page is
+ * either read/written directly or the page's I/O handler is called
+ */
+void cpu_map_pages(Cpu6502* cpu, uint16_t addr, unsigned size
+                  , uint8_t* read_mem, uint8_t* write_mem)
+{
+	unsigned first_page = addr / CPU_PAGE_SIZE;
+	if (cpu->block_cache) { // e.g. a PRG bank switch
+		block_cache_unmap_pages(cpu->block_cache, first_page, size / CPU_PAGE_SIZE);
+	}
+	for (unsigned i = 0; i < size / CPU_PAGE_SIZE; i++) {
+		cpu->read_page[first_page + i] = read_mem ? read_mem + (i * CPU_PAGE_SIZE) : NULL;
+		cpu->write_page[first_page + i] = write_mem ? write_mem + (i * CPU_PAGE_SIZE) : NULL;
+	}
+}
+
+void cpu_map_io_pages(Cpu6502* cpu, uint16_t addr, unsigned size
+                     , CpuPageRead read_handler, CpuPageWrite write_handler)
+{
+	unsigned first_page = addr / CPU_PAGE_SIZE;
+	if (cpu->block_cache) {
+		block_cache_unmap_pages(cpu->block_cache, first_page, size / CPU_PAGE_SIZE);
+	}
+	for (unsigned i = 0; i < size / CPU_PAGE_SIZE; i++) {
+		cpu->read_page[first_page + i] = NULL;
+		cpu->write_page[first_page + i] = NULL;
+		cpu->read_handler[first_page + i] = read_handler;
+		cpu->write_handler[first_page + i] = write_handler;
+	}
+}
+
+static uint8_t ppu_page_read(Cpu6502* cpu, uint16_t addr)
+{
+	sync_ppu_before_access(cpu);
+	return read_ppu_reg(addr & PPU_REG_NON_MIRROR_MASK, cpu);
+}
+
+static void ppu_page_write(Cpu6502* cpu, uint16_t addr, uint8_t val)
+{
+	sync_ppu_before_access(cpu);
+	delay_write_ppu_reg(addr & PPU_REG_NON_MIRROR_MASK, val, cpu);
+	cpu->mem[addr & PPU_REG_NON_MIRROR_MASK] = val;
+}
+
+// $4000 to $40FF: APU and I/O registers, then the start of the mapper space
+static uint8_t io_page_read(Cpu6502* cpu, uint16_t addr)
+{
+	unsigned read;
+	if (addr == ADDR_JOY1) {
+		sync_ppu_before_access(cpu);
+		read = read_4016(cpu);
+	} else if (addr == ADDR_JOY2) {
+		sync_ppu_before_access(cpu);
+		read = read_4017(cpu);
+	} else if (addr >= ADDR_MAPPER_START) {
+		read = mapper_read(cpu, addr); // no side effects, no need to sync the ppu
+	} else {
+		read = cpu->mem[addr]; /* catch-all */
+	}
+
+	return read;
+}
+
+static void io_page_write(Cpu6502* cpu, uint16_t addr, uint8_t val)
+{
+	if (addr == ADDR_OAM_DMA) {
+		sync_ppu_before_access(cpu);
 		write_ppu_reg(addr, val, cpu);
 	} else if (addr == ADDR_JOY1) {
+		sync_ppu_before_access(cpu);
 		write_4016(val, cpu);
-	} else if (addr >= 0x4020) { // Mapper space/region
+	} else if (addr >= ADDR_MAPPER_START) {
+		sync_ppu_before_access(cpu); // mapper registers can switch CHR banks
 		mapper_write(cpu, addr, val);
 	} else {
 		cpu->mem[addr] = val;
 	}
 }
 
+static uint8_t mapper_page_read(Cpu6502* cpu, uint16_t addr)
+{
+	return mapper_read(cpu, addr); // no side effects, no need to sync the ppu
+}
+
+static void mapper_page_write(Cpu6502* cpu, uint16_t addr, uint8_t val)
+{
+	sync_ppu_before_access(cpu); // mapper registers can switch CHR banks
+	mapper_write(cpu, addr, val);
+}
+
+/* Power on memory map, mappers then remap their own pages (see init_mapper())
+ *
+ * $0000 to $1FFF: 2KiB RAM, mirrored every $0800
+ * $2000 to $3FFF: PPU registers
+ * $4000 to $40FF: APU/IO registers and start of the mapper space
+ * $4100 to $7FFF: mapper space (PRG RAM etc.)
+ * $8000 to $FFFF: PRG ROM, reads are direct, writes go to the mapper
+ */
+void cpu_default_memory_map(Cpu6502* cpu)
+{
+	for (unsigned mirror = 0; mirror < 4; mirror++) {
+		cpu_map_pages(cpu, mirror * 0x0800, 0x0800, &cpu->mem[0x0000], &cpu->mem[0x0000]);
+	}
+	cpu_map_io_pages(cpu, ADDR_PPU_REG_START, 0x2000, ppu_page_read, ppu_page_write);
+	cpu_map_io_pages(cpu, 0x4000, 0x0100, io_page_read, io_page_write);
+	cpu_map_io_pages(cpu, 0x4100, 0x3F00, mapper_page_read, mapper_page_write);
+	cpu_map_io_pages(cpu, 0x8000, 0x8000, mapper_page_read, mapper_page_write);
+	cpu_map_pages(cpu, 0x8000, 0x8000, &cpu->mem[0x8000], NULL);
+}
+
 void write_ppu_reg(const uint16_t addr, const uint8_t data, Cpu6502* cpu)
 {
 	switch (addr) {
@@ -663,11 +802,16 @@ void write_ppu_reg(const uint16_t addr, const uint8_t data, Cpu6502* cpu)
 
 void delay_write_ppu_reg(const uint16_t addr, const uint8_t data, Cpu6502* cpu)
 {
-	cpu->cpu_ppu_io->buffer_write = true;
-	cpu->cpu_ppu_io->buffer_counter = 2;
+	// the ppu has run up to the previous cpu cycle, the write lands 2 dots later
+	EventQueue* events = &cpu->cpu_ppu_io->events;
+	unsigned delay = 2;
 	if (addr == 0x2001) {
-		cpu->cpu_ppu_io->buffer_counter += 3; // 3 dot delay for background/sprite rendering
+		delay += 3; // 3 dot delay for background/sprite rendering
+		events_schedule(events, EVENT_PPU_MASK_EARLY, events->now + 2);
+	} else {
+		events_cancel(events, EVENT_PPU_MASK_EARLY); // any earlier $2001 write is dropped
 	}
+	events_schedule(events, EVENT_PPU_WRITE, events->now + delay);
 	cpu->cpu_ppu_io->buffer_address = addr;
 	cpu->cpu_ppu_io->buffer_value = data;
 
@@ -687,13 +831,12 @@ static void write_4016(uint8_t data, Cpu6502* cpu)
 
 static unsigned read_4016(Cpu6502* cpu)
 {
-	static unsigned clock_pulse = 0;
 	unsigned ret = 0;
 
-	ret = get_nth_bit(cpu->player_1_controller, clock_pulse);
+	ret = get_nth_bit(cpu->player_1_controller, cpu->player_1_clock_pulse);
 
-	++clock_pulse;
-	if (clock_pulse == 8) { clock_pulse = 0; }
+	++cpu->player_1_clock_pulse;
+	if (cpu->player_1_clock_pulse == 8) { cpu->player_1_clock_pulse = 0; }
 
 	return ret;
 }
@@ -701,13 +844,12 @@ static unsigned read_4016(Cpu6502* cpu)
 
 static unsigned read_4017(Cpu6502* cpu)
 {
-	static unsigned clock_pulse = 0;
 	unsigned ret = 0;
 
-	ret = get_nth_bit(cpu->player_2_controller, clock_pulse);
+	ret = get_nth_bit(cpu->player_2_controller, cpu->player_2_clock_pulse);
 
-	++clock_pulse;
-	if (clock_pulse == 8) { clock_pulse = 0; }
+	++cpu->player_2_clock_pulse;
+	if (cpu->player_2_clock_pulse == 8) { cpu->player_2_clock_pulse = 0; }
 
 	return ret;
 }
@@ -738,7 +880,10 @@ void cpu_mem_hexdump_addr_range(const Cpu6502* cpu, uint16_t start_addr, uint16_
 			if ((start_addr + x) > end_addr) {
 				break; // early stop
 			}
-			printf("%.2X ", cpu->mem[start_addr + x]);
+			// PRG ROM lives outside of mem[], I/O pages show their last written value
+			uint16_t addr = start_addr + x;
+			const uint8_t* page = cpu->read_page[addr >> 8];
+			printf("%.2X ", page ? page[addr & 0xFF] : cpu->mem[addr]);
 			// halfway point, print extra space for readability
 			if (x == 7) {
 				printf(" ");
@@ -749,16 +894,39 @@ void cpu_mem_hexdump_addr_range(const Cpu6502* cpu, uint16_t start_addr, uint16_
 	}
 }
 
-void clock_cpu(Cpu6502* cpu)
+static void check_ignore_nmi(Cpu6502* cpu)
 {
-	++cpu->cycle;
-	--cpu->instruction_cycles_remaining;
-
 	// disable any pending interrupts when suppressing an NMI
 	if (cpu->cpu_ppu_io->ignore_nmi) {
 		cpu->process_interrupt = false;
 		cpu->cpu_ppu_io->ignore_nmi = false;
 	}
+}
+
+// Interrupts are polled on the last cycle of an instruction
+static void poll_interrupts(Cpu6502* cpu)
+{
+	if (cpu->cpu_ppu_io->nmi_pending) {
+		cpu->process_interrupt = true;
+	}
+
+	if (cpu->cpu_ppu_io->nmi_lookahead) {
+		cpu->delay_nmi = true;
+	}
+
+	if (cpu->cpu_ppu_io->nmi_lookahead && cpu->cpu_ignore_fetch_on_nmi) {
+		cpu->delay_nmi = false;
+	}
+	cpu->cpu_ignore_fetch_on_nmi = false;
+}
+
+void clock_cpu(Cpu6502* cpu)
+{
+	++cpu->cycle;
+	--cpu->instruction_cycles_remaining;
+
+	sync_ppu_at_deadline(cpu, cpu->cycle - 1);
+	check_ignore_nmi(cpu);
 
 	// Fetch-decode-execute state logic
 	if (cpu->instruction_state == FETCH) {
@@ -779,25 +947,1005 @@ void clock_cpu(Cpu6502* cpu)
 	if (cpu->instruction_state == EXECUTE) {
 		cpu->instruction_state = POST_EXECUTE;
 		isa_info[cpu->opcode].execute_opcode(cpu); // can change the PC which the early fetch made!
+		poll_interrupts(cpu);
+	}
 
-		if (cpu->cpu_ppu_io->nmi_pending) {
-			cpu->process_interrupt = true;
+	if (cpu->instruction_state == POST_EXECUTE) {
+		cpu->instruction_state = FETCH;
+		cpu->trigger_trace_logger = true;
+	}
+}
+
+void cpu_attach_ppu(Cpu6502* cpu, Ppu2C02* ppu, Sdl2DisplayOutputs* cnes_windows)
+{
+	// a detached ppu is clocked in lockstep, the cpu can look at it any time
+	if (cpu->ppu) { cpu->ppu->unobserved_until = 0; }
+	if (ppu) { ppu->unobserved_until = 0; }
+	cpu->ppu = ppu;
+	cpu->cnes_windows = cnes_windows;
+	cpu->ppu_synced_cycle = cpu->cycle;
+	cpu->ppu_deadline_cycle = cpu->cycle;
+}
+
+void cpu_attach_trace(Cpu6502* cpu, CpuTrace* trace)
+{
+	// records hold the ppu position, it is kept up to date while tracing
+	cpu_sync_ppu(cpu);
+	cpu->ppu_deadline_cycle = cpu->ppu_synced_cycle;
+	cpu->trace = trace;
+}
+
+void cpu_attach_jit(Cpu6502* cpu, Jit* jit)
+{
+	cpu->jit = jit;
+}
+
+void cpu_attach_block_cache(Cpu6502* cpu, BlockCache* block_cache)
+{
+	cpu->block_cache = block_cache;
+	cpu->decoded = NULL;
+	if (block_cache) { // pages may have been remapped while detached
+		block_cache_unmap_pages(block_cache, 0, CPU_PAGE_COUNT);
+	}
+}
+
+unsigned cpu_instruction_length(uint8_t opcode)
+{
+	switch (isa_info[opcode].address_mode) {
+	case ABS:
+	case ABSX:
+	case ABSY:
+	case IND:
+		return 3;
+	case IMM:
+	case INDX:
+	case INDY:
+	case REL:
+	case ZP:
+	case ZPX:
+	case ZPY:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+/* Clock the ppu until it has finished the dots of target_cycle
+ *
+ * Replays exactly what the clock_cpu() + 3 * clock_ppu() loop does, i.e.
+ * the ppu sees the cpu cycle it is running alongside and the NMI suppression
+ * check runs at the start of the next cpu cycle. Afterwards the ppu can be
+ * left alone until the deadline, nothing the cpu sees changes before it
+ */
+static void catch_up_ppu(Cpu6502* cpu, uint64_t target_cycle)
+{
+	if (!cpu->ppu || (cpu->ppu_synced_cycle >= target_cycle)) {
+		return;
+	}
+
+	uint64_t cycle = cpu->cycle;
+	cpu->ppu->unobserved_until = 3 * target_cycle; // the cpu doesn't run until then
+	while (cpu->ppu_synced_cycle < target_cycle) {
+		// VBlank and rendering disabled stretches are skipped in whole cpu cycles
+		uint64_t idle_cycles = ppu_idle_dots(cpu->ppu) / 3;
+		if (idle_cycles) {
+			if (idle_cycles > target_cycle - cpu->ppu_synced_cycle) {
+				idle_cycles = target_cycle - cpu->ppu_synced_cycle;
+			}
+			ppu_skip_idle_dots(cpu->ppu, 3 * idle_cycles);
+			cpu->ppu_synced_cycle += idle_cycles;
+			continue;
 		}
 
-		if (cpu->cpu_ppu_io->nmi_lookahead) {
-			cpu->delay_nmi = true;
+		cpu->cycle = ++cpu->ppu_synced_cycle;
+		clock_ppu(cpu->ppu, cpu, cpu->cnes_windows);
+		clock_ppu(cpu->ppu, cpu, cpu->cnes_windows);
+		clock_ppu(cpu->ppu, cpu, cpu->cnes_windows);
+		check_ignore_nmi(cpu);
+	}
+	cpu->cycle = cycle;
+
+	cpu->ppu_deadline_cycle = cpu->ppu_synced_cycle;
+	if (!cpu->trace) { // records hold the ppu position
+		cpu->ppu_deadline_cycle += quiet_cpu_cycles(cpu);
+	}
+}
+
+// Catches the ppu up only once the cpu has reached the deadline
+static inline void sync_ppu_at_deadline(Cpu6502* cpu, uint64_t target_cycle)
+{
+	if (target_cycle >= cpu->ppu_deadline_cycle) {
+		catch_up_ppu(cpu, target_cycle);
+	}
+}
+
+/* Accesses happen mid cpu cycle, the ppu is done with the previous cycle.
+ * The access can change what the ppu does next (e.g. a buffered write), so
+ * it is caught up every cycle until the deadline is worked out again
+ */
+static void sync_ppu_before_access(Cpu6502* cpu)
+{
+	if (cpu->ppu) {
+		catch_up_ppu(cpu, cpu->cycle - 1);
+		cpu->ppu_deadline_cycle = cpu->ppu_synced_cycle;
+	}
+}
+
+void clock_cpu_and_ppu(Cpu6502* cpu)
+{
+	clock_cpu(cpu);
+	sync_ppu_at_deadline(cpu, cpu->cycle);
+}
+
+void cpu_sync_ppu(Cpu6502* cpu)
+{
+	catch_up_ppu(cpu, cpu->cycle);
+}
+
+/* Lets a decoder carry on to its next cycle when stepping a whole instruction,
+ * otherwise clock_cpu() calls the decoder again on the next cycle
+ */
+static bool decode_next_cycle(Cpu6502* cpu)
+{
+	if (!cpu->stepping) {
+		return false;
+	}
+
+	++cpu->cycle;
+	--cpu->instruction_cycles_remaining;
+	return true;
+}
+
+// bad opcodes have no cycles, the cpu never leaves the decode state (1 cycle per step)
+static bool cpu_jammed(const Cpu6502* cpu)
+{
+	return (cpu->instruction_state == DECODE) && !isa_info[cpu->opcode].max_cycles;
+}
+
+/* Cpu cycles that can be run ahead without missing anything the ppu would
+ * signal, used by recompiled blocks and skipped idle loops
+ */
+static unsigned quiet_cpu_cycles(const Cpu6502* cpu)
+{
+	const CpuPpuShare* io = cpu->cpu_ppu_io;
+	if (io->nmi_pending || io->nmi_lookahead || io->ignore_nmi
+	    || io->dma_pending || cpu->process_interrupt) {
+		return 0;
+	}
+
+	// the ppu is caught up, stop short of the next scheduled event
+	unsigned cycles = UINT_MAX;
+	if (io->events.next != EVENT_NEVER) {
+		uint64_t dots = (io->events.next > io->events.now) ? io->events.next - io->events.now : 0;
+		cycles = (dots / 3 < UINT_MAX) ? (unsigned) (dots / 3) : UINT_MAX;
+	}
+	if (cpu->ppu && ppu_quiet_dots(cpu->ppu) / 3 < cycles) {
+		cycles = ppu_quiet_dots(cpu->ppu) / 3;
+	}
+
+	return cycles;
+}
+
+// Cpu cycles left before the lagging ppu has to be caught up
+static unsigned cycles_to_ppu_deadline(const Cpu6502* cpu)
+{
+	if (!cpu->ppu) {
+		return quiet_cpu_cycles(cpu);
+	}
+	if (cpu->ppu_deadline_cycle <= cpu->cycle) {
+		return 0;
+	}
+	uint64_t cycles = cpu->ppu_deadline_cycle - cpu->cycle;
+
+	return (cycles < UINT_MAX) ? (unsigned) cycles : UINT_MAX;
+}
+
+/***************************
+ * IDLE LOOPS              *
+ * *************************/
+/* Loops that spin until the ppu or an NMI changes what they read:
+ *
+ *   JMP *                  (only an NMI gets out)
+ *   LDA/BIT abs/zp, Bxx *  ($2002 or memory only the NMI handler changes)
+ */
+struct IdleLoop {
+	uint8_t load_opcode; // 0x4C for JMP *
+	uint16_t addr; // read each time round
+	uint8_t data_bus; // bus value the load leaves
+	unsigned load_cycles;
+	uint8_t branch_opcode;
+	uint8_t branch_offset;
+	unsigned cycles; // one time round
+};
+
+// read without side effects, false if addr is on an I/O page
+static bool peek_cpu(const Cpu6502* cpu, uint16_t addr, uint8_t* val)
+{
+	const uint8_t* page = cpu->read_page[addr >> 8];
+	if (!page) {
+		return false;
+	}
+	*val = page[addr & 0xFF];
+
+	return true;
+}
+
+static bool is_ppu_status(uint16_t addr)
+{
+	return (addr >= ADDR_PPU_REG_START) && (addr <= ADDR_PPU_REG_END) && ((addr & 0x0007) == 0x0002);
+}
+
+static bool decode_idle_loop(const Cpu6502* cpu, struct IdleLoop* loop)
+{
+	uint16_t pc = cpu->PC;
+	uint8_t lo, hi = 0;
+	if (!peek_cpu(cpu, pc, &loop->load_opcode) || !peek_cpu(cpu, pc + 1, &lo)) {
+		return false;
+	}
+
+	unsigned length = cpu_instruction_length(loop->load_opcode);
+	switch (loop->load_opcode) {
+	case 0x4C: // JMP
+		if (!peek_cpu(cpu, pc + 2, &hi) || (append_hi_byte_to_lo_byte(hi, lo) != pc)) {
+			return false;
+		}
+		loop->data_bus = hi;
+		loop->cycles = isa_info[0x4C].max_cycles;
+		return true;
+	case 0x24: // BIT zp
+	case 0xA5: // LDA zp
+		loop->addr = lo;
+		loop->data_bus = lo;
+		break;
+	case 0x2C: // BIT abs
+	case 0xAD: // LDA abs
+		if (!peek_cpu(cpu, pc + 2, &hi)) {
+			return false;
 		}
+		loop->addr = append_hi_byte_to_lo_byte(hi, lo);
+		loop->data_bus = hi;
+		break;
+	default:
+		return false;
+	}
 
-		if (cpu->cpu_ppu_io->nmi_lookahead && cpu->cpu_ignore_fetch_on_nmi) {
-			cpu->delay_nmi = false;
+	uint16_t branch = pc + length;
+	if (!peek_cpu(cpu, branch, &loop->branch_opcode) || (isa_info[loop->branch_opcode].address_mode != REL)
+	    || !peek_cpu(cpu, branch + 1, &loop->branch_offset)
+	    || ((uint16_t) (branch + 2 + (int8_t) loop->branch_offset) != pc)) {
+		return false;
+	}
+	if (!cpu->read_page[loop->addr >> 8] && !is_ppu_status(loop->addr)) {
+		return false; // other I/O has side effects or changes without the ppu
+	}
+
+	loop->load_cycles = isa_info[loop->load_opcode].max_cycles;
+	bool page_cross = ((branch + 2) & 0xFF00) != (pc & 0xFF00);
+	loop->cycles = loop->load_cycles + 3 + page_cross;
+
+	return true;
+}
+
+// runs the load and the branch on the value read, false (nothing changed) if the loop ends
+static bool idle_loop_continues(Cpu6502* cpu, const struct IdleLoop* loop, uint8_t val)
+{
+	uint8_t a = cpu->A;
+	uint8_t p = cpu->P;
+	uint8_t opcode = cpu->opcode;
+
+	if (loop->load_opcode == 0x24 || loop->load_opcode == 0x2C) { // BIT
+		update_flag_z(cpu, cpu->A & val);
+		update_flag_n(cpu, val);
+		update_flag_v(cpu, val & FLAG_V);
+	} else {
+		cpu->A = val;
+		update_flag_z(cpu, val);
+		update_flag_n(cpu, val);
+	}
+	cpu->opcode = loop->branch_opcode;
+	if (branch_not_taken(cpu)) {
+		cpu->A = a;
+		cpu->P = p;
+		cpu->opcode = opcode;
+		return false;
+	}
+
+	return true;
+}
+
+/* Runs an idle loop at the PC round as many times as fit before the ppu can
+ * change anything the loop sees, returns the cpu cycles skipped (0 if none).
+ * $2002 is still read each time round (with the ppu caught up), the loop
+ * stops early when the status changes, e.g. sprite 0 hit
+ */
+static unsigned skip_idle_loop(Cpu6502* cpu)
+{
+	struct IdleLoop loop;
+	if (!cpu->ppu || !decode_idle_loop(cpu, &loop)) {
+		return 0;
+	}
+
+	unsigned budget = cycles_to_ppu_deadline(cpu);
+	if (budget <= loop.cycles) {
+		return 0;
+	}
+	unsigned laps = (budget - 1) / loop.cycles;
+	uint64_t start_cycle = cpu->cycle;
+
+	if (loop.load_opcode == 0x4C) {
+		cpu->opcode = loop.load_opcode;
+		cpu->cycle += laps * loop.cycles;
+	} else if (!is_ppu_status(loop.addr)) { // memory only an NMI handler changes
+		uint8_t val;
+		peek_cpu(cpu, loop.addr, &val);
+		if (!idle_loop_continues(cpu, &loop, val)) {
+			return 0;
+		}
+		cpu->cycle += laps * loop.cycles;
+	} else {
+		catch_up_ppu(cpu, cpu->cycle); // the ppu can be lagging behind
+		uint8_t first_status = cpu->cpu_ppu_io->ppu_status;
+		for (unsigned i = 0; i < laps; i++) {
+			catch_up_ppu(cpu, cpu->cycle + loop.load_cycles - 1);
+			if ((cpu->cpu_ppu_io->ppu_status != first_status)
+			    || !idle_loop_continues(cpu, &loop, cpu->cpu_ppu_io->ppu_status)) {
+				break;
+			}
+			read_ppu_reg(loop.addr & PPU_REG_NON_MIRROR_MASK, cpu); // clears the write toggle
+			cpu->cycle += loop.cycles;
+		}
+	}
+	if (cpu->cycle == start_cycle) {
+		return 0;
+	}
+
+	cpu->data_bus = (loop.load_opcode == 0x4C) ? loop.data_bus : loop.branch_offset;
+	cpu->trace_event = TRACE_OPCODE;
+	cpu->delay_nmi = false;
+	cpu->cpu_ignore_fetch_on_nmi = false;
+
+	return cpu->cycle - start_cycle;
+}
+
+// T1 onwards through the isa_info decode/execute functions
+static void step_decoded_instruction(Cpu6502* cpu)
+{
+	// decoders run through all of their cycles in one call
+	isa_info[cpu->opcode].decode_opcode(cpu);
+
+	// execute functions which take more than one cycle ask to be called again
+	while (cpu->instruction_state == EXECUTE) {
+		sync_ppu_at_deadline(cpu, cpu->cycle - 1);
+		cpu->instruction_state = POST_EXECUTE;
+		isa_info[cpu->opcode].execute_opcode(cpu);
+		poll_interrupts(cpu);
+
+		if (cpu->instruction_state == EXECUTE) {
+			++cpu->cycle;
+			--cpu->instruction_cycles_remaining;
+		}
+	}
+}
+
+unsigned cpu_step_instruction(Cpu6502* cpu)
+{
+	uint64_t start_cycle = cpu->cycle;
+	cpu->trigger_trace_logger = false;
+
+	// Interrupts, DMA and instructions started by clock_cpu() keep the
+	// cycle by cycle state machine
+	if ((cpu->instruction_state != FETCH)
+	    || (!cpu->delay_nmi && cpu->process_interrupt)
+	    || cpu->cpu_ppu_io->dma_pending) {
+		do {
+			clock_cpu(cpu);
+		} while (!cpu->trigger_trace_logger && !cpu_jammed(cpu));
+		sync_ppu_at_deadline(cpu, cpu->cycle);
+		return cpu->cycle - start_cycle;
+	}
+
+	sync_ppu_at_deadline(cpu, cpu->cycle);
+	if (!cpu->trace) { // the trace records every fetch
+		if (skip_idle_loop(cpu)
+		    || (cpu->jit && jit_run(cpu->jit, cpu, cycles_to_ppu_deadline(cpu)))) {
+			cpu->trigger_trace_logger = true;
+			sync_ppu_at_deadline(cpu, cpu->cycle);
+			return cpu->cycle - start_cycle;
 		}
-		cpu->cpu_ignore_fetch_on_nmi = false;
 	}
+	cpu->stepping = true;
+
+	// T0: fetch, PRG ROM instructions come predecoded from the block cache
+	++cpu->cycle;
+	--cpu->instruction_cycles_remaining;
+	if (cpu->block_cache) {
+		cpu->decoded = block_cache_next(cpu->block_cache, cpu);
+	}
+	fetch_opcode(cpu);
+	cpu->delay_nmi = false; // reset after returning from NMI
+
+	// T1 onwards
+	++cpu->cycle;
+	--cpu->instruction_cycles_remaining;
+#ifdef CNES_FUSED_CPU
+	step_fused_instruction(cpu);
+#else
+	step_decoded_instruction(cpu);
+#endif
+	cpu->stepping = false;
+	cpu->decoded = NULL;
 
 	if (cpu->instruction_state == POST_EXECUTE) {
 		cpu->instruction_state = FETCH;
 		cpu->trigger_trace_logger = true;
 	}
+	sync_ppu_at_deadline(cpu, cpu->cycle);
+
+	return cpu->cycle - start_cycle;
+}
+
+#ifdef CNES_FUSED_CPU
+/***************************
+ * FUSED INSTRUCTIONS      *
+ * *************************/
+
+/* Legal opcodes for step_fused_instruction(), same details as isa_info
+ *
+ *   X(opcode, operation, address mode, access)
+ *
+ * access picks the handler template: how the address mode's cycles are
+ * combined with execute_<operation>() (or shift_<operation>() for shifts)
+ */
+#define FUSED_OPCODES(X) \
+	X(0x00, BRK, SPECIAL, MULTI_CYCLE) \
+	X(0x01, ORA, INDX, READ) \
+	X(0x05, ORA, ZP, READ) \
+	X(0x06, ASL, ZP, SHIFT) \
+	X(0x08, PHP, IMP, PUSH) \
+	X(0x09, ORA, IMM, IMMEDIATE) \
+	X(0x0A, ASL, ACC, SHIFT_ACC) \
+	X(0x0D, ORA, ABS, READ) \
+	X(0x0E, ASL, ABS, SHIFT) \
+	X(0x10, BPL, REL, BRANCH) \
+	X(0x11, ORA, INDY, READ) \
+	X(0x15, ORA, ZPX, READ) \
+	X(0x16, ASL, ZPX, SHIFT) \
+	X(0x18, CLC, IMP, IMPLIED) \
+	X(0x19, ORA, ABSY, READ) \
+	X(0x1D, ORA, ABSX, READ) \
+	X(0x1E, ASL, ABSX, SHIFT) \
+	X(0x20, JSR, SPECIAL, MULTI_CYCLE) \
+	X(0x21, AND, INDX, READ) \
+	X(0x24, BIT, ZP, READ) \
+	X(0x25, AND, ZP, READ) \
+	X(0x26, ROL, ZP, SHIFT) \
+	X(0x28, PLP, IMP, PULL) \
+	X(0x29, AND, IMM, IMMEDIATE) \
+	X(0x2A, ROL, ACC, SHIFT_ACC) \
+	X(0x2C, BIT, ABS, READ) \
+	X(0x2D, AND, ABS, READ) \
+	X(0x2E, ROL, ABS, SHIFT) \
+	X(0x30, BMI, REL, BRANCH) \
+	X(0x31, AND, INDY, READ) \
+	X(0x35, AND, ZPX, READ) \
+	X(0x36, ROL, ZPX, SHIFT) \
+	X(0x38, SEC, IMP, IMPLIED) \
+	X(0x39, AND, ABSY, READ) \
+	X(0x3D, AND, ABSX, READ) \
+	X(0x3E, ROL, ABSX, SHIFT) \
+	X(0x40, RTI, SPECIAL, MULTI_CYCLE) \
+	X(0x41, EOR, INDX, READ) \
+	X(0x45, EOR, ZP, READ) \
+	X(0x46, LSR, ZP, SHIFT) \
+	X(0x48, PHA, IMP, PUSH) \
+	X(0x49, EOR, IMM, IMMEDIATE) \
+	X(0x4A, LSR, ACC, SHIFT_ACC) \
+	X(0x4C, JMP, ABS, JMP_ABS) \
+	X(0x4D, EOR, ABS, READ) \
+	X(0x4E, LSR, ABS, SHIFT) \
+	X(0x50, BVC, REL, BRANCH) \
+	X(0x51, EOR, INDY, READ) \
+	X(0x55, EOR, ZPX, READ) \
+	X(0x56, LSR, ZPX, SHIFT) \
+	X(0x58, CLI, IMP, IMPLIED) \
+	X(0x59, EOR, ABSY, READ) \
+	X(0x5D, EOR, ABSX, READ) \
+	X(0x5E, LSR, ABSX, SHIFT) \
+	X(0x60, RTS, IMP, RTS) \
+	X(0x61, ADC, INDX, READ) \
+	X(0x65, ADC, ZP, READ) \
+	X(0x66, ROR, ZP, SHIFT) \
+	X(0x68, PLA, IMP, PULL) \
+	X(0x69, ADC, IMM, IMMEDIATE) \
+	X(0x6A, ROR, ACC, SHIFT_ACC) \
+	X(0x6C, JMP, IND, JMP_IND) \
+	X(0x6D, ADC, ABS, READ) \
+	X(0x6E, ROR, ABS, SHIFT) \
+	X(0x70, BVS, REL, BRANCH) \
+	X(0x71, ADC, INDY, READ) \
+	X(0x75, ADC, ZPX, READ) \
+	X(0x76, ROR, ZPX, SHIFT) \
+	X(0x78, SEI, IMP, IMPLIED) \
+	X(0x79, ADC, ABSY, READ) \
+	X(0x7D, ADC, ABSX, READ) \
+	X(0x7E, ROR, ABSX, SHIFT) \
+	X(0x81, STA, INDX, STORE) \
+	X(0x84, STY, ZP, STORE) \
+	X(0x85, STA, ZP, STORE) \
+	X(0x86, STX, ZP, STORE) \
+	X(0x88, DEY, IMP, IMPLIED) \
+	X(0x8A, TXA, IMP, IMPLIED) \
+	X(0x8C, STY, ABS, STORE) \
+	X(0x8D, STA, ABS, STORE) \
+	X(0x8E, STX, ABS, STORE) \
+	X(0x90, BCC, REL, BRANCH) \
+	X(0x91, STA, INDY, STORE) \
+	X(0x94, STY, ZPX, STORE) \
+	X(0x95, STA, ZPX, STORE) \
+	X(0x96, STX, ZPY, STORE) \
+	X(0x98, TYA, IMP, IMPLIED) \
+	X(0x99, STA, ABSY, STORE) \
+	X(0x9A, TXS, IMP, IMPLIED) \
+	X(0x9D, STA, ABSX, STORE) \
+	X(0xA0, LDY, IMM, IMMEDIATE) \
+	X(0xA1, LDA, INDX, READ) \
+	X(0xA2, LDX, IMM, IMMEDIATE) \
+	X(0xA4, LDY, ZP, READ) \
+	X(0xA5, LDA, ZP, READ) \
+	X(0xA6, LDX, ZP, READ) \
+	X(0xA8, TAY, IMP, IMPLIED) \
+	X(0xA9, LDA, IMM, IMMEDIATE) \
+	X(0xAA, TAX, IMP, IMPLIED) \
+	X(0xAC, LDY, ABS, READ) \
+	X(0xAD, LDA, ABS, READ) \
+	X(0xAE, LDX, ABS, READ) \
+	X(0xB0, BCS, REL, BRANCH) \
+	X(0xB1, LDA, INDY, READ) \
+	X(0xB4, LDY, ZPX, READ) \
+	X(0xB5, LDA, ZPX, READ) \
+	X(0xB6, LDX, ZPY, READ) \
+	X(0xB8, CLV, IMP, IMPLIED) \
+	X(0xB9, LDA, ABSY, READ) \
+	X(0xBA, TSX, IMP, IMPLIED) \
+	X(0xBC, LDY, ABSX, READ) \
+	X(0xBD, LDA, ABSX, READ) \
+	X(0xBE, LDX, ABSY, READ) \
+	X(0xC0, CPY, IMM, IMMEDIATE) \
+	X(0xC1, CMP, INDX, READ) \
+	X(0xC4, CPY, ZP, READ) \
+	X(0xC5, CMP, ZP, READ) \
+	X(0xC6, DEC, ZP, RMW) \
+	X(0xC8, INY, IMP, IMPLIED) \
+	X(0xC9, CMP, IMM, IMMEDIATE) \
+	X(0xCA, DEX, IMP, IMPLIED) \
+	X(0xCC, CPY, ABS, READ) \
+	X(0xCD, CMP, ABS, READ) \
+	X(0xCE, DEC, ABS, RMW) \
+	X(0xD0, BNE, REL, BRANCH) \
+	X(0xD1, CMP, INDY, READ) \
+	X(0xD5, CMP, ZPX, READ) \
+	X(0xD6, DEC, ZPX, RMW) \
+	X(0xD8, CLD, IMP, IMPLIED) \
+	X(0xD9, CMP, ABSY, READ) \
+	X(0xDD, CMP, ABSX, READ) \
+	X(0xDE, DEC, ABSX, RMW) \
+	X(0xE0, CPX, IMM, IMMEDIATE) \
+	X(0xE1, SBC, INDX, READ) \
+	X(0xE4, CPX, ZP, READ) \
+	X(0xE5, SBC, ZP, READ) \
+	X(0xE6, INC, ZP, RMW) \
+	X(0xE8, INX, IMP, IMPLIED) \
+	X(0xE9, SBC, IMM, IMMEDIATE) \
+	X(0xEA, NOP, IMP, IMPLIED) \
+	X(0xEC, CPX, ABS, READ) \
+	X(0xED, SBC, ABS, READ) \
+	X(0xEE, INC, ABS, RMW) \
+	X(0xF0, BEQ, REL, BRANCH) \
+	X(0xF1, SBC, INDY, READ) \
+	X(0xF5, SBC, ZPX, READ) \
+	X(0xF6, INC, ZPX, RMW) \
+	X(0xF8, SED, IMP, IMPLIED) \
+	X(0xF9, SBC, ABSY, READ) \
+	X(0xFD, SBC, ABSX, READ) \
+	X(0xFE, INC, ABSX, RMW)
+
+#define FUSED_FLAG(opcode, op, mode, access) [opcode] = true,
+static const bool fused_opcodes[256] = { FUSED_OPCODES(FUSED_FLAG) };
+#undef FUSED_FLAG
+
+static inline void fused_next_cycle(Cpu6502* cpu)
+{
+	++cpu->cycle;
+	--cpu->instruction_cycles_remaining;
+}
+
+// start of an execute cycle, same as the execute loop in step_decoded_instruction()
+static inline void fused_execute_cycle(Cpu6502* cpu)
+{
+	sync_ppu_at_deadline(cpu, cpu->cycle - 1);
+	cpu->instruction_state = POST_EXECUTE;
+}
+
+/* Address modes: the cycles of the decode_X() functions run back to back,
+ * ending on the cycle the operation executes in
+ */
+// predecoded instructions already have their operand bytes (PRG ROM reads have no side effects)
+static inline void fused_fetch_operand(Cpu6502* cpu, enum DataBusType data_type)
+{
+	set_address_bus(cpu, cpu->PC);
+	if (cpu->decoded) {
+		bool second_operand = (data_type == ADH) || (data_type == INH);
+		latch_data_bus(cpu, second_operand ? cpu->decoded->operand_hi : cpu->decoded->operand_lo, data_type);
+	} else {
+		set_data_bus_via_read(cpu, cpu->PC, data_type);
+	}
+	++cpu->PC;
+}
+
+static inline void fused_ABS_address(Cpu6502* cpu)
+{
+	fused_fetch_operand(cpu, ADL); // T1
+	fused_next_cycle(cpu);
+	fused_fetch_operand(cpu, ADH); // T2
+	fused_next_cycle(cpu);
+	set_address_bus_bytes(cpu, cpu->addr_hi, cpu->addr_lo);
+	cpu->target_addr = cpu->address_bus;
+}
+
+// T3 onwards of ABSX/ABSY/INDY, stores and page crosses take the extra cycle
+static inline void fused_index_address(Cpu6502* cpu, uint8_t index, bool store)
+{
+	set_address_bus_bytes(cpu, cpu->addr_hi, cpu->addr_lo + index);
+	cpu->target_addr = cpu->address_bus;
+	if (!store && !page_cross_occurs(cpu->addr_lo, index)) {
+		return;
+	}
+	set_data_bus_via_read(cpu, cpu->target_addr, DATA); // dummy read
+	fused_next_cycle(cpu);
+	set_address_bus(cpu, append_hi_byte_to_lo_byte(cpu->addr_hi, cpu->addr_lo) + index);
+	cpu->target_addr = cpu->address_bus;
+}
+
+static inline void fused_ZP_address(Cpu6502* cpu)
+{
+	fused_fetch_operand(cpu, ADL); // T1
+	fused_next_cycle(cpu);
+	set_address_bus_bytes(cpu, 0x00, cpu->addr_lo);
+	cpu->target_addr = cpu->addr_lo;
+}
+
+static inline void fused_ZP_index_address(Cpu6502* cpu, uint8_t index)
+{
+	fused_ZP_address(cpu);
+	set_data_bus_via_read(cpu, cpu->target_addr, DATA); // T2 (dummy read)
+	fused_next_cycle(cpu);
+	set_address_bus_bytes(cpu, 0x00, cpu->addr_lo + index);
+	cpu->target_addr = (uint8_t) (cpu->addr_lo + index);
+}
+
+static inline void fused_ABS_read_store(Cpu6502* cpu, bool store)
+{
+	(void) store;
+	cpu->address_mode = ABS;
+	fused_ABS_address(cpu);
+}
+
+static inline void fused_ABSX_read_store(Cpu6502* cpu, bool store)
+{
+	cpu->address_mode = ABSX;
+	fused_fetch_operand(cpu, ADL); // T1
+	fused_next_cycle(cpu);
+	fused_fetch_operand(cpu, ADH); // T2
+	fused_next_cycle(cpu);
+	fused_index_address(cpu, cpu->X, store);
+}
+
+static inline void fused_ABSY_read_store(Cpu6502* cpu, bool store)
+{
+	cpu->address_mode = ABSY;
+	fused_fetch_operand(cpu, ADL); // T1
+	fused_next_cycle(cpu);
+	fused_fetch_operand(cpu, ADH); // T2
+	fused_next_cycle(cpu);
+	fused_index_address(cpu, cpu->Y, store);
+}
+
+static inline void fused_INDX_read_store(Cpu6502* cpu, bool store)
+{
+	(void) store;
+	cpu->address_mode = INDX;
+	fused_fetch_operand(cpu, BAL); // T1
+	fused_next_cycle(cpu);
+	set_address_bus_bytes(cpu, 0x00, cpu->base_addr); // T2 (dummy read)
+	set_data_bus_via_read(cpu, cpu->base_addr, DATA);
+	fused_next_cycle(cpu);
+	set_address_bus_bytes(cpu, 0x00, cpu->base_addr + cpu->X); // T3
+	set_data_bus_via_read(cpu, (uint8_t) (cpu->base_addr + cpu->X), ADL);
+	fused_next_cycle(cpu);
+	set_address_bus_bytes(cpu, 0x00, cpu->base_addr + cpu->X + 1); // T4
+	set_data_bus_via_read(cpu, (uint8_t) (cpu->base_addr + cpu->X + 1), ADH);
+	fused_next_cycle(cpu);
+	set_address_bus_bytes(cpu, cpu->addr_hi, cpu->addr_lo);
+	cpu->target_addr = append_hi_byte_to_lo_byte(cpu->addr_hi, cpu->addr_lo);
+}
+
+static inline void fused_INDY_read_store(Cpu6502* cpu, bool store)
+{
+	cpu->address_mode = INDY;
+	fused_fetch_operand(cpu, BAL); // T1
+	fused_next_cycle(cpu);
+	set_address_bus_bytes(cpu, 0x00, cpu->base_addr); // T2
+	set_data_bus_via_read(cpu, cpu->base_addr, ADL);
+	fused_next_cycle(cpu);
+	set_address_bus_bytes(cpu, 0x00, cpu->base_addr + 1); // T3
+	set_data_bus_via_read(cpu, (uint8_t) (cpu->base_addr + 1), ADH);
+	fused_next_cycle(cpu);
+	fused_index_address(cpu, cpu->Y, store);
+}
+
+static inline void fused_ZP_read_store(Cpu6502* cpu, bool store)
+{
+	(void) store;
+	cpu->address_mode = ZP;
+	fused_ZP_address(cpu);
+}
+
+static inline void fused_ZPX_read_store(Cpu6502* cpu, bool store)
+{
+	(void) store;
+	cpu->address_mode = ZPX;
+	fused_ZP_index_address(cpu, cpu->X);
+}
+
+static inline void fused_ZPY_read_store(Cpu6502* cpu, bool store)
+{
+	(void) store;
+	cpu->address_mode = ZPY;
+	fused_ZP_index_address(cpu, cpu->Y);
+}
+
+static inline void fused_IMM_read(Cpu6502* cpu)
+{
+	cpu->address_mode = IMM;
+	set_address_bus(cpu, cpu->PC);
+	cpu->target_addr = cpu->address_bus;
+	++cpu->PC;
+}
+
+// IMP and ACC: T1 reads the next opcode
+static inline void fused_implied(Cpu6502* cpu, AddressMode address_mode)
+{
+	cpu->address_mode = address_mode;
+	set_address_bus(cpu, cpu->PC);
+	set_data_bus_via_read(cpu, cpu->PC, DATA);
+}
+
+// dummy read then dummy write of the unmodified value
+static inline void fused_rmw_cycles(Cpu6502* cpu)
+{
+	set_data_bus_via_read(cpu, cpu->target_addr, DATA);
+	fused_next_cycle(cpu);
+	write_to_cpu(cpu, cpu->target_addr, cpu->data_bus);
+	fused_next_cycle(cpu);
+}
+
+static inline void fused_ABS_rmw(Cpu6502* cpu)
+{
+	cpu->address_mode = ABS;
+	fused_ABS_address(cpu);
+	fused_rmw_cycles(cpu);
+}
+
+static inline void fused_ABSX_rmw(Cpu6502* cpu)
+{
+	cpu->address_mode = ABSX;
+	fused_fetch_operand(cpu, ADL); // T1
+	fused_next_cycle(cpu);
+	fused_fetch_operand(cpu, ADH); // T2
+	fused_next_cycle(cpu);
+	set_address_bus_bytes(cpu, cpu->addr_hi, cpu->addr_lo + cpu->X); // T3 (dummy read)
+	cpu->target_addr = cpu->address_bus;
+	set_data_bus_via_read(cpu, cpu->target_addr, DATA);
+	fused_next_cycle(cpu);
+	set_address_bus(cpu, append_hi_byte_to_lo_byte(cpu->addr_hi, cpu->addr_lo) + cpu->X);
+	cpu->target_addr = cpu->address_bus;
+	fused_rmw_cycles(cpu);
+}
+
+static inline void fused_ZP_rmw(Cpu6502* cpu)
+{
+	cpu->address_mode = ZP;
+	fused_ZP_address(cpu);
+	fused_rmw_cycles(cpu);
+}
+
+static inline void fused_ZPX_rmw(Cpu6502* cpu)
+{
+	cpu->address_mode = ZPX;
+	fused_ZP_index_address(cpu, cpu->X);
+	fused_rmw_cycles(cpu);
+}
+
+static inline void fused_push(Cpu6502* cpu)
+{
+	fused_implied(cpu, IMP); // T1 (dummy read)
+	fused_next_cycle(cpu);
+}
+
+static inline void fused_pull(Cpu6502* cpu)
+{
+	fused_push(cpu);
+	set_address_bus(cpu, SP_START + cpu->stack); // T2 (dummy read on stack)
+	set_data_bus_via_read(cpu, SP_START + cpu->stack, DATA);
+	fused_next_cycle(cpu);
+}
+
+static inline void fused_rts(Cpu6502* cpu)
+{
+	fused_pull(cpu);
+	set_address_bus(cpu, SP_START + cpu->stack + 1); // T3
+	cpu->addr_lo = stack_pull(cpu);
+	set_data_bus_via_write(cpu, cpu->addr_lo);
+	fused_next_cycle(cpu);
+	set_address_bus(cpu, SP_START + cpu->stack + 1); // T4
+	cpu->addr_hi = stack_pull(cpu);
+	set_data_bus_via_write(cpu, cpu->addr_hi);
+	fused_next_cycle(cpu);
+}
+
+static inline void fused_branch(Cpu6502* cpu, bool taken)
+{
+	cpu->address_mode = REL;
+	fused_fetch_operand(cpu, BRANCH); // T1
+	if (!taken) {
+		cpu->target_addr = cpu->PC;
+		return;
+	}
+	fused_next_cycle(cpu);
+	set_address_bus_bytes(cpu, cpu->PC >> 8, (uint8_t) (cpu->PC + cpu->offset)); // T2
+	cpu->target_addr = (cpu->PC & 0xFF00) | ((cpu->PC + cpu->offset) & 0x00FF);
+	if (!page_cross_occurs(cpu->PC & 0xFF, cpu->offset)) {
+		return;
+	}
+	fused_next_cycle(cpu);
+	set_address_bus(cpu, cpu->PC + cpu->offset); // T3 (page cross)
+	cpu->target_addr = cpu->PC + cpu->offset;
+}
+
+#define BRANCH_TAKEN_BCC(cpu) (!((cpu)->P & FLAG_C))
+#define BRANCH_TAKEN_BCS(cpu) ((cpu)->P & FLAG_C)
+#define BRANCH_TAKEN_BNE(cpu) (!((cpu)->P & FLAG_Z))
+#define BRANCH_TAKEN_BEQ(cpu) ((cpu)->P & FLAG_Z)
+#define BRANCH_TAKEN_BPL(cpu) (!((cpu)->P & FLAG_N))
+#define BRANCH_TAKEN_BMI(cpu) ((cpu)->P & FLAG_N)
+#define BRANCH_TAKEN_BVC(cpu) (!((cpu)->P & FLAG_V))
+#define BRANCH_TAKEN_BVS(cpu) ((cpu)->P & FLAG_V)
+
+/* Jumps execute over several cycles, interrupts are polled on each of them
+ * like the execute loop does
+ */
+static inline void fused_JMP_ABS(Cpu6502* cpu)
+{
+	cpu->address_mode = ABS;
+	cpu->cpu_ignore_fetch_on_nmi = true;
+	fused_execute_cycle(cpu); // T1
+	fused_fetch_operand(cpu, ADL);
+	poll_interrupts(cpu);
+	fused_next_cycle(cpu);
+	fused_execute_cycle(cpu); // T2
+	set_address_bus(cpu, cpu->PC);
+	set_data_bus_via_read(cpu, cpu->PC, ADH);
+	cpu->PC = append_hi_byte_to_lo_byte(cpu->addr_hi, cpu->addr_lo);
+	cpu->target_addr = cpu->PC;
+	poll_interrupts(cpu);
+}
+
+static inline void fused_JMP_IND(Cpu6502* cpu)
+{
+	cpu->address_mode = IND;
+	fused_execute_cycle(cpu); // T1
+	fused_fetch_operand(cpu, INL);
+	poll_interrupts(cpu);
+	fused_next_cycle(cpu);
+	fused_execute_cycle(cpu); // T2
+	fused_fetch_operand(cpu, INH);
+	poll_interrupts(cpu);
+	fused_next_cycle(cpu);
+	fused_execute_cycle(cpu); // T3
+	set_address_bus_bytes(cpu, cpu->index_hi, cpu->index_lo);
+	set_data_bus_via_read(cpu, cpu->address_bus, ADL);
+	poll_interrupts(cpu);
+	fused_next_cycle(cpu);
+	fused_execute_cycle(cpu); // T4 (index_lo wraps within the page)
+	set_address_bus_bytes(cpu, cpu->index_hi, (uint8_t) cpu->index_lo + 1);
+	set_data_bus_via_read(cpu, cpu->address_bus, ADH);
+	cpu->PC = append_hi_byte_to_lo_byte(cpu->addr_hi, cpu->addr_lo);
+	cpu->target_addr = cpu->address_bus - 1;
+	poll_interrupts(cpu);
+}
+
+// BRK, JSR and RTI keep their cycle by cycle execute functions
+static inline void fused_multi_cycle(Cpu6502* cpu, void (*execute_opcode)(Cpu6502*))
+{
+	cpu->address_mode = SPECIAL;
+	cpu->instruction_state = EXECUTE;
+	while (cpu->instruction_state == EXECUTE) {
+		fused_execute_cycle(cpu);
+		execute_opcode(cpu);
+		poll_interrupts(cpu);
+
+		if (cpu->instruction_state == EXECUTE) {
+			fused_next_cycle(cpu);
+		}
+	}
+}
+
+// Handler templates, one per access type in FUSED_OPCODES
+#define FUSED_EXECUTE(operation) \
+	fused_execute_cycle(cpu); \
+	operation; \
+	poll_interrupts(cpu)
+
+#define FUSED_READ(op, mode)        fused_##mode##_read_store(cpu, false); FUSED_EXECUTE(execute_##op(cpu))
+#define FUSED_STORE(op, mode)       fused_##mode##_read_store(cpu, true); FUSED_EXECUTE(execute_##op(cpu))
+#define FUSED_IMMEDIATE(op, mode)   fused_IMM_read(cpu); FUSED_EXECUTE(execute_##op(cpu))
+#define FUSED_IMPLIED(op, mode)     fused_implied(cpu, IMP); FUSED_EXECUTE(execute_##op(cpu))
+#define FUSED_RMW(op, mode)         fused_##mode##_rmw(cpu); FUSED_EXECUTE(execute_##op(cpu))
+#define FUSED_SHIFT(op, mode) \
+	fused_##mode##_rmw(cpu); \
+	FUSED_EXECUTE(write_to_cpu(cpu, cpu->target_addr, shift_##op(cpu, read_from_cpu(cpu, cpu->target_addr))))
+#define FUSED_SHIFT_ACC(op, mode)   fused_implied(cpu, ACC); FUSED_EXECUTE(cpu->A = shift_##op(cpu, cpu->A))
+#define FUSED_PUSH(op, mode)        fused_push(cpu); FUSED_EXECUTE(execute_##op(cpu))
+#define FUSED_PULL(op, mode)        fused_pull(cpu); FUSED_EXECUTE(execute_##op(cpu))
+#define FUSED_RTS(op, mode)         fused_rts(cpu); FUSED_EXECUTE(execute_##op(cpu))
+#define FUSED_BRANCH(op, mode)      fused_branch(cpu, BRANCH_TAKEN_##op(cpu)); FUSED_EXECUTE(execute_##op(cpu))
+#define FUSED_JMP_ABS(op, mode)     fused_JMP_ABS(cpu)
+#define FUSED_JMP_IND(op, mode)     fused_JMP_IND(cpu)
+#define FUSED_MULTI_CYCLE(op, mode) fused_multi_cycle(cpu, execute_##op)
+
+/* T1 onwards of a legal opcode in a single handler, dispatched with a
+ * computed goto on GCC/clang (a switch elsewhere)
+ */
+static void step_fused_instruction(Cpu6502* cpu)
+{
+#if defined(__GNUC__)
+#define FUSED_LABEL(opcode, op, mode, access) [opcode] = &&fused_##opcode,
+#define FUSED_HANDLER(opcode, op, mode, access) fused_##opcode: FUSED_##access(op, mode); return;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init" // legal opcodes replace the default
+	static const void* const handlers[256] = {
+		[0x00 ... 0xFF] = &&fused_bad_opcode,
+		FUSED_OPCODES(FUSED_LABEL)
+	};
+#pragma GCC diagnostic pop
+
+	goto *handlers[cpu->opcode];
+	FUSED_OPCODES(FUSED_HANDLER)
+fused_bad_opcode:
+	step_decoded_instruction(cpu);
+#undef FUSED_LABEL
+#undef FUSED_HANDLER
+#else
+#define FUSED_CASE(opcode, op, mode, access) case opcode: FUSED_##access(op, mode); return;
+	switch (cpu->opcode) {
+	FUSED_OPCODES(FUSED_CASE)
+	default:
+		step_decoded_instruction(cpu);
+		break;
+	}
+#undef FUSED_CASE
+#endif
+}
+#endif /* CNES_FUSED_CPU */
+
+bool cpu_fused_opcode(uint8_t opcode)
+{
+#ifdef CNES_FUSED_CPU
+	return fused_opcodes[opcode];
+#else
+	(void) opcode;
+	return false;
+#endif
 }
 
 // true if branch not taken based on opcode
@@ -838,8 +1986,26 @@ static bool branch_not_taken(const Cpu6502* cpu)
 	return result;
 }
 
+/* Disassembles the last completed instruction from its opcode and the
+ * decoded addresses, only called when tracing so execute_*() do no string work
+ */
 void set_cpu_disassembler_trace(const Cpu6502* cpu, char* instruction, char* append_int, char* end)
 {
+	switch (cpu->trace_event) {
+	case TRACE_IRQ:
+		strcpy(instruction, "IRQ");
+		return;
+	case TRACE_NMI:
+		strcpy(instruction, "NMI");
+		return;
+	case TRACE_DMA:
+		strcpy(instruction, "DMA");
+		return;
+	case TRACE_OPCODE:
+		break;
+	}
+
+	strcpy(instruction, isa_info[cpu->opcode].mnemonic);
 	switch(cpu->address_mode) {
 	case ABS:
 		sprintf(append_int, "%.4X", cpu->target_addr);
@@ -914,7 +2080,10 @@ void set_cpu_disassembler_trace(const Cpu6502* cpu, char* instruction, char* app
 		printf("Invalid address mode\n");
 		break;
 	}
-	strcat(instruction, end); // execute_* functions provide the instruction string
+	if (end[0]) {
+		strcat(instruction, " ");
+		strcat(instruction, end);
+	}
 }
 
 void print_cpu_instruction_trace(const Cpu6502* cpu)
@@ -926,7 +2095,7 @@ void print_cpu_instruction_trace(const Cpu6502* cpu)
 	printf("Y:%.2X ", cpu->old_Y);
 	printf("P:%.2X ", cpu->old_P);
 	printf("SP:%.2X ", cpu->old_stack);
-	printf("CPU:%-10u", cpu->old_cycle);
+	printf("CPU:%-10" PRIu64, cpu->old_cycle);
 }
 
 void update_cpu_info(Cpu6502* cpu)
@@ -962,7 +2131,11 @@ uint8_t stack_pull(Cpu6502* cpu)
 
 static void fetch_opcode(Cpu6502* cpu)
 {
-	cpu->opcode = read_from_cpu(cpu, cpu->PC);
+	cpu->opcode = cpu->decoded ? cpu->decoded->opcode : read_from_cpu(cpu, cpu->PC);
+	cpu->trace_event = TRACE_OPCODE;
+	if (cpu->trace) {
+		cpu_trace_record(cpu->trace, cpu);
+	}
 	set_data_bus_via_write(cpu, cpu->opcode);
 	++cpu->PC;
 
@@ -1005,12 +2178,14 @@ static void decode_ABS_read_store(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADL);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T2
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADH);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: //T3
 		set_address_bus_bytes(cpu, cpu->addr_hi, cpu->addr_lo);
 		cpu->target_addr = cpu->address_bus;
@@ -1028,20 +2203,24 @@ static void decode_ABS_rmw(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADL);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 4: // T2
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADH);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 3: // T3 (dummy read)
 		set_address_bus_bytes(cpu, cpu->addr_hi, cpu->addr_lo);
 		cpu->target_addr = cpu->address_bus;
 		set_data_bus_via_read(cpu, cpu->target_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T4 (dummy write)
 		write_to_cpu(cpu, cpu->target_addr, cpu->data_bus);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T5
 		cpu->instruction_state = EXECUTE;
 		break;
@@ -1057,12 +2236,14 @@ static void decode_ABSX_read_store(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADL);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 3: // T2
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADH);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T3 (non-page cross address)
 		set_address_bus_bytes(cpu, cpu->addr_hi, cpu->addr_lo + cpu->X);
 		cpu->target_addr = cpu->address_bus;
@@ -1072,7 +2253,8 @@ static void decode_ABSX_read_store(Cpu6502* cpu)
 		}
 		// dummy read (only if T4 executes next)
 		set_data_bus_via_read(cpu, cpu->target_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T4 (correct address, page crossed or not)
 		set_address_bus(cpu, append_hi_byte_to_lo_byte(cpu->addr_hi, cpu->addr_lo) + cpu->X);
 		cpu->target_addr = cpu->address_bus;
@@ -1090,25 +2272,30 @@ static void decode_ABSX_rmw(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADL);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 5: // T2
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADH);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 4: // T3 (dummy read)
 		set_address_bus_bytes(cpu, cpu->addr_hi, cpu->addr_lo + cpu->X);
 		cpu->target_addr = cpu->address_bus;
 		set_data_bus_via_read(cpu, cpu->target_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 3: // T4
 		set_address_bus(cpu, append_hi_byte_to_lo_byte(cpu->addr_hi, cpu->addr_lo) + cpu->X);
 		cpu->target_addr = cpu->address_bus;
 		set_data_bus_via_read(cpu, cpu->target_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T5 (dummy write)
 		write_to_cpu(cpu, cpu->target_addr, cpu->data_bus);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T6
 		cpu->instruction_state = EXECUTE;
 		break;
@@ -1124,12 +2311,14 @@ static void decode_ABSY_read_store(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADL);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 3: // T2
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADH);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T3 (non-page cross address)
 		set_address_bus_bytes(cpu, cpu->addr_hi, cpu->addr_lo + cpu->Y);
 		cpu->target_addr = cpu->address_bus;
@@ -1139,7 +2328,8 @@ static void decode_ABSY_read_store(Cpu6502* cpu)
 		}
 		// dummy read (only if T4 executes next)
 		set_data_bus_via_read(cpu, cpu->target_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T4 (correct address, page crossed or not)
 		set_address_bus(cpu, append_hi_byte_to_lo_byte(cpu->addr_hi, cpu->addr_lo) + cpu->Y);
 		cpu->target_addr = cpu->address_bus;
@@ -1191,19 +2381,23 @@ static void decode_INDX_read_store(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, BAL);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 4: // T2 (dummy read)
 		set_address_bus_bytes(cpu, 0x00, cpu->base_addr);
 		set_data_bus_via_read(cpu, cpu->base_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 3: // T3
 		set_address_bus_bytes(cpu, 0x00, cpu->base_addr + cpu->X);
 		set_data_bus_via_read(cpu, (uint8_t) (cpu->base_addr + cpu->X), ADL);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T4
 		set_address_bus_bytes(cpu, 0x00, cpu->base_addr + cpu->X + 1);
 		set_data_bus_via_read(cpu, (uint8_t) (cpu->base_addr + cpu->X + 1), ADH);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T5
 		set_address_bus_bytes(cpu, cpu->addr_hi, cpu->addr_lo);
 		cpu->target_addr = append_hi_byte_to_lo_byte(cpu->addr_hi, cpu->addr_lo);
@@ -1221,15 +2415,18 @@ static void decode_INDY_read_store(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, BAL);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 4: // T2
 		set_address_bus_bytes(cpu, 0x00, cpu->base_addr);
 		set_data_bus_via_read(cpu, cpu->base_addr, ADL); // ZP read
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 3: // T3
 		set_address_bus_bytes(cpu, 0x00, cpu->base_addr + 1);
 		set_data_bus_via_read(cpu, (uint8_t) (cpu->base_addr + 1), ADH); // ZP read
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T4 (non-page cross address)
 		set_address_bus_bytes(cpu, cpu->addr_hi, cpu->addr_lo + cpu->Y);
 		cpu->target_addr = cpu->address_bus;
@@ -1239,7 +2436,8 @@ static void decode_INDY_read_store(Cpu6502* cpu)
 		}
 		// dummy read (only if T5 executes next)
 		set_data_bus_via_read(cpu, cpu->target_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T5 (correct address, page crossed or not)
 		set_address_bus(cpu, append_hi_byte_to_lo_byte(cpu->addr_hi, cpu->addr_lo) + cpu->Y);
 		cpu->target_addr = cpu->address_bus;
@@ -1257,7 +2455,8 @@ static void decode_ZP_read_store(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADL);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T2
 		set_address_bus_bytes(cpu, 0x00, cpu->addr_lo);
 		cpu->target_addr = cpu->addr_lo;
@@ -1275,15 +2474,18 @@ static void decode_ZP_rmw(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADL);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 3: // T2
 		set_address_bus_bytes(cpu, 0x00, cpu->addr_lo);
 		cpu->target_addr = cpu->addr_lo;
 		set_data_bus_via_read(cpu, cpu->target_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T3
 		write_to_cpu(cpu, cpu->target_addr, cpu->data_bus);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T4
 		cpu->instruction_state = EXECUTE;
 		break;
@@ -1299,12 +2501,14 @@ static void decode_ZPX_read_store(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADL); // base address
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T2 (dummy read)
 		set_address_bus_bytes(cpu, 0x00, cpu->addr_lo);
 		cpu->target_addr = cpu->addr_lo;
 		set_data_bus_via_read(cpu, cpu->target_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T3
 		set_address_bus_bytes(cpu, 0x00, cpu->addr_lo + cpu->X);
 		cpu->target_addr = (uint8_t) (cpu->addr_lo + cpu->X);
@@ -1322,20 +2526,24 @@ static void decode_ZPX_rmw(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADL);
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 4: // T2 (dummy read)
 		set_address_bus_bytes(cpu, 0x00, cpu->addr_lo);
 		cpu->target_addr = cpu->addr_lo;
 		set_data_bus_via_read(cpu, cpu->target_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 3: // T3
 		set_address_bus_bytes(cpu, 0x00, cpu->addr_lo + cpu->X);
 		cpu->target_addr = (uint8_t) (cpu->addr_lo + cpu->X);
 		set_data_bus_via_read(cpu, cpu->target_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T4 (dummy write)
 		write_to_cpu(cpu, cpu->target_addr, cpu->data_bus);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T5
 		cpu->instruction_state = EXECUTE;
 		break;
@@ -1351,12 +2559,14 @@ static void decode_ZPY_read_store(Cpu6502* cpu)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, ADL); // base address
 		++cpu->PC;
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T2 (dummy read)
 		set_address_bus_bytes(cpu, 0x00, cpu->addr_lo);
 		cpu->target_addr = cpu->addr_lo;
 		set_data_bus_via_read(cpu, cpu->target_addr, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T3
 		set_address_bus_bytes(cpu, 0x00, cpu->addr_lo + cpu->Y);
 		cpu->target_addr = (uint8_t) (cpu->addr_lo + cpu->Y);
@@ -1399,7 +2609,8 @@ static void decode_PUSH(Cpu6502* cpu)
 	case 2: // T1 (dummy read)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T2
 		cpu->instruction_state = EXECUTE;
 		// push A or P onto stack w/ PHA or PHP
@@ -1417,11 +2628,13 @@ static void decode_PULL(Cpu6502* cpu)
 	case 3: // T1 (dummy read)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T2 (dummy read on stack)
 		set_address_bus(cpu, SP_START + cpu->stack);
 		set_data_bus_via_read(cpu, SP_START + cpu->stack, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T2
 		cpu->instruction_state = EXECUTE;
 		// pull A or P via execute functions
@@ -1442,16 +2655,20 @@ static void decode_Bxx(Cpu6502* cpu) // branch instructions
 		if (branch_not_taken(cpu)) {
 			cpu->target_addr = cpu->PC; // already @ PC + 2 (1 from opcode and 1 from T1)
 			cpu->instruction_state = EXECUTE;
+			break;
 		}
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T2
 		// w/o carry --> (PCH | (PC + offset) & 0xFF)
 		set_address_bus_bytes(cpu, cpu->PC >> 8, (uint8_t) (cpu->PC + cpu->offset));
 		cpu->target_addr = (cpu->PC & 0xFF00) | ((cpu->PC + cpu->offset) & 0x00FF);
 		if (!page_cross_occurs(cpu->PC & 0xFF, cpu->offset)) {
 			cpu->instruction_state = EXECUTE;
+			break;
 		}
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T3 (page cross)
 		set_address_bus(cpu, cpu->PC + cpu->offset);
 		cpu->target_addr = cpu->PC + cpu->offset;
@@ -1468,21 +2685,25 @@ static void decode_RTS(Cpu6502* cpu)
 	case 5: // T1 (dummy read)
 		set_address_bus(cpu, cpu->PC);
 		set_data_bus_via_read(cpu, cpu->PC, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 4: // T2 (dummy read on stack)
 		set_address_bus(cpu, SP_START + cpu->stack);
 		set_data_bus_via_read(cpu, SP_START + cpu->stack, DATA);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 3: // T3
 		set_address_bus(cpu, SP_START + cpu->stack + 1); // pull increments SP to non-empty slot
 		cpu->addr_lo = stack_pull(cpu);
 		set_data_bus_via_write(cpu, cpu->addr_lo);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 2: // T4
 		set_address_bus(cpu, SP_START + cpu->stack + 1); // pull increments SP to non-empty slot
 		cpu->addr_hi = stack_pull(cpu);
 		set_data_bus_via_write(cpu, cpu->addr_hi);
-		break;
+		if (!decode_next_cycle(cpu)) { break; }
+		/* fall through */
 	case 1: // T5
 		cpu->instruction_state = EXECUTE;
 		break;
@@ -1552,7 +2773,6 @@ static void update_flag_c(Cpu6502* cpu, const int carry_out)
  */
 static void execute_LDA(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "LDA ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 	cpu->A = cpu->operand;
 	update_flag_n(cpu, cpu->A);
@@ -1564,7 +2784,6 @@ static void execute_LDA(Cpu6502* cpu)
  */
 static void execute_LDX(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "LDX ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 	cpu->X = cpu->operand;
 	update_flag_n(cpu, cpu->X);
@@ -1576,7 +2795,6 @@ static void execute_LDX(Cpu6502* cpu)
  */
 static void execute_LDY(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "LDY ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 	cpu->Y = cpu->operand;
 	update_flag_n(cpu, cpu->Y);
@@ -1588,7 +2806,6 @@ static void execute_LDY(Cpu6502* cpu)
  */
 static void execute_STA(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "STA ");
 	write_to_cpu(cpu, cpu->target_addr, cpu->A);
 }
 
@@ -1597,7 +2814,6 @@ static void execute_STA(Cpu6502* cpu)
  */
 static void execute_STX(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "STX ");
 	write_to_cpu(cpu, cpu->target_addr, cpu->X);
 }
 
@@ -1606,7 +2822,6 @@ static void execute_STX(Cpu6502* cpu)
  */
 static void execute_STY(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "STY ");
 	write_to_cpu(cpu, cpu->target_addr, cpu->Y);
 }
 
@@ -1615,7 +2830,6 @@ static void execute_STY(Cpu6502* cpu)
  */
 static void execute_TAX(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "TAX ");
 	cpu->X = cpu->A;
 	update_flag_n(cpu, cpu->X);
 	update_flag_z(cpu, cpu->X);
@@ -1626,7 +2840,6 @@ static void execute_TAX(Cpu6502* cpu)
  */
 static void execute_TAY(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "TAY ");
 	cpu->Y = cpu->A;
 	update_flag_n(cpu, cpu->Y);
 	update_flag_z(cpu, cpu->Y);
@@ -1637,7 +2850,6 @@ static void execute_TAY(Cpu6502* cpu)
  */
 static void execute_TSX(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "TSX ");
 	cpu->X = cpu->stack;
 	update_flag_n(cpu, cpu->X);
 	update_flag_z(cpu, cpu->X);
@@ -1648,7 +2860,6 @@ static void execute_TSX(Cpu6502* cpu)
  */
 static void execute_TXA(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "TXA ");
 	cpu->A = cpu->X;
 	update_flag_n(cpu, cpu->A);
 	update_flag_z(cpu, cpu->A);
@@ -1659,7 +2870,6 @@ static void execute_TXA(Cpu6502* cpu)
  */
 static void execute_TXS(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "TXS ");
 	cpu->stack = cpu->X;
 }
 
@@ -1668,7 +2878,6 @@ static void execute_TXS(Cpu6502* cpu)
  */
 static void execute_TYA(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "TYA ");
 	cpu->A = cpu->Y;
 	update_flag_n(cpu, cpu->A);
 	update_flag_z(cpu, cpu->A);
@@ -1682,7 +2891,6 @@ static void execute_TYA(Cpu6502* cpu)
  */
 static void execute_ADC(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "ADC ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 
 	int result = cpu->A + cpu->operand + (cpu->P & FLAG_C);
@@ -1706,7 +2914,6 @@ static void execute_ADC(Cpu6502* cpu)
  */
 static void execute_DEC(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "DEC ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 	write_to_cpu(cpu, cpu->target_addr, cpu->operand - 1);
 	update_flag_n(cpu, cpu->operand - 1);
@@ -1719,7 +2926,6 @@ static void execute_DEC(Cpu6502* cpu)
 static void execute_DEX(Cpu6502* cpu)
 {
 	/* Implied Mode */
-	strcpy(cpu->instruction, "DEX ");
 	--cpu->X;
 	update_flag_n(cpu, cpu->X);
 	update_flag_z(cpu, cpu->X);
@@ -1731,7 +2937,6 @@ static void execute_DEX(Cpu6502* cpu)
 static void execute_DEY(Cpu6502* cpu)
 {
 	/* Implied Mode */
-	strcpy(cpu->instruction, "DEY ");
 	--cpu->Y;
 	update_flag_n(cpu, cpu->Y);
 	update_flag_z(cpu, cpu->Y);
@@ -1742,7 +2947,6 @@ static void execute_DEY(Cpu6502* cpu)
  */
 static void execute_INC(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "INC ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 	write_to_cpu(cpu, cpu->target_addr, cpu->operand + 1);
 	update_flag_n(cpu, cpu->operand + 1);
@@ -1754,7 +2958,6 @@ static void execute_INC(Cpu6502* cpu)
  */
 static void execute_INX(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "INX ");
 	/* Implied Mode */
 	++cpu->X;
 	update_flag_n(cpu, cpu->X);
@@ -1766,7 +2969,6 @@ static void execute_INX(Cpu6502* cpu)
  */
 static void execute_INY(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "INY ");
 	/* Implied Mode */
 	++cpu->Y;
 	update_flag_n(cpu, cpu->Y);
@@ -1779,7 +2981,6 @@ static void execute_INY(Cpu6502* cpu)
 static void execute_SBC(Cpu6502* cpu)
 
 {
-	strcpy(cpu->instruction, "SBC ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 
 	int result = cpu->A - cpu->operand - !(cpu->P & FLAG_C);
@@ -1810,7 +3011,6 @@ static void execute_SBC(Cpu6502* cpu)
  */
 static void execute_AND(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "AND ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 	cpu->A &= cpu->operand;
 	update_flag_n(cpu, cpu->A);
@@ -1823,20 +3023,25 @@ static void execute_AND(Cpu6502* cpu)
  */
 static void execute_ASL(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "ASL ");
 	// read from memory or accumulator
 	uint8_t operand = cpu_generic_read(cpu, ADDRESS_MODE_DEP
 	                                  , cpu->address_mode
 	                                  , cpu->target_addr
 	                                  , NULL);
+	cpu_generic_write(cpu, ADDRESS_MODE_DEP, cpu->address_mode
+	                 , cpu->target_addr, NULL, shift_ASL(cpu, operand));
+}
+
+// shifts operand and updates the flags, shared with the fused handlers
+static uint8_t shift_ASL(Cpu6502* cpu, uint8_t operand)
+{
 	unsigned high_bit = operand & 0x80; // Mask 7th bit
 	uint8_t asl_result = operand << 1;
-	cpu_generic_write(cpu, ADDRESS_MODE_DEP, cpu->address_mode
-	                 , cpu->target_addr, NULL, asl_result);
 
 	update_flag_n(cpu, asl_result);
 	update_flag_z(cpu, asl_result);
 	update_flag_c(cpu, high_bit >> 7);
+	return asl_result;
 }
 
 
@@ -1844,7 +3049,6 @@ static void execute_ASL(Cpu6502* cpu)
  */
 static void execute_BIT(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "BIT ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 	/* Update Flags */
 	/* N = Bit 7, V = Bit 6 (of fetched operand) & Z = 1 (if AND result = 0) */
@@ -1859,7 +3063,6 @@ static void execute_BIT(Cpu6502* cpu)
  */
 static void execute_EOR(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "EOR ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 	cpu->A ^= cpu->operand;
 	update_flag_n(cpu, cpu->A);
@@ -1871,20 +3074,24 @@ static void execute_EOR(Cpu6502* cpu)
  */
 static void execute_LSR(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "LSR ");
 	// read from memory or accumulator
 	uint8_t operand = cpu_generic_read(cpu, ADDRESS_MODE_DEP
 	                                  , cpu->address_mode
 	                                  , cpu->target_addr
 	                                  , NULL);
+	cpu_generic_write(cpu, ADDRESS_MODE_DEP, cpu->address_mode
+	                 , cpu->target_addr, NULL, shift_LSR(cpu, operand));
+}
+
+static uint8_t shift_LSR(Cpu6502* cpu, uint8_t operand)
+{
 	unsigned low_bit = operand & 0x01; // Mask 0th bit
 	uint8_t lsr_result = operand >> 1;
-	cpu_generic_write(cpu, ADDRESS_MODE_DEP, cpu->address_mode
-	                 , cpu->target_addr, NULL, lsr_result);
 
 	update_flag_n(cpu, lsr_result);
 	update_flag_z(cpu, lsr_result);
 	update_flag_c(cpu, low_bit);
+	return lsr_result;
 }
 
 
@@ -1892,7 +3099,6 @@ static void execute_LSR(Cpu6502* cpu)
  */
 static void execute_ORA(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "ORA ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 	cpu->A |= cpu->operand;
 	update_flag_n(cpu, cpu->A);
@@ -1905,23 +3111,27 @@ static void execute_ORA(Cpu6502* cpu)
  */
 static void execute_ROL(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "ROL ");
 	// read from memory or accumulator
 	uint8_t operand = cpu_generic_read(cpu, ADDRESS_MODE_DEP
 	                                  , cpu->address_mode
 	                                  , cpu->target_addr
 	                                  , NULL);
+	cpu_generic_write(cpu, ADDRESS_MODE_DEP, cpu->address_mode
+	                 , cpu->target_addr, NULL, shift_ROL(cpu, operand));
+}
+
+static uint8_t shift_ROL(Cpu6502* cpu, uint8_t operand)
+{
 	unsigned high_bit = operand & 0x80; // Mask 7th bit
 	uint8_t rol_result = operand << 1;
 	if (cpu->P & FLAG_C) {
 		rol_result |= FLAG_C; // Copy carry into LSB (bit 0)
 	} // if carry = 0 do nothing as that still leaves a zero in the 0th bit
-	cpu_generic_write(cpu, ADDRESS_MODE_DEP, cpu->address_mode
-	                 , cpu->target_addr, NULL, rol_result);
 
 	update_flag_n(cpu, rol_result);
 	update_flag_z(cpu, rol_result);
 	update_flag_c(cpu, high_bit >> 7);
+	return rol_result;
 }
 
 
@@ -1930,23 +3140,27 @@ static void execute_ROL(Cpu6502* cpu)
  */
 static void execute_ROR(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "ROR ");
 	// read from memory or accumulator
 	uint8_t operand = cpu_generic_read(cpu, ADDRESS_MODE_DEP
 	                                  , cpu->address_mode
 	                                  , cpu->target_addr
 	                                  , NULL);
+	cpu_generic_write(cpu, ADDRESS_MODE_DEP, cpu->address_mode
+	                 , cpu->target_addr, NULL, shift_ROR(cpu, operand));
+}
+
+static uint8_t shift_ROR(Cpu6502* cpu, uint8_t operand)
+{
 	unsigned low_bit = operand & 0x01; // Mask 0th bit
 	uint8_t ror_result = operand >> 1;
 	if (cpu->P & FLAG_C) {
 		ror_result |= 0x80; // Copy carry into MSB (bit 7)
 	} // if carry = 0 do nothing as that still leaves a zero in the 7th bit
-	cpu_generic_write(cpu, ADDRESS_MODE_DEP, cpu->address_mode
-	                 , cpu->target_addr, NULL, ror_result);
 
 	update_flag_n(cpu, ror_result);
 	update_flag_z(cpu, ror_result);
 	update_flag_c(cpu, low_bit);
+	return ror_result;
 }
 
 /***************************
@@ -1959,7 +3173,6 @@ static void execute_ROR(Cpu6502* cpu)
  */
 static void execute_BCC(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "BCC ");
 	cpu->PC = cpu->target_addr;
 }
 
@@ -1968,7 +3181,6 @@ static void execute_BCC(Cpu6502* cpu)
  */
 static void execute_BCS(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "BCS ");
 	cpu->PC = cpu->target_addr;
 }
 
@@ -1977,7 +3189,6 @@ static void execute_BCS(Cpu6502* cpu)
  */
 static void execute_BEQ(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "BEQ ");
 	cpu->PC = cpu->target_addr;
 }
 
@@ -1986,7 +3197,6 @@ static void execute_BEQ(Cpu6502* cpu)
  */
 static void execute_BMI(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "BMI ");
 	cpu->PC = cpu->target_addr;
 }
 
@@ -1995,7 +3205,6 @@ static void execute_BMI(Cpu6502* cpu)
  */
 static void execute_BNE(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "BNE ");
 	cpu->PC = cpu->target_addr;
 }
 
@@ -2004,7 +3213,6 @@ static void execute_BNE(Cpu6502* cpu)
  */
 static void execute_BPL(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "BPL ");
 	cpu->PC = cpu->target_addr;
 }
 
@@ -2013,7 +3221,6 @@ static void execute_BPL(Cpu6502* cpu)
  */
 static void execute_BVC(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "BVC ");
 	cpu->PC = cpu->target_addr;
 }
 
@@ -2022,7 +3229,6 @@ static void execute_BVC(Cpu6502* cpu)
  */
 static void execute_BVS(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "BVS ");
 	cpu->PC = cpu->target_addr;
 }
 
@@ -2035,7 +3241,6 @@ static void execute_BVS(Cpu6502* cpu)
  */
 static void execute_JMP(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "JMP ");
 	if (cpu->address_mode == ABS) {
 		switch (cpu->instruction_cycles_remaining) {
 		case 2: // T1
@@ -2088,7 +3293,6 @@ static void execute_JMP(Cpu6502* cpu)
  */
 static void execute_JSR(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "JSR ");
 	// opcode fetched: T0
 	switch (cpu->instruction_cycles_remaining) {
 	case 5: // T1
@@ -2129,7 +3333,6 @@ static void execute_JSR(Cpu6502* cpu)
  */
 static void execute_RTI(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "RTI");
 	// opcode fetched: T0
 	switch (cpu->instruction_cycles_remaining) {
 	case 5: // T1 (dummy read)
@@ -2168,7 +3371,6 @@ static void execute_RTI(Cpu6502* cpu)
  */
 static void execute_RTS(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "RTS");
 	cpu->target_addr = append_hi_byte_to_lo_byte(cpu->addr_hi, cpu->addr_lo);
 	set_data_bus_via_read(cpu, cpu->target_addr, DATA); // dummy read
 	cpu->PC = cpu->target_addr + 1;
@@ -2182,7 +3384,6 @@ static void execute_RTS(Cpu6502* cpu)
  */
 static void execute_CLC(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "CLC");
 	cpu->P &= ~FLAG_C;
 }
 
@@ -2191,7 +3392,6 @@ static void execute_CLC(Cpu6502* cpu)
  */
 static void execute_CLD(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "CLD");
 	cpu->P &= ~FLAG_D;
 
 }
@@ -2201,7 +3401,6 @@ static void execute_CLD(Cpu6502* cpu)
  */
 static void execute_CLI(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "CLI");
 	cpu->P &= ~FLAG_I;
 }
 
@@ -2210,7 +3409,6 @@ static void execute_CLI(Cpu6502* cpu)
  */
 static void execute_CLV(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "CLV");
 	cpu->P &= ~FLAG_V;
 }
 
@@ -2219,7 +3417,6 @@ static void execute_CLV(Cpu6502* cpu)
  */
 static void execute_CMP(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "CMP ");
 	/* CMP - same as SBC except result isn't stored and V flag isn't changed */
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 
@@ -2234,7 +3431,6 @@ static void execute_CMP(Cpu6502* cpu)
  */
 static void execute_CPX(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "CPX ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 	int result = cpu->X - cpu->operand;
 	update_flag_n(cpu, result);
@@ -2247,7 +3443,6 @@ static void execute_CPX(Cpu6502* cpu)
  */
 static void execute_CPY(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "CPY ");
 	cpu->operand = read_from_cpu(cpu, cpu->target_addr);
 
 	int result = cpu->Y - cpu->operand;
@@ -2261,7 +3456,6 @@ static void execute_CPY(Cpu6502* cpu)
  */
 static void execute_SEC(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "SEC ");
 	cpu->P |= FLAG_C;
 }
 
@@ -2270,7 +3464,6 @@ static void execute_SEC(Cpu6502* cpu)
  */
 static void execute_SED(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "SED ");
 	cpu->P |= FLAG_D;
 }
 
@@ -2279,7 +3472,6 @@ static void execute_SED(Cpu6502* cpu)
  */
 static void execute_SEI(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "SEI ");
 	cpu->P |= FLAG_I;
 }
 
@@ -2289,14 +3481,12 @@ static void execute_SEI(Cpu6502* cpu)
 
 static void execute_PHA(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "PHA ");
 	set_data_bus_via_write(cpu, cpu->A);
 	stack_push(cpu, cpu->A);
 }
 
 static void execute_PHP(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "PHP ");
 	set_data_bus_via_write(cpu, cpu->P | 0x30);
 	stack_push(cpu, cpu->P | 0x30); // set bits 4 & 5
 }
@@ -2304,7 +3494,6 @@ static void execute_PHP(Cpu6502* cpu)
 
 static void execute_PLA(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "PLA ");
 	cpu->A = stack_pull(cpu);
 	set_data_bus_via_write(cpu, cpu->A);
 	update_flag_n(cpu, cpu->A);
@@ -2314,7 +3503,6 @@ static void execute_PLA(Cpu6502* cpu)
 
 static void execute_PLP(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "PLP ");
 	cpu->P = stack_pull(cpu) & ~ 0x10; // B flag may exist on stack but not P so it is cleared
 	cpu->P |= 0x20; // bit 5 always set
 	set_data_bus_via_read(cpu, SP_START + cpu->stack, DATA);
@@ -2328,7 +3516,6 @@ static void execute_PLP(Cpu6502* cpu)
  */
 static void execute_BRK(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "BRK ");
 	// opcode fetched: T0
 	switch (cpu->instruction_cycles_remaining) {
 	case 6: // T1 (dummy read)
@@ -2374,7 +3561,6 @@ static void execute_BRK(Cpu6502* cpu)
  */
 static void execute_NOP(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "NOP ");
 	(void) cpu; // suppress unused variable compiler warning
 }
 
@@ -2382,7 +3568,7 @@ static void execute_NOP(Cpu6502* cpu)
 /* Non opcode interrupts */
 static void execute_IRQ(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "IRQ ");
+	cpu->trace_event = TRACE_IRQ;
 	// opcode fetched: T0
 	switch (cpu->instruction_cycles_remaining) {
 	case 6: // T1 (dummy read)
@@ -2425,7 +3611,7 @@ static void execute_IRQ(Cpu6502* cpu)
 
 static void execute_NMI(Cpu6502* cpu)
 {
-	strcpy(cpu->instruction, "NMI");
+	cpu->trace_event = TRACE_NMI;
 	cpu->address_mode = SPECIAL;
 	// opcode fetched: T0
 	switch (cpu->cpu_ppu_io->nmi_cycles_left) {
@@ -2470,41 +3656,31 @@ static void execute_NMI(Cpu6502* cpu)
 static void execute_DMA(Cpu6502* cpu)
 {
 	/* Triggered by PPU, CPU is suspended */
-	strcpy(cpu->instruction, "DMA");
+	cpu->trace_event = TRACE_DMA;
 	cpu->address_mode = SPECIAL;
 
-	// initialise static (actually takes 513 cycles to complete)
-	// this is due to the first idle tick(s) and the if (cycles < 513) check
-	// which nullifies the last cycle skip
-	static unsigned cycles_left = 514;
-
-	// + 1 cycle on an odd cycle
-	if (((cpu->cycle - 1) & 1) && cycles_left == 514) {  cycles_left += 1;  }
-
-	if (cycles_left >= 513) {
-		// dummy read
-		--cycles_left;
-	}
-
-	// copy to dma, alternating read and writes
-	unsigned index = 0;
-	//static unsigned read = 0; // read comments below
-	if (cycles_left < 513) {
-		index = (512 - cycles_left) / 2; // index starts from 256 and ends on 0
-		if (cycles_left % 2) { // read (on the first cycle)
-			// have weird behaviour using static variable
-			// just write the expected read on the second cycle
-			//read = cpu->mem[(cpu->base_addr << 8) + index];
-		} else { // write (on the second)
-			cpu->cpu_ppu_io->oam[cpu->cpu_ppu_io->oam_addr + index] = cpu->mem[(cpu->base_addr << 8) + index];
-		}
-		--cycles_left;
+	// takes 513 cycles, + 1 cycle when starting on an odd cycle, the
+	// last cycle is scheduled up front and the rest count down to it
+	EventQueue* events = &cpu->cpu_ppu_io->events;
+	uint64_t now = 3 * cpu->cycle;
+	if (!events_pending(events, EVENT_DMA_DONE)) {
+		unsigned length = ((cpu->cycle - 1) & 1) ? 514 : 513;
+		events_schedule(events, EVENT_DMA_DONE, now + 3 * (length - 1));
+	}
+	unsigned cycles_left = (unsigned) ((events->when[EVENT_DMA_DONE] - now) / 3) + 1;
+
+	// dummy read(s) first then alternating reads and writes, the read is
+	// done on the write cycle, the last cycle is a read
+	if (cycles_left <= 512 && !(cycles_left % 2)) {
+		unsigned index = (512 - cycles_left) / 2; // index starts from 0 and ends on 255
+		// read without side effects, I/O pages give their last written value
+		uint16_t addr = (uint16_t) ((cpu->base_addr << 8) + index);
+		const uint8_t* page = cpu->read_page[addr >> 8];
+		cpu->cpu_ppu_io->oam[cpu->cpu_ppu_io->oam_addr + index] = page ? page[addr & 0xFF] : cpu->mem[addr];
 	}
 
-	// reset static
-	if (cycles_left == 0) {
+	if (events_pop(events, now, 1u << EVENT_DMA_DONE) == EVENT_DMA_DONE) {
 		cpu->instruction_state = POST_EXECUTE;
 		cpu->cpu_ppu_io->dma_pending = false;
-		cycles_left = 514;
 	}
 }
@@ -33,6 +33,10 @@ int cpu_mapper_init(CpuMapperShare* cpu_mapper, Cartridge* cart)
 	cpu_mapper->prg_high_bank_fixed = false;
 	cpu_mapper->enable_prg_ram = false;
 
+	cpu_mapper->mmc1_write_count = 0;
+	cpu_mapper->mmc1_shift_reg = 0;
+	cpu_mapper->mmc1_write_cycle = 0;
+
 	return_code = 0;
 
 	return return_code;
@@ -41,9 +41,8 @@ int cpu_ppu_io_init(CpuPpuShare* cpu_ppu_io)
 
 	cpu_ppu_io->nmi_cycles_left = 7;
 
-	cpu_ppu_io->buffer_write = false;
+	events_init(&cpu_ppu_io->events);
 	cpu_ppu_io->buffer_address = 0;
-	cpu_ppu_io->buffer_counter = 0;
 	cpu_ppu_io->buffer_value = 0;
 
 	// Ppu related stuff
@@ -1,12 +1,16 @@
 /* NES emulator executes here */
 
 #include "emu.h"
+#include "nes.h"
 #include "cart.h"
 #include "cpu.h"
 #include "ppu.h"
 #include "gui.h"
 #include "cpu_ppu_interface.h"
-#include "cpu_mapper_interface.h"
+#include "movie.h"
+#include "trace.h"
+#include "block_cache.h"
+#include "jit.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,15 +26,11 @@
 #define RIGHT_BUTTON  0x80U
 
 
-void clock_all_units(Cpu6502* cpu, Ppu2C02* ppu, Sdl2DisplayOutputs* cnes_windows, const bool logging_cpu_instructions)
+static void log_cpu_instruction(Cpu6502* cpu, Ppu2C02* ppu, const bool logging_cpu_instructions)
 {
-	// 3 : 1 PPU to CPU ratio
-	clock_cpu(cpu);
-	clock_ppu(ppu, cpu, cnes_windows);
-	clock_ppu(ppu, cpu, cnes_windows);
-	clock_ppu(ppu, cpu, cnes_windows);
-
 	// only used in DEBUG mode, suppress unused variable for RELEASE
+	(void) cpu;
+	(void) ppu;
 	(void) logging_cpu_instructions;
 
 #ifdef __DEBUG__
@@ -38,12 +38,30 @@ void clock_all_units(Cpu6502* cpu, Ppu2C02* ppu, Sdl2DisplayOutputs* cnes_window
 		set_cpu_disassembler_trace(cpu, cpu->instruction, cpu->append_int, cpu->end);
 		print_cpu_instruction_trace(cpu);
 		update_cpu_info(cpu);
+		cpu_sync_ppu(cpu);
 		append_ppu_info(ppu);
 		cpu->trigger_trace_logger = false;
 	}
 #endif /* __DEBUG__ */
 }
 
+// cpu must have the ppu attached, see cpu_attach_ppu()
+void clock_all_units(Cpu6502* cpu, Ppu2C02* ppu, const bool logging_cpu_instructions)
+{
+	// 3 : 1 PPU to CPU ratio, the attached ppu catches up when it has to
+	clock_cpu_and_ppu(cpu);
+
+	log_cpu_instruction(cpu, ppu, logging_cpu_instructions);
+}
+
+// cpu must have the ppu attached, see cpu_attach_ppu()
+void step_all_units(Cpu6502* cpu, Ppu2C02* ppu, const bool logging_cpu_instructions)
+{
+	cpu_step_instruction(cpu);
+
+	log_cpu_instruction(cpu, ppu, logging_cpu_instructions);
+}
+
 void emu_usuage(const char* program_name)
 {
 	fprintf(stderr, "\nUSAGE: %s [options]\n", program_name);
@@ -53,7 +71,13 @@ void emu_usuage(const char* program_name)
 	fprintf(stderr, "\t-s\n\tSuppress logging to file or terminal\n\n");
 	fprintf(stderr, "\t-o FILE\n\tOpen the provided file\n\n");
 	fprintf(stderr, "\t-c CYCLES\n\tRun the CPU up to the specified number of cycles\n\n");
-	fprintf(stderr, "\t-u UI_SCALE_FACTOR\n\tScaling factor (integer) to be applied to the displayed output\n");
+	fprintf(stderr, "\t-i\n\tStep the CPU an instruction at a time, the PPU is caught up on demand\n\n");
+	fprintf(stderr, "\t-j\n\tRecompile hot PRG ROM code to native code (x86-64 only), implies -i\n\n");
+	fprintf(stderr, "\t-u UI_SCALE_FACTOR\n\tScaling factor (integer) to be applied to the displayed output\n\n");
+	fprintf(stderr, "\t-r MOVIE\n\tRecord the controller input to MOVIE (written on exit)\n\n");
+	fprintf(stderr, "\t-p MOVIE\n\tPlay back the controller input recorded in MOVIE, the keyboard is ignored\n\n");
+	fprintf(stderr, "\t-t TRACE\n\tRecord the last executed instructions to TRACE (written on exit), F9 pauses/resumes\n");
+	fprintf(stderr, "\tthe trace. View it with cnes-tracedump\n");
 }
 
 void process_player_1_input(SDL_Event e, Cpu6502* cpu)
@@ -150,7 +174,12 @@ int main(int argc, char** argv)
 	bool help = false;
 	bool log_to_file = false;
 	bool logging_cpu_instructions = true;
+	bool step_instructions = false;
+	bool use_jit = false;
 	int ui_scale_factor = 1;
+	const char* record_filename = NULL;
+	const char* play_filename = NULL;
+	const char* trace_filename = NULL;
 
 	// process command line arguments
 	while ((argc > 1) && (argv[1][0] == '-')) {
@@ -194,6 +223,12 @@ int main(int argc, char** argv)
 			++argv;
 			max_cycles = atoi(&argv[1][0]);
 			break;
+		case 'i': // i - instruction stepping instead of cycle stepping
+			step_instructions = true;
+			break;
+		case 'j': // j - recompile hot PRG ROM blocks
+			step_instructions = use_jit = true;
+			break;
 		case 'u': // u - change ui scale factor of emulator
 			if (argc < 3 || (argv[2][0] == '-')) {
 				fprintf(stderr, "Please provide an integer\n");
@@ -204,6 +239,31 @@ int main(int argc, char** argv)
 			++argv;
 			ui_scale_factor = atoi(&argv[1][0]);
 			break;
+		case 'r': // r - record an input movie
+		case 'p': // p - play back an input movie
+			if (argc < 3 || (argv[2][0] == '-')) {
+				fprintf(stderr, "Please provide a movie filename\n");
+				help = true;
+				break;
+			}
+			if (argv[1][1] == 'r') {
+				record_filename = &argv[2][0];
+			} else {
+				play_filename = &argv[2][0];
+			}
+			--argc;
+			++argv;
+			break;
+		case 't': // t - binary instruction trace
+			if (argc < 3 || (argv[2][0] == '-')) {
+				fprintf(stderr, "Please provide a trace filename\n");
+				help = true;
+				break;
+			}
+			--argc;
+			++argv;
+			trace_filename = &argv[1][0];
+			break;
 		}
 		// increment argv and decrement argc
 		--argc;
@@ -218,73 +278,90 @@ int main(int argc, char** argv)
 
 #define __RESET__
 
-	Cartridge* cart = cart_allocator();
-	CpuMapperShare* cpu_mapper = cpu_mapper_allocator();
-	CpuPpuShare* cpu_ppu = cpu_ppu_io_allocator();
-	Cpu6502* cpu = cpu_allocator();
-	Ppu2C02* ppu = ppu_allocator();
-	Sdl2DisplayOutputs cnes_windows;
-	cnes_windows.cnes_main = sdl2_display_allocator();
-
-	if (!cart || !cpu_mapper || !cpu_ppu || !cpu || !ppu || !cnes_windows.cnes_main) {
-		goto program_exit;
-	}
-
-	if (cart_init(cart)) {
-		fprintf(stderr, "Failed to initialise the Cart struct members\n");
-	}
-
-	if (cpu_mapper_init(cpu_mapper, cart)) {
-		fprintf(stderr, "Failed to initialise the Cpu/Mapper struct members\n");
-	}
-
-	if (cpu_ppu_io_init(cpu_ppu)) {
-		fprintf(stderr, "Failed to initialise the Cpu/Ppu struct members\n");
-	}
-	map_ppu_data_to_cpu_ppu_io(cpu_ppu, ppu);
-
-	if (cpu_init(cpu, 0xC000, cpu_ppu, cpu_mapper)) {
-		fprintf(stderr, "Failed to initialise the Cpu struct members\n");
+	InputMovie* movie = NULL;
+	CpuTrace* trace = NULL;
+	BlockCache* block_cache = NULL;
+	Jit* jit = NULL;
+	Nes* nes = nes_allocator();
+	if (!nes) {
+		goto early_return;
 	}
 
-	if (ppu_init(ppu, cpu_ppu)) {
-		fprintf(stderr, "Failed to initialise the Ppu struct members\n");
-	}
+	nes_init(nes);
+	Cpu6502* cpu = nes->cpu;
+	Ppu2C02* ppu = nes->ppu;
+	Sdl2DisplayOutputs* cnes_windows = &nes->cnes_windows;
 
 	if (SDL_Init(SDL_INIT_VIDEO)) {
 		fprintf(stderr, "Failed to initialise the SDL library: %s\n", SDL_GetError());
 	}
 
-	if (screen_init(cnes_windows.cnes_main, "cNES"
+	if (screen_init(cnes_windows->cnes_main, "cNES"
 	               , DEFAULT_WIDTH, DEFAULT_HEIGHT, ui_scale_factor)) {
 		fprintf(stderr, "Error when initialsing the SDL2 display\n");
 	}
 
 #ifdef __DEBUG__
-	cnes_windows.cnes_nt_viewer = sdl2_display_allocator();
-	if (!cnes_windows.cnes_nt_viewer) {
-		goto program_exit;
-	}
-	if (screen_init(cnes_windows.cnes_nt_viewer, "cNES Nametable Viewer"
+	if (screen_init(cnes_windows->cnes_nt_viewer, "cNES Nametable Viewer"
 	               , DEFAULT_WIDTH * 2, DEFAULT_HEIGHT * 2, ui_scale_factor)) {
 		fprintf(stderr, "Error when initialsing the SDL2 display\n");
 	}
 #endif /* __DEBUG__ */
 
-	if (parse_nes_cart_file(cart, filename, cpu, ppu)) {
+	if (nes_load_cart(nes, filename)) {
 		goto program_exit;
 	}
 
-	init_pc(cpu); // Initialise PC to reset vector
-	update_cpu_info(cpu);
-
 	if (log_to_file) {
 		stdout = freopen("trace_log.txt", "w", stdout);
 	}
 
+	if (record_filename || play_filename) {
+		movie = movie_allocator();
+		if (!movie) {
+			goto program_exit;
+		}
+		if (play_filename) {
+			if (movie_load(movie, play_filename, nes)) {
+				goto program_exit;
+			}
+			movie_play_frame(movie, nes);
+		} else {
+			movie_init(movie, nes);
+			movie_record_frame(movie, nes);
+		}
+	}
+
+	// the ppu lags behind the cpu and catches up when it has to
+	cpu_attach_ppu(cpu, ppu, cnes_windows);
+	if (step_instructions) {
+		block_cache = block_cache_allocator();
+		if (!block_cache || block_cache_init(block_cache, &nes->cart->prg_rom)) {
+			goto program_exit;
+		}
+		cpu_attach_block_cache(cpu, block_cache);
+	}
+
+	if (use_jit) {
+		jit = jit_allocator();
+		if (!jit || jit_init(jit, &nes->cart->prg_rom, false)) {
+			goto program_exit;
+		}
+		cpu_attach_jit(cpu, jit);
+	}
+
+	if (trace_filename) {
+		trace = cpu_trace_allocator();
+		if (!trace || cpu_trace_init(trace, TRACE_DEFAULT_MAX_RECORDS, ppu)) {
+			goto program_exit;
+		}
+		cpu_attach_trace(cpu, trace);
+	}
+
 	/* SDL GAME LOOOOOOP */
 	int quit = 0;
 	SDL_Event e;
+	bool last_odd_frame = ppu->odd_frame;
 	while (!quit) {
 		// run for a fixed number of cycles if specified by the user
 		if (max_cycles && (cpu->cycle > max_cycles)) { quit = 1; }
@@ -294,38 +371,57 @@ int main(int argc, char** argv)
 				if (e.type == SDL_QUIT) {
 					quit = 1;
 				}
-				process_player_1_input(e, cpu);
+				if (!play_filename) {
+					process_player_1_input(e, cpu);
+				}
+				if (trace && (e.type == SDL_KEYDOWN) && (e.key.keysym.sym == SDLK_F9) && !e.key.repeat) {
+					cpu_attach_trace(cpu, cpu->trace ? NULL : trace);
+				}
 
-				process_window_events(e, cnes_windows.cnes_main);
+				process_window_events(e, cnes_windows->cnes_main);
 #ifdef __DEBUG__
-				process_window_events(e, cnes_windows.cnes_nt_viewer);
+				process_window_events(e, cnes_windows->cnes_nt_viewer);
 #endif/* __DEBUG__ */
 			}
 		}
-		clock_all_units(cpu, ppu, &cnes_windows, logging_cpu_instructions);
+		if (step_instructions) {
+			step_all_units(cpu, ppu, logging_cpu_instructions);
+		} else {
+			clock_all_units(cpu, ppu, logging_cpu_instructions);
+		}
+
+		// input movies are fed/sampled once per frame, when odd_frame flips
+		if (movie && (ppu->odd_frame != last_odd_frame)) {
+			if (play_filename) {
+				movie_play_frame(movie, nes);
+			} else {
+				movie_record_frame(movie, nes);
+			}
+		}
+		last_odd_frame = ppu->odd_frame;
 	}
 
 	SDL_Quit();
 
+	if (record_filename && movie_save(movie, record_filename)) {
+		goto program_exit;
+	}
+
+	if (trace && cpu_trace_flush(trace, trace_filename)) {
+		goto program_exit;
+	}
+
 	//cpu_mem_hexdump_addr_range(cpu, 0x0000, 0x2000);
 	//ppu_mem_hexdump_addr_range(ppu, VRAM, 0x0000, 0x2000);
 
 	ret = 0;
 
 program_exit:
-	free(cart->chr_rom.data);
-	free(cart->chr_ram.data);
-	free(cart->prg_rom.data);
-	free(cart->trainer.data);
-	free(cart);
-	free(cnes_windows.cnes_main);
-#ifdef __DEBUG__
-	free(cnes_windows.cnes_nt_viewer);
-#endif /* __DEBUG__ */
-	free(ppu);
-	free(cpu);
-	free(cpu_ppu);
-	free(cpu_mapper);
+	movie_free(movie);
+	cpu_trace_free(trace);
+	block_cache_free(block_cache);
+	jit_free(jit);
+	nes_free(nes);
 
 early_return:
 	return ret;
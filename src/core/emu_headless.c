@@ -0,0 +1,284 @@
+/* Headless NES emulator: no SDL, no input, no window
+ *
+ * Links against the null video backend (gui_null.c) and runs as fast as the
+ * host allows. Prints throughput and a hash of the final frame so runs can be
+ * compared between builds/machines.
+ */
+
+#include "nes.h"
+#include "cart.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "gui.h"
+#include "movie.h"
+#include "trace.h"
+#include "block_cache.h"
+#include "jit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+
+
+static void headless_usuage(const char* program_name)
+{
+	fprintf(stderr, "\nUSAGE: %s [options]\n", program_name);
+	fprintf(stderr, "OPTIONS:\n");
+	fprintf(stderr, "\t-h\n\tShows all the possible command-line options\n\n");
+	fprintf(stderr, "\t-o FILE\n\tOpen the provided file\n\n");
+	fprintf(stderr, "\t-c CYCLES\n\tRun the CPU up to the specified number of cycles\n\n");
+	fprintf(stderr, "\t--frames N\n\tRun the emulator for N frames\n\n");
+	fprintf(stderr, "\t-i\n\tStep the CPU an instruction at a time, the PPU is caught up on demand\n\n");
+	fprintf(stderr, "\t-j\n\tRecompile hot PRG ROM code to native code (x86-64 only), implies -i\n\n");
+	fprintf(stderr, "\t--jit-verify\n\tLike -j but every recompiled block is checked against the interpreter\n\n");
+	fprintf(stderr, "\t-p MOVIE\n\tPlay back the controller input recorded in MOVIE (see cnes -r)\n\n");
+	fprintf(stderr, "\t-t TRACE\n\tRecord the last executed instructions to TRACE, view it with cnes-tracedump\n\n");
+	fprintf(stderr, "At least one of -c, --frames or -p must be given, the first limit reached stops the run\n");
+	fprintf(stderr, "(-p on its own runs until the movie ends)\n");
+}
+
+/* 64-bit FNV-1a over the framebuffer, cheap and good enough to spot a changed frame */
+static uint64_t hash_framebuffer(const uint32_t* buffer, size_t len)
+{
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for (size_t i = 0; i < len; i++) {
+		for (int byte = 0; byte < 4; byte++) {
+			hash ^= (buffer[i] >> (byte * 8)) & 0xFF;
+			hash *= 0x100000001B3ULL;
+		}
+	}
+
+	return hash;
+}
+
+int main(int argc, char** argv)
+{
+	int ret = -1;
+
+	const char* program_name = "cnes-headless";
+	char* filename = "dummy.nes";  // default: forces user to submit a file to open
+	unsigned long max_cycles = 0;
+	unsigned long max_frames = 0;
+	bool help = false;
+	bool step_instructions = false;
+	bool use_jit = false;
+	bool jit_verify = false;
+	const char* movie_filename = NULL;
+	const char* trace_filename = NULL;
+
+	// process command line arguments
+	while ((argc > 1) && (argv[1][0] == '-')) {
+		if (!strcmp(argv[1], "--frames")) {
+			if (argc < 3 || (argv[2][0] == '-')) {
+				fprintf(stderr, "Please provide an unsigned integer\n");
+				help = true;
+				break;
+			}
+			--argc;
+			++argv;
+			max_frames = strtoul(&argv[1][0], NULL, 10);
+			--argc;
+			++argv;
+			continue;
+		}
+		if (!strcmp(argv[1], "--jit-verify")) {
+			step_instructions = use_jit = jit_verify = true;
+			--argc;
+			++argv;
+			continue;
+		}
+
+		// make sure -x isn't the same as -xxxxxxx (where x is any command line option)
+		if (strlen(argv[1]) > 2) {
+			fprintf(stderr, "Command line option must be a single character when using the '-' option\n");
+			help = true;
+			break;
+		}
+
+		switch (argv[1][1]) {
+		case 'h': // h - display help message
+			help = true;
+			break;
+		case 'o': // o - open file
+			if (argc < 3 || (argv[2][0] == '-')) {
+				fprintf(stderr, "Please provide a filename\n");
+				help = true;
+				break;
+			}
+			--argc;
+			++argv;
+			filename = &argv[1][0];
+			break;
+		case 'c': // c - execute emulator for a fixed number of cpu clock cycles
+			if (argc < 3 || (argv[2][0] == '-')) {
+				fprintf(stderr, "Please provide an unsigned integer\n");
+				help = true;
+				break;
+			}
+			--argc;
+			++argv;
+			max_cycles = strtoul(&argv[1][0], NULL, 10);
+			break;
+		case 'i': // i - instruction stepping instead of cycle stepping
+			step_instructions = true;
+			break;
+		case 'j': // j - recompile hot PRG ROM blocks
+			step_instructions = use_jit = true;
+			break;
+		case 'p': // p - play back an input movie
+			if (argc < 3 || (argv[2][0] == '-')) {
+				fprintf(stderr, "Please provide a movie filename\n");
+				help = true;
+				break;
+			}
+			--argc;
+			++argv;
+			movie_filename = &argv[1][0];
+			break;
+		case 't': // t - binary instruction trace
+			if (argc < 3 || (argv[2][0] == '-')) {
+				fprintf(stderr, "Please provide a trace filename\n");
+				help = true;
+				break;
+			}
+			--argc;
+			++argv;
+			trace_filename = &argv[1][0];
+			break;
+		}
+		// increment argv and decrement argc
+		--argc;
+		++argv;
+	}
+
+	// without a limit the run would never end
+	if (!max_cycles && !max_frames && !movie_filename) {
+		help = true;
+	}
+
+	if (help) {
+		headless_usuage(program_name);
+		goto early_return;
+	}
+
+	InputMovie* movie = NULL;
+	CpuTrace* trace = NULL;
+	BlockCache* block_cache = NULL;
+	Jit* jit = NULL;
+	Nes* nes = nes_allocator();
+	if (!nes) {
+		goto early_return;
+	}
+
+	if (nes_init(nes)) {
+		goto program_exit;
+	}
+	Cpu6502* cpu = nes->cpu;
+	Ppu2C02* ppu = nes->ppu;
+
+	// null backend, these never fail but keep the window pointers NULL
+	screen_init(nes->cnes_windows.cnes_main, "cNES", DEFAULT_WIDTH, DEFAULT_HEIGHT, 1);
+	screen_init(nes->cnes_windows.cnes_nt_viewer, "cNES Nametable Viewer"
+	           , DEFAULT_WIDTH * 2, DEFAULT_HEIGHT * 2, 1);
+
+	if (nes_load_cart(nes, filename)) {
+		goto program_exit;
+	}
+
+	if (movie_filename) {
+		movie = movie_allocator();
+		if (!movie || movie_load(movie, movie_filename, nes)) {
+			goto program_exit;
+		}
+		if (!max_cycles && !max_frames) {
+			max_frames = movie->frame_count;
+		}
+		movie_play_frame(movie, nes);
+	}
+
+	// the ppu lags behind the cpu and catches up when it has to
+	cpu_attach_ppu(cpu, ppu, &nes->cnes_windows);
+	if (step_instructions) {
+		block_cache = block_cache_allocator();
+		if (!block_cache || block_cache_init(block_cache, &nes->cart->prg_rom)) {
+			goto program_exit;
+		}
+		cpu_attach_block_cache(cpu, block_cache);
+	}
+
+	if (use_jit) {
+		jit = jit_allocator();
+		if (!jit || jit_init(jit, &nes->cart->prg_rom, jit_verify)) {
+			goto program_exit;
+		}
+		cpu_attach_jit(cpu, jit);
+	}
+
+	if (trace_filename) {
+		trace = cpu_trace_allocator();
+		if (!trace || cpu_trace_init(trace, TRACE_DEFAULT_MAX_RECORDS, ppu)) {
+			goto program_exit;
+		}
+		cpu_attach_trace(cpu, trace);
+	}
+
+	unsigned long frames = 0;
+	bool last_odd_frame = ppu->odd_frame;
+	clock_t start = clock();
+	while (1) {
+		if (max_cycles && (cpu->cycle > max_cycles)) { break; }
+		if (max_frames && (frames >= max_frames)) { break; }
+
+		if (step_instructions) {
+			cpu_step_instruction(cpu);
+		} else {
+			clock_cpu_and_ppu(cpu); // 3 : 1 PPU to CPU ratio
+		}
+
+		// odd_frame flips once per frame (at the end of the pre-render scanline)
+		if (ppu->odd_frame != last_odd_frame) {
+			last_odd_frame = ppu->odd_frame;
+			++frames;
+			if (movie) {
+				movie_play_frame(movie, nes);
+			}
+		}
+	}
+	double elapsed = (double) (clock() - start) / CLOCKS_PER_SEC;
+	cpu_sync_ppu(cpu);
+
+	printf("frames: %lu\n", frames);
+	printf("cpu cycles: %" PRIu64 "\n", cpu->cycle);
+	printf("seconds: %.3f\n", elapsed);
+	printf("frames/sec: %.2f\n", elapsed > 0.0 ? frames / elapsed : 0.0);
+	printf("framebuffer hash: %016" PRIx64 "\n", hash_framebuffer(ppu->pixels, sizeof(ppu->pixels) / sizeof(ppu->pixels[0])));
+	if (jit) {
+		printf("jit blocks compiled: %lu\n", jit->blocks_compiled);
+		printf("jit instructions: %llu\n", jit->instructions);
+		if (jit_verify) {
+			printf("jit mismatches: %lu\n", jit->mismatches);
+			if (jit->mismatches) {
+				goto program_exit;
+			}
+		}
+	}
+
+	if (trace && cpu_trace_flush(trace, trace_filename)) {
+		goto program_exit;
+	}
+
+	ret = 0;
+
+program_exit:
+	movie_free(movie);
+	cpu_trace_free(trace);
+	block_cache_free(block_cache);
+	jit_free(jit);
+	nes_free(nes);
+
+early_return:
+	return ret;
+}
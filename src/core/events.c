@@ -0,0 +1,66 @@
+#include "events.h"
+
+static void update_next(EventQueue* q)
+{
+	q->next = EVENT_NEVER;
+	for (unsigned i = 0; i < EVENT_COUNT; i++) {
+		if (q->when[i] < q->next) {
+			q->next = q->when[i];
+		}
+	}
+}
+
+void events_init(EventQueue* q)
+{
+	q->now = 0;
+	for (unsigned i = 0; i < EVENT_COUNT; i++) {
+		q->when[i] = EVENT_NEVER;
+	}
+	q->next = EVENT_NEVER;
+}
+
+/* Each event type is pending at most once, scheduling it again moves it
+ */
+void events_schedule(EventQueue* q, EventType type, uint64_t when)
+{
+	q->when[type] = when;
+	if (when < q->next) {
+		q->next = when;
+	} else {
+		update_next(q);
+	}
+}
+
+void events_cancel(EventQueue* q, EventType type)
+{
+	if (q->when[type] == EVENT_NEVER) {
+		return;
+	}
+	q->when[type] = EVENT_NEVER;
+	update_next(q);
+}
+
+int events_pop(EventQueue* q, uint64_t timestamp, unsigned mask)
+{
+	if (q->next > timestamp) {
+		return -1;
+	}
+
+	int type = -1;
+	uint64_t earliest = timestamp;
+	for (unsigned i = 0; i < EVENT_COUNT; i++) {
+		if ((mask & (1u << i)) && q->when[i] <= earliest) {
+			// ties go to the lower type, keep the first one found
+			if (type < 0 || q->when[i] < earliest) {
+				type = (int) i;
+				earliest = q->when[i];
+			}
+		}
+	}
+
+	if (type >= 0) {
+		events_cancel(q, (EventType) type);
+	}
+
+	return type;
+}
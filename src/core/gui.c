@@ -1,4 +1,5 @@
 #include "gui.h"
+#include "SDL2/SDL.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -0,0 +1,50 @@
+/* Null video backend: same interface as gui.c but never touches SDL,
+ * used by the headless build (cnes-headless)
+ */
+
+#include "gui.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+
+Sdl2Display* sdl2_display_allocator(void)
+{
+	Sdl2Display* cnes_screen = malloc(sizeof(Sdl2Display));
+	if (!cnes_screen) {
+		fprintf(stderr, "Failed to allocate enough memory for Sdl2Display struct\n");
+	}
+
+	return cnes_screen; // either valid or NULL
+}
+
+int screen_init(Sdl2Display* cnes_screen, const char* window_name
+               , const unsigned int width, const unsigned int height
+               , int scale_factor)
+{
+	(void) window_name;
+	(void) width;
+	(void) height;
+	(void) scale_factor;
+
+	// No window is ever created, draw_pixels() (and the nametable viewer) skip it
+	cnes_screen->window = NULL;
+	cnes_screen->renderer = NULL;
+	cnes_screen->framebuffer = NULL;
+	cnes_screen->window_id = 0;
+
+	return 0;
+}
+
+void kill_screen(Sdl2Display* cnes_screen)
+{
+	cnes_screen->window = NULL;
+}
+
+void draw_pixels(uint32_t* pixels, const unsigned int width, Sdl2Display* cnes_screen)
+{
+	// Frame stays in the pixel buffer, nothing to present it to
+	(void) pixels;
+	(void) width;
+	(void) cnes_screen;
+}
@@ -0,0 +1,1326 @@
+#define _DEFAULT_SOURCE // mmap() MAP_ANONYMOUS and mprotect()
+
+#include "jit.h"
+#include "cart.h"
+#include "cpu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#if defined(__x86_64__) && !defined(_WIN32) // System V calling convention
+#define JIT_X86_64
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+
+bool jit_supported(void)
+{
+#ifdef JIT_X86_64
+	return true;
+#else
+	return false;
+#endif
+}
+
+Jit* jit_allocator(void)
+{
+	Jit* jit = calloc(1, sizeof(Jit));
+	if (!jit) {
+		fprintf(stderr, "Failed to allocate enough memory for Jit\n");
+	}
+
+	return jit;
+}
+
+// PRG ROM mapped at a cpu page, NULL for anything else (same test as the block cache)
+static const uint8_t* prg_rom_page(const Jit* jit, const Cpu6502* cpu, unsigned page)
+{
+	const uint8_t* mem = cpu->read_page[page & 0xFF];
+	if (!mem || cpu->write_page[page & 0xFF] || (mem < jit->prg_rom)
+	    || (mem >= jit->prg_rom + jit->prg_rom_size)) {
+		return NULL;
+	}
+
+	return mem;
+}
+
+static bool block_mapped(const Cpu6502* cpu, const struct JitBlock* block)
+{
+	for (unsigned i = 0; i < block->page_count; i++) {
+		if (cpu->read_page[(block->first_page + i) & 0xFF] != block->pages[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void flush_blocks(Jit* jit)
+{
+	for (size_t i = 0; i < jit->prg_rom_size; i++) {
+		free(jit->blocks[i]);
+		jit->blocks[i] = NULL;
+	}
+	jit->arena_used = 0;
+}
+
+#ifdef JIT_X86_64
+/***************************
+ * X86-64 EMITTER          *
+ * *************************/
+enum HostReg { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11 };
+#define NO_INDEX (-1)
+
+// emit_mem()/emit_rr() flags
+#define OP_WIDE   0x01U // 64-bit operand (REX.W)
+#define OP_16     0x02U // 16-bit operand (0x66 prefix)
+#define OP_BYTE   0x04U // byte register operand, spl-dil need a REX prefix
+#define OP_SCALE8 0x08U // index * 8 (page tables)
+
+// ALU opcodes (op r/m, reg) and their /digit for the immediate forms
+#define X86_ADD  0x01U
+#define X86_OR   0x09U
+#define X86_AND  0x21U
+#define X86_SUB  0x29U
+#define X86_XOR  0x31U
+#define X86_CMP  0x39U
+#define X86_TEST 0x85U
+#define X86_MOV  0x89U
+enum { EXT_ADD = 0, EXT_OR = 1, EXT_AND = 4, EXT_SUB = 5, EXT_XOR = 6, EXT_CMP = 7 };
+enum { EXT_SHL = 4, EXT_SHR = 5 };
+enum { CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5 };
+
+#define CPU_FIELD(field) ((int32_t) offsetof(Cpu6502, field))
+#define CPU_MEM(addr) (CPU_FIELD(mem) + (int32_t) (addr))
+#define CPU_STACK CPU_MEM(SP_START)
+
+// side exit: jump to be patched to the stub that leaves before an instruction
+struct JitExit {
+	size_t at;
+	unsigned instruction;
+};
+
+typedef struct {
+	uint8_t* code;
+	size_t size;
+	size_t capacity;
+	bool overflow;
+	struct JitExit exits[JIT_MAX_BLOCK_INSTRUCTIONS * 4];
+	unsigned exit_count;
+} Emitter;
+
+static void emit8(Emitter* e, uint8_t byte)
+{
+	if (e->size >= e->capacity) {
+		e->overflow = true;
+		return;
+	}
+	e->code[e->size++] = byte;
+}
+
+static void emit16(Emitter* e, uint16_t value)
+{
+	emit8(e, value & 0xFF);
+	emit8(e, value >> 8);
+}
+
+static void emit32(Emitter* e, uint32_t value)
+{
+	emit16(e, value & 0xFFFF);
+	emit16(e, value >> 16);
+}
+
+static void emit_opcode(Emitter* e, unsigned opcode)
+{
+	if (opcode > 0xFF) { // 0x0F escaped
+		emit8(e, opcode >> 8);
+	}
+	emit8(e, opcode & 0xFF);
+}
+
+static bool needs_byte_rex(unsigned flags, int reg)
+{
+	return (flags & OP_BYTE) && (reg >= RSP) && (reg <= RDI);
+}
+
+/* opcode reg, [base + index + disp32] */
+static void emit_mem(Emitter* e, unsigned opcode, unsigned flags, int reg, int base, int index, int32_t disp)
+{
+	if (flags & OP_16) {
+		emit8(e, 0x66);
+	}
+	uint8_t rex = 0x40 | ((flags & OP_WIDE) ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0)
+	            | (((index != NO_INDEX) && (index & 8)) ? 0x02 : 0) | ((base & 8) ? 0x01 : 0);
+	if ((rex != 0x40) || needs_byte_rex(flags, reg)) {
+		emit8(e, rex);
+	}
+	emit_opcode(e, opcode);
+	if ((index == NO_INDEX) && ((base & 7) != RSP)) {
+		emit8(e, 0x80 | ((reg & 7) << 3) | (base & 7));
+	} else { // SIB byte
+		emit8(e, 0x80 | ((reg & 7) << 3) | RSP);
+		emit8(e, ((flags & OP_SCALE8) ? 0xC0 : 0x00)
+		        | ((((index == NO_INDEX) ? RSP : index) & 7) << 3) | (base & 7));
+	}
+	emit32(e, (uint32_t) disp);
+}
+
+/* opcode rm, reg (register direct) */
+static void emit_rr(Emitter* e, unsigned opcode, unsigned flags, int reg, int rm)
+{
+	uint8_t rex = 0x40 | ((flags & OP_WIDE) ? 0x08 : 0) | ((reg & 8) ? 0x04 : 0) | ((rm & 8) ? 0x01 : 0);
+	if ((rex != 0x40) || needs_byte_rex(flags, reg) || needs_byte_rex(flags, rm)) {
+		emit8(e, rex);
+	}
+	emit_opcode(e, opcode);
+	emit8(e, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// movzx reg32, byte [base + index + disp]
+static void load_u8(Emitter* e, int reg, int base, int index, int32_t disp)
+{
+	emit_mem(e, 0x0FB6, 0, reg, base, index, disp);
+}
+
+static void store_u8(Emitter* e, int base, int index, int32_t disp, int reg)
+{
+	emit_mem(e, 0x88, OP_BYTE, reg, base, index, disp);
+}
+
+static void store_u8_imm(Emitter* e, int base, int index, int32_t disp, uint8_t value)
+{
+	emit_mem(e, 0xC6, 0, 0, base, index, disp);
+	emit8(e, value);
+}
+
+static void store_u16(Emitter* e, int32_t disp, int reg)
+{
+	emit_mem(e, 0x89, OP_16, reg, RDI, NO_INDEX, disp);
+}
+
+static void store_u16_imm(Emitter* e, int32_t disp, uint16_t value)
+{
+	emit_mem(e, 0xC7, OP_16, 0, RDI, NO_INDEX, disp);
+	emit16(e, value);
+}
+
+// page table entry of a static page
+static void load_page(Emitter* e, int reg, int32_t table, unsigned page)
+{
+	emit_mem(e, 0x8B, OP_WIDE, reg, RDI, NO_INDEX, table + (int32_t) (page * sizeof(uint8_t*)));
+}
+
+// page table entry of the page in page_reg
+static void load_page_indexed(Emitter* e, int reg, int32_t table, int page_reg)
+{
+	emit_mem(e, 0x8B, OP_WIDE | OP_SCALE8, reg, RDI, page_reg, table);
+}
+
+static void alu(Emitter* e, unsigned opcode, int dst, int src)
+{
+	emit_rr(e, opcode, 0, src, dst);
+}
+
+static void alu_imm(Emitter* e, unsigned ext, int reg, int32_t value)
+{
+	emit_rr(e, 0x81, 0, ext, reg);
+	emit32(e, (uint32_t) value);
+}
+
+static void shift_imm(Emitter* e, unsigned ext, int reg, uint8_t count)
+{
+	emit_rr(e, 0xC1, 0, ext, reg);
+	emit8(e, count);
+}
+
+static void mov_imm(Emitter* e, int reg, uint32_t value)
+{
+	if (reg & 8) {
+		emit8(e, 0x41);
+	}
+	emit8(e, 0xB8 + (reg & 7));
+	emit32(e, value);
+}
+
+static void movzx_u8(Emitter* e, int dst, int src)
+{
+	emit_rr(e, 0x0FB6, OP_BYTE, dst, src);
+}
+
+static void set_cc(Emitter* e, unsigned cc, int reg)
+{
+	emit_rr(e, 0x0F90 + cc, OP_BYTE, 0, reg);
+}
+
+// or dst8, [rsi + value], rsi holds nz_flags
+static void or_nz_flags(Emitter* e, int dst, int value)
+{
+	emit_mem(e, 0x0A, OP_BYTE, dst, RSI, value, 0);
+}
+
+static void add_cycles(Emitter* e, unsigned cycles)
+{
+	// cycle may be widened, add to the whole counter
+	emit_mem(e, 0x81, sizeof(((Cpu6502*) 0)->cycle) == 8 ? OP_WIDE : 0, EXT_ADD, RDI, NO_INDEX, CPU_FIELD(cycle));
+	emit32(e, cycles);
+}
+
+static size_t jump_cc(Emitter* e, unsigned cc)
+{
+	emit8(e, 0x0F);
+	emit8(e, 0x80 + cc);
+	size_t at = e->size;
+	emit32(e, 0);
+	return at;
+}
+
+static size_t jump(Emitter* e)
+{
+	emit8(e, 0xE9);
+	size_t at = e->size;
+	emit32(e, 0);
+	return at;
+}
+
+// point a jump at the next instruction emitted
+static void patch_jump(Emitter* e, size_t at)
+{
+	if (e->overflow) {
+		return;
+	}
+	uint32_t rel = (uint32_t) (e->size - (at + 4));
+	for (int i = 0; i < 4; i++) {
+		e->code[at + i] = (rel >> (i * 8)) & 0xFF;
+	}
+}
+
+// leave before instruction when the page pointer in reg is NULL (an I/O page)
+static void exit_if_null(Emitter* e, int reg, unsigned instruction)
+{
+	emit_rr(e, X86_TEST, OP_WIDE, reg, reg);
+	size_t at = jump_cc(e, CC_E);
+	if (e->exit_count >= sizeof(e->exits) / sizeof(e->exits[0])) {
+		e->overflow = true;
+		return;
+	}
+	e->exits[e->exit_count].at = at;
+	e->exits[e->exit_count].instruction = instruction;
+	++e->exit_count;
+}
+
+/* Returns to jit_run() with instruction_count instructions done, the PC is
+ * either pc or pc_reg and cycles are the static cycles not added yet
+ */
+static void emit_return(Emitter* e, int pc_reg, uint16_t pc, uint8_t opcode
+                       , unsigned instruction_count, unsigned cycles)
+{
+	if (!instruction_count) {
+		alu(e, X86_XOR, RAX, RAX);
+		emit8(e, 0xC3); // ret
+		return;
+	}
+	if (pc_reg == NO_INDEX) {
+		store_u16_imm(e, CPU_FIELD(PC), pc);
+	} else {
+		store_u16(e, CPU_FIELD(PC), pc_reg);
+	}
+	if (cycles) {
+		add_cycles(e, cycles);
+	}
+	store_u8_imm(e, RDI, NO_INDEX, CPU_FIELD(opcode), opcode);
+	mov_imm(e, RAX, instruction_count);
+	emit8(e, 0xC3); // ret
+}
+
+/***************************
+ * TRANSLATION             *
+ * *************************/
+#define JIT_OPERATIONS(X) \
+	X(LDA) X(LDX) X(LDY) X(STA) X(STX) X(STY) \
+	X(AND) X(ORA) X(EOR) X(ADC) X(SBC) X(CMP) X(CPX) X(CPY) X(BIT) \
+	X(INC) X(DEC) X(ASL) X(LSR) X(ROL) X(ROR) \
+	X(TAX) X(TAY) X(TSX) X(TXA) X(TXS) X(TYA) \
+	X(INX) X(INY) X(DEX) X(DEY) \
+	X(CLC) X(CLD) X(CLI) X(CLV) X(SEC) X(SED) X(SEI) X(NOP) \
+	X(PHA) X(PHP) X(PLA) X(PLP) \
+	X(BCC) X(BCS) X(BEQ) X(BMI) X(BNE) X(BPL) X(BVC) X(BVS) \
+	X(JMP) X(JSR) X(RTS)
+
+#define JIT_ENUM(op) JIT_##op,
+#define JIT_NAME(op) #op,
+enum JitOperation { JIT_NONE, JIT_OPERATIONS(JIT_ENUM) }; // BRK, RTI and bad opcodes are JIT_NONE
+static const char* const operation_names[] = { "", JIT_OPERATIONS(JIT_NAME) };
+#undef JIT_ENUM
+#undef JIT_NAME
+
+enum JitAccess { ACCESS_READ, ACCESS_STORE, ACCESS_RMW };
+
+struct JitInstruction {
+	uint16_t pc;
+	uint8_t opcode;
+	uint8_t lo; // operand bytes
+	uint8_t hi;
+	uint8_t next; // byte after the opcode, the dummy read of 1 byte instructions
+	enum JitOperation operation;
+	AddressMode mode;
+};
+
+// where the operand of a memory access lives once the address is known
+struct JitOperand {
+	int read_base;
+	int write_base;
+	int index;
+	int32_t disp;
+};
+
+// N and Z for a result, read by compiled blocks so it is never written
+#define NZ_1(i) (((i) & FLAG_N) | ((i) ? 0 : FLAG_Z))
+#define NZ_2(i) NZ_1(i), NZ_1((i) + 1)
+#define NZ_4(i) NZ_2(i), NZ_2((i) + 2)
+#define NZ_8(i) NZ_4(i), NZ_4((i) + 4)
+#define NZ_16(i) NZ_8(i), NZ_8((i) + 8)
+#define NZ_32(i) NZ_16(i), NZ_16((i) + 16)
+#define NZ_64(i) NZ_32(i), NZ_32((i) + 32)
+#define NZ_128(i) NZ_64(i), NZ_64((i) + 64)
+static const uint8_t nz_flags[256] = { NZ_128(0), NZ_128(128) };
+
+static enum JitOperation jit_operation(uint8_t opcode)
+{
+	for (unsigned i = 1; i < sizeof(operation_names) / sizeof(operation_names[0]); i++) {
+		if (!strcmp(isa_info[opcode].mnemonic, operation_names[i])) {
+			return (enum JitOperation) i;
+		}
+	}
+
+	return JIT_NONE;
+}
+
+static enum JitAccess jit_access(const struct JitInstruction* in)
+{
+	switch (in->operation) {
+	case JIT_STA:
+	case JIT_STX:
+	case JIT_STY:
+		return ACCESS_STORE;
+	case JIT_INC:
+	case JIT_DEC:
+	case JIT_ASL:
+	case JIT_LSR:
+	case JIT_ROL:
+	case JIT_ROR:
+		return ACCESS_RMW;
+	default:
+		return ACCESS_READ;
+	}
+}
+
+static bool ends_block(const struct JitInstruction* in)
+{
+	return (in->mode == REL) || (in->operation == JIT_JMP)
+	       || (in->operation == JIT_JSR) || (in->operation == JIT_RTS);
+}
+
+// static accesses to I/O pages end the block before the instruction
+static bool static_access_allowed(const Cpu6502* cpu, const struct JitInstruction* in)
+{
+	unsigned page = in->hi;
+	switch (in->mode) {
+	case ABS:
+		if ((in->operation == JIT_JMP) || (in->operation == JIT_JSR)) {
+			return true;
+		}
+		switch (jit_access(in)) {
+		case ACCESS_STORE:
+			return cpu->write_page[page];
+		case ACCESS_RMW:
+			return cpu->read_page[page] && cpu->write_page[page];
+		default:
+			return cpu->read_page[page];
+		}
+	case ABSX:
+	case ABSY:
+		return cpu->read_page[page]; // dummy read/page cross
+	case IND:
+		return cpu->read_page[page];
+	default:
+		return true;
+	}
+}
+
+static unsigned static_cycles(const struct JitInstruction* in)
+{
+	unsigned cycles = isa_info[in->opcode].max_cycles;
+	bool indexed = (in->mode == ABSX) || (in->mode == ABSY) || (in->mode == INDY);
+	if (indexed && (jit_access(in) == ACCESS_READ)) {
+		--cycles; // the page cross is added at run time
+	}
+
+	return cycles;
+}
+
+static int32_t register_field(enum JitOperation operation)
+{
+	switch (operation) {
+	case JIT_LDX: case JIT_STX: case JIT_CPX:
+	case JIT_INX: case JIT_DEX:
+		return CPU_FIELD(X);
+	case JIT_LDY: case JIT_STY: case JIT_CPY:
+	case JIT_INY: case JIT_DEY:
+		return CPU_FIELD(Y);
+	default:
+		return CPU_FIELD(A);
+	}
+}
+
+// P = (P & ~(N | Z)) | N/Z of the value in reg
+static void emit_nz(Emitter* e, int reg)
+{
+	load_u8(e, R11, RDI, NO_INDEX, CPU_FIELD(P));
+	alu_imm(e, EXT_AND, R11, 0x7D);
+	or_nz_flags(e, R11, reg);
+	store_u8(e, RDI, NO_INDEX, CPU_FIELD(P), R11);
+}
+
+/* Operations on the operand in EAX, clobber RAX, RCX, R10 and R11 only so
+ * the operand location (RDX, R8, R9) survives for the RMW write back
+ */
+static void emit_add_with_carry(Emitter* e)
+{
+	load_u8(e, RCX, RDI, NO_INDEX, CPU_FIELD(A));
+	load_u8(e, R11, RDI, NO_INDEX, CPU_FIELD(P));
+	alu(e, X86_MOV, R10, R11);
+	alu_imm(e, EXT_AND, R10, FLAG_C);
+	alu(e, X86_ADD, R10, RCX);
+	alu(e, X86_ADD, R10, RAX); // 9-bit sum
+	alu(e, X86_XOR, RCX, R10); // overflow: result sign differs from both inputs
+	alu(e, X86_XOR, RAX, R10);
+	alu(e, X86_AND, RAX, RCX);
+	alu_imm(e, EXT_AND, RAX, 0x80);
+	shift_imm(e, EXT_SHR, RAX, 1);
+	alu_imm(e, EXT_AND, R11, 0x3C);
+	alu(e, X86_OR, R11, RAX);
+	alu(e, X86_MOV, RAX, R10);
+	shift_imm(e, EXT_SHR, RAX, 8);
+	alu(e, X86_OR, R11, RAX);
+	alu_imm(e, EXT_AND, R10, 0xFF);
+	store_u8(e, RDI, NO_INDEX, CPU_FIELD(A), R10);
+	or_nz_flags(e, R11, R10);
+	store_u8(e, RDI, NO_INDEX, CPU_FIELD(P), R11);
+}
+
+static void emit_compare(Emitter* e, int32_t reg_field)
+{
+	load_u8(e, RCX, RDI, NO_INDEX, reg_field);
+	load_u8(e, R11, RDI, NO_INDEX, CPU_FIELD(P));
+	alu_imm(e, EXT_AND, R11, 0x7C);
+	alu(e, X86_SUB, RCX, RAX);
+	set_cc(e, CC_AE, RAX); // no borrow
+	movzx_u8(e, RAX, RAX);
+	alu(e, X86_OR, R11, RAX);
+	alu_imm(e, EXT_AND, RCX, 0xFF);
+	or_nz_flags(e, R11, RCX);
+	store_u8(e, RDI, NO_INDEX, CPU_FIELD(P), R11);
+}
+
+static void emit_bit(Emitter* e)
+{
+	load_u8(e, RCX, RDI, NO_INDEX, CPU_FIELD(A));
+	alu(e, X86_AND, RCX, RAX);
+	load_u8(e, R11, RDI, NO_INDEX, CPU_FIELD(P));
+	alu_imm(e, EXT_AND, R11, 0x3D);
+	alu_imm(e, EXT_AND, RAX, FLAG_N | FLAG_V);
+	alu(e, X86_OR, R11, RAX);
+	alu(e, X86_TEST, RCX, RCX);
+	set_cc(e, CC_E, RCX);
+	movzx_u8(e, RCX, RCX);
+	alu(e, X86_ADD, RCX, RCX); // FLAG_Z
+	alu(e, X86_OR, R11, RCX);
+	store_u8(e, RDI, NO_INDEX, CPU_FIELD(P), R11);
+}
+
+// ASL, LSR, ROL and ROR of EAX, the result is left in EAX
+static void emit_shift(Emitter* e, enum JitOperation operation)
+{
+	load_u8(e, R11, RDI, NO_INDEX, CPU_FIELD(P));
+	alu(e, X86_MOV, RCX, R11);
+	alu_imm(e, EXT_AND, RCX, FLAG_C);
+	alu_imm(e, EXT_AND, R11, 0x7C);
+	alu(e, X86_MOV, R10, RAX);
+	if ((operation == JIT_ASL) || (operation == JIT_ROL)) {
+		shift_imm(e, EXT_SHR, R10, 7);
+		alu(e, X86_OR, R11, R10);
+		alu(e, X86_ADD, RAX, RAX);
+		if (operation == JIT_ROL) {
+			alu(e, X86_OR, RAX, RCX);
+		}
+		alu_imm(e, EXT_AND, RAX, 0xFF);
+	} else {
+		alu_imm(e, EXT_AND, R10, FLAG_C);
+		alu(e, X86_OR, R11, R10);
+		shift_imm(e, EXT_SHR, RAX, 1);
+		if (operation == JIT_ROR) {
+			shift_imm(e, EXT_SHL, RCX, 7);
+			alu(e, X86_OR, RAX, RCX);
+		}
+	}
+	or_nz_flags(e, R11, RAX);
+	store_u8(e, RDI, NO_INDEX, CPU_FIELD(P), R11);
+}
+
+static void emit_read_operation(Emitter* e, enum JitOperation operation)
+{
+	switch (operation) {
+	case JIT_LDA:
+	case JIT_LDX:
+	case JIT_LDY:
+		store_u8(e, RDI, NO_INDEX, register_field(operation), RAX);
+		emit_nz(e, RAX);
+		break;
+	case JIT_AND:
+	case JIT_ORA:
+	case JIT_EOR:
+		load_u8(e, RCX, RDI, NO_INDEX, CPU_FIELD(A));
+		alu(e, operation == JIT_AND ? X86_AND : operation == JIT_ORA ? X86_OR : X86_XOR, RCX, RAX);
+		store_u8(e, RDI, NO_INDEX, CPU_FIELD(A), RCX);
+		emit_nz(e, RCX);
+		break;
+	case JIT_SBC: // A + ~M + C
+		alu_imm(e, EXT_XOR, RAX, 0xFF);
+		emit_add_with_carry(e);
+		break;
+	case JIT_ADC:
+		emit_add_with_carry(e);
+		break;
+	case JIT_CMP:
+	case JIT_CPX:
+	case JIT_CPY:
+		emit_compare(e, register_field(operation));
+		break;
+	case JIT_BIT:
+		emit_bit(e);
+		break;
+	default:
+		break;
+	}
+}
+
+static void emit_rmw_operation(Emitter* e, enum JitOperation operation)
+{
+	if ((operation == JIT_INC) || (operation == JIT_DEC)) {
+		alu_imm(e, operation == JIT_INC ? EXT_ADD : EXT_SUB, RAX, 1);
+		alu_imm(e, EXT_AND, RAX, 0xFF);
+		emit_nz(e, RAX);
+	} else {
+		emit_shift(e, operation);
+	}
+}
+
+/* ABSX, ABSY and INDY: effective address in EDX on entry, base page in R11
+ * (ignored if base_page_reg is NO_INDEX, static_base_page is used instead).
+ * Leaves the low byte of the address in EDX and the page(s) in R8/R9
+ */
+static void emit_indexed(Emitter* e, const struct JitInstruction* in, unsigned index, enum JitAccess access
+                        , int base_page_reg, unsigned static_base_page)
+{
+	alu(e, X86_MOV, RCX, RDX);
+	shift_imm(e, EXT_SHR, RCX, 8);
+	if (access != ACCESS_STORE) {
+		load_page_indexed(e, R8, CPU_FIELD(read_page), RCX);
+		exit_if_null(e, R8, index);
+	}
+	if (access != ACCESS_READ) {
+		load_page_indexed(e, R9, CPU_FIELD(write_page), RCX);
+		exit_if_null(e, R9, index);
+	}
+
+	// the dummy read happens on the base page (page crosses of reads, always for writes)
+	size_t no_cross = 0;
+	if (access == ACCESS_READ) {
+		if (base_page_reg == NO_INDEX) {
+			alu_imm(e, EXT_CMP, RCX, static_base_page);
+		} else {
+			alu(e, X86_CMP, RCX, base_page_reg);
+		}
+		no_cross = jump_cc(e, CC_E);
+	}
+	if (base_page_reg == NO_INDEX) {
+		load_page(e, R10, CPU_FIELD(read_page), static_base_page);
+	} else {
+		load_page_indexed(e, R10, CPU_FIELD(read_page), base_page_reg);
+	}
+	exit_if_null(e, R10, index);
+	movzx_u8(e, RCX, RDX);
+	load_u8(e, RAX, R10, RCX, 0);
+	store_u16(e, CPU_FIELD(data_bus), RAX);
+	if (access == ACCESS_READ) {
+		add_cycles(e, 1);
+		size_t done = jump(e);
+		patch_jump(e, no_cross);
+		if (base_page_reg == NO_INDEX) {
+			store_u16_imm(e, CPU_FIELD(data_bus), in->hi);
+		} else {
+			store_u16(e, CPU_FIELD(data_bus), base_page_reg);
+		}
+		patch_jump(e, done);
+	}
+	movzx_u8(e, RDX, RDX);
+}
+
+/* Address mode cycles: page checks first (side exits leave nothing changed),
+ * then the data bus as the decoder leaves it
+ */
+static void emit_operand(Emitter* e, const struct JitInstruction* in, unsigned index
+                        , enum JitAccess access, struct JitOperand* operand)
+{
+	uint16_t addr = in->lo | (in->hi << 8);
+	operand->read_base = operand->write_base = RDI;
+	operand->index = NO_INDEX;
+
+	switch (in->mode) {
+	case ZP:
+		operand->disp = CPU_MEM(in->lo);
+		store_u16_imm(e, CPU_FIELD(data_bus), in->lo);
+		break;
+	case ZPX:
+	case ZPY:
+		load_u8(e, RDX, RDI, NO_INDEX, in->mode == ZPX ? CPU_FIELD(X) : CPU_FIELD(Y));
+		alu_imm(e, EXT_ADD, RDX, in->lo);
+		alu_imm(e, EXT_AND, RDX, 0xFF);
+		load_u8(e, RCX, RDI, NO_INDEX, CPU_MEM(in->lo)); // dummy read
+		store_u16(e, CPU_FIELD(data_bus), RCX);
+		operand->index = RDX;
+		operand->disp = CPU_MEM(0);
+		break;
+	case ABS:
+		if (addr < 0x2000) { // internal RAM is never remapped
+			operand->disp = CPU_MEM(addr & 0x07FF);
+		} else {
+			if (access != ACCESS_STORE) {
+				load_page(e, R8, CPU_FIELD(read_page), in->hi);
+				exit_if_null(e, R8, index);
+			}
+			if (access != ACCESS_READ) {
+				load_page(e, R9, CPU_FIELD(write_page), in->hi);
+				exit_if_null(e, R9, index);
+			}
+			operand->read_base = R8;
+			operand->write_base = R9;
+			operand->disp = in->lo;
+		}
+		store_u16_imm(e, CPU_FIELD(data_bus), in->hi);
+		break;
+	case ABSX:
+	case ABSY:
+		load_u8(e, RCX, RDI, NO_INDEX, in->mode == ABSX ? CPU_FIELD(X) : CPU_FIELD(Y));
+		mov_imm(e, RDX, addr);
+		alu(e, X86_ADD, RDX, RCX);
+		alu_imm(e, EXT_AND, RDX, 0xFFFF);
+		emit_indexed(e, in, index, access, NO_INDEX, in->hi);
+		operand->read_base = R8;
+		operand->write_base = R9;
+		operand->index = RDX;
+		operand->disp = 0;
+		break;
+	case INDX:
+		load_u8(e, RCX, RDI, NO_INDEX, CPU_FIELD(X));
+		alu_imm(e, EXT_ADD, RCX, in->lo);
+		alu_imm(e, EXT_AND, RCX, 0xFF);
+		load_u8(e, RDX, RDI, RCX, CPU_MEM(0)); // ADL
+		alu_imm(e, EXT_ADD, RCX, 1);
+		alu_imm(e, EXT_AND, RCX, 0xFF);
+		load_u8(e, RCX, RDI, RCX, CPU_MEM(0)); // ADH
+		if (access != ACCESS_STORE) {
+			load_page_indexed(e, R8, CPU_FIELD(read_page), RCX);
+			exit_if_null(e, R8, index);
+		}
+		if (access != ACCESS_READ) {
+			load_page_indexed(e, R9, CPU_FIELD(write_page), RCX);
+			exit_if_null(e, R9, index);
+		}
+		store_u16(e, CPU_FIELD(data_bus), RCX);
+		operand->read_base = R8;
+		operand->write_base = R9;
+		operand->index = RDX;
+		operand->disp = 0;
+		break;
+	case INDY:
+		load_u8(e, RAX, RDI, NO_INDEX, CPU_MEM(in->lo)); // ADL
+		load_u8(e, R11, RDI, NO_INDEX, CPU_MEM((uint8_t) (in->lo + 1))); // ADH
+		load_u8(e, RCX, RDI, NO_INDEX, CPU_FIELD(Y));
+		alu(e, X86_ADD, RAX, RCX);
+		alu(e, X86_MOV, RDX, R11);
+		shift_imm(e, EXT_SHL, RDX, 8);
+		alu(e, X86_ADD, RDX, RAX);
+		alu_imm(e, EXT_AND, RDX, 0xFFFF);
+		emit_indexed(e, in, index, access, R11, 0);
+		operand->read_base = R8;
+		operand->write_base = R9;
+		operand->index = RDX;
+		operand->disp = 0;
+		break;
+	default:
+		break;
+	}
+}
+
+static void emit_memory_instruction(Emitter* e, const struct JitInstruction* in, unsigned index)
+{
+	enum JitAccess access = jit_access(in);
+
+	if (in->mode == IMM) {
+		store_u16_imm(e, CPU_FIELD(data_bus), in->opcode); // IMM reads leave the opcode on the bus
+		mov_imm(e, RAX, in->lo);
+		emit_read_operation(e, in->operation);
+		return;
+	}
+
+	struct JitOperand operand;
+	emit_operand(e, in, index, access, &operand);
+	switch (access) {
+	case ACCESS_READ:
+		load_u8(e, RAX, operand.read_base, operand.index, operand.disp);
+		emit_read_operation(e, in->operation);
+		break;
+	case ACCESS_STORE:
+		load_u8(e, RAX, RDI, NO_INDEX, register_field(in->operation));
+		store_u8(e, operand.write_base, operand.index, operand.disp, RAX);
+		break;
+	case ACCESS_RMW: // dummy read, dummy write of the same value, then the result
+		load_u8(e, RAX, operand.read_base, operand.index, operand.disp);
+		store_u16(e, CPU_FIELD(data_bus), RAX);
+		emit_rmw_operation(e, in->operation);
+		store_u8(e, operand.write_base, operand.index, operand.disp, RAX);
+		break;
+	}
+}
+
+static void emit_implied_instruction(Emitter* e, const struct JitInstruction* in)
+{
+	store_u16_imm(e, CPU_FIELD(data_bus), in->next); // dummy read of the next byte
+	switch (in->operation) {
+	case JIT_TAX:
+	case JIT_TAY:
+	case JIT_TSX:
+	case JIT_TXA:
+	case JIT_TXS:
+	case JIT_TYA: {
+		int32_t from = (in->operation == JIT_TSX) ? CPU_FIELD(stack)
+		             : (in->operation == JIT_TXA) || (in->operation == JIT_TXS) ? CPU_FIELD(X)
+		             : (in->operation == JIT_TYA) ? CPU_FIELD(Y) : CPU_FIELD(A);
+		int32_t to = (in->operation == JIT_TXS) ? CPU_FIELD(stack)
+		           : (in->operation == JIT_TAX) || (in->operation == JIT_TSX) ? CPU_FIELD(X)
+		           : (in->operation == JIT_TAY) ? CPU_FIELD(Y) : CPU_FIELD(A);
+		load_u8(e, RAX, RDI, NO_INDEX, from);
+		store_u8(e, RDI, NO_INDEX, to, RAX);
+		if (in->operation != JIT_TXS) {
+			emit_nz(e, RAX);
+		}
+		break;
+	}
+	case JIT_INX:
+	case JIT_INY:
+	case JIT_DEX:
+	case JIT_DEY: {
+		bool increment = (in->operation == JIT_INX) || (in->operation == JIT_INY);
+		load_u8(e, RAX, RDI, NO_INDEX, register_field(in->operation));
+		alu_imm(e, increment ? EXT_ADD : EXT_SUB, RAX, 1);
+		alu_imm(e, EXT_AND, RAX, 0xFF);
+		store_u8(e, RDI, NO_INDEX, register_field(in->operation), RAX);
+		emit_nz(e, RAX);
+		break;
+	}
+	case JIT_CLC: case JIT_CLD: case JIT_CLI: case JIT_CLV:
+	case JIT_SEC: case JIT_SED: case JIT_SEI: {
+		uint8_t flag = (in->operation == JIT_CLC) || (in->operation == JIT_SEC) ? FLAG_C
+		             : (in->operation == JIT_CLD) || (in->operation == JIT_SED) ? FLAG_D
+		             : (in->operation == JIT_CLI) || (in->operation == JIT_SEI) ? FLAG_I : FLAG_V;
+		bool set = (in->operation == JIT_SEC) || (in->operation == JIT_SED) || (in->operation == JIT_SEI);
+		emit_mem(e, 0x80, 0, set ? EXT_OR : EXT_AND, RDI, NO_INDEX, CPU_FIELD(P));
+		emit8(e, set ? flag : (uint8_t) ~flag);
+		break;
+	}
+	case JIT_ASL:
+	case JIT_LSR:
+	case JIT_ROL:
+	case JIT_ROR: // accumulator
+		load_u8(e, RAX, RDI, NO_INDEX, CPU_FIELD(A));
+		emit_shift(e, in->operation);
+		store_u8(e, RDI, NO_INDEX, CPU_FIELD(A), RAX);
+		break;
+	case JIT_PHA:
+	case JIT_PHP:
+		load_u8(e, RAX, RDI, NO_INDEX, in->operation == JIT_PHA ? CPU_FIELD(A) : CPU_FIELD(P));
+		if (in->operation == JIT_PHP) {
+			alu_imm(e, EXT_OR, RAX, 0x30);
+		}
+		load_u8(e, RCX, RDI, NO_INDEX, CPU_FIELD(stack));
+		store_u8(e, RDI, RCX, CPU_STACK, RAX);
+		alu_imm(e, EXT_SUB, RCX, 1);
+		store_u8(e, RDI, NO_INDEX, CPU_FIELD(stack), RCX);
+		store_u16(e, CPU_FIELD(data_bus), RAX);
+		break;
+	case JIT_PLA:
+	case JIT_PLP:
+		load_u8(e, RCX, RDI, NO_INDEX, CPU_FIELD(stack));
+		alu_imm(e, EXT_ADD, RCX, 1);
+		alu_imm(e, EXT_AND, RCX, 0xFF);
+		store_u8(e, RDI, NO_INDEX, CPU_FIELD(stack), RCX);
+		load_u8(e, RAX, RDI, RCX, CPU_STACK);
+		store_u16(e, CPU_FIELD(data_bus), RAX);
+		if (in->operation == JIT_PLA) {
+			store_u8(e, RDI, NO_INDEX, CPU_FIELD(A), RAX);
+			emit_nz(e, RAX);
+		} else {
+			alu_imm(e, EXT_AND, RAX, 0xEF); // no B flag in P
+			alu_imm(e, EXT_OR, RAX, 0x20);
+			store_u8(e, RDI, NO_INDEX, CPU_FIELD(P), RAX);
+		}
+		break;
+	default: // NOP
+		break;
+	}
+}
+
+// branches, jumps and returns end the block, cycles is what the block ran before it
+static void emit_control_flow(Emitter* e, const struct JitInstruction* in, unsigned index, unsigned cycles)
+{
+	uint16_t addr = in->lo | (in->hi << 8);
+	unsigned count = index + 1;
+
+	if (in->mode == REL) {
+		static const struct { enum JitOperation operation; uint8_t flag; bool set; } conditions[] = {
+			{ JIT_BCC, FLAG_C, false }, { JIT_BCS, FLAG_C, true },
+			{ JIT_BNE, FLAG_Z, false }, { JIT_BEQ, FLAG_Z, true },
+			{ JIT_BPL, FLAG_N, false }, { JIT_BMI, FLAG_N, true },
+			{ JIT_BVC, FLAG_V, false }, { JIT_BVS, FLAG_V, true },
+		};
+		unsigned c = 0;
+		while (conditions[c].operation != in->operation) {
+			++c;
+		}
+		uint16_t next = in->pc + 2;
+		uint16_t target = next + (int8_t) in->lo;
+		bool page_cross = (target & 0xFF00) != (next & 0xFF00);
+
+		store_u16_imm(e, CPU_FIELD(data_bus), in->lo);
+		emit_mem(e, 0xF6, 0, 0, RDI, NO_INDEX, CPU_FIELD(P)); // test byte [P], flag
+		emit8(e, conditions[c].flag);
+		size_t taken = jump_cc(e, conditions[c].set ? CC_NE : CC_E);
+		emit_return(e, NO_INDEX, next, in->opcode, count, cycles + 2);
+		patch_jump(e, taken);
+		emit_return(e, NO_INDEX, target, in->opcode, count, cycles + 3 + page_cross);
+		return;
+	}
+
+	switch (in->operation) {
+	case JIT_JMP:
+		if (in->mode == IND) { // the pointer's high byte doesn't carry into the next page
+			load_page(e, R8, CPU_FIELD(read_page), in->hi);
+			exit_if_null(e, R8, index);
+			load_u8(e, RAX, R8, NO_INDEX, in->lo);
+			load_u8(e, RDX, R8, NO_INDEX, (uint8_t) (in->lo + 1));
+			store_u16(e, CPU_FIELD(data_bus), RDX);
+			shift_imm(e, EXT_SHL, RDX, 8);
+			alu(e, X86_OR, RDX, RAX);
+			emit_return(e, RDX, 0, in->opcode, count, cycles + isa_info[in->opcode].max_cycles);
+		} else {
+			store_u16_imm(e, CPU_FIELD(data_bus), in->hi);
+			emit_return(e, NO_INDEX, addr, in->opcode, count, cycles + isa_info[in->opcode].max_cycles);
+		}
+		break;
+	case JIT_JSR: {
+		uint16_t return_addr = in->pc + 2; // last byte of the JSR
+		load_u8(e, RCX, RDI, NO_INDEX, CPU_FIELD(stack));
+		store_u8_imm(e, RDI, RCX, CPU_STACK, return_addr >> 8);
+		alu_imm(e, EXT_SUB, RCX, 1);
+		alu_imm(e, EXT_AND, RCX, 0xFF);
+		store_u8_imm(e, RDI, RCX, CPU_STACK, return_addr & 0xFF);
+		alu_imm(e, EXT_SUB, RCX, 1);
+		store_u8(e, RDI, NO_INDEX, CPU_FIELD(stack), RCX);
+		store_u16_imm(e, CPU_FIELD(data_bus), in->hi);
+		emit_return(e, NO_INDEX, addr, in->opcode, count, cycles + isa_info[in->opcode].max_cycles);
+		break;
+	}
+	case JIT_RTS: // dummy read of the return address, it may be an I/O page
+		load_u8(e, RCX, RDI, NO_INDEX, CPU_FIELD(stack));
+		alu_imm(e, EXT_ADD, RCX, 1);
+		alu_imm(e, EXT_AND, RCX, 0xFF);
+		load_u8(e, RAX, RDI, RCX, CPU_STACK);
+		alu_imm(e, EXT_ADD, RCX, 1);
+		alu_imm(e, EXT_AND, RCX, 0xFF);
+		load_u8(e, RDX, RDI, RCX, CPU_STACK);
+		load_page_indexed(e, R8, CPU_FIELD(read_page), RDX);
+		exit_if_null(e, R8, index);
+		store_u8(e, RDI, NO_INDEX, CPU_FIELD(stack), RCX);
+		load_u8(e, R11, R8, RAX, 0);
+		store_u16(e, CPU_FIELD(data_bus), R11);
+		shift_imm(e, EXT_SHL, RDX, 8);
+		alu(e, X86_OR, RDX, RAX);
+		alu_imm(e, EXT_ADD, RDX, 1);
+		emit_return(e, RDX, 0, in->opcode, count, cycles + isa_info[in->opcode].max_cycles);
+		break;
+	default:
+		break;
+	}
+}
+
+/* Reads the next byte of the block, false if it isn't in PRG ROM or the
+ * block would span too many pages
+ */
+static bool read_block_byte(const Jit* jit, const Cpu6502* cpu, struct JitBlock* block, uint16_t addr, uint8_t* byte)
+{
+	unsigned page = addr >> 8;
+	unsigned page_index = (page - block->first_page) & 0xFF;
+	if (page_index >= JIT_MAX_BLOCK_PAGES) {
+		return false;
+	}
+	if (page_index >= block->page_count) {
+		const uint8_t* mem = prg_rom_page(jit, cpu, page);
+		if (!mem) {
+			return false;
+		}
+		block->pages[page_index] = mem;
+		block->page_count = page_index + 1;
+	}
+	*byte = block->pages[page_index][addr & 0xFF];
+
+	return true;
+}
+
+static bool decode_block_instruction(const Jit* jit, const Cpu6502* cpu, struct JitBlock* block
+                                    , uint16_t pc, struct JitInstruction* in)
+{
+	struct JitBlock scratch = *block; // pages are only kept if the instruction is
+	in->pc = pc;
+	if (!read_block_byte(jit, cpu, &scratch, pc, &in->opcode)) {
+		return false;
+	}
+	in->operation = jit_operation(in->opcode);
+	in->mode = isa_info[in->opcode].address_mode;
+	if (in->operation == JIT_NONE) {
+		return false;
+	}
+
+	unsigned length = cpu_instruction_length(in->opcode);
+	in->lo = in->hi = in->next = 0;
+	if ((length > 1) && !read_block_byte(jit, cpu, &scratch, pc + 1, &in->lo)) {
+		return false;
+	}
+	if ((length > 2) && !read_block_byte(jit, cpu, &scratch, pc + 2, &in->hi)) {
+		return false;
+	}
+	if ((length == 1) && (in->operation != JIT_RTS)
+	    && !read_block_byte(jit, cpu, &scratch, pc + 1, &in->next)) {
+		return false;
+	}
+	if (!static_access_allowed(cpu, in)) {
+		return false;
+	}
+	*block = scratch;
+
+	return true;
+}
+
+static struct JitBlock* compile_block(Jit* jit, const Cpu6502* cpu)
+{
+	struct JitBlock* block = calloc(1, sizeof(struct JitBlock));
+	if (!block) {
+		fprintf(stderr, "Failed to allocate enough memory for a JIT block\n");
+		return NULL;
+	}
+	block->pc = cpu->PC;
+	block->first_page = cpu->PC >> 8;
+
+	struct JitInstruction instructions[JIT_MAX_BLOCK_INSTRUCTIONS];
+	unsigned count = 0;
+	uint16_t pc = cpu->PC;
+	while (count < JIT_MAX_BLOCK_INSTRUCTIONS) {
+		struct JitInstruction* in = &instructions[count];
+		if (!decode_block_instruction(jit, cpu, block, pc, in)) {
+			break;
+		}
+		block->max_cycles += isa_info[in->opcode].max_cycles;
+		++count;
+		if (ends_block(in)) {
+			break;
+		}
+		pc += cpu_instruction_length(in->opcode);
+	}
+	if (!count) {
+		return block; // interpreter only
+	}
+
+	if ((JIT_ARENA_SIZE - jit->arena_used) < JIT_MAX_BLOCK_CODE) {
+		flush_blocks(jit);
+	}
+	if (mprotect(jit->arena, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE)) {
+		perror("JIT arena");
+		return block;
+	}
+
+	Emitter e = { .code = jit->arena + jit->arena_used, .capacity = JIT_MAX_BLOCK_CODE };
+	emit8(&e, 0x48); // mov rsi, nz_flags
+	emit8(&e, 0xBE);
+	uint64_t table = (uint64_t) (uintptr_t) nz_flags;
+	emit32(&e, table & 0xFFFFFFFFU);
+	emit32(&e, table >> 32);
+
+	unsigned cycles = 0; // static cycles of the instructions so far
+	unsigned exit_cycles[JIT_MAX_BLOCK_INSTRUCTIONS + 1];
+	const struct JitInstruction* last = &instructions[count - 1];
+	for (unsigned i = 0; i < count; i++) {
+		const struct JitInstruction* in = &instructions[i];
+		exit_cycles[i] = cycles;
+		if (ends_block(in)) {
+			emit_control_flow(&e, in, i, cycles);
+		} else if ((cpu_instruction_length(in->opcode) == 1)) {
+			emit_implied_instruction(&e, in);
+		} else {
+			emit_memory_instruction(&e, in, i);
+		}
+		cycles += static_cycles(in);
+	}
+	exit_cycles[count] = cycles;
+	if (!ends_block(last)) { // runs into something the interpreter does
+		emit_return(&e, NO_INDEX, last->pc + cpu_instruction_length(last->opcode), last->opcode, count, cycles);
+	}
+
+	// side exits, leave with everything before the instruction done
+	size_t stubs[JIT_MAX_BLOCK_INSTRUCTIONS];
+	memset(stubs, 0, sizeof(stubs));
+	for (unsigned i = 0; i < e.exit_count; i++) {
+		unsigned instruction = e.exits[i].instruction;
+		if (!stubs[instruction]) {
+			stubs[instruction] = e.size;
+			emit_return(&e, NO_INDEX, instructions[instruction].pc
+			           , instruction ? instructions[instruction - 1].opcode : 0
+			           , instruction, exit_cycles[instruction]);
+		}
+		size_t end = e.size;
+		e.size = stubs[instruction];
+		patch_jump(&e, e.exits[i].at);
+		e.size = end;
+	}
+
+	if (!e.overflow) {
+		block->code = (JitBlockCode) (void*) e.code;
+		jit->arena_used = (jit->arena_used + e.size + 15) & ~(size_t) 15;
+		++jit->blocks_compiled;
+	}
+	if (mprotect(jit->arena, JIT_ARENA_SIZE, PROT_READ | PROT_EXEC)) {
+		perror("JIT arena");
+		block->code = NULL;
+	}
+
+	return block;
+}
+#else
+static struct JitBlock* compile_block(Jit* jit, const Cpu6502* cpu)
+{
+	(void) jit;
+	(void) cpu;
+	return NULL;
+}
+#endif /* JIT_X86_64 */
+
+int jit_init(Jit* jit, const CartMemory* prg_rom, bool verify)
+{
+	if (!jit_supported()) {
+		fprintf(stderr, "The JIT has no backend for this host (x86-64 only)\n");
+		return -1;
+	}
+
+	jit->prg_rom = prg_rom->data;
+	jit->prg_rom_size = prg_rom->size;
+	jit->hot_runs = JIT_HOT_RUNS;
+	jit->verify = verify;
+	jit->blocks = calloc(prg_rom->size ? prg_rom->size : 1, sizeof(struct JitBlock*));
+	jit->heat = calloc(prg_rom->size ? prg_rom->size : 1, sizeof(uint8_t));
+	if (!jit->blocks || !jit->heat) {
+		fprintf(stderr, "Failed to allocate enough memory for the JIT\n");
+		return -1;
+	}
+	if (verify) {
+		jit->shadow = malloc(sizeof(Cpu6502));
+		jit->shadow_pages = malloc(CPU_PAGE_COUNT * sizeof(*jit->shadow_pages));
+		if (!jit->shadow || !jit->shadow_pages) {
+			fprintf(stderr, "Failed to allocate enough memory for the JIT shadow cpu\n");
+			return -1;
+		}
+	}
+
+#ifdef JIT_X86_64
+	jit->arena = mmap(NULL, JIT_ARENA_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (jit->arena == MAP_FAILED) {
+		jit->arena = NULL;
+		perror("Failed to map the JIT arena");
+		return -1;
+	}
+#endif
+
+	return 0;
+}
+
+/***************************
+ * VERIFICATION            *
+ * *************************/
+static bool in_cpu_mem(const Cpu6502* cpu, const uint8_t* ptr)
+{
+	return ptr && (ptr >= cpu->mem) && (ptr < cpu->mem + sizeof(cpu->mem));
+}
+
+/* Interpreter copy of the cpu, it gets its own RAM and copies of any other
+ * writable pages (PRG RAM) so both runs start from the same memory
+ */
+static void snapshot_shadow(Jit* jit, const Cpu6502* cpu)
+{
+	Cpu6502* shadow = jit->shadow;
+	memcpy(shadow, cpu, sizeof(Cpu6502));
+	shadow->ppu = NULL;
+	shadow->trace = NULL;
+	shadow->block_cache = NULL;
+	shadow->jit = NULL;
+	shadow->decoded = NULL;
+
+	for (unsigned page = 0; page < CPU_PAGE_COUNT; page++) {
+		uint8_t* read = cpu->read_page[page];
+		uint8_t* write = cpu->write_page[page];
+		if (in_cpu_mem(cpu, write)) {
+			shadow->write_page[page] = shadow->mem + (write - cpu->mem);
+		} else if (write) {
+			memcpy(jit->shadow_pages[page], write, sizeof(jit->shadow_pages[page]));
+			shadow->write_page[page] = jit->shadow_pages[page];
+		}
+
+		if (in_cpu_mem(cpu, read)) {
+			shadow->read_page[page] = shadow->mem + (read - cpu->mem);
+		} else if (read && (read == write)) {
+			shadow->read_page[page] = jit->shadow_pages[page];
+		}
+	}
+}
+
+static bool shadow_matches(const Jit* jit, const Cpu6502* cpu)
+{
+	const Cpu6502* shadow = jit->shadow;
+	if ((shadow->A != cpu->A) || (shadow->X != cpu->X) || (shadow->Y != cpu->Y)
+	    || (shadow->P != cpu->P) || (shadow->stack != cpu->stack) || (shadow->PC != cpu->PC)
+	    || (shadow->cycle != cpu->cycle) || (shadow->data_bus != cpu->data_bus)
+	    || (shadow->opcode != cpu->opcode) || (shadow->delay_nmi != cpu->delay_nmi)
+	    || (shadow->cpu_ignore_fetch_on_nmi != cpu->cpu_ignore_fetch_on_nmi)
+	    || (shadow->process_interrupt != cpu->process_interrupt)
+	    || (shadow->instruction_state != cpu->instruction_state)
+	    || (shadow->trace_event != cpu->trace_event)
+	    || memcmp(shadow->mem, cpu->mem, sizeof(cpu->mem))) {
+		return false;
+	}
+
+	for (unsigned page = 0; page < CPU_PAGE_COUNT; page++) {
+		if (cpu->write_page[page] && !in_cpu_mem(cpu, cpu->write_page[page])
+		    && memcmp(jit->shadow_pages[page], cpu->write_page[page], sizeof(jit->shadow_pages[page]))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void print_registers(const char* name, const Cpu6502* cpu)
+{
+	fprintf(stderr, "  %-12s A:%02X X:%02X Y:%02X P:%02X SP:%02X PC:%04X CYC:%llu BUS:%02X\n"
+	       , name, cpu->A, cpu->X, cpu->Y, cpu->P, cpu->stack, cpu->PC
+	       , (unsigned long long) cpu->cycle, cpu->data_bus);
+}
+
+static void verify_block(Jit* jit, const Cpu6502* cpu, uint16_t pc, unsigned instructions)
+{
+	for (unsigned i = 0; i < instructions; i++) {
+		cpu_step_instruction(jit->shadow);
+	}
+
+	if (!shadow_matches(jit, cpu)) {
+		++jit->mismatches;
+		fprintf(stderr, "JIT mismatch in the block at $%04X (%u instructions)\n", pc, instructions);
+		print_registers("jit:", cpu);
+		print_registers("interpreter:", jit->shadow);
+	}
+}
+
+/***************************
+ * RUNNING BLOCKS          *
+ * *************************/
+unsigned jit_run(Jit* jit, Cpu6502* cpu, unsigned cycle_budget)
+{
+	uint16_t pc = cpu->PC;
+	const uint8_t* page = prg_rom_page(jit, cpu, pc >> 8);
+	if (!page) {
+		return 0; // RAM or I/O, always interpreted
+	}
+
+	size_t offset = (size_t) (page - jit->prg_rom) + (pc & 0xFF);
+	if (offset >= jit->prg_rom_size) {
+		return 0;
+	}
+
+	struct JitBlock* block = jit->blocks[offset];
+	if (!block || (block->pc != pc) || !block_mapped(cpu, block)) {
+		if (jit->heat[offset] < jit->hot_runs) {
+			++jit->heat[offset];
+			return 0;
+		}
+		jit->heat[offset] = 0;
+		free(block);
+		jit->blocks[offset] = NULL;
+
+		block = compile_block(jit, cpu);
+		if (!block) {
+			return 0;
+		}
+		jit->blocks[offset] = block;
+	}
+
+	if (!block->code || (block->max_cycles >= cycle_budget)) {
+		return 0;
+	}
+
+	if (jit->verify) {
+		snapshot_shadow(jit, cpu);
+	}
+	unsigned instructions = block->code(cpu);
+	if (instructions) {
+		// interrupts were polled after each instruction without anything pending
+		cpu->trace_event = TRACE_OPCODE;
+		cpu->delay_nmi = false;
+		cpu->cpu_ignore_fetch_on_nmi = false;
+		jit->instructions += instructions;
+		if (jit->verify) {
+			verify_block(jit, cpu, pc, instructions);
+		}
+	}
+
+	return instructions;
+}
+
+void jit_free(Jit* jit)
+{
+	if (jit) {
+		if (jit->blocks) {
+			flush_blocks(jit);
+		}
+		free(jit->blocks);
+		free(jit->heat);
+		free(jit->shadow);
+		free(jit->shadow_pages);
+#ifdef JIT_X86_64
+		if (jit->arena) {
+			munmap(jit->arena, JIT_ARENA_SIZE);
+		}
+#endif
+	}
+	free(jit);
+}
@@ -7,7 +7,6 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 // Static prototype functions
 static void mmc1_reg_write(Cpu6502* cpu, const uint16_t addr, const uint8_t val);
@@ -15,18 +14,20 @@ static void mapper_000(Cartridge* cart, Cpu6502* cpu, struct PpuMemoryMap* vram)
 static void mapper_001(Cartridge* cart, Cpu6502* cpu, struct PpuMemoryMap* vram);
 
 // Helper functions
+// PRG ROM is mapped straight out of the cartridge data, a bank switch only
+// rewrites the cpu memory map pages (nothing is copied)
 static inline void set_prg_rom_bank_1(Cpu6502* cpu, const unsigned prg_bank_offset, const unsigned kib_size)
 {
-	memcpy(&cpu->mem[0x8000]
-		  , cpu->cpu_mapper_io->prg_rom->data + ((prg_bank_offset) * (kib_size))
-		  , kib_size);
+	cpu_map_pages(cpu, 0x8000, kib_size
+	             , cpu->cpu_mapper_io->prg_rom->data + ((prg_bank_offset) * (kib_size))
+	             , NULL);
 }
 
 static inline void set_prg_rom_bank_2(Cpu6502* cpu, const unsigned prg_bank_offset)
 {
-	memcpy(&cpu->mem[0xC000]
-		  , cpu->cpu_mapper_io->prg_rom->data + ((prg_bank_offset) * (16 * KiB))
-		  , 16 * KiB);
+	cpu_map_pages(cpu, 0xC000, 16 * KiB
+	             , cpu->cpu_mapper_io->prg_rom->data + ((prg_bank_offset) * (16 * KiB))
+	             , NULL);
 }
 
 static inline void set_4k_chr_bank(uint8_t** const cart_chr_data, unsigned four_kib_bank_offset
@@ -54,6 +55,17 @@ static void prg_ram_writes(bool enable_prg_ram, Cpu6502* cpu, uint16_t addr, uin
 	}
 }
 
+// PRG RAM is read/written directly when enabled, otherwise the pages fall
+// back to mapper_read()/mapper_write() which handle the open bus behaviour
+static void map_prg_ram_pages(Cpu6502* cpu)
+{
+	if (cpu->cpu_mapper_io->enable_prg_ram) {
+		cpu_map_pages(cpu, 0x6000, 8 * KiB, &cpu->mem[0x6000], &cpu->mem[0x6000]);
+	} else {
+		cpu_map_pages(cpu, 0x6000, 8 * KiB, NULL, NULL);
+	}
+}
+
 void mapper_write(Cpu6502* cpu, uint16_t addr, uint8_t val)
 {
 	switch (cpu->cpu_mapper_io->mapper_number) {
@@ -94,7 +106,7 @@ uint8_t mapper_read(const Cpu6502* cpu, uint16_t addr)
 	uint8_t read_val = 0;
 	// Read from PRG ROM regardless of mapper
 	if (addr >= 0x8000) {
-		read_val = cpu->mem[addr];
+		read_val = cpu->read_page[addr >> 8][addr & 0xFF];
 		return read_val; // early return
 	}
 
@@ -164,20 +176,21 @@ void init_mapper(Cartridge* cart, Cpu6502* cpu, Ppu2C02* ppu)
 /* NROM mapper */
 static void mapper_000(Cartridge* cart, Cpu6502* cpu, struct PpuMemoryMap* vram)
 {
-	/* Load PRG ROM into CPU program memory space */
+	/* Map PRG ROM into CPU program memory space */
 	if (cart->prg_rom.size == (16 * KiB)) {
-		memcpy(&cpu->mem[0x8000], cart->prg_rom.data, 16 * KiB); // First 16KiB
-		memcpy(&cpu->mem[0xC000], cart->prg_rom.data, 16 * KiB); // Last 16KiB (Mirrored)
+		cpu_map_pages(cpu, 0x8000, 16 * KiB, cart->prg_rom.data, NULL); // First 16KiB
+		cpu_map_pages(cpu, 0xC000, 16 * KiB, cart->prg_rom.data, NULL); // Last 16KiB (Mirrored)
 	} else {
-		memcpy(&cpu->mem[0x8000], cart->prg_rom.data, 32 * KiB);
+		cpu_map_pages(cpu, 0x8000, 32 * KiB, cart->prg_rom.data, NULL);
 	}
-	free(cart->prg_rom.data);
-	cart->prg_rom.data = NULL;
 
 	/* Load CHR ROM data into PPU VRAM, NROM always seems to have 8K CHR ROM */
 	if (cart->chr_rom.size) {
 		set_4k_chr_bank(&cart->chr_rom.data, 0, &vram->pattern_table_0k);
 		set_4k_chr_bank(&cart->chr_rom.data, 1, &vram->pattern_table_4k);
+	} else if (cart->chr_ram.size) { // some (homebrew) NROM carts use 8K CHR RAM instead
+		set_4k_chr_bank(&cart->chr_ram.data, 0, &vram->pattern_table_0k);
+		set_4k_chr_bank(&cart->chr_ram.data, 1, &vram->pattern_table_4k);
 	}
 }
 
@@ -189,6 +202,7 @@ static void mapper_001(Cartridge* cart, Cpu6502* cpu, struct PpuMemoryMap* vram)
 	unsigned prg_rom_banks = cart->prg_rom.size / (16 * KiB);
 	set_prg_rom_bank_1(cpu, 0, 16 * KiB);
 	set_prg_rom_bank_2(cpu, prg_rom_banks - 1);
+	map_prg_ram_pages(cpu);
 
 	// setup chr banks so they actually point to something on startup
 	if (cart->chr_rom.size) {
@@ -254,39 +268,37 @@ static void mmc1_set_chr_1_bank(CpuMapperShare const* cpu_mapper, struct PpuMemo
 
 static void mmc1_reg_write(Cpu6502* cpu, const uint16_t addr, const uint8_t val)
 {
-	static unsigned write_count = 0;
-	static unsigned buffer = 0;
-	static unsigned write_cycle = 0;
+	CpuMapperShare* cpu_mapper = cpu->cpu_mapper_io;
 
 	// ignore adjacent writes
-	if (write_cycle == (cpu->cycle - 1)) {
+	if (cpu_mapper->mmc1_write_cycle == (cpu->cycle - 1)) {
 		return;
 	}
 
 	// Process reset bit first
 	if (val & 0x80) {
-		write_count = 0;
-		buffer = 0;
+		cpu_mapper->mmc1_write_count = 0;
+		cpu_mapper->mmc1_shift_reg = 0;
 
 		unsigned prg_rom_banks = cpu->cpu_mapper_io->prg_rom->size / (16 * KiB);
 		cpu->cpu_mapper_io->prg_high_bank_fixed = true;
 		cpu->cpu_mapper_io->prg_rom_bank_size = 16;
 		set_prg_rom_bank_2(cpu, prg_rom_banks - 1);
 
-		write_cycle = cpu->cycle;  // update write_cycle
+		cpu_mapper->mmc1_write_cycle = cpu->cycle;  // update write_cycle
 		return; // early return
 	}
 
 	// write lsb of val to write_count'th bit (bits 0 through 4)
-	buffer |= (val & 0x01) << write_count;
-	++write_count;
-	write_cycle = cpu->cycle;  // update write_cycle
+	cpu_mapper->mmc1_shift_reg |= (val & 0x01) << cpu_mapper->mmc1_write_count;
+	++cpu_mapper->mmc1_write_count;
+	cpu_mapper->mmc1_write_cycle = cpu->cycle;  // update write_cycle
 
-	if (write_count == 5) {
+	if (cpu_mapper->mmc1_write_count == 5) {
 		if ((addr >= 0x8000) && (addr <= 0x9FFF)) {
 			// reg 0: xxxC FHMM
 			// MM bits
-			switch (buffer & 0x03) {
+			switch (cpu_mapper->mmc1_shift_reg & 0x03) {
 			case 0x00: // 1-screen mirroring nametable 0
 				*(cpu->cpu_ppu_io->nametable_mirroring) = SINGLE_SCREEN_A;
 				set_nametable_mirroring(cpu->cpu_ppu_io->vram
@@ -309,7 +321,7 @@ static void mmc1_reg_write(Cpu6502* cpu, const uint16_t addr, const uint8_t val)
 				break;
 			}
 			// H bit
-			switch ((buffer >> 2) & 0x01) {
+			switch ((cpu_mapper->mmc1_shift_reg >> 2) & 0x01) {
 			case 0: // 0 = fixed lower bank
 				cpu->cpu_mapper_io->prg_low_bank_fixed = true;
 				cpu->cpu_mapper_io->prg_high_bank_fixed = false;
@@ -320,7 +332,7 @@ static void mmc1_reg_write(Cpu6502* cpu, const uint16_t addr, const uint8_t val)
 				break;
 			}
 			// F bit
-			switch ((buffer >> 3) & 0x01) {
+			switch ((cpu_mapper->mmc1_shift_reg >> 3) & 0x01) {
 			// Size in KiB
 			case 0:
 				cpu->cpu_mapper_io->prg_rom_bank_size = 32;
@@ -330,7 +342,7 @@ static void mmc1_reg_write(Cpu6502* cpu, const uint16_t addr, const uint8_t val)
 				break;
 			}
 			// C bit
-			switch ((buffer >> 4) & 0x01) {
+			switch ((cpu_mapper->mmc1_shift_reg >> 4) & 0x01) {
 			case 0: // can either be rom or ram
 			// Size in KiB
 				cpu->cpu_mapper_io->chr_bank_size = 8;
@@ -342,7 +354,7 @@ static void mmc1_reg_write(Cpu6502* cpu, const uint16_t addr, const uint8_t val)
 		} else if ((addr >= 0xA000) && (addr <= 0xBFFF)) {
 			// reg 1: RxxC CCCC
 			// C bits
-			unsigned bank_select = buffer & 0x1F;
+			unsigned bank_select = cpu_mapper->mmc1_shift_reg & 0x1F;
 			unsigned chr_banks = cpu->cpu_mapper_io->chr_rom->size / (4 * KiB);
 			// assume CHR ROM first then try CHR RAM
 			if (cpu->cpu_mapper_io->chr_ram->size) {
@@ -360,7 +372,7 @@ static void mmc1_reg_write(Cpu6502* cpu, const uint16_t addr, const uint8_t val)
 			                    , cpu->cpu_ppu_io->vram, bank_select);
 		} else if ((addr >= 0xC000) && (addr <= 0xDFFF)) {
 			// reg 2: RxxC CCCC (ignored if CHR banks are in 8K mode)
-			unsigned bank_select = buffer & 0x1F;
+			unsigned bank_select = cpu_mapper->mmc1_shift_reg & 0x1F;
 			unsigned chr_banks = cpu->cpu_mapper_io->chr_rom->size / (4 * KiB);
 			// assume CHR ROM first then try CHR RAM
 			if (cpu->cpu_mapper_io->chr_ram->size) {
@@ -375,7 +387,7 @@ static void mmc1_reg_write(Cpu6502* cpu, const uint16_t addr, const uint8_t val)
 			}
 		} else if (addr >= 0xE000) { // else (addr >= 0xE000 && addr <= 0xFFFF)
 			// reg 3: RxxB PPPP
-			unsigned bank_select = buffer & 0x0F;
+			unsigned bank_select = cpu_mapper->mmc1_shift_reg & 0x0F;
 			unsigned prg_rom_banks = cpu->cpu_mapper_io->prg_rom->size / (16 * KiB);
 			normalise_any_out_of_bounds_bank(&bank_select, prg_rom_banks);
 
@@ -393,7 +405,7 @@ static void mmc1_reg_write(Cpu6502* cpu, const uint16_t addr, const uint8_t val)
 					set_prg_rom_bank_2(cpu, prg_rom_banks - 1);
 				}
 			}
-			cpu->cpu_mapper_io->enable_prg_ram = !((buffer & 0x10) >> 4);
+			cpu->cpu_mapper_io->enable_prg_ram = !((cpu_mapper->mmc1_shift_reg & 0x10) >> 4);
 
 			// Disable PRG RAM if there is actually no PRG RAM present
 			// only valid for NES2.0 headers as iNES headers always have at least
@@ -401,8 +413,9 @@ static void mmc1_reg_write(Cpu6502* cpu, const uint16_t addr, const uint8_t val)
 			if (!cpu->cpu_mapper_io->prg_ram->size) {
 				cpu->cpu_mapper_io->enable_prg_ram = false;
 			}
+			map_prg_ram_pages(cpu);
 		}
-		write_count = 0;
-		buffer = 0;
+		cpu_mapper->mmc1_write_count = 0;
+		cpu_mapper->mmc1_shift_reg = 0;
 	}
 }
@@ -0,0 +1,218 @@
+#include "movie.h"
+#include "nes.h"
+#include "cart.h"
+#include "cpu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* File layout, all integers little endian:
+ *   "CNMV", u32 version, u32 rom hash, u32 frame count, u32 input count
+ *   then per input: u32 frame, u8 player 1, u8 player 2
+ */
+#define MOVIE_HEADER_SIZE 20U
+#define MOVIE_INPUT_SIZE 6U
+
+static const char movie_magic[4] = {'C', 'N', 'M', 'V'};
+
+
+static uint32_t fnv1a_32(uint32_t hash, const uint8_t* data, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x01000193U;
+	}
+
+	return hash;
+}
+
+static uint32_t hash_rom(const Nes* nes)
+{
+	uint32_t hash = 0x811C9DC5U;
+	hash = fnv1a_32(hash, nes->cart->prg_rom.data, nes->cart->prg_rom.size);
+	if (nes->cart->chr_rom.data) {
+		hash = fnv1a_32(hash, nes->cart->chr_rom.data, nes->cart->chr_rom.size);
+	}
+
+	return hash;
+}
+
+static void write_u32(uint8_t* out, uint32_t value)
+{
+	out[0] = value & 0xFF;
+	out[1] = (value >> 8) & 0xFF;
+	out[2] = (value >> 16) & 0xFF;
+	out[3] = (value >> 24) & 0xFF;
+}
+
+static uint32_t read_u32(const uint8_t* in)
+{
+	return (uint32_t) in[0] | ((uint32_t) in[1] << 8)
+	     | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+}
+
+static int reserve_inputs(InputMovie* movie, size_t count)
+{
+	if (count <= movie->input_capacity) {
+		return 0;
+	}
+
+	size_t capacity = movie->input_capacity ? movie->input_capacity : 64;
+	while (capacity < count) {
+		capacity *= 2;
+	}
+	struct MovieInput* inputs = realloc(movie->inputs, capacity * sizeof(struct MovieInput));
+	if (!inputs) {
+		fprintf(stderr, "Failed to allocate enough memory for the movie inputs\n");
+		return -1;
+	}
+	movie->inputs = inputs;
+	movie->input_capacity = capacity;
+
+	return 0;
+}
+
+InputMovie* movie_allocator(void)
+{
+	InputMovie* movie = calloc(1, sizeof(InputMovie));
+	if (!movie) {
+		fprintf(stderr, "Failed to allocate enough memory for InputMovie\n");
+	}
+
+	return movie;
+}
+
+int movie_init(InputMovie* movie, const Nes* nes)
+{
+	movie->input_count = 0;
+	movie->frame_count = 0;
+	movie->rom_hash = hash_rom(nes);
+	movie->play_frame = 0;
+	movie->next_input = 0;
+
+	return 0;
+}
+
+int movie_record_frame(InputMovie* movie, const Nes* nes)
+{
+	uint8_t player_1 = nes->cpu->player_1_controller;
+	uint8_t player_2 = nes->cpu->player_2_controller;
+	const struct MovieInput* last = movie->input_count ? &movie->inputs[movie->input_count - 1] : NULL;
+
+	if (!last || last->player_1 != player_1 || last->player_2 != player_2) {
+		if (reserve_inputs(movie, movie->input_count + 1)) {
+			return -1;
+		}
+		movie->inputs[movie->input_count++] = (struct MovieInput) {movie->frame_count, player_1, player_2};
+	}
+	++movie->frame_count;
+
+	return 0;
+}
+
+int movie_play_frame(InputMovie* movie, Nes* nes)
+{
+	if (movie->play_frame >= movie->frame_count) {
+		nes->cpu->player_1_controller = 0;
+		nes->cpu->player_2_controller = 0;
+		return 1;
+	}
+
+	while ((movie->next_input < movie->input_count)
+	      && (movie->inputs[movie->next_input].frame <= movie->play_frame)) {
+		nes->cpu->player_1_controller = movie->inputs[movie->next_input].player_1;
+		nes->cpu->player_2_controller = movie->inputs[movie->next_input].player_2;
+		++movie->next_input;
+	}
+	++movie->play_frame;
+
+	return 0;
+}
+
+int movie_save(const InputMovie* movie, const char* filename)
+{
+	FILE* file = fopen(filename, "wb");
+	if (!file) {
+		fprintf(stderr, "Unable to create movie file %s\n", filename);
+		return -1;
+	}
+
+	uint8_t header[MOVIE_HEADER_SIZE];
+	memcpy(header, movie_magic, sizeof(movie_magic));
+	write_u32(&header[4], MOVIE_VERSION);
+	write_u32(&header[8], movie->rom_hash);
+	write_u32(&header[12], movie->frame_count);
+	write_u32(&header[16], movie->input_count);
+	int ret = fwrite(header, sizeof(header), 1, file) == 1 ? 0 : -1;
+
+	for (size_t i = 0; !ret && i < movie->input_count; i++) {
+		uint8_t input[MOVIE_INPUT_SIZE];
+		write_u32(input, movie->inputs[i].frame);
+		input[4] = movie->inputs[i].player_1;
+		input[5] = movie->inputs[i].player_2;
+		ret = fwrite(input, sizeof(input), 1, file) == 1 ? 0 : -1;
+	}
+
+	if (fclose(file) || ret) {
+		fprintf(stderr, "Failed to write movie file %s\n", filename);
+		return -1;
+	}
+
+	return 0;
+}
+
+int movie_load(InputMovie* movie, const char* filename, const Nes* nes)
+{
+	FILE* file = fopen(filename, "rb");
+	if (!file) {
+		fprintf(stderr, "Unable to open movie file %s\n", filename);
+		return -1;
+	}
+
+	int ret = -1;
+	uint8_t header[MOVIE_HEADER_SIZE];
+	if (fread(header, sizeof(header), 1, file) != 1 || memcmp(header, movie_magic, sizeof(movie_magic))) {
+		fprintf(stderr, "%s is not a cNES movie\n", filename);
+		goto close_file;
+	}
+	if (read_u32(&header[4]) != MOVIE_VERSION) {
+		fprintf(stderr, "Unsupported movie version %u\n", (unsigned) read_u32(&header[4]));
+		goto close_file;
+	}
+	if (read_u32(&header[8]) != hash_rom(nes)) {
+		fprintf(stderr, "Movie %s was recorded on a different game\n", filename);
+		goto close_file;
+	}
+
+	movie_init(movie, nes);
+	uint32_t frame_count = read_u32(&header[12]);
+	size_t input_count = read_u32(&header[16]);
+	if (reserve_inputs(movie, input_count)) {
+		goto close_file;
+	}
+
+	for (size_t i = 0; i < input_count; i++) {
+		uint8_t input[MOVIE_INPUT_SIZE];
+		if (fread(input, sizeof(input), 1, file) != 1) {
+			fprintf(stderr, "Movie file %s is truncated\n", filename);
+			goto close_file;
+		}
+		movie->inputs[i] = (struct MovieInput) {read_u32(input), input[4], input[5]};
+	}
+	movie->input_count = input_count;
+	movie->frame_count = frame_count;
+	ret = 0;
+
+close_file:
+	fclose(file);
+	return ret;
+}
+
+void movie_free(InputMovie* movie)
+{
+	if (movie) {
+		free(movie->inputs);
+	}
+	free(movie);
+}
@@ -0,0 +1,111 @@
+#include "nes.h"
+#include "cart.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "gui.h"
+#include "cpu_ppu_interface.h"
+#include "cpu_mapper_interface.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+Nes* nes_allocator(void)
+{
+	Nes* nes = calloc(1, sizeof(Nes));
+	if (!nes) {
+		fprintf(stderr, "Failed to allocate enough memory for Nes\n");
+		return NULL;
+	}
+
+	nes->cart = cart_allocator();
+	nes->cpu_mapper = cpu_mapper_allocator();
+	nes->cpu_ppu = cpu_ppu_io_allocator();
+	nes->cpu = cpu_allocator();
+	nes->ppu = ppu_allocator();
+	nes->cnes_windows.cnes_main = sdl2_display_allocator();
+	nes->cnes_windows.cnes_nt_viewer = sdl2_display_allocator();
+
+	if (!nes->cart || !nes->cpu_mapper || !nes->cpu_ppu || !nes->cpu || !nes->ppu
+	   || !nes->cnes_windows.cnes_main || !nes->cnes_windows.cnes_nt_viewer) {
+		// cart data pointers aren't set yet, free the structs only
+		free(nes->cart);
+		nes->cart = NULL;
+		nes_free(nes);
+		return NULL;
+	}
+
+	// no window until screen_init() is called
+	nes->cnes_windows.cnes_main->window = NULL;
+	nes->cnes_windows.cnes_nt_viewer->window = NULL;
+
+	return nes;
+}
+
+int nes_init(Nes* nes)
+{
+	int return_code = 0;
+
+	if (cart_init(nes->cart)) {
+		fprintf(stderr, "Failed to initialise the Cart struct members\n");
+		return_code = -1;
+	}
+
+	if (cpu_mapper_init(nes->cpu_mapper, nes->cart)) {
+		fprintf(stderr, "Failed to initialise the Cpu/Mapper struct members\n");
+		return_code = -1;
+	}
+
+	if (cpu_ppu_io_init(nes->cpu_ppu)) {
+		fprintf(stderr, "Failed to initialise the Cpu/Ppu struct members\n");
+		return_code = -1;
+	}
+	map_ppu_data_to_cpu_ppu_io(nes->cpu_ppu, nes->ppu);
+
+	if (cpu_init(nes->cpu, 0xC000, nes->cpu_ppu, nes->cpu_mapper)) {
+		fprintf(stderr, "Failed to initialise the Cpu struct members\n");
+		return_code = -1;
+	}
+
+	if (ppu_init(nes->ppu, nes->cpu_ppu)) {
+		fprintf(stderr, "Failed to initialise the Ppu struct members\n");
+		return_code = -1;
+	}
+
+	return return_code;
+}
+
+int nes_load_cart(Nes* nes, const char* filename)
+{
+	if (parse_nes_cart_file(nes->cart, filename, nes->cpu, nes->ppu)) {
+		return -1;
+	}
+
+	init_pc(nes->cpu); // Initialise PC to reset vector
+	update_cpu_info(nes->cpu);
+
+	return 0;
+}
+
+void nes_free(Nes* nes)
+{
+	if (!nes) {
+		return;
+	}
+
+	if (nes->cart) {
+		free(nes->cart->chr_rom.data);
+		free(nes->cart->chr_ram.data);
+		free(nes->cart->chr_rows);
+		free(nes->cart->prg_rom.data);
+		free(nes->cart->trainer.data);
+		free(nes->cart);
+	}
+	free(nes->cnes_windows.cnes_main);
+	free(nes->cnes_windows.cnes_nt_viewer);
+	free(nes->ppu);
+	free(nes->cpu);
+	free(nes->cpu_ppu);
+	free(nes->cpu_mapper);
+	free(nes);
+}
@@ -2,12 +2,17 @@
 #include "cpu.h"
 #include "gui.h"
 #include "cpu_ppu_interface.h"
+#include "compositor.h"
 #include "bits_and_bytes.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 
+static void schedule_vblank(Ppu2C02* p);
+static void update_chr_row(struct PpuMemoryMap* mem, unsigned addr);
+
 /* Reverse bits lookup table for an 8 bit number */
 static const uint8_t reverse_bits[256] = {
 	0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0, 0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
@@ -55,9 +60,6 @@ static const uint32_t palette[64] = {
 };
 #endif
 
-uint32_t pixels[256 * 240];
-uint32_t nt_pixels[512 * 480];
-
 // Static prototype functions
 static unsigned eight_to_one_mux(uint16_t input, unsigned select_lines);
 
@@ -114,8 +116,18 @@ int ppu_init(Ppu2C02* ppu, CpuPpuShare* cp)
 	ppu->sp_hi_reg = 0;
 	ppu->l_sl = 400;
 	ppu->l_cl = 400;
+	ppu_attach_chr_rows(&ppu->vram, NULL, 0, NULL);
+	ppu->unobserved_until = 0;
+	ppu->bg_line_ready = false;
+	memset(ppu->bg_line, 0, sizeof(ppu->bg_line));
+	ppu->sprite_line_ready = false;
+	ppu->sprite_line_first = 0;
+	memset(ppu->sprite_line, 0, sizeof(ppu->sprite_line));
 	memset(ppu->bg_opaque_hit, 0, sizeof(ppu->bg_opaque_hit));
 	memset(ppu->sp_opaque_hit, 0, sizeof(ppu->sp_opaque_hit));
+	ppu->oam_y_byte_offset = 0;
+	ppu->sprite_y_offset = 0;
+	ppu->warmup_count = 0;
 
 	// Zero out arrays
 	memset(ppu->oam, 0, sizeof(ppu->oam));
@@ -124,9 +136,12 @@ int ppu_init(Ppu2C02* ppu, CpuPpuShare* cp)
 	memset(ppu->sprite_at_latches, 0, sizeof(ppu->sprite_at_latches));
 	memset(ppu->sprite_pt_lo_shift_reg, 0, sizeof(ppu->sprite_pt_lo_shift_reg));
 	memset(ppu->sprite_pt_hi_shift_reg, 0, sizeof(ppu->sprite_pt_hi_shift_reg));
+	memset(ppu->pixels, 0, sizeof(ppu->pixels));
+	memset(ppu->nt_pixels, 0, sizeof(ppu->nt_pixels));
 
 	/* NTSC */
 	ppu->nmi_start = 241;
+	schedule_vblank(ppu);
 
 	return_code = 0;
 
@@ -134,19 +149,26 @@ int ppu_init(Ppu2C02* ppu, CpuPpuShare* cp)
 }
 
 
+/* Cpu cycle the current dot runs alongside, from the master clock (dots since
+ * power up), cpu cycle N covers dots 3N - 2 to 3N
+ */
+static inline uint64_t ppu_cpu_cycle(const Ppu2C02* p)
+{
+	return (p->cpu_ppu_io->events.now + 2) / 3;
+}
+
 // Reset/Warm-up function, clears and sets VBL flag at certain CPU cycles
-static void ppu_vblank_warmup_seq(Ppu2C02* p, const Cpu6502* cpu)
+static void ppu_vblank_warmup_seq(Ppu2C02* p)
 {
-	static unsigned count = 0;
-	if (!count) {
+	if (!p->warmup_count) {
 		clear_ppu_status_vblank_bit(p->cpu_ppu_io);
-		++count;
-	} else if ((count == 1) && cpu->cycle >= 27383) {
+		++p->warmup_count;
+	} else if ((p->warmup_count == 1) && ppu_cpu_cycle(p) >= 27383) {
 		set_ppu_status_vblank_bit(p->cpu_ppu_io);
-		++count;
-	} else if ((count == 2) && cpu->cycle >= 57164) {
+		++p->warmup_count;
+	} else if ((p->warmup_count == 2) && ppu_cpu_cycle(p) >= 57164) {
 		set_ppu_status_vblank_bit(p->cpu_ppu_io);
-		++count;
+		++p->warmup_count;
 	}
 }
 
@@ -167,9 +189,11 @@ void write_to_ppu_vram(struct PpuMemoryMap* mem, unsigned addr, uint8_t data)
 	if (addr < 0x1000) {
 		// 0x0000 to 0x0FFF
 		mem->pattern_table_0k[addr] = data;
+		update_chr_row(mem, addr);
 	} else if (addr < 0x2000) {
 		// 0x1000 to 0x1FFF
 		mem->pattern_table_4k[addr & 0x0FFF] = data;
+		update_chr_row(mem, addr);
 	} else if (addr < 0x2400) {
 		// 0x2000 to 0x23FF
 		(*mem->nametable_0)[addr & 0x03FF] = data;
@@ -241,6 +265,75 @@ uint8_t read_from_ppu_vram(const struct PpuMemoryMap* mem, unsigned addr)
 	return ret;
 }
 
+/* CHR tile row cache
+ *
+ * Tiles are 16 bytes, the lo bitplane of rows 0-7 then the hi bitplane, a
+ * pixel's colour index is its bit from each plane (MSB = leftmost pixel).
+ * Rows are decoded once when the cart is loaded (and again for CHR RAM
+ * writes) so the renderer gets a whole row of indices from one lookup
+ */
+static struct ChrRow decode_chr_row(uint8_t lo, uint8_t hi)
+{
+	struct ChrRow row = {0, 0};
+	for (unsigned px = 0; px < 8; px++) {
+		unsigned index = (get_nth_bit(hi, 7 - px) << 1) | get_nth_bit(lo, 7 - px);
+		row.normal |= (uint16_t) (index << (2 * px));
+		row.flipped |= (uint16_t) (index << (2 * (7 - px)));
+	}
+
+	return row;
+}
+
+// 8 rows per 16 byte tile
+static inline uint32_t chr_row_index(uint32_t offset)
+{
+	return ((offset >> 4) << 3) | (offset & 0x07);
+}
+
+void ppu_decode_chr(struct ChrRow* rows, const uint8_t* chr_data, uint32_t size)
+{
+	for (uint32_t tile = 0; tile < size; tile += 16) {
+		for (unsigned y = 0; y < 8; y++) {
+			rows[chr_row_index(tile | y)] = decode_chr_row(chr_data[tile | y], chr_data[tile | y | 8]);
+		}
+	}
+}
+
+void ppu_attach_chr_rows(struct PpuMemoryMap* mem, const uint8_t* chr_data, uint32_t size, struct ChrRow* rows)
+{
+	mem->chr_data = rows ? chr_data : NULL;
+	mem->chr_size = rows ? size : 0;
+	mem->chr_rows = rows;
+}
+
+// Offset into chr_data of a pattern table address, chr_size if it isn't in there
+static uint32_t chr_offset(const struct PpuMemoryMap* mem, unsigned addr)
+{
+	const uint8_t* table = (addr & 0x1000) ? mem->pattern_table_4k : mem->pattern_table_0k;
+	uintptr_t offset = (uintptr_t) (table + (addr & 0x0FFF)) - (uintptr_t) mem->chr_data;
+
+	return (mem->chr_rows && (offset < mem->chr_size)) ? (uint32_t) offset : mem->chr_size;
+}
+
+static void update_chr_row(struct PpuMemoryMap* mem, unsigned addr)
+{
+	uint32_t offset = chr_offset(mem, addr & ~0x08U);
+	if (offset < mem->chr_size) {
+		mem->chr_rows[chr_row_index(offset)]
+			= decode_chr_row(mem->chr_data[offset], mem->chr_data[offset | 8]);
+	}
+}
+
+struct ChrRow ppu_chr_row(const struct PpuMemoryMap* mem, unsigned addr)
+{
+	uint32_t offset = chr_offset(mem, addr);
+	if (offset < mem->chr_size) {
+		return mem->chr_rows[chr_row_index(offset)];
+	}
+
+	return decode_chr_row(read_from_ppu_vram(mem, addr), read_from_ppu_vram(mem, addr | 8));
+}
+
 void ppu_mem_hexdump_addr_range(const Ppu2C02* ppu, const enum PpuMemoryTypes ppu_mem, unsigned start_addr, uint16_t end_addr)
 {
 	if (end_addr <= start_addr) {
@@ -482,7 +575,7 @@ static void all_nametables_fill_pixel_buffer(Ppu2C02* ppu)
 					bkg_internals.at_hi_shift_reg >>= 1;
 					bkg_internals.at_lo_shift_reg >>= 1;
 
-					set_rgba_pixel_in_buffer(nt_pixels, 512
+					set_rgba_pixel_in_buffer(ppu->nt_pixels, 512
 					                        , (coarse_x * 8) + fine_x
 					                        , (coarse_y * 8) + fine_y
 					                        , palette[RGB], 0xFF);
@@ -863,8 +956,7 @@ void reset_secondary_oam(Ppu2C02* p)
 void sprite_evaluation(Ppu2C02* p)
 {
 	int y_offset = 0;
-	static int oam_y_byte_offset = 0;
-	unsigned oam_read_addr = (p->sprite_index * 4) + oam_y_byte_offset;
+	unsigned oam_read_addr = (p->sprite_index * 4) + p->oam_y_byte_offset;
 
 	switch (p->cycle % 2) {
 	case 1: // Odd cycles
@@ -879,11 +971,11 @@ void sprite_evaluation(Ppu2C02* p)
 			if (sprite_in_y_range) {
 				p->sprites_found++; // max val is 9 now
 				p->cpu_ppu_io->ppu_status |= 0x20; // Trigger sprite overflow flag
-				oam_y_byte_offset = 0;
+				p->oam_y_byte_offset = 0;
 			} else {
-				++oam_y_byte_offset;
-				if (oam_y_byte_offset == 4) {
-					oam_y_byte_offset = 0;
+				++p->oam_y_byte_offset;
+				if (p->oam_y_byte_offset == 4) {
+					p->oam_y_byte_offset = 0;
 				}
 			}
 		}
@@ -902,7 +994,7 @@ void sprite_evaluation(Ppu2C02* p)
 		if (p->sprite_index == 64) {
 			p->sprite_index = 0; // above reset should cover this
 			p->stop_early = true;
-			oam_y_byte_offset = 0;
+			p->oam_y_byte_offset = 0;
 		}
 
 		break;
@@ -910,15 +1002,20 @@ void sprite_evaluation(Ppu2C02* p)
 }
 
 
+static bool sprite_zero_in_range(const Ppu2C02* p)
+{
+	// -1 as Y pos of sprite is delayed until the next scanline
+	return ((p->scanline - p->oam[0] - 1) < ppu_sprite_height(p->cpu_ppu_io))
+	       && (p->scanline > 0)
+	       && (p->scanline < 240);
+}
+
 /* Sprite 0 hit peek for the next 8 pixels to be rendered
  */
 static void sprite_hit_lookahead(Ppu2C02* p)
 {
 	// Check if sprite is in Y range
-	// -1 as Y pos of sprite is delayed until the next scanline
-	if ((p->scanline - p->oam[0] - 1) < ppu_sprite_height(p->cpu_ppu_io)
-		&& (p->scanline > 0)
-		&& (p->scanline < 240)) {
+	if (sprite_zero_in_range(p)) {
 		// should be looking @ px 9-16 (1 index) @ cyc 8
 		if (((p->cycle - 1) & 0x07) == 0x07) {
 			// perform our check on the start of a tile boundry i.e. 0, 8, 16 ...
@@ -1018,11 +1115,562 @@ static void sprite_hit_lookahead(Ppu2C02* p)
  * RENDERING             *
  *************************/
 
+/* Whole scanline BG fast path
+ *
+ * Runs the BG part of dots 1-256 (the pixel, AT reload, fetches, shift
+ * register reloads and scroll increments) in one go, keeping the pixels in
+ * bg_line. The ppu ends up as it would after dot 256 and clock_ppu() skips
+ * the BG work of those dots. Only done when nothing can change or look at
+ * the BG state during the scanline: the cpu doesn't run until the ppu is
+ * past dot 256 (so no register writes, CHR bank or mirroring changes), no
+ * event is due and the sprite 0 lookahead (which peeks at the BG shift
+ * registers) has nothing to do
+ */
+static bool bg_scanline_unobserved(const Ppu2C02* p)
+{
+	const CpuPpuShare* io = p->cpu_ppu_io;
+	uint64_t last_dot = io->events.now + 255;
+
+	if (!ppu_show_bg(io) || (p->unobserved_until < last_dot) || (io->events.next <= last_dot)) {
+		return false;
+	}
+
+	return !(ppu_show_sprite(io) && !sprite_overflow_occured(io) && sprite_zero_in_range(p));
+}
+
+static void render_bg_scanline(Ppu2C02* p)
+{
+	struct BackgroundRenderingInternals* bkg = &p->bkg_internals;
+	uint16_t base_pt_address = ppu_base_pt_address(p->cpu_ppu_io);
+	bool left_8px_masked = ppu_mask_left_8px_bg(p->cpu_ppu_io);
+	unsigned fine_x = p->fine_x;
+
+	// Colour indices of the 2 tiles in the pipeline (as struct ChrRow), the
+	// first 2 come from the shift registers then a predecoded row per fetch
+	uint32_t pipeline = 0;
+	for (unsigned px = 0; px < 16; px++) {
+		pipeline |= (uint32_t) ((get_nth_bit(bkg->pt_hi_shift_reg, px) << 1)
+		                       | get_nth_bit(bkg->pt_lo_shift_reg, px)) << (2 * px);
+	}
+
+	for (unsigned tile = 0; tile < 32; tile++) {
+		// pixels, same as get_bkg_pixel() and the attribute reloads
+		for (unsigned px = 0; px < 8; px++) {
+			unsigned cycle = (tile * 8) + px + 1;
+			unsigned bg_colour_index = (pipeline >> (2 * (px + fine_x))) & 0x03;
+			unsigned bg_palette = ((bkg->at_hi_shift_reg & 0x01) << 1) | (bkg->at_lo_shift_reg & 0x01);
+			if ((left_8px_masked && cycle < 8) || !bg_colour_index) {
+				p->bg_line[cycle - 1] = 0;
+			} else {
+				p->bg_line[cycle - 1] = (uint8_t) ((bg_palette << 2) | bg_colour_index);
+			}
+			bkg->at_hi_shift_reg >>= 1;
+			bkg->at_lo_shift_reg >>= 1;
+			if (!((cycle + fine_x) % 8)) {
+				fill_attribute_shift_reg(bkg->nt_addr_current, bkg->at_current, bkg);
+			}
+		}
+
+		// fetches, the PT ones come from the row cache
+		fetch_nt_byte(&p->vram, p->vram_addr, bkg);
+		fetch_at_byte(&p->vram, p->vram_addr, bkg);
+		uint16_t pt_offset = (bkg->nt_byte << 4) + ((p->vram_addr & 0x7000) >> 12);
+		pipeline = (pipeline >> 16)
+		         | ((uint32_t) ppu_chr_row(&p->vram, base_pt_address | pt_offset).normal << 16);
+		if (tile >= 30) {
+			// leave the latches and pt shift registers as the dot path would
+			fetch_pt_lo(&p->vram, p->vram_addr, base_pt_address, bkg);
+			fetch_pt_hi(&p->vram, p->vram_addr, base_pt_address, bkg);
+			bkg->pt_lo_shift_reg = (uint16_t) ((bkg->pt_lo_shift_reg >> 8) | (bkg->pt_lo_latch << 8));
+			bkg->pt_hi_shift_reg = (uint16_t) ((bkg->pt_hi_shift_reg >> 8) | (bkg->pt_hi_latch << 8));
+		}
+		bkg->at_current = bkg->at_latch;
+		bkg->nt_addr_current = p->vram_addr;
+		inc_horz_scroll(p->cpu_ppu_io);
+	}
+	inc_vert_scroll(p->cpu_ppu_io);
+
+	p->bg_line_ready = true;
+}
+
+/* The sprite registers loaded at dots 257-320 are drawn once, from the
+ * first pixel dot of the next line, into sprite_line. Same pixels as calling
+ * get_sprite_pixel() on every dot: lower numbered sprites are drawn last so
+ * the lowest opaque one wins. The left 8 pixel mask, show sprites and
+ * greyscale can change mid line, they're applied as the line is read
+ */
+void render_sprite_line(Ppu2C02* p, unsigned first)
+{
+	memset(p->sprite_line, 0, sizeof(p->sprite_line));
+	for (int i = 7; i >= 0; i--) {
+		uint8_t entry = (uint8_t) (0x10 | ((p->sprite_at_latches[i] & 0x03) << 2));
+		if (!sprite_is_front_priority(p, (unsigned) i)) {
+			entry |= SPRITE_LINE_BEHIND;
+		}
+
+		unsigned x = first - 1 + p->sprite_x_counter[i];
+		for (unsigned bit = 0; bit < 8 && x < 256; bit++, x++) {
+			unsigned index = (((p->sprite_pt_hi_shift_reg[i] >> bit) & 0x01) << 1)
+			               |  ((p->sprite_pt_lo_shift_reg[i] >> bit) & 0x01);
+			if (index) {
+				p->sprite_line[x] = entry | (uint8_t) index;
+			}
+		}
+	}
+	p->sprite_line_first = (uint16_t) first;
+	p->sprite_line_ready = true;
+}
+
+// Moves the sprite x counters and shift registers on by count dots
+static void shift_sprite_regs(Ppu2C02* p, unsigned count)
+{
+	for (int i = 0; i < 8; i++) {
+		if (p->sprite_x_counter[i] >= count) {
+			p->sprite_x_counter[i] -= count;
+			continue;
+		}
+		// active sprites shift out a pixel each dot
+		unsigned shifts = count - p->sprite_x_counter[i];
+		p->sprite_x_counter[i] = 0;
+		p->sprite_pt_lo_shift_reg[i] = (shifts < 8) ? p->sprite_pt_lo_shift_reg[i] >> shifts : 0;
+		p->sprite_pt_hi_shift_reg[i] = (shifts < 8) ? p->sprite_pt_hi_shift_reg[i] >> shifts : 0;
+	}
+}
+
+static void ensure_sprite_line(Ppu2C02* p, unsigned first)
+{
+	if (!p->sprite_line_ready) {
+		render_sprite_line(p, first);
+	}
+}
+
+// Registers end the line as if get_sprite_pixel() had been run for every dot
+static void finish_sprite_line(Ppu2C02* p)
+{
+	shift_sprite_regs(p, 257 - p->sprite_line_first);
+	p->sprite_line_ready = false;
+}
+
+static bool sprite_pixel_masked(const Ppu2C02* p)
+{
+	return (ppu_mask_left_8px_sprite(p->cpu_ppu_io) && p->cycle < 8) || !ppu_show_sprite(p->cpu_ppu_io);
+}
+
+// get_sprite_pixel() for the current dot, read from sprite_line
+static void get_sprite_line_pixel(Ppu2C02* p, uint8_t* colour_ref)
+{
+	uint8_t entry = p->sprite_line[p->cycle - 1];
+	unsigned sprite_colour_index = entry & 0x03;
+	if (sprite_pixel_masked(p)) {
+		sprite_colour_index = 0;
+	}
+
+	*colour_ref = read_from_ppu_vram(&p->vram, 0x3F00 + (sprite_colour_index ? (entry & SPRITE_LINE_OFFSET) : 0));
+	if (ppu_show_greyscale(p->cpu_ppu_io)) { *colour_ref &= 0x30; }
+	p->current_pixel.sprite_pattern_index = sprite_colour_index;
+	p->current_pixel.sprite_col = *colour_ref;
+}
+
+/* A render_bg_scanline() line is composited with sprite_line at dot 256
+ * (the palette and ppu_mask can't change part way through a line that took
+ * the fast path), the sprite masks are applied to the whole line first
+ */
+static void composite_line(Ppu2C02* p)
+{
+	if (p->cycle != 256) {
+		return;
+	}
+
+	if (!ppu_show_sprite(p->cpu_ppu_io)) {
+		memset(p->sprite_line, 0, sizeof(p->sprite_line));
+	} else if (ppu_mask_left_8px_sprite(p->cpu_ppu_io)) {
+		memset(p->sprite_line, 0, 7); // dots 1-7
+	}
+
+	uint32_t colours[COMPOSITOR_COLOURS];
+	uint8_t greyscale_mask = ppu_show_greyscale(p->cpu_ppu_io) ? 0x30 : 0x3F;
+	for (unsigned i = 0; i < COMPOSITOR_COLOURS; i++) {
+		colours[i] = 0xFF000000 | palette[read_from_ppu_vram(&p->vram, 0x3F00 + i) & greyscale_mask];
+	}
+	composite_scanline(&p->pixels[p->scanline * 256], p->bg_line, p->sprite_line, colours);
+}
+
+static void output_pixel(Ppu2C02* p)
+{
+	ensure_sprite_line(p, p->cycle);
+
+	if (p->bg_line_ready) {
+		composite_line(p);
+	} else {
+		get_bkg_pixel(p, &p->current_pixel.bkg_col);
+		get_sprite_line_pixel(p, &p->current_pixel.sprite_col);
+		get_pixel(&p->current_pixel, !(p->sprite_line[p->cycle - 1] & SPRITE_LINE_BEHIND));
+		set_rgba_pixel_in_buffer(p->pixels, 256, p->cycle - 1, p->scanline, palette[p->current_pixel.output_col], 0xFF);
+	}
+
+	if (p->cycle == 256) {
+		finish_sprite_line(p);
+	}
+}
+
+unsigned ppu_quiet_dots(const Ppu2C02* p)
+{
+	const unsigned dots_per_scanline = 341;
+	unsigned dot = p->scanline * dots_per_scanline + p->cycle;
+	unsigned end;
+
+	if (p->scanline < 240) {
+		end = 240 * dots_per_scanline + 339; // status clear, then the NMI lookahead
+	} else if (((p->scanline > p->nmi_start) || (p->scanline == p->nmi_start && p->cycle > 4))
+	           && (p->scanline <= 261)) {
+		// past the dots where the NMI can be raised, delayed or cancelled
+		// stop short of the odd frame skip, frontends count frames between steps
+		end = 261 * dots_per_scanline + 339;
+	} else {
+		return 0; // scanline 240 up to the end of the NMI window
+	}
+
+	return (end > dot) ? end - dot : 0;
+}
+
+unsigned ppu_idle_dots(const Ppu2C02* p)
+{
+	const unsigned dots_per_scanline = 341;
+	const CpuPpuShare* io = p->cpu_ppu_io;
+	if ((p->warmup_count < 3) || io->suppress_nmi_flag || io->ignore_nmi) {
+		return 0;
+	}
+
+	unsigned dot = p->scanline * dots_per_scanline + p->cycle; // already clocked
+	unsigned vblank_start = p->nmi_start * dots_per_scanline + 4; // past the NMI window
+	unsigned vblank_end = 260 * dots_per_scanline + 340;
+	unsigned end; // last idle dot
+
+	if ((dot >= vblank_start) && (dot < vblank_end)) {
+		end = vblank_end;
+	} else if (ppu_mask_bg_or_sprite_enabled(io)) {
+		return 0;
+	} else if (dot < 239 * dots_per_scanline + 340) {
+		end = 239 * dots_per_scanline + 340; // then the frame is output
+	} else if ((dot >= 240 * dots_per_scanline) && (dot < 240 * dots_per_scanline + 338)) {
+		end = 240 * dots_per_scanline + 338; // then the status clear and NMI lookahead
+	} else if ((dot >= 261 * dots_per_scanline + 1) && (dot < 261 * dots_per_scanline + 338)) {
+		end = 261 * dots_per_scanline + 338; // then the odd frame skip
+	} else {
+		return 0;
+	}
+
+	// sprite 0 hit found while rendering was still on
+	if ((p->l_sl >= 0) && (p->l_sl <= 261)) {
+		unsigned hit = p->l_sl * dots_per_scanline + p->l_cl;
+		if ((hit > dot) && (hit <= end)) {
+			end = hit - 1;
+		}
+	}
+
+	// events are run on the dot the master clock reaches them
+	if (io->events.next <= io->events.now) {
+		return 0;
+	}
+	uint64_t until_event = io->events.next - io->events.now;
+	if (end - dot >= until_event) {
+		end = dot + until_event - 1;
+	}
+
+	return end - dot;
+}
+
+/* count backdrop pixels from x_pos, the shift registers move on as
+ * get_bkg_pixel() would, the sprites are left to sprite_line
+ */
+static void skip_backdrop_pixels(Ppu2C02* p, unsigned x_pos, unsigned count)
+{
+	uint8_t colour = read_from_ppu_vram(&p->vram, 0x3F00);
+	if (ppu_show_greyscale(p->cpu_ppu_io)) { colour &= 0x30; }
+	for (unsigned x = x_pos; x < x_pos + count; x++) {
+		set_rgba_pixel_in_buffer(p->pixels, 256, x - 1, p->scanline, palette[colour], 0xFF);
+	}
+
+	struct BackgroundRenderingInternals* bkg = &p->bkg_internals;
+	bkg->pt_hi_shift_reg = (count < 16) ? bkg->pt_hi_shift_reg >> count : 0;
+	bkg->pt_lo_shift_reg = (count < 16) ? bkg->pt_lo_shift_reg >> count : 0;
+	bkg->at_hi_shift_reg = (count < 8) ? bkg->at_hi_shift_reg >> count : 0;
+	bkg->at_lo_shift_reg = (count < 8) ? bkg->at_lo_shift_reg >> count : 0;
+
+	ensure_sprite_line(p, x_pos);
+}
+
+void ppu_skip_idle_dots(Ppu2C02* p, unsigned dots)
+{
+	if (!dots) {
+		return;
+	}
+	const unsigned dots_per_scanline = 341;
+	unsigned dot = p->scanline * dots_per_scanline + p->cycle;
+	unsigned end = dot + dots; // spans never cross the end of the frame
+
+	p->cpu_ppu_io->nmi_lookahead = false;
+	p->cpu_ppu_io->clear_status = false;
+	p->cpu_ppu_io->events.now += dots;
+
+	// pixels are only output while rendering is off, VBlank has none
+	for (unsigned scanline = dot / dots_per_scanline; scanline <= 239 && scanline <= end / dots_per_scanline; scanline++) {
+		unsigned first = (scanline == dot / dots_per_scanline) ? (dot % dots_per_scanline) + 1 : 1;
+		unsigned last = (scanline == end / dots_per_scanline) ? end % dots_per_scanline : 256;
+		if (last > 256) {
+			last = 256;
+		}
+		if (first > last) {
+			continue;
+		}
+		// the last pixel goes through the pipeline, it leaves current_pixel as it should be
+		p->scanline = scanline;
+		skip_backdrop_pixels(p, first, last - first);
+		p->cycle = last;
+		output_pixel(p);
+	}
+
+	p->scanline = end / dots_per_scanline;
+	p->cycle = end % dots_per_scanline;
+	if ((p->scanline == 261) || (p->scanline <= 239)) {
+		p->cpu_ppu_io->ppu_rendering_period = true;
+	} else if (p->scanline == 240) {
+		p->cpu_ppu_io->ppu_rendering_period = false;
+	}
+}
+
+/* Schedules the start of VBlank (dot 0 of the NMI scanline) if it is still to
+ * come this frame, the odd frame skip happens after it so the distance is fixed
+ */
+static void schedule_vblank(Ppu2C02* p)
+{
+	EventQueue* events = &p->cpu_ppu_io->events;
+	unsigned dot = p->scanline * 341 + p->cycle;
+	unsigned vblank_dot = p->nmi_start * 341;
+
+	if (dot < vblank_dot) {
+		events_schedule(events, EVENT_VBLANK, events->now + vblank_dot - dot);
+	}
+}
+
+static void run_ppu_events(Ppu2C02* p, Cpu6502* cpu)
+{
+	CpuPpuShare* io = p->cpu_ppu_io;
+	int event;
+
+	while ((event = events_pop(&io->events, io->events.now, PPU_EVENTS)) >= 0) {
+		switch (event) {
+		case EVENT_PPU_MASK_EARLY:
+			// buffering a write to enable/disable bg rendering sets a flag
+			if (io->buffer_value & 0x08) {
+				io->bg_early_enable_mask = true;
+			} else {
+				io->bg_early_disable_mask = true;
+			}
+			break;
+		case EVENT_PPU_WRITE:
+			write_ppu_reg(io->buffer_address, io->buffer_value, cpu);
+			// clear flags about buffered writes to enable/disable bg rendering
+			io->bg_early_enable_mask = false;
+			io->bg_early_disable_mask = false;
+			break;
+		case EVENT_VBLANK:
+			set_ppu_status_vblank_bit(io); // In VBlank
+			io->nmi_lookahead = true;
+			io->clear_status = true;
+			events_schedule(&io->events, EVENT_NMI, io->events.now + 1);
+			break;
+		case EVENT_NMI:
+			if (ppu_ctrl_gen_nmi_bit_set(io)) {
+				io->nmi_pending = true;
+				io->nmi_lookahead = true; // nmi is delayed
+			}
+			break;
+		}
+	}
+}
+
+/***************************
+ * DOT ACTIONS             *
+ * *************************/
+enum ScanlineClass {
+	SCANLINE_VISIBLE,     // 0-239
+	SCANLINE_POST_RENDER, // 240
+	SCANLINE_VBLANK,      // 241-260
+	SCANLINE_PRE_RENDER,  // 261
+	SCANLINE_CLASSES
+};
+
+static inline enum ScanlineClass scanline_class(unsigned scanline)
+{
+	if (scanline <= 239) {
+		return SCANLINE_VISIBLE;
+	} else if (scanline == 240) {
+		return SCANLINE_POST_RENDER;
+	} else if (scanline == 261) {
+		return SCANLINE_PRE_RENDER;
+	}
+
+	return SCANLINE_VBLANK;
+}
+
+/* dot_actions[] is worked out at compile time from the dot timing of a
+ * scanline, the same for every ppu. DOT_ACTIONS(sl, cycle) is a constant
+ * expression for one dot, the DOTS_N() macros repeat it along a scanline
+ */
+#define DOT_IN(cycle, first, last) (((cycle) >= (first)) && ((cycle) <= (last)))
+// 8 dots per tile fetch (and per sprite fetch), dot 1 is tile dot 0
+#define TILE_DOT(cycle, n, action) (((((cycle) - 1) & 0x07) == (n)) ? (action) : 0)
+
+// NT, AT and the pattern table bytes take 2 dots each
+#define BG_FETCH_ACTIONS(cycle) (TILE_DOT(cycle, 0, DOT_BG_NT_FETCH) | TILE_DOT(cycle, 2, DOT_BG_AT_FETCH) \
+	| TILE_DOT(cycle, 4, DOT_BG_PT_LO_FETCH) | TILE_DOT(cycle, 6, DOT_BG_PT_HI_FETCH) \
+	| TILE_DOT(cycle, 7, DOT_INC_HORZ) | (((cycle) == 256) ? DOT_INC_VERT : 0))
+
+// 1st 16 pixels of next scanline
+#define BG_PREFETCH_ACTIONS(cycle) (TILE_DOT(cycle, 0, DOT_BG_NT_FETCH) | TILE_DOT(cycle, 1, DOT_BG_AT_FILL) \
+	| TILE_DOT(cycle, 2, DOT_BG_AT_FETCH) | TILE_DOT(cycle, 4, DOT_BG_PT_LO_FETCH) \
+	| TILE_DOT(cycle, 6, DOT_BG_PT_HI_FETCH | DOT_BG_SHIFT_PREFETCH) | TILE_DOT(cycle, 7, DOT_INC_HORZ))
+
+#define BG_ACTIONS(sl, cycle) ((((sl) == SCANLINE_VISIBLE) || ((sl) == SCANLINE_PRE_RENDER)) \
+	? (DOT_IN(cycle, 1, 256) ? BG_FETCH_ACTIONS(cycle) \
+	   : DOT_IN(cycle, 321, 336) ? BG_PREFETCH_ACTIONS(cycle) \
+	   : ((cycle) == 257) ? DOT_HORZ_COPY : 0) \
+	: 0)
+
+#define SPRITE_FETCH_ACTIONS(cycle) (TILE_DOT(cycle, 1, DOT_SPRITE_ADDR) | TILE_DOT(cycle, 2, DOT_SPRITE_AT_FETCH) \
+	| TILE_DOT(cycle, 3, DOT_SPRITE_X_FETCH) | TILE_DOT(cycle, 4, DOT_SPRITE_PT_LO_FETCH) \
+	| TILE_DOT(cycle, 6, DOT_SPRITE_PT_HI_FETCH) | TILE_DOT(cycle, 7, DOT_SPRITE_BLANK))
+
+#define VISIBLE_ACTIONS(cycle) \
+	((DOT_IN(cycle, 1, 256) ? (DOT_PIXEL | DOT_BG_AT_RELOAD | TILE_DOT(cycle, 7, DOT_BG_SHIFT_RELOAD)) : 0) \
+	| (DOT_IN(cycle, 1, 64) ? DOT_SPRITE_OAM_CLEAR \
+	   : DOT_IN(cycle, 65, 256) ? DOT_SPRITE_EVAL \
+	   : DOT_IN(cycle, 257, 320) ? SPRITE_FETCH_ACTIONS(cycle) : 0))
+
+#define POST_RENDER_ACTIONS(cycle) (((cycle) == 0) ? DOT_FRAME_DONE \
+	: ((cycle) == 339) ? DOT_CLEAR_STATUS \
+	: ((cycle) == 340) ? DOT_NMI_LOOKAHEAD : 0)
+
+#define PRE_RENDER_ACTIONS(cycle) (DOT_SPRITE_RESET \
+	| (((cycle) == 0) ? DOT_CLEAR_SPRITE_HIT \
+	   : ((cycle) == 1) ? (DOT_CLEAR_STATUS_FLAGS | DOT_SPRITE_ZERO_RESET) \
+	   : DOT_IN(cycle, 280, 304) ? DOT_VERT_COPY : 0))
+
+#define DOT_ACTIONS(sl, cycle) ((uint32_t) (BG_ACTIONS(sl, cycle) \
+	| (((sl) == SCANLINE_VISIBLE) ? VISIBLE_ACTIONS(cycle) \
+	   : ((sl) == SCANLINE_POST_RENDER) ? POST_RENDER_ACTIONS(cycle) \
+	   : ((sl) == SCANLINE_PRE_RENDER) ? PRE_RENDER_ACTIONS(cycle) : 0)))
+
+#define DOTS_1(sl, c) DOT_ACTIONS(sl, c)
+#define DOTS_2(sl, c) DOTS_1(sl, c), DOTS_1(sl, (c) + 1)
+#define DOTS_4(sl, c) DOTS_2(sl, c), DOTS_2(sl, (c) + 2)
+#define DOTS_8(sl, c) DOTS_4(sl, c), DOTS_4(sl, (c) + 4)
+#define DOTS_16(sl, c) DOTS_8(sl, c), DOTS_8(sl, (c) + 8)
+#define DOTS_32(sl, c) DOTS_16(sl, c), DOTS_16(sl, (c) + 16)
+#define DOTS_64(sl, c) DOTS_32(sl, c), DOTS_32(sl, (c) + 32)
+#define DOTS_128(sl, c) DOTS_64(sl, c), DOTS_64(sl, (c) + 64)
+#define DOTS_256(sl, c) DOTS_128(sl, c), DOTS_128(sl, (c) + 128)
+// dots 0-340
+#define SCANLINE_DOTS(sl) { DOTS_256(sl, 0), DOTS_64(sl, 256), DOTS_16(sl, 320), DOTS_4(sl, 336), DOTS_1(sl, 340) }
+
+static const uint32_t dot_actions[SCANLINE_CLASSES][341] = {
+	SCANLINE_DOTS(SCANLINE_VISIBLE),
+	SCANLINE_DOTS(SCANLINE_POST_RENDER),
+	SCANLINE_DOTS(SCANLINE_VBLANK),
+	SCANLINE_DOTS(SCANLINE_PRE_RENDER),
+};
+
+uint32_t ppu_dot_actions(unsigned scanline, unsigned cycle)
+{
+	return dot_actions[scanline_class(scanline)][cycle];
+}
+
+// Background fetches and shift register loads of a dot, in pipeline order
+static void run_bg_dot(Ppu2C02* p, uint32_t actions)
+{
+	struct BackgroundRenderingInternals* bkg = &p->bkg_internals;
+
+	// reload at shift registers when we move onto a new tile
+	// (the original pixels 9-16 in the pipeline)
+	// e.g. if fine_x == 7 then 1 bit of the first tile is rendered
+	// then we reload the shift reg on cycle 1 w/ new attribute data
+	// for the next tile
+	if ((actions & DOT_BG_AT_RELOAD) && !((p->cycle + p->fine_x) % 8)) {
+		fill_attribute_shift_reg(bkg->nt_addr_current, bkg->at_current, bkg);
+	}
+
+	if (actions & DOT_BG_NT_FETCH) {
+		fetch_nt_byte(&p->vram, p->vram_addr, bkg);
+	} else if (actions & DOT_BG_AT_FILL) {
+		fill_attribute_shift_reg(bkg->nt_addr_current, bkg->at_current, bkg);
+	} else if (actions & DOT_BG_AT_FETCH) {
+		fetch_at_byte(&p->vram, p->vram_addr, bkg);
+	} else if (actions & DOT_BG_PT_LO_FETCH) {
+		fetch_pt_lo(&p->vram, p->vram_addr, ppu_base_pt_address(p->cpu_ppu_io), bkg);
+	} else if (actions & DOT_BG_PT_HI_FETCH) {
+		fetch_pt_hi(&p->vram, p->vram_addr, ppu_base_pt_address(p->cpu_ppu_io), bkg);
+	} else if (actions & DOT_HORZ_COPY) {
+		// Copy horz scroll bits from t
+		p->vram_addr = (p->vram_addr & ~0x041F) | (p->vram_tmp_addr & 0x041F);
+	} else if (actions & DOT_VERT_COPY) {
+		// Copy vert scroll bits from t
+		p->vram_addr = (p->vram_addr & ~0x7BE0) | (p->vram_tmp_addr & 0x7BE0);
+	}
+
+	if (actions & (DOT_BG_SHIFT_RELOAD | DOT_BG_SHIFT_PREFETCH)) {
+		if (actions & DOT_BG_SHIFT_PREFETCH) {
+			bkg->pt_hi_shift_reg >>= 8;
+			bkg->pt_lo_shift_reg >>= 8;
+		}
+		// 8 Shifts should have occured by now, load new data
+		// Load latched values into upper byte of shift regs
+		bkg->pt_lo_shift_reg |= (uint16_t) (bkg->pt_lo_latch << 8);
+		bkg->pt_hi_shift_reg |= (uint16_t) (bkg->pt_hi_latch << 8);
+		// Used to fill at shift registers later
+		bkg->at_current = bkg->at_latch;
+		bkg->nt_addr_current = p->vram_addr;
+	}
+}
+
+// Sprite data fetches, dots 257-320 of the visible scanlines
+static void run_sprite_fetch_dot(Ppu2C02* p, uint32_t actions)
+{
+	unsigned count = sprite_fetch_index(p); // Counts 8 secondary OAM, kept within array bounds
+
+	// Garbage NT and AT bytes - no need to emulate
+	if (actions & DOT_SPRITE_ADDR) {
+		get_sprite_address(p, &p->sprite_y_offset, count);
+	} else if (actions & DOT_SPRITE_AT_FETCH) {
+		p->sprite_at_latches[count] = secondary_oam_at_byte(p, count);
+
+		if (p->sprite_at_latches[count] & 0x80) {
+			// Undo Y offset before flipping sprite
+			p->sprite_addr = p->sprite_addr - p->sprite_y_offset;
+			flip_sprites_vertically(p, p->sprite_y_offset);
+		}
+	} else if (actions & DOT_SPRITE_X_FETCH) {
+		// Read X Pos (In NES it's re-read until the 8th cycle)
+		p->sprite_x_counter[count] = secondary_oam_x_pos(p, count);
+	} else if (actions & DOT_SPRITE_PT_LO_FETCH) {
+		load_sprite_pattern_table_data(p, &p->sprite_pt_lo_shift_reg[0], count, p->sprite_addr);
+	} else if (actions & DOT_SPRITE_PT_HI_FETCH) {
+		load_sprite_pattern_table_data(p, &p->sprite_pt_hi_shift_reg[0], count, p->sprite_addr + 8);
+	} else if ((actions & DOT_SPRITE_BLANK) && (p->sprites_found < 8)) {
+		// Missing sprites should have transparent pixels
+		memset(&p->sprite_pt_lo_shift_reg[p->sprites_found], 0
+		      , sizeof(p->sprite_pt_lo_shift_reg) - p->sprites_found);
+		memset(&p->sprite_pt_hi_shift_reg[p->sprites_found], 0
+		      , sizeof(p->sprite_pt_lo_shift_reg) - p->sprites_found);
+	}
+}
+
 void clock_ppu(Ppu2C02* p, Cpu6502* cpu, Sdl2DisplayOutputs* cnes_windows)
 {
 	p->cpu_ppu_io->nmi_lookahead = false;
 	p->cpu_ppu_io->clear_status = false;
 
+	++p->cpu_ppu_io->events.now;
 	p->cycle++;
 	if (p->cycle > 340) {
 		p->cycle = 0; // Reset cycle count to 0, max val = 340
@@ -1031,6 +1679,7 @@ void clock_ppu(Ppu2C02* p, Cpu6502* cpu, Sdl2DisplayOutputs* cnes_windows)
 		if (p->scanline > 261) {
 			p->scanline = 0; // Reset scanline to 0, max val == 261
 			p->odd_frame = !p->odd_frame;
+			schedule_vblank(p);
 		}
 	}
 
@@ -1041,34 +1690,13 @@ void clock_ppu(Ppu2C02* p, Cpu6502* cpu, Sdl2DisplayOutputs* cnes_windows)
 		p->cpu_ppu_io->ppu_rendering_period = false;
 	}
 
-	ppu_vblank_warmup_seq(p, cpu);
+	ppu_vblank_warmup_seq(p);
 
 	// cpu is clocked first, ppu must be updated after the ppu runs its clock
 	// as the ppu is supposed to be running at the same time the write to the ppu reg occurs
-	// this means a buffer system needs to be implemented to preserve this behaviour
-	if (p->cpu_ppu_io->buffer_write) {
-		--p->cpu_ppu_io->buffer_counter;
-		// buffering a write to enable bg render sets flag
-		if (p->cpu_ppu_io->buffer_address == 0x2001 && (p->cpu_ppu_io->buffer_value & 0x08)) {
-			if (p->cpu_ppu_io->buffer_counter == 3) {
-				cpu->cpu_ppu_io->bg_early_enable_mask = true;
-			}
-		}
-
-		// buffering a write to disable bg render sets flag
-		if (p->cpu_ppu_io->buffer_address == 0x2001 && !(p->cpu_ppu_io->buffer_value & 0x08)) {
-			if (p->cpu_ppu_io->buffer_counter == 3) {
-				cpu->cpu_ppu_io->bg_early_disable_mask = true;
-			}
-		}
-		if (!p->cpu_ppu_io->buffer_counter) {
-			write_ppu_reg(p->cpu_ppu_io->buffer_address, p->cpu_ppu_io->buffer_value, cpu);
-			p->cpu_ppu_io->buffer_write = false;
-			p->cpu_ppu_io->buffer_counter = 6; // reset to non-zero value
-			// clear flags about buffered writes to enable/disable bg rendering
-			cpu->cpu_ppu_io->bg_early_enable_mask = false;
-			cpu->cpu_ppu_io->bg_early_disable_mask = false;
-		}
+	// this means writes are buffered (scheduled a few dots later), see delay_write_ppu_reg()
+	if (events_due(&p->cpu_ppu_io->events, p->cpu_ppu_io->events.now)) {
+		run_ppu_events(p, cpu);
 	}
 
 	// odd frame skip
@@ -1080,18 +1708,13 @@ void clock_ppu(Ppu2C02* p, Cpu6502* cpu, Sdl2DisplayOutputs* cnes_windows)
 	}
 
 
+	uint32_t actions = dot_actions[scanline_class(p->scanline)][p->cycle];
+
 	/* NMI, VBlank and ppu_status register handling */
+	// VBlank is set and the NMI raised by EVENT_VBLANK/EVENT_NMI
 	if (p->scanline == p->nmi_start) {
-		if (p->cycle == 0) {
-			set_ppu_status_vblank_bit(p->cpu_ppu_io); // In VBlank
-			p->cpu_ppu_io->nmi_lookahead = true;
-			p->cpu_ppu_io->clear_status = true;
-		}
 		if (ppu_ctrl_gen_nmi_bit_set(p->cpu_ppu_io)) {
-			if (p->cycle == 1) {
-				p->cpu_ppu_io->nmi_pending = true;
-				p->cpu_ppu_io->nmi_lookahead = true; // nmi is delayed
-			} else if (p->cycle == 2) {
+			if (p->cycle == 2) {
 				p->cpu_ppu_io->nmi_lookahead = true;
 			}
 			if (p->cpu_ppu_io->suppress_nmi_flag
@@ -1114,251 +1737,69 @@ void clock_ppu(Ppu2C02* p, Cpu6502* cpu, Sdl2DisplayOutputs* cnes_windows)
 
 		// clear VBlank flag if cpu clock is aligned w/ the ppu clock
 		// hard coded for NTSC currently
-		if (p->cpu_ppu_io->suppress_nmi_flag && (cpu->cycle % 3 == 0)) {
+		if (p->cpu_ppu_io->suppress_nmi_flag && (ppu_cpu_cycle(p) % 3 == 0)) {
 			clear_ppu_status_vblank_bit(p->cpu_ppu_io);
 		}
-	} else if (p->scanline == 261 && p->cycle == 0) { // Pre-render scanline
-		p->cpu_ppu_io->ppu_status &= ~0x40;
-	} else if (p->scanline == 261 && p->cycle == 1) { // Pre-render scanline
-		// Clear VBlank, sprite hit and sprite overflow flags
-		p->cpu_ppu_io->ppu_status &= ~0xE0;
-	} else if (p->scanline == 240 && p->cycle == 340) {
-		p->cpu_ppu_io->nmi_lookahead = true;
-	} else if (p->scanline == 240 && (p->cycle == 339 || p->cycle == 340)) {
-		p->cpu_ppu_io->clear_status = true;
+	} else if (actions & DOT_STATUS_ACTIONS) {
+		if (actions & DOT_CLEAR_SPRITE_HIT) {
+			p->cpu_ppu_io->ppu_status &= ~0x40;
+		} else if (actions & DOT_CLEAR_STATUS_FLAGS) {
+			// Clear VBlank, sprite hit and sprite overflow flags
+			p->cpu_ppu_io->ppu_status &= ~0xE0;
+		} else if (actions & DOT_NMI_LOOKAHEAD) {
+			p->cpu_ppu_io->nmi_lookahead = true;
+		} else {
+			p->cpu_ppu_io->clear_status = true;
+		}
 	}
 
 
 	p->cpu_ppu_io->suppress_nmi_flag = false;
 
 
-	if (ppu_show_bg(p->cpu_ppu_io) || ppu_show_sprite(p->cpu_ppu_io)) {
-		// Sprites are evaluated for either BG or sprite rendering
-		if (p->scanline <= 239) { // Visible scanlines
-			if (p->cycle > 64 && p->cycle <= 256) {
-				sprite_evaluation(p);
-			}
-		}
+	// Sprites are evaluated for either BG or sprite rendering
+	if ((actions & DOT_SPRITE_EVAL)
+	    && (ppu_show_bg(p->cpu_ppu_io) || ppu_show_sprite(p->cpu_ppu_io))) {
+		sprite_evaluation(p);
 	}
 
 	// Fill pixel buffer and then render frame
-	if (p->scanline <= 239) { // Visible scanlines
-		if (p->cycle <= 256 && (p->cycle != 0)) { // 0 is an idle cycle
-			get_bkg_pixel(p, &p->current_pixel.bkg_col);
-			get_sprite_pixel(p, &p->current_pixel.sprite_col);
-			get_pixel(&p->current_pixel, sprite_is_front_priority(p, p->current_pixel.scanline_sprite));
-			set_rgba_pixel_in_buffer(pixels, 256, p->cycle - 1, p->scanline, palette[p->current_pixel.output_col], 0xFF);
+	if (actions & DOT_PIXEL) {
+		if ((p->cycle == 1) && bg_scanline_unobserved(p)) {
+			render_bg_scanline(p);
+		}
+		output_pixel(p);
+		if (p->bg_line_ready) { // BG work already done
+			actions &= ~(DOT_BG_ACTIONS | DOT_INC_HORZ | DOT_INC_VERT);
+			p->bg_line_ready = (p->cycle != 256);
 		}
-	} else if (p->scanline == 240 && p->cycle == 0) {
-		draw_pixels(pixels, DEFAULT_WIDTH, cnes_windows->cnes_main);  // Render frame
+	} else if (actions & DOT_FRAME_DONE) {
+		draw_pixels(p->pixels, DEFAULT_WIDTH, cnes_windows->cnes_main);  // Render frame
 
 #ifdef __DEBUG__
 		// The for loop is expensive don't execute if necessary
 		if (cnes_windows->cnes_nt_viewer->window) {
 			all_nametables_fill_pixel_buffer(p);
 		}
-		draw_pixels(nt_pixels, DEFAULT_WIDTH * 2, cnes_windows->cnes_nt_viewer);  // Render frame
+		draw_pixels(p->nt_pixels, DEFAULT_WIDTH * 2, cnes_windows->cnes_nt_viewer);  // Render frame
 #endif /*__DEBUG__ */
 	}
 
-	/* Process BG Scanlines */
-	if (ppu_show_bg(p->cpu_ppu_io)) {
-		if (p->scanline <= 239) { // Visible scanlines
-			if (p->cycle <= 256 && (p->cycle != 0)) { // 0 is an idle cycle
-				// reload at shift registers when we move onto a new tile
-				// (the original pixels 9-16 in the pipeline)
-				// e.g. if fine_x == 7 then 1 bit of the first tile is rendered
-				// then we reload the shift reg on cycle 1 w/ new attribute data
-				// for the next tile
-				if (!((p->cycle + p->fine_x) % 8)) {
-					fill_attribute_shift_reg(p->bkg_internals.nt_addr_current
-					                        , p->bkg_internals.at_current
-					                        , &p->bkg_internals);
-				}
-				// BG STUFF
-				switch ((p->cycle - 1) & 0x07) {
-				case 0: // Cycle 1, 2 (and + 8)
-					fetch_nt_byte(&p->vram, p->vram_addr, &p->bkg_internals);
-					break;
-				case 2: // Cycle 3, 4 (and + 8)
-					fetch_at_byte(&p->vram, p->vram_addr, &p->bkg_internals);
-					break;
-				case 4: // Cycle 5, 6 (and + 8)
-					fetch_pt_lo(&p->vram, p->vram_addr, ppu_base_pt_address(p->cpu_ppu_io)
-					           , &p->bkg_internals);
-					break;
-				case 6: // Cycle 7 (and + 8)
-					fetch_pt_hi(&p->vram, p->vram_addr, ppu_base_pt_address(p->cpu_ppu_io)
-					           , &p->bkg_internals);
-					break;
-				case 7: // Cycle 8 (and +8)
-					// 8 Shifts should have occured by now, load new data
-					// Load latched values into upper byte of shift regs
-					p->bkg_internals.pt_lo_shift_reg |= (uint16_t) (p->bkg_internals.pt_lo_latch << 8);
-					p->bkg_internals.pt_hi_shift_reg |= (uint16_t) (p->bkg_internals.pt_hi_latch << 8);
-					// Used to fill at shift registers later
-					p->bkg_internals.at_current = p->bkg_internals.at_latch;
-					p->bkg_internals.nt_addr_current = p->vram_addr;
-					break;
-				}
-			} else if (p->cycle == 257) {
-				// Copy horz scroll bits from t
-				p->vram_addr = (p->vram_addr & ~0x041F) | (p->vram_tmp_addr & 0x041F);
-			} else if (p->cycle >= 321 && p->cycle <= 336) { // 1st 16 pixels of next scanline
-				switch ((p->cycle - 1) & 0x07) {
-				case 0: // Cycle 321 (and + 8)
-					fetch_nt_byte(&p->vram, p->vram_addr, &p->bkg_internals);
-					break;
-				case 1: // Cycle 322 (and +8)
-					fill_attribute_shift_reg(p->bkg_internals.nt_addr_current
-					                        , p->bkg_internals.at_current
-					                        , &p->bkg_internals);
-					break;
-				case 2: // Cycle 323, 324 (and +8)
-					fetch_at_byte(&p->vram, p->vram_addr, &p->bkg_internals);
-					break;
-				case 4: // Cycle 325, 326 (and +8)
-					fetch_pt_lo(&p->vram, p->vram_addr, ppu_base_pt_address(p->cpu_ppu_io)
-					           , &p->bkg_internals);
-					break;
-				case 6: // Cycle 327 (and +8)
-					fetch_pt_hi(&p->vram, p->vram_addr, ppu_base_pt_address(p->cpu_ppu_io)
-					           , &p->bkg_internals);
-					// Load latched values into upper byte of shift regs
-					p->bkg_internals.pt_hi_shift_reg >>= 8;
-					p->bkg_internals.pt_lo_shift_reg >>= 8;
-					p->bkg_internals.pt_hi_shift_reg |= (uint16_t) (p->bkg_internals.pt_hi_latch << 8);
-					p->bkg_internals.pt_lo_shift_reg |= (uint16_t) (p->bkg_internals.pt_lo_latch << 8);
-					// Used to fill at shift registers later
-					p->bkg_internals.at_current = p->bkg_internals.at_latch;
-					p->bkg_internals.nt_addr_current = p->vram_addr;
-					break;
-				case 7: // Cycle 328 (and +8)
-					break;
-				}
-			}
-		} else if (p->scanline == 261) {
-			// Pre-render scanline
-			if (p->cycle <= 256 && (p->cycle != 0)) { // 0 is an idle cycle
-				switch ((p->cycle - 1) & 0x07) {
-				case 0: // Cycle 256, 257 (and +8)
-					fetch_nt_byte(&p->vram, p->vram_addr, &p->bkg_internals);
-					break;
-				case 2: // Cycle 258, 259 (and +8)
-					fetch_at_byte(&p->vram, p->vram_addr, &p->bkg_internals);
-					break;
-				case 4: // Cycle 260, 261 (and +8)
-					fetch_pt_lo(&p->vram, p->vram_addr, ppu_base_pt_address(p->cpu_ppu_io)
-					           , &p->bkg_internals);
-					break;
-				case 6: // Cycle 262 (and +8)
-					fetch_pt_hi(&p->vram, p->vram_addr, ppu_base_pt_address(p->cpu_ppu_io)
-					           , &p->bkg_internals);
-					break;
-				case 7: // Cycle 263 (and +8)
-					// No need to fill shift registers as nothing is being rendered here
-					break;
-				}
-			} else if (p->cycle == 257) {
-				// Copy horz scroll bits from t
-				p->vram_addr = (p->vram_addr & ~0x041F) | (p->vram_tmp_addr & 0x041F);
-			} else if (p->cycle >= 280 && p->cycle <= 304) {
-				// Copy horz scroll bits from t
-				p->vram_addr = (p->vram_addr & ~0x7BE0) | (p->vram_tmp_addr & 0x7BE0);
-			} else if (p->cycle >= 321 && p->cycle <= 336) { // 1st 16 pixels of next scanline
-				switch ((p->cycle - 1) & 0x07) {
-				case 0: // Cycle 321 (and + 8)
-					fetch_nt_byte(&p->vram, p->vram_addr, &p->bkg_internals);
-					break;
-				case 1: // Cycle 322 (and +8)
-					fill_attribute_shift_reg(p->bkg_internals.nt_addr_current
-					                        , p->bkg_internals.at_current
-					                        , &p->bkg_internals);
-					break;
-				case 2: // Cycle 323, 324 (and +8)
-					fetch_at_byte(&p->vram, p->vram_addr, &p->bkg_internals);
-					break;
-				case 4: // Cycle 325, 326 (and +8)
-					fetch_pt_lo(&p->vram, p->vram_addr, ppu_base_pt_address(p->cpu_ppu_io)
-					           , &p->bkg_internals);
-					break;
-				case 6: // Cycle 327 (and +8)
-					fetch_pt_hi(&p->vram, p->vram_addr, ppu_base_pt_address(p->cpu_ppu_io)
-					           , &p->bkg_internals);
-					// Load latched values into upper byte of shift regs
-					p->bkg_internals.pt_hi_shift_reg >>= 8;
-					p->bkg_internals.pt_lo_shift_reg >>= 8;
-					p->bkg_internals.pt_hi_shift_reg |= (uint16_t) (p->bkg_internals.pt_hi_latch << 8);
-					p->bkg_internals.pt_lo_shift_reg |= (uint16_t) (p->bkg_internals.pt_lo_latch << 8);
-					// Used to fill at shift registers later
-					p->bkg_internals.at_current = p->bkg_internals.at_latch;
-					p->bkg_internals.nt_addr_current = p->vram_addr;
-					break;
-				case 7: // Cycle 328 (and +8)
-					break;
-				}
-			}
-		}
+	if ((actions & DOT_BG_ACTIONS) && ppu_show_bg(p->cpu_ppu_io)) {
+		run_bg_dot(p, actions);
 	}
 
 	/* Process Sprites */
 	if (ppu_show_sprite(p->cpu_ppu_io)) {
-		if (p->scanline <= 239) { // Visible scanlines
-			if (p->cycle <= 64 && (p->cycle != 0)) {
-				reset_secondary_oam(p);
-			} else if (p->cycle > 256 && p->cycle <= 320) { // Sprite data fetches
-				static unsigned count = 0; // Counts 8 secondary OAM
-				count = sprite_fetch_index(p); // keep count within array bounds
-				static int sprite_y_offset = 0;
-				switch ((p->cycle - 1) & 0x07) {
-				case 0:
-					// Garbage NT byte - no need to emulate
-					break;
-				case 1:
-					get_sprite_address(p, &sprite_y_offset, count);
-					break;
-				case 2:
-					// Garbage AT byte - no need to emulate
-					p->sprite_at_latches[count] = secondary_oam_at_byte(p, count);
-
-					if (p->sprite_at_latches[count] & 0x80) {
-						// Undo Y offset before flipping sprite
-						p->sprite_addr = p->sprite_addr - sprite_y_offset;
-						flip_sprites_vertically(p, sprite_y_offset);
-					}
-					break;
-				case 3:
-					// Read X Pos (In NES it's re-read until the 8th cycle)
-					p->sprite_x_counter[count] = secondary_oam_x_pos(p, count);
-					break;
-				case 4:
-					// Fetch sprite lo pattern table
-					load_sprite_pattern_table_data(p, &p->sprite_pt_lo_shift_reg[0], count
-					                              , p->sprite_addr);
-					break;
-				case 6:
-					// Fetch sprite hi pattern table
-					load_sprite_pattern_table_data(p, &p->sprite_pt_hi_shift_reg[0], count
-					                              , p->sprite_addr + 8);
-					break;
-				case 7: // 8th Cycle
-					// Missing sprites should have transparent pixels
-					if (p->sprites_found < 8) {
-						memset(&p->sprite_pt_lo_shift_reg[p->sprites_found], 0
-						      , sizeof(p->sprite_pt_lo_shift_reg) - p->sprites_found);
-						memset(&p->sprite_pt_hi_shift_reg[p->sprites_found], 0
-						      , sizeof(p->sprite_pt_lo_shift_reg) - p->sprites_found);
-					}
-					break;
-				}
-			}
-		} else if (p->scanline == 261) { // Pre-render scanline
+		if (actions & DOT_SPRITE_OAM_CLEAR) {
+			reset_secondary_oam(p);
+		} else if (actions & DOT_SPRITE_FETCH_ACTIONS) {
+			run_sprite_fetch_dot(p, actions);
+		} else if (actions & DOT_SPRITE_RESET) {
 			p->sp_frame_hit_lookahead = false;
-			// only bg fetches occur
-	
 			p->sprite_index = 0;
 			// Clear sprite #0 hit data
-			if (p->cycle == 1) {
+			if (actions & DOT_SPRITE_ZERO_RESET) {
 				p->sprite_zero_hit = false;
 				p->sprite_zero_scanline = 600;
 				p->sprite_zero_scanline_tmp = 600;
@@ -1381,19 +1822,13 @@ void clock_ppu(Ppu2C02* p, Cpu6502* cpu, Sdl2DisplayOutputs* cnes_windows)
 	}
 
 	// increment coarse X and Y scrolling pos on visible scanlines and if rendering is enabled
-	if (cpu->cpu_ppu_io->ppu_rendering_period && ppu_mask_bg_or_sprite_enabled(cpu->cpu_ppu_io)) {
-		if (p->cycle <= 256 && (p->cycle != 0)) {
-			if (((p->cycle - 1) & 0x07) == 0x07) { // cycles divisble by 8
-				inc_horz_scroll(p->cpu_ppu_io);
-			} if (p->cycle == 256) {
-				inc_vert_scroll(p->cpu_ppu_io);
-			}
-		} else if (p->cycle >= 321 && p->cycle <= 336) { // 1st 16 pixels of next scanline
-			if (((p->cycle - 1) & 0x07) == 0x07) { // cycles divisble by 8
-				inc_horz_scroll(p->cpu_ppu_io);
-			} if (p->cycle == 256) {
-				inc_vert_scroll(p->cpu_ppu_io);
-			}
+	if ((actions & (DOT_INC_HORZ | DOT_INC_VERT))
+	    && cpu->cpu_ppu_io->ppu_rendering_period && ppu_mask_bg_or_sprite_enabled(cpu->cpu_ppu_io)) {
+		if (actions & DOT_INC_HORZ) {
+			inc_horz_scroll(p->cpu_ppu_io);
+		}
+		if (actions & DOT_INC_VERT) {
+			inc_vert_scroll(p->cpu_ppu_io);
 		}
 	}
 }
@@ -0,0 +1,298 @@
+#include "rewind.h"
+#include "save_state.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Encoded frame: a list of runs, each run is
+ *   u16 count of unchanged bytes (XOR is zero)
+ *   u16 count of changed bytes
+ *   changed bytes XOR'd with the previous frame
+ * A keyframe is the same encoding against an all zero frame. Short gaps of
+ * unchanged bytes are folded into the changed bytes, otherwise a frame with
+ * scattered changes could encode bigger than the state itself.
+ */
+#define RUN_HEADER_SIZE 4U
+#define RUN_MAX_LENGTH 0xFFFFU
+#define MIN_ZERO_RUN RUN_HEADER_SIZE
+
+static size_t max_encoded_size(size_t state_size)
+{
+	// worst case is every run being MIN_ZERO_RUN zeros and a single change
+	return state_size + RUN_HEADER_SIZE * (state_size / MIN_ZERO_RUN + 2);
+}
+
+static inline uint8_t xor_byte(const uint8_t* state, const uint8_t* base, size_t i)
+{
+	return base ? state[i] ^ base[i] : state[i];
+}
+
+static size_t zero_run_length(const uint8_t* state, const uint8_t* base, size_t start, size_t end)
+{
+	size_t i = start;
+	// whole words at a time, frames are mostly unchanged
+	if (base) {
+		while ((end - i) >= sizeof(uint64_t)) {
+			uint64_t a, b;
+			memcpy(&a, &state[i], sizeof(a));
+			memcpy(&b, &base[i], sizeof(b));
+			if (a != b) { break; }
+			i += sizeof(uint64_t);
+		}
+	} else {
+		while ((end - i) >= sizeof(uint64_t)) {
+			uint64_t a;
+			memcpy(&a, &state[i], sizeof(a));
+			if (a) { break; }
+			i += sizeof(uint64_t);
+		}
+	}
+	while (i < end && !xor_byte(state, base, i)) {
+		++i;
+	}
+
+	return i - start;
+}
+
+static void write_u16(uint8_t* out, size_t value)
+{
+	out[0] = value & 0xFF;
+	out[1] = (value >> 8) & 0xFF;
+}
+
+static size_t read_u16(const uint8_t* in)
+{
+	return (size_t) in[0] | ((size_t) in[1] << 8);
+}
+
+/* XOR's state against base (NULL = all zeros) and run length encodes the result */
+static size_t encode_frame(const uint8_t* state, const uint8_t* base, size_t size, uint8_t* out)
+{
+	size_t out_size = 0;
+	size_t i = 0;
+
+	while (i < size) {
+		size_t zeros = zero_run_length(state, base, i, size);
+		if (zeros > RUN_MAX_LENGTH) { zeros = RUN_MAX_LENGTH; }
+		i += zeros;
+
+		// changed bytes, up to the next long enough run of unchanged ones
+		size_t changed_start = i;
+		while (i < size && (i - changed_start) < RUN_MAX_LENGTH) {
+			if (!xor_byte(state, base, i)) {
+				size_t gap = zero_run_length(state, base, i, size);
+				if (gap >= MIN_ZERO_RUN || (i + gap) == size) { break; }
+				i += gap;
+				if ((i - changed_start) > RUN_MAX_LENGTH) { i = changed_start + RUN_MAX_LENGTH; }
+				continue;
+			}
+			++i;
+		}
+		size_t changed = i - changed_start;
+
+		write_u16(&out[out_size], zeros);
+		write_u16(&out[out_size + 2], changed);
+		out_size += RUN_HEADER_SIZE;
+		for (size_t j = 0; j < changed; j++) {
+			out[out_size + j] = xor_byte(state, base, changed_start + j);
+		}
+		out_size += changed;
+	}
+
+	return out_size;
+}
+
+/* XOR's an encoded frame into state */
+static void apply_frame(const uint8_t* in, size_t in_size, uint8_t* state)
+{
+	size_t pos = 0;
+	size_t i = 0;
+
+	while (pos < in_size) {
+		i += read_u16(&in[pos]);
+		size_t changed = read_u16(&in[pos + 2]);
+		pos += RUN_HEADER_SIZE;
+		for (size_t j = 0; j < changed; j++) {
+			state[i + j] ^= in[pos + j];
+		}
+		i += changed;
+		pos += changed;
+	}
+}
+
+static unsigned frame_slot(const RewindBuffer* rb, unsigned index)
+{
+	return (rb->first + index) % rb->max_frames;
+}
+
+static void drop_oldest_frame(RewindBuffer* rb)
+{
+	rb->first = (rb->first + 1) % rb->max_frames;
+	--rb->count;
+	// frames before the oldest keyframe can't be decoded
+	while (rb->count && !rb->frames[rb->first].keyframe) {
+		rb->first = (rb->first + 1) % rb->max_frames;
+		--rb->count;
+	}
+}
+
+/* Finds space for an encoded frame, dropping the oldest frames it overwrites */
+static size_t reserve_frame(RewindBuffer* rb, size_t size)
+{
+	if ((rb->write_pos + size) > rb->data_size) {
+		rb->write_pos = 0;
+	}
+	size_t start = rb->write_pos;
+	size_t end = start + size;
+
+	while (rb->count) {
+		const struct RewindFrame* oldest = &rb->frames[rb->first];
+		bool overlaps = (oldest->offset < end) && (start < (oldest->offset + oldest->size));
+		if (!overlaps && rb->count < rb->max_frames) {
+			break;
+		}
+		drop_oldest_frame(rb);
+	}
+	rb->write_pos = end;
+
+	return start;
+}
+
+RewindBuffer* rewind_buffer_allocator(void)
+{
+	RewindBuffer* rb = calloc(1, sizeof(RewindBuffer));
+	if (!rb) {
+		fprintf(stderr, "Failed to allocate enough memory for RewindBuffer\n");
+	}
+
+	return rb;
+}
+
+int rewind_buffer_init(RewindBuffer* rb, const Nes* nes, size_t memory_budget
+                      , unsigned max_frames, unsigned keyframe_interval)
+{
+	rb->state_size = nes_save_state_size(nes);
+	rb->encode_buffer_size = max_encoded_size(rb->state_size);
+	if (!max_frames || !keyframe_interval || memory_budget < rb->encode_buffer_size) {
+		fprintf(stderr, "Rewind buffer needs at least %zu bytes and one frame\n", rb->encode_buffer_size);
+		return -1;
+	}
+
+	rb->data = malloc(memory_budget);
+	rb->frames = calloc(max_frames, sizeof(struct RewindFrame));
+	rb->head_state = malloc(rb->state_size);
+	rb->work_state = malloc(rb->state_size);
+	rb->encode_buffer = malloc(rb->encode_buffer_size);
+	if (!rb->data || !rb->frames || !rb->head_state || !rb->work_state || !rb->encode_buffer) {
+		fprintf(stderr, "Failed to allocate enough memory for the rewind buffer\n");
+		return -1;
+	}
+
+	rb->data_size = memory_budget;
+	rb->write_pos = 0;
+	rb->max_frames = max_frames;
+	rb->first = 0;
+	rb->count = 0;
+	rb->keyframe_interval = keyframe_interval;
+	rb->since_keyframe = 0;
+
+	return 0;
+}
+
+int rewind_buffer_push(RewindBuffer* rb, const Nes* nes)
+{
+	if (nes_save_state(nes, rb->work_state, rb->state_size) != rb->state_size) {
+		return -1;
+	}
+
+	bool keyframe = !rb->count || (rb->since_keyframe + 1) >= rb->keyframe_interval;
+	size_t size = encode_frame(rb->work_state, keyframe ? NULL : rb->head_state
+	                          , rb->state_size, rb->encode_buffer);
+
+	size_t offset = reserve_frame(rb, size);
+	if (!keyframe && !rb->count) {
+		// the previous frame was dropped to make room, store a keyframe instead
+		keyframe = true;
+		size = encode_frame(rb->work_state, NULL, rb->state_size, rb->encode_buffer);
+		rb->write_pos = 0;
+		offset = reserve_frame(rb, size);
+	}
+	memcpy(&rb->data[offset], rb->encode_buffer, size);
+
+	struct RewindFrame* frame = &rb->frames[frame_slot(rb, rb->count)];
+	frame->offset = offset;
+	frame->size = size;
+	frame->keyframe = keyframe;
+	++rb->count;
+	rb->since_keyframe = keyframe ? 0 : rb->since_keyframe + 1;
+
+	uint8_t* tmp = rb->head_state;
+	rb->head_state = rb->work_state;
+	rb->work_state = tmp;
+
+	return 0;
+}
+
+int rewind_buffer_restore(RewindBuffer* rb, Nes* nes, unsigned frames_back)
+{
+	if (!rb->count) {
+		return -1;
+	}
+	if (frames_back >= rb->count) {
+		frames_back = rb->count - 1;
+	}
+
+	unsigned newest = rb->count - 1;
+	unsigned target = newest - frames_back;
+	unsigned keyframe = target;
+	while (!rb->frames[frame_slot(rb, keyframe)].keyframe) {
+		--keyframe; // the oldest frame is always a keyframe
+	}
+
+	// XOR deltas work both ways: step back from the newest frame unless that
+	// crosses a keyframe (which stores no delta) or is slower than going forward
+	// from the keyframe
+	unsigned newest_keyframe = newest - rb->since_keyframe;
+	if (keyframe == newest_keyframe && frames_back <= (target - keyframe + 1)) {
+		for (unsigned i = newest; i > target; i--) {
+			const struct RewindFrame* frame = &rb->frames[frame_slot(rb, i)];
+			apply_frame(&rb->data[frame->offset], frame->size, rb->head_state);
+		}
+	} else {
+		memset(rb->head_state, 0, rb->state_size);
+		for (unsigned i = keyframe; i <= target; i++) {
+			const struct RewindFrame* frame = &rb->frames[frame_slot(rb, i)];
+			apply_frame(&rb->data[frame->offset], frame->size, rb->head_state);
+		}
+	}
+
+	// newer frames are gone, recording carries on from the target
+	const struct RewindFrame* frame = &rb->frames[frame_slot(rb, target)];
+	rb->count = target + 1;
+	rb->write_pos = frame->offset + frame->size;
+	rb->since_keyframe = target - keyframe;
+
+	if (nes_load_state(nes, rb->head_state, rb->state_size)) {
+		return -1;
+	}
+
+	return (int) frames_back;
+}
+
+unsigned rewind_buffer_frame_count(const RewindBuffer* rb)
+{
+	return rb->count;
+}
+
+void rewind_buffer_free(RewindBuffer* rb)
+{
+	if (rb) {
+		free(rb->data);
+		free(rb->frames);
+		free(rb->head_state);
+		free(rb->work_state);
+		free(rb->encode_buffer);
+	}
+	free(rb);
+}
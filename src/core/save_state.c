@@ -0,0 +1,329 @@
+#include "save_state.h"
+#include "nes.h"
+#include "cart.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "cpu_ppu_interface.h"
+#include "cpu_mapper_interface.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// An encoded pointer is (region << 24) | offset, 0 is a NULL pointer
+#define STATE_OFFSET_BITS 24U
+#define STATE_OFFSET_MASK ((1U << STATE_OFFSET_BITS) - 1)
+#define STATE_BAD_POINTER 0xFFFFFFFFU
+
+// framebuffers aren't machine state, they are redrawn every frame (see ppu.h)
+#define PPU_STATE_SIZE offsetof(Ppu2C02, pixels)
+
+enum StateRegions {
+	NULL_REGION,
+	CPU_MEM_REGION,
+	PRG_ROM_REGION,
+	CHR_ROM_REGION,
+	CHR_RAM_REGION,
+	NAMETABLE_A_REGION,
+	NAMETABLE_B_REGION,
+	REGION_COUNT
+};
+
+struct StateRegion {
+	uint8_t* base;
+	size_t size;
+};
+
+struct SaveStateHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t total_size;
+
+	// Layout checks, a state from a different build or cart is rejected
+	uint32_t cpu_size;
+	uint32_t ppu_size;
+	uint32_t cpu_ppu_size;
+	uint32_t cpu_mapper_size;
+	uint32_t mapper_number;
+	uint32_t prg_rom_size;
+	uint32_t chr_rom_size;
+	uint32_t chr_ram_size;
+};
+
+// Pointers held by the cpu and ppu that point into emulated memory
+struct SaveStatePointers {
+	uint32_t read_page[CPU_PAGE_COUNT];
+	uint32_t write_page[CPU_PAGE_COUNT];
+	uint32_t pattern_table_0k;
+	uint32_t pattern_table_4k;
+	uint32_t nametable[4];
+};
+
+static const char state_magic[4] = {'C', 'N', 'S', 'S'};
+
+
+static void get_state_regions(const Nes* nes, struct StateRegion* regions)
+{
+	regions[NULL_REGION] = (struct StateRegion) {NULL, 0};
+	regions[CPU_MEM_REGION] = (struct StateRegion) {nes->cpu->mem, CPU_MEMORY_SIZE};
+	regions[PRG_ROM_REGION] = (struct StateRegion) {nes->cart->prg_rom.data, nes->cart->prg_rom.size};
+	regions[CHR_ROM_REGION] = (struct StateRegion) {nes->cart->chr_rom.data, nes->cart->chr_rom.size};
+	regions[CHR_RAM_REGION] = (struct StateRegion) {nes->cart->chr_ram.data, nes->cart->chr_ram.size};
+	regions[NAMETABLE_A_REGION] = (struct StateRegion) {nes->ppu->vram.nametable_A, sizeof(nes->ppu->vram.nametable_A)};
+	regions[NAMETABLE_B_REGION] = (struct StateRegion) {nes->ppu->vram.nametable_B, sizeof(nes->ppu->vram.nametable_B)};
+}
+
+static uint32_t encode_pointer(const uint8_t* ptr, const struct StateRegion* regions)
+{
+	if (!ptr) {
+		return 0;
+	}
+
+	for (unsigned r = NULL_REGION + 1; r < REGION_COUNT; r++) {
+		if (regions[r].base && (ptr >= regions[r].base) && (ptr < regions[r].base + regions[r].size)) {
+			size_t offset = ptr - regions[r].base;
+			if (offset > STATE_OFFSET_MASK) {
+				break;
+			}
+			return (r << STATE_OFFSET_BITS) | offset;
+		}
+	}
+
+	return STATE_BAD_POINTER;
+}
+
+// Returns false if the encoded pointer doesn't fit in this console's memory
+static bool decode_pointer(uint32_t encoded, const struct StateRegion* regions, uint8_t** ptr)
+{
+	unsigned r = encoded >> STATE_OFFSET_BITS;
+	size_t offset = encoded & STATE_OFFSET_MASK;
+
+	if (!encoded) {
+		*ptr = NULL;
+		return true;
+	}
+
+	if ((r >= REGION_COUNT) || !regions[r].base || (offset >= regions[r].size)) {
+		return false;
+	}
+
+	*ptr = regions[r].base + offset;
+	return true;
+}
+
+static void fill_header(const Nes* nes, struct SaveStateHeader* header)
+{
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, state_magic, sizeof(state_magic));
+	header->version = SAVE_STATE_VERSION;
+	header->total_size = nes_save_state_size(nes);
+	header->cpu_size = sizeof(Cpu6502);
+	header->ppu_size = PPU_STATE_SIZE;
+	header->cpu_ppu_size = sizeof(CpuPpuShare);
+	header->cpu_mapper_size = sizeof(CpuMapperShare);
+	header->mapper_number = nes->cpu_mapper->mapper_number;
+	header->prg_rom_size = nes->cart->prg_rom.size;
+	header->chr_rom_size = nes->cart->chr_rom.data ? nes->cart->chr_rom.size : 0;
+	header->chr_ram_size = nes->cart->chr_ram.data ? nes->cart->chr_ram.size : 0;
+}
+
+size_t nes_save_state_size(const Nes* nes)
+{
+	size_t chr_ram_size = nes->cart->chr_ram.data ? nes->cart->chr_ram.size : 0;
+
+	return sizeof(struct SaveStateHeader)
+	     + sizeof(struct SaveStatePointers)
+	     + sizeof(Cpu6502)
+	     + PPU_STATE_SIZE
+	     + sizeof(CpuPpuShare)
+	     + sizeof(CpuMapperShare)
+	     + chr_ram_size;
+}
+
+size_t nes_save_state(const Nes* nes, uint8_t* buffer, size_t buffer_size)
+{
+	struct SaveStateHeader header;
+	struct SaveStatePointers pointers;
+	struct StateRegion regions[REGION_COUNT];
+
+	fill_header(nes, &header);
+	if (buffer_size < header.total_size) {
+		return 0;
+	}
+
+	get_state_regions(nes, regions);
+	for (unsigned page = 0; page < CPU_PAGE_COUNT; page++) {
+		pointers.read_page[page] = encode_pointer(nes->cpu->read_page[page], regions);
+		pointers.write_page[page] = encode_pointer(nes->cpu->write_page[page], regions);
+		if ((pointers.read_page[page] == STATE_BAD_POINTER)
+		   || (pointers.write_page[page] == STATE_BAD_POINTER)) {
+			fprintf(stderr, "Save state failed, cpu page $%.2X isn't mapped to emulated memory\n", page);
+			return 0;
+		}
+	}
+
+	const struct PpuMemoryMap* vram = &nes->ppu->vram;
+	pointers.pattern_table_0k = encode_pointer(vram->pattern_table_0k, regions);
+	pointers.pattern_table_4k = encode_pointer(vram->pattern_table_4k, regions);
+	pointers.nametable[0] = encode_pointer((const uint8_t*) vram->nametable_0, regions);
+	pointers.nametable[1] = encode_pointer((const uint8_t*) vram->nametable_1, regions);
+	pointers.nametable[2] = encode_pointer((const uint8_t*) vram->nametable_2, regions);
+	pointers.nametable[3] = encode_pointer((const uint8_t*) vram->nametable_3, regions);
+	if ((pointers.pattern_table_0k == STATE_BAD_POINTER) || (pointers.pattern_table_4k == STATE_BAD_POINTER)
+	   || (pointers.nametable[0] == STATE_BAD_POINTER) || (pointers.nametable[1] == STATE_BAD_POINTER)
+	   || (pointers.nametable[2] == STATE_BAD_POINTER) || (pointers.nametable[3] == STATE_BAD_POINTER)) {
+		fprintf(stderr, "Save state failed, ppu vram isn't mapped to emulated memory\n");
+		return 0;
+	}
+
+	uint8_t* pos = buffer;
+	memcpy(pos, &header, sizeof(header));
+	pos += sizeof(header);
+	memcpy(pos, &pointers, sizeof(pointers));
+	pos += sizeof(pointers);
+	memcpy(pos, nes->cpu, sizeof(Cpu6502));
+	pos += sizeof(Cpu6502);
+	memcpy(pos, nes->ppu, PPU_STATE_SIZE);
+	pos += PPU_STATE_SIZE;
+	memcpy(pos, nes->cpu_ppu, sizeof(CpuPpuShare));
+	pos += sizeof(CpuPpuShare);
+	memcpy(pos, nes->cpu_mapper, sizeof(CpuMapperShare));
+	pos += sizeof(CpuMapperShare);
+	if (header.chr_ram_size) {
+		memcpy(pos, nes->cart->chr_ram.data, header.chr_ram_size);
+		pos += header.chr_ram_size;
+	}
+
+	return pos - buffer;
+}
+
+/* Raw struct copies overwrite every member, the ones below belong to the
+ * console being loaded into (links between units, I/O handlers, the
+ * instruction stepping attachment and the trace) and are put back afterwards
+ */
+static void load_cpu(Cpu6502* cpu, const uint8_t* saved)
+{
+	CpuPpuShare* cpu_ppu_io = cpu->cpu_ppu_io;
+	CpuMapperShare* cpu_mapper_io = cpu->cpu_mapper_io;
+	Ppu2C02* ppu = cpu->ppu;
+	Sdl2DisplayOutputs* cnes_windows = cpu->cnes_windows;
+	CpuTrace* trace = cpu->trace;
+	BlockCache* block_cache = cpu->block_cache;
+	Jit* jit = cpu->jit;
+	CpuPageRead read_handler[CPU_PAGE_COUNT];
+	CpuPageWrite write_handler[CPU_PAGE_COUNT];
+	memcpy(read_handler, cpu->read_handler, sizeof(read_handler));
+	memcpy(write_handler, cpu->write_handler, sizeof(write_handler));
+
+	memcpy(cpu, saved, sizeof(Cpu6502));
+
+	cpu->cpu_ppu_io = cpu_ppu_io;
+	cpu->cpu_mapper_io = cpu_mapper_io;
+	cpu->ppu = ppu;
+	cpu->cnes_windows = cnes_windows;
+	cpu->trace = trace;
+	cpu_attach_block_cache(cpu, block_cache); // the saved memory map replaced the pages
+	cpu_attach_jit(cpu, jit);
+	memcpy(cpu->read_handler, read_handler, sizeof(read_handler));
+	memcpy(cpu->write_handler, write_handler, sizeof(write_handler));
+}
+
+static void load_ppu(Ppu2C02* ppu, const uint8_t* saved)
+{
+	CpuPpuShare* cpu_ppu_io = ppu->cpu_ppu_io;
+	struct PpuMemoryMap vram = ppu->vram;
+
+	memcpy(ppu, saved, PPU_STATE_SIZE);
+
+	ppu->cpu_ppu_io = cpu_ppu_io;
+	ppu_attach_chr_rows(&ppu->vram, vram.chr_data, vram.chr_size, vram.chr_rows);
+}
+
+static void load_cpu_ppu(CpuPpuShare* cpu_ppu, Ppu2C02* ppu, const uint8_t* saved)
+{
+	memcpy(cpu_ppu, saved, sizeof(CpuPpuShare));
+
+	map_ppu_data_to_cpu_ppu_io(cpu_ppu, ppu);
+}
+
+static void load_cpu_mapper(CpuMapperShare* cpu_mapper, Cartridge* cart, const uint8_t* saved)
+{
+	memcpy(cpu_mapper, saved, sizeof(CpuMapperShare));
+
+	cpu_mapper->prg_rom = &cart->prg_rom;
+	cpu_mapper->prg_ram = &cart->prg_ram;
+	cpu_mapper->chr_rom = &cart->chr_rom;
+	cpu_mapper->chr_ram = &cart->chr_ram;
+}
+
+int nes_load_state(Nes* nes, const uint8_t* buffer, size_t buffer_size)
+{
+	struct SaveStateHeader header;
+	struct SaveStateHeader expected;
+	struct SaveStatePointers pointers;
+	struct StateRegion regions[REGION_COUNT];
+
+	if (buffer_size < sizeof(header)) {
+		return -1;
+	}
+	memcpy(&header, buffer, sizeof(header));
+	fill_header(nes, &expected);
+	if (memcmp(&header, &expected, sizeof(header)) || (buffer_size < header.total_size)) {
+		fprintf(stderr, "Load state failed, state is from another cart or an incompatible build\n");
+		return -1;
+	}
+
+	const uint8_t* pos = buffer + sizeof(header);
+	memcpy(&pointers, pos, sizeof(pointers));
+	pos += sizeof(pointers);
+
+	// decode every pointer before touching the console
+	uint8_t* read_page[CPU_PAGE_COUNT];
+	uint8_t* write_page[CPU_PAGE_COUNT];
+	uint8_t* pattern_table[2];
+	uint8_t* nametable[4];
+	bool valid = true;
+	get_state_regions(nes, regions);
+	for (unsigned page = 0; page < CPU_PAGE_COUNT; page++) {
+		valid &= decode_pointer(pointers.read_page[page], regions, &read_page[page]);
+		valid &= decode_pointer(pointers.write_page[page], regions, &write_page[page]);
+	}
+	valid &= decode_pointer(pointers.pattern_table_0k, regions, &pattern_table[0]);
+	valid &= decode_pointer(pointers.pattern_table_4k, regions, &pattern_table[1]);
+	for (int i = 0; i < 4; i++) {
+		valid &= decode_pointer(pointers.nametable[i], regions, &nametable[i]);
+	}
+	if (!valid) {
+		fprintf(stderr, "Load state failed, state is corrupt\n");
+		return -1;
+	}
+
+	load_cpu(nes->cpu, pos);
+	pos += sizeof(Cpu6502);
+	load_ppu(nes->ppu, pos);
+	pos += PPU_STATE_SIZE;
+	load_cpu_ppu(nes->cpu_ppu, nes->ppu, pos);
+	pos += sizeof(CpuPpuShare);
+	load_cpu_mapper(nes->cpu_mapper, nes->cart, pos);
+	pos += sizeof(CpuMapperShare);
+	if (header.chr_ram_size) {
+		memcpy(nes->cart->chr_ram.data, pos, header.chr_ram_size);
+		if (nes->cart->chr_rows && !nes->cart->chr_rom.size) {
+			ppu_decode_chr(nes->cart->chr_rows, nes->cart->chr_ram.data, header.chr_ram_size);
+		}
+	}
+
+	// re-link the pointers, cpu memory map regions are in this console's cpu/cart
+	memcpy(nes->cpu->read_page, read_page, sizeof(read_page));
+	memcpy(nes->cpu->write_page, write_page, sizeof(write_page));
+	struct PpuMemoryMap* vram = &nes->ppu->vram;
+	vram->pattern_table_0k = pattern_table[0];
+	vram->pattern_table_4k = pattern_table[1];
+	vram->nametable_0 = (uint8_t (*)[0x0400]) nametable[0];
+	vram->nametable_1 = (uint8_t (*)[0x0400]) nametable[1];
+	vram->nametable_2 = (uint8_t (*)[0x0400]) nametable[2];
+	vram->nametable_3 = (uint8_t (*)[0x0400]) nametable[3];
+
+	return 0;
+}
@@ -0,0 +1,229 @@
+#define _POSIX_C_SOURCE 200809L // ftruncate() and mmap()
+
+#include "trace.h"
+#include "cpu.h"
+#include "ppu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+const char trace_file_magic[4] = {'C', 'N', 'T', 'R'};
+
+
+// operand bytes of the instruction being fetched, without the side effects of an I/O read
+static uint8_t peek_cpu(const Cpu6502* cpu, uint16_t addr)
+{
+	const uint8_t* page = cpu->read_page[addr >> 8];
+	return page ? page[addr & 0xFF] : 0;
+}
+
+CpuTrace* cpu_trace_allocator(void)
+{
+	CpuTrace* trace = calloc(1, sizeof(CpuTrace));
+	if (!trace) {
+		fprintf(stderr, "Failed to allocate enough memory for CpuTrace\n");
+	}
+
+	return trace;
+}
+
+int cpu_trace_init(CpuTrace* trace, size_t max_records, const Ppu2C02* ppu)
+{
+	if (!max_records) {
+		fprintf(stderr, "A cpu trace needs room for at least one record\n");
+		return -1;
+	}
+
+	size_t capacity = 1;
+	while (capacity < max_records) {
+		capacity *= 2;
+	}
+	trace->records = malloc(capacity * sizeof(struct TraceRecord));
+	if (!trace->records) {
+		fprintf(stderr, "Failed to allocate enough memory for the cpu trace\n");
+		return -1;
+	}
+
+	trace->max_records = capacity;
+	trace->count = 0;
+	trace->ppu = ppu;
+
+	return 0;
+}
+
+void cpu_trace_record(CpuTrace* trace, const Cpu6502* cpu)
+{
+	struct TraceRecord* record = &trace->records[trace->count & (trace->max_records - 1)];
+	uint16_t pc = cpu->PC;
+
+	record->cpu_cycle = cpu->cycle - 1; // the fetch cycle has already been counted
+	record->pc = pc;
+	record->opcode = cpu->opcode;
+	record->operand_lo = peek_cpu(cpu, pc + 1);
+	record->operand_hi = peek_cpu(cpu, pc + 2);
+	record->A = cpu->A;
+	record->X = cpu->X;
+	record->Y = cpu->Y;
+	record->P = cpu->P;
+	record->SP = cpu->stack;
+	if (trace->ppu) {
+		record->ppu_dot = trace->ppu->cycle;
+		record->scanline = trace->ppu->scanline;
+	} else {
+		record->ppu_dot = 0;
+		record->scanline = 0;
+	}
+	record->reserved[0] = 0;
+	record->reserved[1] = 0;
+	++trace->count;
+}
+
+size_t cpu_trace_count(const CpuTrace* trace)
+{
+	return trace->count < trace->max_records ? (size_t) trace->count : trace->max_records;
+}
+
+const struct TraceRecord* cpu_trace_get(const CpuTrace* trace, size_t index)
+{
+	uint64_t oldest = trace->count - cpu_trace_count(trace);
+	return &trace->records[(oldest + index) & (trace->max_records - 1)];
+}
+
+void cpu_trace_clear(CpuTrace* trace)
+{
+	trace->count = 0;
+}
+
+int cpu_trace_flush(const CpuTrace* trace, const char* filename)
+{
+	size_t record_count = cpu_trace_count(trace);
+	size_t file_size = sizeof(struct TraceFileHeader) + record_count * sizeof(struct TraceRecord);
+
+	int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to create trace file %s\n", filename);
+		return -1;
+	}
+	if (ftruncate(fd, (off_t) file_size)) {
+		fprintf(stderr, "Failed to resize trace file %s\n", filename);
+		close(fd);
+		return -1;
+	}
+	uint8_t* file = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd); // the mapping keeps the file open
+	if (file == MAP_FAILED) {
+		fprintf(stderr, "Failed to map trace file %s\n", filename);
+		return -1;
+	}
+
+	struct TraceFileHeader header = {
+		.version = TRACE_VERSION,
+		.record_size = sizeof(struct TraceRecord),
+		.record_count = record_count,
+	};
+	memcpy(header.magic, trace_file_magic, sizeof(trace_file_magic));
+	memcpy(file, &header, sizeof(header));
+
+	// the ring wraps at most once, copy it out in two pieces
+	struct TraceRecord* out = (struct TraceRecord*) (file + sizeof(header));
+	if (record_count) {
+		size_t first = (size_t) ((trace->count - record_count) & (trace->max_records - 1));
+		size_t head = record_count < (trace->max_records - first) ? record_count : trace->max_records - first;
+		memcpy(out, &trace->records[first], head * sizeof(struct TraceRecord));
+		memcpy(out + head, trace->records, (record_count - head) * sizeof(struct TraceRecord));
+	}
+
+	int ret = 0;
+	if (msync(file, file_size, MS_SYNC)) {
+		fprintf(stderr, "Failed to write trace file %s\n", filename);
+		ret = -1;
+	}
+	munmap(file, file_size);
+
+	return ret;
+}
+
+static void format_operand(const struct TraceRecord* record, AddressMode mode, char* out, size_t size)
+{
+	unsigned addr = record->operand_lo | (record->operand_hi << 8);
+
+	switch (mode) {
+	case ABS:
+		snprintf(out, size, "$%.4X", addr);
+		break;
+	case ABSX:
+		snprintf(out, size, "$%.4X,X", addr);
+		break;
+	case ABSY:
+		snprintf(out, size, "$%.4X,Y", addr);
+		break;
+	case ACC:
+		snprintf(out, size, "A");
+		break;
+	case IMM:
+		snprintf(out, size, "#$%.2X", record->operand_lo);
+		break;
+	case IND:
+		snprintf(out, size, "($%.4X)", addr);
+		break;
+	case INDX:
+		snprintf(out, size, "($%.2X,X)", record->operand_lo);
+		break;
+	case INDY:
+		snprintf(out, size, "($%.2X),Y", record->operand_lo);
+		break;
+	case REL:
+		snprintf(out, size, "$%.4X", (record->pc + 2 + (int8_t) record->operand_lo) & 0xFFFF);
+		break;
+	case ZP:
+		snprintf(out, size, "$%.2X", record->operand_lo);
+		break;
+	case ZPX:
+		snprintf(out, size, "$%.2X,X", record->operand_lo);
+		break;
+	case ZPY:
+		snprintf(out, size, "$%.2X,Y", record->operand_lo);
+		break;
+	default: // IMP, SPECIAL
+		out[0] = '\0';
+		break;
+	}
+}
+
+void cpu_trace_format_record(const struct TraceRecord* record, char* line, size_t size)
+{
+	const struct InstructionDetails* info = &isa_info[record->opcode];
+	unsigned length = cpu_instruction_length(record->opcode);
+
+	char bytes[9];
+	if (length == 3) {
+		sprintf(bytes, "%.2X %.2X %.2X", record->opcode, record->operand_lo, record->operand_hi);
+	} else if (length == 2) {
+		sprintf(bytes, "%.2X %.2X", record->opcode, record->operand_lo);
+	} else {
+		sprintf(bytes, "%.2X", record->opcode);
+	}
+
+	char operand[10];
+	format_operand(record, info->address_mode, operand, sizeof(operand));
+	char disassembly[16];
+	snprintf(disassembly, sizeof(disassembly), "%s%s%s", info->mnemonic[0] ? info->mnemonic : "???"
+	        , operand[0] ? " " : "", operand);
+
+	snprintf(line, size, "%.4X  %-8s  %-32sA:%.2X X:%.2X Y:%.2X P:%.2X SP:%.2X PPU:%3u,%3u CYC:%" PRIu64
+	        , record->pc, bytes, disassembly, record->A, record->X, record->Y, record->P, record->SP
+	        , (unsigned) record->scanline, (unsigned) record->ppu_dot, record->cpu_cycle);
+}
+
+void cpu_trace_free(CpuTrace* trace)
+{
+	if (trace) {
+		free(trace->records);
+	}
+	free(trace);
+}
@@ -0,0 +1,123 @@
+/* cnes-tracedump: prints a binary cpu trace (see trace.h) as nestest style text
+ *
+ * One line per instruction, oldest first, so the output can be diffed
+ * against nestest.log or a trace from another emulator
+ */
+#define _POSIX_C_SOURCE 200809L // mmap()
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+static void tracedump_usuage(const char* program_name)
+{
+	fprintf(stderr, "\nUSAGE: %s [options] TRACE_FILE\n", program_name);
+	fprintf(stderr, "OPTIONS:\n");
+	fprintf(stderr, "\t-h\n\tShows all the possible command-line options\n\n");
+	fprintf(stderr, "\t-n COUNT\n\tOnly print the last COUNT instructions\n\n");
+	fprintf(stderr, "Trace files are written by cnes -t, cnes-headless -t or cnes_trace_flush()\n");
+}
+
+int main(int argc, char** argv)
+{
+	int ret = -1;
+
+	const char* program_name = "cnes-tracedump";
+	unsigned long last_count = 0;
+	bool help = false;
+
+	// process command line arguments
+	while ((argc > 1) && (argv[1][0] == '-')) {
+		// make sure -x isn't the same as -xxxxxxx (where x is any command line option)
+		if (strlen(argv[1]) > 2) {
+			fprintf(stderr, "Command line option must be a single character when using the '-' option\n");
+			help = true;
+			break;
+		}
+
+		switch (argv[1][1]) {
+		case 'h': // h - display help message
+			help = true;
+			break;
+		case 'n': // n - only the newest records
+			if (argc < 3 || (argv[2][0] == '-')) {
+				fprintf(stderr, "Please provide an unsigned integer\n");
+				help = true;
+				break;
+			}
+			--argc;
+			++argv;
+			last_count = strtoul(&argv[1][0], NULL, 10);
+			break;
+		}
+		// increment argv and decrement argc
+		--argc;
+		++argv;
+	}
+
+	if (help || argc != 2) {
+		tracedump_usuage(program_name);
+		goto early_return;
+	}
+	const char* filename = argv[1];
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to open trace file %s\n", filename);
+		goto early_return;
+	}
+	struct stat info;
+	if (fstat(fd, &info) || (size_t) info.st_size < sizeof(struct TraceFileHeader)) {
+		fprintf(stderr, "%s is not a cNES trace\n", filename);
+		close(fd);
+		goto early_return;
+	}
+	size_t file_size = info.st_size;
+	const uint8_t* file = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps the file open
+	if (file == MAP_FAILED) {
+		fprintf(stderr, "Failed to map trace file %s\n", filename);
+		goto early_return;
+	}
+
+	struct TraceFileHeader header;
+	memcpy(&header, file, sizeof(header));
+	if (memcmp(header.magic, trace_file_magic, sizeof(trace_file_magic))) {
+		fprintf(stderr, "%s is not a cNES trace\n", filename);
+		goto unmap_file;
+	}
+	if (header.version != TRACE_VERSION || header.record_size != sizeof(struct TraceRecord)) {
+		fprintf(stderr, "Unsupported trace version %u\n", (unsigned) header.version);
+		goto unmap_file;
+	}
+	if (header.record_count > (file_size - sizeof(header)) / sizeof(struct TraceRecord)) {
+		fprintf(stderr, "Trace file %s is truncated\n", filename);
+		goto unmap_file;
+	}
+
+	const struct TraceRecord* records = (const struct TraceRecord*) (file + sizeof(header));
+	size_t first = 0;
+	if (last_count && last_count < header.record_count) {
+		first = header.record_count - last_count;
+	}
+	char line[TRACE_LINE_SIZE];
+	for (size_t i = first; i < header.record_count; i++) {
+		cpu_trace_format_record(&records[i], line, sizeof(line));
+		puts(line);
+	}
+	ret = 0;
+
+unmap_file:
+	munmap((void*) file, file_size);
+
+early_return:
+	return ret;
+}
@@ -0,0 +1,762 @@
+#include <check.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cnes_tests.h"
+#include "cnes.h"
+#include "nes.h"
+#include "cart.h"
+#include "rewind.h"
+#include "movie.h"
+#include "trace.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "cpu_ppu_interface.h"
+#include "cpu_mapper_interface.h"
+
+#define TEST_ROM_SIZE (16 + 16 * KiB + 8 * KiB)
+#define TEST_MOVIE_FILE "cnes_test_movie.cnm"
+#define TEST_TRACE_FILE "cnes_test_trace.cnt"
+
+Nes* nes;
+uint8_t* test_rom;
+
+/* NROM-128 image, the program strobes the controller and stores
+ * the 8 button bits (lsb of each $4016 read) in $0000-$0007, then
+ * writes a counter to $2007 (walking through vram), forever
+ */
+static void build_test_rom(uint8_t* rom)
+{
+	const uint8_t header[16] = {'N', 'E', 'S', 0x1A, 1, 1};
+	const uint8_t program[] = {
+		0xA9, 0x01,       // C000: LDA #$01
+		0x8D, 0x16, 0x40, // C002: STA $4016
+		0xA9, 0x00,       // C005: LDA #$00
+		0x8D, 0x16, 0x40, // C007: STA $4016
+		0xA2, 0x00,       // C00A: LDX #$00
+		0xAD, 0x16, 0x40, // C00C: LDA $4016
+		0x29, 0x01,       // C00F: AND #$01
+		0x95, 0x00,       // C011: STA $00,X
+		0xE8,             // C013: INX
+		0xE0, 0x08,       // C014: CPX #$08
+		0xD0, 0xF4,       // C016: BNE $C00C
+		0xE6, 0x10,       // C018: INC $10
+		0xA5, 0x10,       // C01A: LDA $10
+		0x8D, 0x07, 0x20, // C01C: STA $2007
+		0x4C, 0x00, 0xC0, // C01F: JMP $C000
+	};
+	uint8_t* prg_rom = &rom[16];
+
+	memset(rom, 0, TEST_ROM_SIZE);
+	memcpy(rom, header, sizeof(header));
+	memcpy(prg_rom, program, sizeof(program));
+	// NMI and reset vectors -> $C000
+	prg_rom[0x3FFA] = 0x00;
+	prg_rom[0x3FFB] = 0xC0;
+	prg_rom[0x3FFC] = 0x00;
+	prg_rom[0x3FFD] = 0xC0;
+}
+
+static void setup(void)
+{
+	nes = cnes_create();
+	test_rom = malloc(TEST_ROM_SIZE);
+	if (!nes || !test_rom) {
+		ck_abort_msg("Failed to create the console");
+	}
+	build_test_rom(test_rom);
+}
+
+static void teardown(void)
+{
+	cnes_destroy(nes);
+	free(test_rom);
+}
+
+START_TEST (load_rom_rejects_bad_header)
+{
+	memcpy(test_rom, "SEN\x1A", 4);
+
+	ck_assert_int_ne(cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE), 0);
+}
+
+START_TEST (load_rom_rejects_truncated_image)
+{
+	test_rom[4] = 2; // header claims 32 KiB of PRG ROM
+
+	ck_assert_int_ne(cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE), 0);
+}
+
+START_TEST (load_rom_resets_cpu)
+{
+	ck_assert_int_eq(cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE), 0);
+	ck_assert_uint_eq(nes->cpu->PC, 0xC000);
+	unsigned power_on_cycle = nes->cpu->cycle;
+
+	// reloading powers the console back on
+	cnes_run_cycles(nes, 1000);
+	ck_assert_int_eq(cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE), 0);
+	ck_assert_uint_eq(nes->cpu->PC, 0xC000);
+	ck_assert_uint_eq(nes->cpu->cycle, power_on_cycle);
+}
+
+START_TEST (run_cycles_advances_cpu_clock)
+{
+	unsigned long cycles[3] = {1, 7, 12345};
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	unsigned start_cycle = nes->cpu->cycle;
+
+	cnes_run_cycles(nes, cycles[_i]);
+
+	ck_assert_uint_eq(nes->cpu->cycle - start_cycle, cycles[_i]);
+}
+
+START_TEST (run_frame_runs_a_whole_frame)
+{
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	cnes_run_frame(nes); // power up starts part way through a frame
+	bool odd_frame = nes->ppu->odd_frame;
+
+	// rendering is disabled so no dot is skipped: 341 * 262 / 3 cpu cycles
+	unsigned long cycles = cnes_run_frame(nes);
+
+	ck_assert_uint_ge(cycles, 29780);
+	ck_assert_uint_le(cycles, 29781);
+	ck_assert(nes->ppu->odd_frame != odd_frame);
+}
+
+START_TEST (run_frame_without_a_rom)
+{
+	// a console with nothing loaded still clocks its ppu
+	bool odd_frame = nes->ppu->odd_frame;
+	cnes_run_frame(nes);
+	ck_assert(nes->ppu->odd_frame != odd_frame);
+
+	unsigned cycle = nes->ppu->cycle;
+	unsigned scanline = nes->ppu->scanline;
+	cnes_run_cycles(nes, 1000);
+	ck_assert(nes->ppu->cycle != cycle || nes->ppu->scanline != scanline);
+}
+
+START_TEST (set_input_is_read_by_cpu)
+{
+	uint8_t buttons[2] = {CNES_BUTTON_A | CNES_BUTTON_START, CNES_BUTTON_RIGHT | CNES_BUTTON_B};
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+
+	cnes_set_input(nes, 0, buttons[_i]);
+	cnes_run_cycles(nes, 1000);
+
+	for (int i = 0; i < 8; i++) {
+		ck_assert_uint_eq(nes->cpu->mem[i], (buttons[_i] >> i) & 0x01);
+	}
+}
+
+START_TEST (consoles_are_independent)
+{
+	Nes* second_nes = cnes_create();
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	cnes_load_rom_from_memory(second_nes, test_rom, TEST_ROM_SIZE);
+
+	cnes_set_input(nes, 0, CNES_BUTTON_UP);
+	cnes_set_input(second_nes, 0, CNES_BUTTON_DOWN);
+	// interleave the two consoles
+	for (int i = 0; i < 100; i++) {
+		cnes_run_cycles(nes, 7);
+		cnes_run_cycles(second_nes, 13);
+	}
+
+	for (int i = 0; i < 8; i++) {
+		ck_assert_uint_eq(nes->cpu->mem[i], (CNES_BUTTON_UP >> i) & 0x01);
+		ck_assert_uint_eq(second_nes->cpu->mem[i], (CNES_BUTTON_DOWN >> i) & 0x01);
+	}
+	ck_assert_ptr_ne(cnes_framebuffer(nes), cnes_framebuffer(second_nes));
+	cnes_destroy(second_nes);
+}
+
+/* Compares the machine state that matters, not the raw structs
+ * (they hold pointers to the console they belong to)
+ */
+static void assert_same_machine_state(const Nes* a, const Nes* b)
+{
+	ck_assert_uint_eq(a->cpu->cycle, b->cpu->cycle);
+	ck_assert_uint_eq(a->cpu->PC, b->cpu->PC);
+	ck_assert_uint_eq(a->cpu->A, b->cpu->A);
+	ck_assert_uint_eq(a->cpu->X, b->cpu->X);
+	ck_assert_uint_eq(a->cpu->Y, b->cpu->Y);
+	ck_assert_uint_eq(a->cpu->P, b->cpu->P);
+	ck_assert_uint_eq(a->cpu->stack, b->cpu->stack);
+	ck_assert_mem_eq(a->cpu->mem, b->cpu->mem, CPU_MEMORY_SIZE);
+	ck_assert_uint_eq(a->ppu->cycle, b->ppu->cycle);
+	ck_assert_uint_eq(a->ppu->scanline, b->ppu->scanline);
+	ck_assert_uint_eq(a->ppu->vram_addr, b->ppu->vram_addr);
+	ck_assert_mem_eq(a->ppu->vram.nametable_A, b->ppu->vram.nametable_A, 0x0400);
+	ck_assert_mem_eq(a->ppu->vram.nametable_B, b->ppu->vram.nametable_B, 0x0400);
+	ck_assert_mem_eq(a->ppu->vram.palette_ram, b->ppu->vram.palette_ram, 0x0020);
+	ck_assert_mem_eq(a->ppu->vram.pattern_table_0k, b->ppu->vram.pattern_table_0k, 4 * KiB);
+	ck_assert_mem_eq(a->ppu->vram.pattern_table_4k, b->ppu->vram.pattern_table_4k, 4 * KiB);
+}
+
+/* The original 3 : 1 loop, with no ppu attached clock_cpu() leaves it alone
+ */
+static void run_lockstep(Nes* console, uint64_t cycles)
+{
+	cpu_attach_ppu(console->cpu, NULL, NULL);
+	for (uint64_t i = 0; i < cycles; i++) {
+		clock_cpu(console->cpu);
+		clock_ppu(console->ppu, console->cpu, &console->cnes_windows);
+		clock_ppu(console->ppu, console->cpu, &console->cnes_windows);
+		clock_ppu(console->ppu, console->cpu, &console->cnes_windows);
+	}
+}
+
+/* NROM-128 image idling the way games do: spins on $2002 until vblank,
+ * then spins on a RAM flag set by the NMI handler three times over and
+ * parks on a JMP to itself
+ */
+static void build_idle_rom(uint8_t* rom)
+{
+	const uint8_t program[] = {
+		0xA9, 0x80,       // C000: LDA #$80
+		0x8D, 0x00, 0x20, // C002: STA $2000
+		0x2C, 0x02, 0x20, // C005: BIT $2002
+		0x10, 0xFB,       // C008: BPL $C005
+		0xA5, 0x10,       // C00A: LDA $10
+		0xF0, 0xFC,       // C00C: BEQ $C00A
+		0xA9, 0x00,       // C00E: LDA #$00
+		0x85, 0x10,       // C010: STA $10
+		0xE6, 0x11,       // C012: INC $11
+		0xA5, 0x11,       // C014: LDA $11
+		0xC9, 0x03,       // C016: CMP #$03
+		0xD0, 0xF0,       // C018: BNE $C00A
+		0x4C, 0x1A, 0xC0, // C01A: JMP $C01A
+		0x00, 0x00, 0x00,
+		0xE6, 0x10,       // C020: INC $10 (NMI)
+		0x40,             // C022: RTI
+	};
+
+	memcpy(&rom[16], program, sizeof(program));
+	rom[16 + 0x3FFA] = 0x20; // NMI -> $C020
+}
+
+START_TEST (step_instruction_skips_idle_loops_exactly)
+{
+	Nes* stepped = cnes_create();
+	build_idle_rom(test_rom);
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	cnes_load_rom_from_memory(stepped, test_rom, TEST_ROM_SIZE);
+
+	unsigned long steps = 0;
+	unsigned long start_cycle = stepped->cpu->cycle;
+	while (stepped->cpu->cycle - start_cycle < 5 * 29781) {
+		cpu_step_instruction(stepped->cpu);
+		cpu_sync_ppu(stepped->cpu);
+		++steps;
+		// the reference is clocked in lockstep to the same cycle
+		run_lockstep(nes, stepped->cpu->cycle - nes->cpu->cycle);
+		ck_assert_uint_eq(nes->cpu->PC, stepped->cpu->PC);
+		ck_assert_uint_eq(nes->cpu->P, stepped->cpu->P);
+		ck_assert_uint_eq(nes->ppu->cycle, stepped->ppu->cycle);
+		ck_assert_uint_eq(nes->ppu->scanline, stepped->ppu->scanline);
+	}
+
+	assert_same_machine_state(nes, stepped);
+	ck_assert_uint_eq(stepped->cpu->mem[0x11], 3);
+	ck_assert_uint_eq(stepped->cpu->PC, 0xC01A);
+	// every spin through a loop would take a step without the fast forward
+	ck_assert_uint_lt(steps, 200);
+	cnes_destroy(stepped);
+}
+
+/* Gives the background something to draw: a mix of tiles, attributes and
+ * palettes with a fine x scroll that doesn't line up with the tiles. Sprites
+ * (from the same $0000 pattern table, flipped and behind the BG) too, sprite
+ * 0 is kept off screen
+ */
+static void fill_background(Nes* console, uint8_t fine_x)
+{
+	Ppu2C02* ppu = console->ppu;
+	for (unsigned i = 0; i < 4 * KiB; i++) {
+		write_to_ppu_vram(&ppu->vram, i, (uint8_t) (i * 37 + (i >> 4))); // keeps the row cache in step
+	}
+	for (unsigned i = 0; i < 0x0400; i++) {
+		ppu->vram.nametable_A[i] = (uint8_t) (i * 7);
+		ppu->vram.nametable_B[i] = (uint8_t) (i * 13 + 1);
+	}
+	for (unsigned i = 0; i < 0x20; i++) {
+		ppu->vram.palette_ram[i] = (uint8_t) ((i * 5) & 0x3F);
+	}
+	for (unsigned i = 0; i < 256; i++) {
+		ppu->oam[i] = (uint8_t) (i * 29 + (i >> 2));
+	}
+	ppu->oam[0] = 0xF0;
+	ppu->fine_x = fine_x;
+}
+
+START_TEST (lazy_ppu_matches_lockstep)
+{
+	Nes* reference = cnes_create();
+	if (_i) {
+		build_idle_rom(test_rom);
+	}
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	cnes_load_rom_from_memory(reference, test_rom, TEST_ROM_SIZE);
+	if (_i >= 2) { // neither program turns rendering on, VBlank is skipped either way
+		nes->cpu_ppu->ppu_mask = (_i == 4) ? 0x18 : 0x1E;
+		reference->cpu_ppu->ppu_mask = nes->cpu_ppu->ppu_mask;
+	}
+	if (_i >= 3) { // whole scanlines of BG are drawn at once
+		fill_background(nes, (_i == 3) ? 3 : 0);
+		fill_background(reference, nes->ppu->fine_x);
+	}
+
+	unsigned long lagging = 0;
+	unsigned long cycles = 5 * 29781;
+	for (unsigned long i = 0; i < cycles; i++) {
+		clock_cpu_and_ppu(nes->cpu);
+		run_lockstep(reference, 1);
+		ck_assert_uint_eq(nes->cpu->PC, reference->cpu->PC);
+		ck_assert_uint_eq(nes->cpu->P, reference->cpu->P);
+		// frontends see the frame end on the same cycle
+		ck_assert_uint_eq(nes->ppu->odd_frame, reference->ppu->odd_frame);
+		if (nes->cpu->ppu_synced_cycle < nes->cpu->cycle) {
+			++lagging;
+		}
+	}
+
+	cpu_sync_ppu(nes->cpu);
+	assert_same_machine_state(nes, reference);
+	ck_assert_mem_eq(nes->ppu->pixels, reference->ppu->pixels, sizeof(nes->ppu->pixels));
+	// the ppu is clocked in bulk, not after every cpu cycle
+	ck_assert_uint_gt(lagging, cycles / 2);
+	if (_i >= 3) {
+		ck_assert(!reference->ppu->bg_line[100]); // only the lazily clocked ppu uses bg_line
+		ck_assert(nes->ppu->bg_line[100]);
+	}
+	cnes_destroy(reference);
+}
+
+/* Moves the console's clocks on as if it had been running that much longer,
+ * a multiple of 6 cycles keeps the cycle parity (OAM DMA) and the cpu/ppu
+ * clock alignment (NMI suppression) the same
+ */
+static void fast_forward_clocks(Nes* console, uint64_t cycles)
+{
+	EventQueue* events = &console->cpu_ppu->events;
+	console->cpu->cycle += cycles;
+	console->cpu->ppu_synced_cycle += cycles;
+	console->cpu->ppu_deadline_cycle += cycles;
+	console->cpu_mapper->mmc1_write_cycle += cycles;
+	events->now += 3 * cycles;
+	for (unsigned i = 0; i < EVENT_COUNT; i++) {
+		if (events_pending(events, i)) {
+			events_schedule(events, i, events->when[i] + 3 * cycles);
+		}
+	}
+}
+
+START_TEST (clocks_run_past_32_bits)
+{
+	Nes* reference = cnes_create();
+	build_idle_rom(test_rom);
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	cnes_load_rom_from_memory(reference, test_rom, TEST_ROM_SIZE);
+	for (int i = 0; i < 3; i++) { // past the power up warm up
+		cnes_run_frame(nes);
+		cnes_run_frame(reference);
+	}
+
+	// a few cycles short of 2^32, then run a few frames over it
+	uint64_t offset = (((1ULL << 32) - nes->cpu->cycle) / 6) * 6;
+	fast_forward_clocks(nes, offset);
+	for (int i = 0; i < 5; i++) {
+		ck_assert_uint_eq(cnes_run_frame(nes), cnes_run_frame(reference));
+		ck_assert_uint_eq(nes->cpu->cycle - offset, reference->cpu->cycle);
+		ck_assert_uint_eq(nes->cpu->PC, reference->cpu->PC);
+		ck_assert_uint_eq(nes->cpu->P, reference->cpu->P);
+		ck_assert_uint_eq(nes->ppu->scanline, reference->ppu->scanline);
+		ck_assert_uint_eq(nes->ppu->cycle, reference->ppu->cycle);
+		ck_assert_mem_eq(nes->cpu->mem, reference->cpu->mem, CPU_MEMORY_SIZE);
+	}
+
+	ck_assert_uint_gt(nes->cpu->cycle, UINT32_MAX);
+	ck_assert_uint_eq(nes->cpu->mem[0x11], 3); // the NMIs kept coming
+	cnes_destroy(reference);
+}
+
+START_TEST (save_state_round_trip)
+{
+	// CHR ROM and CHR RAM carts
+	uint8_t chr_rom_banks[2] = {1, 0};
+	test_rom[5] = chr_rom_banks[_i];
+	Nes* reference = cnes_create();
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	cnes_load_rom_from_memory(reference, test_rom, TEST_ROM_SIZE);
+	cnes_set_input(nes, 0, CNES_BUTTON_SELECT);
+	cnes_set_input(reference, 0, CNES_BUTTON_SELECT);
+	cnes_run_cycles(nes, 12345);
+
+	size_t state_size = cnes_save_state_size(nes);
+	uint8_t* state = malloc(state_size);
+	ck_assert_uint_eq(cnes_save_state(nes, state, state_size), state_size);
+
+	// run on, then rewind into the same console and into another one
+	cnes_run_frame(nes);
+	cnes_run_frame(nes);
+	ck_assert_int_eq(cnes_load_state(nes, state, state_size), 0);
+	ck_assert_int_eq(cnes_load_state(reference, state, state_size), 0);
+	assert_same_machine_state(nes, reference);
+
+	// both carry on identically, the PRG ROM pages point into each console's own cart
+	cnes_run_frame(nes);
+	cnes_run_frame(nes);
+	cnes_run_frame(reference);
+	cnes_run_frame(reference);
+	assert_same_machine_state(nes, reference);
+	// framebuffers aren't saved, but a whole frame has been redrawn since
+	ck_assert_mem_eq(cnes_framebuffer(nes), cnes_framebuffer(reference), CNES_FRAME_WIDTH * CNES_FRAME_HEIGHT * 4);
+	ck_assert_ptr_ne(nes->cpu->read_page[0xC0], reference->cpu->read_page[0xC0]);
+	ck_assert_ptr_eq(reference->cpu->read_page[0xC0], reference->cart->prg_rom.data);
+
+	free(state);
+	cnes_destroy(reference);
+}
+
+START_TEST (save_state_buffer_too_small)
+{
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	size_t state_size = cnes_save_state_size(nes);
+	uint8_t* state = malloc(state_size);
+
+	ck_assert_uint_eq(cnes_save_state(nes, state, state_size - 1), 0);
+	free(state);
+}
+
+START_TEST (load_state_rejects_incompatible_states)
+{
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	size_t state_size = cnes_save_state_size(nes);
+	uint8_t* state = malloc(state_size);
+	cnes_save_state(nes, state, state_size);
+	cnes_run_cycles(nes, 1000);
+	unsigned cycle = nes->cpu->cycle;
+
+	switch (_i) {
+	case 0: // bad magic
+		state[0] = 'X';
+		break;
+	case 1: // newer version
+		state[4] += 1;
+		break;
+	case 2: // different cart (CHR RAM instead of CHR ROM)
+		test_rom[5] = 0;
+		cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+		cycle = nes->cpu->cycle;
+		break;
+	case 3: // truncated
+		state_size -= 1;
+		break;
+	}
+
+	ck_assert_int_ne(cnes_load_state(nes, state, state_size), 0);
+	ck_assert_uint_eq(nes->cpu->cycle, cycle); // console is left untouched
+	free(state);
+}
+
+START_TEST (rewind_restores_earlier_frames)
+{
+	// the newest frame, within the newest keyframe's deltas, across keyframes and clamped to the oldest
+	unsigned frames_back[4] = {0, 3, 2 * REWIND_DEFAULT_KEYFRAME_INTERVAL + 5, 1000};
+	const unsigned pushes = 40;
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	size_t state_size = cnes_save_state_size(nes);
+	uint8_t* states = malloc(state_size * pushes);
+	RewindBuffer* rb = cnes_rewind_create(nes, 16 * KiB * KiB, 3600);
+	ck_assert_ptr_ne(rb, NULL);
+
+	for (unsigned i = 0; i < pushes; i++) {
+		cnes_set_input(nes, 0, i & 0xFF);
+		cnes_run_frame(nes);
+		cnes_save_state(nes, &states[i * state_size], state_size);
+		ck_assert_int_eq(cnes_rewind_push(rb, nes), 0);
+	}
+	unsigned expected_back = frames_back[_i] < pushes ? frames_back[_i] : pushes - 1;
+	ck_assert_int_eq(cnes_rewind(rb, nes, frames_back[_i]), (int) expected_back);
+
+	// the console is back at the frame, byte for byte
+	unsigned target = pushes - 1 - expected_back;
+	uint8_t* state = malloc(state_size);
+	cnes_save_state(nes, state, state_size);
+	ck_assert_mem_eq(state, &states[target * state_size], state_size);
+	ck_assert_uint_eq(rewind_buffer_frame_count(rb), target + 1);
+
+	// recording carries on from there
+	cnes_run_frame(nes);
+	ck_assert_int_eq(cnes_rewind_push(rb, nes), 0);
+	ck_assert_int_eq(cnes_rewind(rb, nes, 1), 1);
+	cnes_save_state(nes, state, state_size);
+	ck_assert_mem_eq(state, &states[target * state_size], state_size);
+
+	free(state);
+	free(states);
+	cnes_rewind_destroy(rb);
+}
+
+START_TEST (rewind_stays_within_memory_budget)
+{
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	size_t state_size = cnes_save_state_size(nes);
+	// keyframes only, so the test ROM's tiny deltas don't let everything fit
+	RewindBuffer* rb = rewind_buffer_allocator();
+	ck_assert_int_eq(rewind_buffer_init(rb, nes, 3 * state_size, 3600, 1), 0);
+
+	for (unsigned i = 0; i < 100; i++) {
+		cnes_run_frame(nes);
+		ck_assert_int_eq(cnes_rewind_push(rb, nes), 0);
+	}
+	unsigned count = rewind_buffer_frame_count(rb);
+	ck_assert_uint_gt(count, 0);
+	ck_assert_uint_lt(count, 100);
+	ck_assert(rb->frames[rb->first].keyframe); // oldest frame can always be decoded
+
+	// frame limit is honoured too
+	cnes_rewind_destroy(rb);
+	rb = cnes_rewind_create(nes, 16 * KiB * KiB, 10);
+	for (unsigned i = 0; i < 25; i++) {
+		cnes_run_frame(nes);
+		cnes_rewind_push(rb, nes);
+	}
+	count = rewind_buffer_frame_count(rb);
+	ck_assert_uint_le(count, 10);
+	ck_assert_int_eq(cnes_rewind(rb, nes, 1000), (int) count - 1);
+
+	cnes_rewind_destroy(rb);
+}
+
+START_TEST (rewind_rejects_tiny_budget)
+{
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+
+	ck_assert_ptr_eq(cnes_rewind_create(nes, 1 * KiB, 3600), NULL);
+	ck_assert_ptr_eq(cnes_rewind_create(nes, 16 * KiB * KiB, 0), NULL);
+}
+
+START_TEST (movie_playback_matches_recording)
+{
+	Nes* playback = cnes_create();
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	cnes_load_rom_from_memory(playback, test_rom, TEST_ROM_SIZE);
+	InputMovie* movie = movie_allocator();
+	movie_init(movie, nes);
+
+	for (unsigned i = 0; i < 30; i++) {
+		// hold each input for a few frames, only changes are stored
+		cnes_set_input(nes, 0, (i / 4) * 0x11);
+		cnes_set_input(nes, 1, (i / 8) & CNES_BUTTON_A);
+		ck_assert_int_eq(movie_record_frame(movie, nes), 0);
+		cnes_run_frame(nes);
+	}
+	ck_assert_uint_eq(movie->frame_count, 30);
+	ck_assert_uint_lt(movie->input_count, 10);
+	ck_assert_int_eq(movie_save(movie, TEST_MOVIE_FILE), 0);
+	movie_free(movie);
+
+	movie = movie_allocator();
+	ck_assert_int_eq(movie_load(movie, TEST_MOVIE_FILE, playback), 0);
+	for (unsigned i = 0; i < 30; i++) {
+		ck_assert_int_eq(movie_play_frame(movie, playback), 0);
+		cnes_run_frame(playback);
+	}
+	assert_same_machine_state(nes, playback);
+	ck_assert_uint_eq(playback->cpu->player_1_controller, nes->cpu->player_1_controller);
+	ck_assert_uint_eq(playback->cpu->player_2_controller, nes->cpu->player_2_controller);
+
+	// out of input, controllers are released
+	ck_assert_int_eq(movie_play_frame(movie, playback), 1);
+	ck_assert_uint_eq(playback->cpu->player_1_controller, 0);
+
+	movie_free(movie);
+	cnes_destroy(playback);
+	remove(TEST_MOVIE_FILE);
+}
+
+START_TEST (movie_load_rejects_other_games)
+{
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	InputMovie* movie = movie_allocator();
+	movie_init(movie, nes);
+	movie_record_frame(movie, nes);
+	movie_save(movie, TEST_MOVIE_FILE);
+
+	test_rom[16] = 0xEA; // NOP, a different program
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	ck_assert_int_ne(movie_load(movie, TEST_MOVIE_FILE, nes), 0);
+	ck_assert_int_ne(movie_load(movie, "no_such_movie.cnm", nes), 0);
+
+	movie_free(movie);
+	remove(TEST_MOVIE_FILE);
+}
+
+START_TEST (trace_records_instructions)
+{
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	CpuTrace* trace = cnes_trace_create(nes, 64);
+	cnes_trace_attach(nes, trace);
+	cnes_run_cycles(nes, 20);
+
+	ck_assert_uint_gt(cpu_trace_count(trace), 2);
+	const struct TraceRecord* lda = cpu_trace_get(trace, 0);
+	const struct TraceRecord* sta = cpu_trace_get(trace, 1);
+	ck_assert_uint_eq(lda->pc, 0xC000);
+	ck_assert_uint_eq(lda->opcode, 0xA9);
+	ck_assert_uint_eq(lda->operand_lo, 0x01);
+	ck_assert_uint_eq(sta->pc, 0xC002);
+	ck_assert_uint_eq(sta->A, 0x01);
+	ck_assert_uint_eq(sta->cpu_cycle, lda->cpu_cycle + 2);
+	ck_assert_uint_eq(sta->ppu_dot, lda->ppu_dot + 6);
+
+	char line[TRACE_LINE_SIZE];
+	cpu_trace_format_record(sta, line, sizeof(line));
+	ck_assert_str_eq(line, "C002  8D 16 40  STA $4016                       A:01 X:00 Y:00 P:24 SP:FD PPU:  0, 33 CYC:2");
+
+	cnes_trace_attach(nes, NULL);
+	cnes_trace_destroy(trace);
+}
+
+START_TEST (trace_keeps_newest_records)
+{
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	CpuTrace* trace = cnes_trace_create(nes, 3); // rounded up to 4
+	cnes_trace_attach(nes, trace);
+	cnes_run_cycles(nes, 200);
+
+	ck_assert_uint_eq(cpu_trace_count(trace), 4);
+	for (size_t i = 1; i < 4; i++) {
+		ck_assert_uint_gt(cpu_trace_get(trace, i)->cpu_cycle, cpu_trace_get(trace, i - 1)->cpu_cycle);
+	}
+	uint64_t newest = cpu_trace_get(trace, 3)->cpu_cycle;
+	ck_assert_uint_gt(newest, 190);
+
+	// detached, nothing more is recorded
+	cnes_trace_attach(nes, NULL);
+	cnes_run_cycles(nes, 200);
+	ck_assert_uint_eq(cpu_trace_get(trace, 3)->cpu_cycle, newest);
+
+	cnes_trace_destroy(trace);
+}
+
+START_TEST (trace_flush_writes_oldest_first)
+{
+	cnes_load_rom_from_memory(nes, test_rom, TEST_ROM_SIZE);
+	CpuTrace* trace = cnes_trace_create(nes, 16);
+	cnes_trace_attach(nes, trace);
+	cnes_run_cycles(nes, 100); // wraps the ring
+	ck_assert_int_eq(cnes_trace_flush(trace, TEST_TRACE_FILE), 0);
+
+	FILE* file = fopen(TEST_TRACE_FILE, "rb");
+	ck_assert_ptr_ne(file, NULL);
+	struct TraceFileHeader header;
+	ck_assert_uint_eq(fread(&header, sizeof(header), 1, file), 1);
+	ck_assert_mem_eq(header.magic, trace_file_magic, sizeof(trace_file_magic));
+	ck_assert_uint_eq(header.version, TRACE_VERSION);
+	ck_assert_uint_eq(header.record_size, sizeof(struct TraceRecord));
+	ck_assert_uint_eq(header.record_count, 16);
+	for (size_t i = 0; i < 16; i++) {
+		struct TraceRecord record;
+		ck_assert_uint_eq(fread(&record, sizeof(record), 1, file), 1);
+		ck_assert_mem_eq(&record, cpu_trace_get(trace, i), sizeof(record));
+	}
+	fclose(file);
+
+	cnes_trace_attach(nes, NULL);
+	cnes_trace_destroy(trace);
+	remove(TEST_TRACE_FILE);
+}
+
+START_TEST (trace_format_matches_nestest)
+{
+	const struct TraceRecord records[4] = {
+		{.pc = 0xC72A, .opcode = 0xD0, .operand_lo = 0xE0, .P = 0x24, .SP = 0xFD
+		, .ppu_dot = 20, .scanline = 10, .cpu_cycle = 7},
+		{.pc = 0xC000, .opcode = 0x6C, .operand_lo = 0x00, .operand_hi = 0x02, .A = 0xFF, .SP = 0xFB
+		, .ppu_dot = 340, .scanline = 261, .cpu_cycle = 0x100000000ULL},
+		{.pc = 0xD000, .opcode = 0x91, .operand_lo = 0x33, .operand_hi = 0xFF, .X = 0x01, .Y = 0x80},
+		{.pc = 0xE000, .opcode = 0x0A, .operand_lo = 0x12, .operand_hi = 0x34},
+	};
+	const char* expected[4] = {
+		"C72A  D0 E0     BNE $C70C                       A:00 X:00 Y:00 P:24 SP:FD PPU: 10, 20 CYC:7",
+		"C000  6C 00 02  JMP ($0200)                     A:FF X:00 Y:00 P:00 SP:FB PPU:261,340 CYC:4294967296",
+		"D000  91 33     STA ($33),Y                     A:00 X:01 Y:80 P:00 SP:00 PPU:  0,  0 CYC:0",
+		"E000  0A        ASL A                           A:00 X:00 Y:00 P:00 SP:00 PPU:  0,  0 CYC:0",
+	};
+
+	char line[TRACE_LINE_SIZE];
+	cpu_trace_format_record(&records[_i], line, sizeof(line));
+	ck_assert_str_eq(line, expected[_i]);
+}
+
+Suite* cnes_master_suite(void)
+{
+	Suite* s;
+
+	s = suite_create("All libcnes Tests");
+
+	return s;
+}
+
+Suite* cnes_api_suite(void)
+{
+	Suite* s;
+	TCase* tc_load_rom;
+	TCase* tc_run;
+	TCase* tc_save_state;
+	TCase* tc_rewind;
+	TCase* tc_movie;
+	TCase* tc_trace;
+
+	s = suite_create("libcnes API Tests");
+	tc_load_rom = tcase_create("Load ROM");
+	tcase_add_checked_fixture(tc_load_rom, setup, teardown);
+	tcase_add_test(tc_load_rom, load_rom_rejects_bad_header);
+	tcase_add_test(tc_load_rom, load_rom_rejects_truncated_image);
+	tcase_add_test(tc_load_rom, load_rom_resets_cpu);
+	suite_add_tcase(s, tc_load_rom);
+	tc_run = tcase_create("Run");
+	tcase_add_checked_fixture(tc_run, setup, teardown);
+	tcase_add_loop_test(tc_run, run_cycles_advances_cpu_clock, 0, 3);
+	tcase_add_test(tc_run, run_frame_runs_a_whole_frame);
+	tcase_add_test(tc_run, run_frame_without_a_rom);
+	tcase_add_loop_test(tc_run, set_input_is_read_by_cpu, 0, 2);
+	tcase_add_test(tc_run, consoles_are_independent);
+	tcase_add_test(tc_run, step_instruction_skips_idle_loops_exactly);
+	tcase_add_loop_test(tc_run, lazy_ppu_matches_lockstep, 0, 5);
+	tcase_add_test(tc_run, clocks_run_past_32_bits);
+	suite_add_tcase(s, tc_run);
+	tc_save_state = tcase_create("Save States");
+	tcase_add_checked_fixture(tc_save_state, setup, teardown);
+	tcase_add_loop_test(tc_save_state, save_state_round_trip, 0, 2);
+	tcase_add_test(tc_save_state, save_state_buffer_too_small);
+	tcase_add_loop_test(tc_save_state, load_state_rejects_incompatible_states, 0, 4);
+	suite_add_tcase(s, tc_save_state);
+	tc_rewind = tcase_create("Rewind");
+	tcase_add_checked_fixture(tc_rewind, setup, teardown);
+	tcase_add_loop_test(tc_rewind, rewind_restores_earlier_frames, 0, 4);
+	tcase_add_test(tc_rewind, rewind_stays_within_memory_budget);
+	tcase_add_test(tc_rewind, rewind_rejects_tiny_budget);
+	suite_add_tcase(s, tc_rewind);
+	tc_movie = tcase_create("Input Movies");
+	tcase_add_checked_fixture(tc_movie, setup, teardown);
+	tcase_add_test(tc_movie, movie_playback_matches_recording);
+	tcase_add_test(tc_movie, movie_load_rejects_other_games);
+	suite_add_tcase(s, tc_movie);
+	tc_trace = tcase_create("CPU Trace");
+	tcase_add_checked_fixture(tc_trace, setup, teardown);
+	tcase_add_test(tc_trace, trace_records_instructions);
+	tcase_add_test(tc_trace, trace_keeps_newest_records);
+	tcase_add_test(tc_trace, trace_flush_writes_oldest_first);
+	tcase_add_loop_test(tc_trace, trace_format_matches_nestest, 0, 4);
+	suite_add_tcase(s, tc_trace);
+
+	return s;
+}
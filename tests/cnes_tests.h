@@ -0,0 +1,7 @@
+#ifndef __CNES_TESTS__
+#define __CNES_TESTS__
+
+Suite* cnes_master_suite(void);
+Suite* cnes_api_suite(void);
+
+#endif /* __CNES_TESTS__ */
@@ -521,6 +521,67 @@ START_TEST (write_ppu_data_2007_during_rendering)
 	ck_assert_uint_eq(0x6B, read_from_ppu_vram(cpu_ppu_tester->vram, 0x2001));
 }
 
+START_TEST (events_pop_in_timestamp_order)
+{
+	EventQueue* events = &cpu_ppu_tester->events;
+	events_schedule(events, EVENT_NMI, 10);
+	events_schedule(events, EVENT_PPU_WRITE, 10);
+	events_schedule(events, EVENT_VBLANK, 5);
+
+	ck_assert_int_eq(-1, events_pop(events, 4, PPU_EVENTS));
+	ck_assert_int_eq(EVENT_VBLANK, events_pop(events, 10, PPU_EVENTS));
+	// same timestamp, lower event type first
+	ck_assert_int_eq(EVENT_PPU_WRITE, events_pop(events, 10, PPU_EVENTS));
+	ck_assert_int_eq(EVENT_NMI, events_pop(events, 10, PPU_EVENTS));
+	ck_assert_int_eq(-1, events_pop(events, 10, PPU_EVENTS));
+	ck_assert(!events_due(events, 1000));
+}
+
+START_TEST (events_pop_only_masked_events)
+{
+	EventQueue* events = &cpu_ppu_tester->events;
+	events_schedule(events, EVENT_DMA_DONE, 3);
+	events_schedule(events, EVENT_PPU_WRITE, 6);
+
+	ck_assert_int_eq(EVENT_PPU_WRITE, events_pop(events, 6, PPU_EVENTS));
+	ck_assert_int_eq(-1, events_pop(events, 6, PPU_EVENTS));
+	ck_assert(events_pending(events, EVENT_DMA_DONE));
+	ck_assert_int_eq(EVENT_DMA_DONE, events_pop(events, 6, 1u << EVENT_DMA_DONE));
+}
+
+START_TEST (events_reschedule_and_cancel)
+{
+	EventQueue* events = &cpu_ppu_tester->events;
+	events_schedule(events, EVENT_VBLANK, 5);
+	events_schedule(events, EVENT_VBLANK, 50); // moves, doesn't add
+
+	ck_assert(!events_due(events, 49));
+	ck_assert(events_due(events, 50));
+	events_cancel(events, EVENT_VBLANK);
+	ck_assert(!events_pending(events, EVENT_VBLANK));
+	ck_assert(!events_due(events, 50));
+}
+
+START_TEST (delayed_ppu_writes_are_scheduled)
+{
+	// $2001 writes land 3 dots later than the other registers, the
+	// odd frame skip sees the new BG enable bit 3 dots before that
+	uint16_t addr[2] = {0x2001, 0x2000};
+	unsigned write_dot[2] = {105, 102};
+	EventQueue* events = &cpu_ppu_tester->events;
+	events->now = 100;
+	events_schedule(events, EVENT_PPU_MASK_EARLY, 90); // an earlier $2001 write
+
+	delay_write_ppu_reg(addr[_i], 0x08, cpio_cpu);
+
+	ck_assert_uint_eq(write_dot[_i], events->when[EVENT_PPU_WRITE]);
+	ck_assert(events_pending(events, EVENT_PPU_MASK_EARLY) == (addr[_i] == 0x2001));
+	if (addr[_i] == 0x2001) {
+		ck_assert_uint_eq(102, events->when[EVENT_PPU_MASK_EARLY]);
+	}
+	ck_assert_uint_eq(0x08, cpu_ppu_tester->buffer_value);
+}
+
 
 START_TEST (ppu_ctrl_base_nt_address)
 {
@@ -668,6 +729,7 @@ Suite* ppu_registers_read_write_suite(void)
 	Suite* s;
 	TCase* tc_ppu_register_reads;
 	TCase* tc_ppu_register_writes;
+	TCase* tc_events;
 
 	s = suite_create("Ppu Registers Read/Write Tests");
 	tc_ppu_register_reads = tcase_create("Ppu Register Reads");
@@ -704,6 +766,13 @@ Suite* ppu_registers_read_write_suite(void)
 	tcase_add_loop_test(tc_ppu_register_writes, write_ppu_data_2007_outside_of_rendering, 0, 2);
 	tcase_add_test(tc_ppu_register_writes, write_ppu_data_2007_during_rendering);
 	suite_add_tcase(s, tc_ppu_register_writes);
+	tc_events = tcase_create("Cpu/Ppu Event Queue");
+	tcase_add_checked_fixture(tc_events, setup, teardown);
+	tcase_add_test(tc_events, events_pop_in_timestamp_order);
+	tcase_add_test(tc_events, events_pop_only_masked_events);
+	tcase_add_test(tc_events, events_reschedule_and_cancel);
+	tcase_add_loop_test(tc_events, delayed_ppu_writes_are_scheduled, 0, 2);
+	suite_add_tcase(s, tc_events);
 
 	return s;
 }
@@ -9,6 +9,9 @@
 #include "cpu_ppu_interface.h" // needed for NMI
 #include "cpu_mapper_interface.h" // needed for open bus tests
 #include "bits_and_bytes.h"
+#include "block_cache.h"
+#include "jit.h"
+#include "cart.h" // CartMemory for the block cache tests
 
 
 /* Get opcode from instruction and addressing mode
@@ -257,6 +260,13 @@ void mapper_setup(void)
 	cpu->cpu_mapper_io->mapper_number = 0;
 }
 
+// decoders run all of their cycles in one call, as they do for cpu_step_instruction()
+void instruction_step_setup(void)
+{
+	setup();
+	cpu->stepping = true;
+}
+
 void teardown(void)
 {
 	free(cpu);
@@ -791,6 +801,91 @@ START_TEST (open_bus_reads_absx_rmw_t4_indexed_read)
 	ck_assert_uint_eq(cpu->data_bus, cpu->addr_hi);
 }
 
+/* Memory map (page table) tests
+ */
+static uint16_t io_handler_addr;
+static uint8_t io_handler_val;
+
+static uint8_t test_io_read(Cpu6502* cpu, uint16_t addr)
+{
+	(void) cpu;
+	io_handler_addr = addr;
+	return 0x5A;
+}
+
+static void test_io_write(Cpu6502* cpu, uint16_t addr, uint8_t val)
+{
+	(void) cpu;
+	io_handler_addr = addr;
+	io_handler_val = val;
+}
+
+START_TEST (memory_map_direct_pages)
+{
+	uint8_t host_mem[2 * CPU_PAGE_SIZE] = {0};
+	cpu_map_pages(cpu, 0x6000, sizeof(host_mem), host_mem, host_mem);
+
+	write_to_cpu(cpu, 0x6123, 0x9C);
+
+	ck_assert_uint_eq(0x9C, host_mem[0x123]);
+	ck_assert_uint_eq(0x9C, read_from_cpu(cpu, 0x6123));
+	ck_assert_uint_eq(0x00, cpu->mem[0x6123]);
+}
+
+START_TEST (memory_map_read_only_pages)
+{
+	cpu->mem[0x8000] = 0x01;
+	cpu->mem[0x8001] = 0x02;
+
+	write_to_cpu(cpu, 0x8001, 0xFF); // mapper 0 ignores writes to PRG ROM
+
+	ck_assert_uint_eq(0x01, read_from_cpu(cpu, 0x8000));
+	ck_assert_uint_eq(0x02, read_from_cpu(cpu, 0x8001));
+}
+
+START_TEST (memory_map_io_pages)
+{
+	cpu_map_io_pages(cpu, 0x5000, 0x1000, test_io_read, test_io_write);
+
+	ck_assert_uint_eq(0x5A, read_from_cpu(cpu, 0x5F01));
+	ck_assert_uint_eq(0x5F01, io_handler_addr);
+	write_to_cpu(cpu, 0x5002, 0x3B);
+	ck_assert_uint_eq(0x5002, io_handler_addr);
+	ck_assert_uint_eq(0x3B, io_handler_val);
+	// neighbouring pages are untouched
+	cpu->data_bus = 0x11;
+	ck_assert_uint_eq(0x11, read_from_cpu(cpu, 0x6000)); // open bus
+}
+
+START_TEST (oam_dma_skips_io_read_handlers)
+{
+	uint8_t oam[256] = {0};
+	cpu->cpu_ppu_io = cpu_ppu_io_allocator();
+	cpu_ppu_io_init(cpu->cpu_ppu_io);
+	cpu->cpu_ppu_io->oam = oam; // no ppu attached
+	cpu_map_io_pages(cpu, 0x5000, 0x1000, test_io_read, test_io_write);
+	for (unsigned i = 0; i < 256; i++) {
+		cpu->mem[0x5000 + i] = (uint8_t) (i ^ 0xA5);
+	}
+	io_handler_addr = 0;
+
+	// DMA from an I/O page copies what's in mem[], like the hexdump
+	cpu->base_addr = 0x50;
+	cpu->instruction_state = EXECUTE;
+	for (unsigned cycles = 0; cycles < 600 && cpu->instruction_state != POST_EXECUTE; cycles++) {
+		++cpu->cycle;
+		hardware_interrupts[DMA_INDEX](cpu);
+	}
+
+	ck_assert(cpu->instruction_state == POST_EXECUTE);
+	ck_assert_uint_eq(0, io_handler_addr);
+	for (unsigned i = 0; i < 256; i++) {
+		ck_assert_uint_eq(i ^ 0xA5, oam[i]);
+	}
+	free(cpu->cpu_ppu_io);
+}
+
+
 
 /* Address bus and data bus unit tests
  */
@@ -6019,6 +6114,39 @@ END_TEST
 
 /* Trace logger unit tests
  */
+/* Decoded operand state the disassembler reads, the same for every log_*
+ * test so each address mode has one expected operand: $1234 ($1234,X/Y),
+ * #$44, $33 ($71,X/Y), ($1234), ($80,X), ($80),Y and $C032 for branches
+ */
+static void log_instruction(Cpu6502* cpu, uint8_t opcode)
+{
+	cpu->trace_event = TRACE_OPCODE;
+	cpu->opcode = opcode;
+	cpu->address_mode = isa_info[opcode].address_mode;
+	cpu->X = 0x05;
+	cpu->Y = 0x0A;
+	cpu->operand = 0x44;
+	cpu->base_addr = 0x80;
+	cpu->addr_lo = 0x71;
+	cpu->old_PC = 0xC010;
+	cpu->offset = 0x20;
+	switch (cpu->address_mode) {
+	case ZP:
+		cpu->target_addr = 0x0033;
+		break;
+	case ABSX:
+		cpu->target_addr = 0x1234 + cpu->X;
+		break;
+	case ABSY:
+		cpu->target_addr = 0x1234 + cpu->Y;
+		break;
+	default:
+		cpu->target_addr = 0x1234;
+		break;
+	}
+	set_cpu_disassembler_trace(cpu, cpu->instruction, cpu->append_int, cpu->end);
+}
+
 START_TEST (log_adc)
 {
 	char ins[4] = "ADC";
@@ -6031,9 +6159,11 @@ START_TEST (log_adc)
 	                         , reverse_opcode_lut(&ins, INDX)
 	                         , reverse_opcode_lut(&ins, INDY)};
 
-	isa_info[adc_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[8] = { "ADC #$44", "ADC $33", "ADC $71,X", "ADC $1234"
+	                          , "ADC $1234,X", "ADC $1234,Y", "ADC ($80,X)", "ADC ($80),Y"};
+	log_instruction(cpu, adc_opcodes[_i]);
 
-	ck_assert_str_eq("ADC ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6049,9 +6179,11 @@ START_TEST (log_and)
 	                         , reverse_opcode_lut(&ins, INDX)
 	                         , reverse_opcode_lut(&ins, INDY)};
 
-	isa_info[and_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[8] = { "AND #$44", "AND $33", "AND $71,X", "AND $1234"
+	                          , "AND $1234,X", "AND $1234,Y", "AND ($80,X)", "AND ($80),Y"};
+	log_instruction(cpu, and_opcodes[_i]);
 
-	ck_assert_str_eq("AND ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6064,9 +6196,10 @@ START_TEST (log_asl)
 	                         , reverse_opcode_lut(&ins, ABS)
 	                         , reverse_opcode_lut(&ins, ABSX)};
 
-	isa_info[asl_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[5] = {"ASL A", "ASL $33", "ASL $71,X", "ASL $1234", "ASL $1234,X"};
+	log_instruction(cpu, asl_opcodes[_i]);
 
-	ck_assert_str_eq("ASL ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6075,9 +6208,9 @@ START_TEST (log_bcc)
 	char ins[4] = "BCC";
 	uint8_t bcc_opcode  = reverse_opcode_lut(&ins, REL);
 
-	isa_info[bcc_opcode].execute_opcode(cpu);
+	log_instruction(cpu, bcc_opcode);
 
-	ck_assert_str_eq("BCC ", cpu->instruction);
+	ck_assert_str_eq("BCC $C032", cpu->instruction);
 }
 END_TEST
 
@@ -6086,9 +6219,9 @@ START_TEST (log_bcs)
 	char ins[4] = "BCS";
 	uint8_t bcs_opcode  = reverse_opcode_lut(&ins, REL);
 
-	isa_info[bcs_opcode].execute_opcode(cpu);
+	log_instruction(cpu, bcs_opcode);
 
-	ck_assert_str_eq("BCS ", cpu->instruction);
+	ck_assert_str_eq("BCS $C032", cpu->instruction);
 }
 END_TEST
 
@@ -6097,9 +6230,9 @@ START_TEST (log_beq)
 	char ins[4] = "BEQ";
 	uint8_t beq_opcode  = reverse_opcode_lut(&ins, REL);
 
-	isa_info[beq_opcode].execute_opcode(cpu);
+	log_instruction(cpu, beq_opcode);
 
-	ck_assert_str_eq("BEQ ", cpu->instruction);
+	ck_assert_str_eq("BEQ $C032", cpu->instruction);
 }
 END_TEST
 
@@ -6109,9 +6242,10 @@ START_TEST (log_bit)
 	uint8_t bit_opcodes[2] = { reverse_opcode_lut(&ins, ZP)
 	                         , reverse_opcode_lut(&ins, ABS)};
 
-	isa_info[bit_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[2] = {"BIT $33", "BIT $1234"};
+	log_instruction(cpu, bit_opcodes[_i]);
 
-	ck_assert_str_eq("BIT ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6120,9 +6254,9 @@ START_TEST (log_bmi)
 	char ins[4] = "BMI";
 	uint8_t bmi_opcode  = reverse_opcode_lut(&ins, REL);
 
-	isa_info[bmi_opcode].execute_opcode(cpu);
+	log_instruction(cpu, bmi_opcode);
 
-	ck_assert_str_eq("BMI ", cpu->instruction);
+	ck_assert_str_eq("BMI $C032", cpu->instruction);
 }
 END_TEST
 
@@ -6131,9 +6265,9 @@ START_TEST (log_bne)
 	char ins[4] = "BNE";
 	uint8_t bne_opcode  = reverse_opcode_lut(&ins, REL);
 
-	isa_info[bne_opcode].execute_opcode(cpu);
+	log_instruction(cpu, bne_opcode);
 
-	ck_assert_str_eq("BNE ", cpu->instruction);
+	ck_assert_str_eq("BNE $C032", cpu->instruction);
 }
 END_TEST
 
@@ -6142,9 +6276,9 @@ START_TEST (log_bpl)
 	char ins[4] = "BPL";
 	uint8_t bpl_opcode  = reverse_opcode_lut(&ins, REL);
 
-	isa_info[bpl_opcode].execute_opcode(cpu);
+	log_instruction(cpu, bpl_opcode);
 
-	ck_assert_str_eq("BPL ", cpu->instruction);
+	ck_assert_str_eq("BPL $C032", cpu->instruction);
 }
 END_TEST
 
@@ -6153,9 +6287,9 @@ START_TEST (log_brk)
 	char ins[4] = "BRK";
 	uint8_t brk_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[brk_opcode].execute_opcode(cpu);
+	log_instruction(cpu, brk_opcode);
 
-	ck_assert_str_eq("BRK ", cpu->instruction);
+	ck_assert_str_eq("BRK", cpu->instruction);
 }
 END_TEST
 
@@ -6164,9 +6298,9 @@ START_TEST (log_bvc)
 	char ins[4] = "BVC";
 	uint8_t bvc_opcode  = reverse_opcode_lut(&ins, REL);
 
-	isa_info[bvc_opcode].execute_opcode(cpu);
+	log_instruction(cpu, bvc_opcode);
 
-	ck_assert_str_eq("BVC ", cpu->instruction);
+	ck_assert_str_eq("BVC $C032", cpu->instruction);
 }
 END_TEST
 
@@ -6175,9 +6309,9 @@ START_TEST (log_bvs)
 	char ins[4] = "BVS";
 	uint8_t bvs_opcode  = reverse_opcode_lut(&ins, REL);
 
-	isa_info[bvs_opcode].execute_opcode(cpu);
+	log_instruction(cpu, bvs_opcode);
 
-	ck_assert_str_eq("BVS ", cpu->instruction);
+	ck_assert_str_eq("BVS $C032", cpu->instruction);
 }
 END_TEST
 
@@ -6186,7 +6320,7 @@ START_TEST (log_clc)
 	char ins[4] = "CLC";
 	uint8_t clc_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[clc_opcode].execute_opcode(cpu);
+	log_instruction(cpu, clc_opcode);
 
 	ck_assert_str_eq("CLC", cpu->instruction); // no space for implied address mode
 }
@@ -6197,7 +6331,7 @@ START_TEST (log_cld)
 	char ins[4] = "CLD";
 	uint8_t cld_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[cld_opcode].execute_opcode(cpu);
+	log_instruction(cpu, cld_opcode);
 
 	ck_assert_str_eq("CLD", cpu->instruction); // no space for implied address mode
 }
@@ -6208,7 +6342,7 @@ START_TEST (log_cli)
 	char ins[4] = "CLI";
 	uint8_t cli_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[cli_opcode].execute_opcode(cpu);
+	log_instruction(cpu, cli_opcode);
 
 	ck_assert_str_eq("CLI", cpu->instruction); // no space for implied address mode
 }
@@ -6219,7 +6353,7 @@ START_TEST (log_clv)
 	char ins[4] = "CLV";
 	uint8_t clv_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[clv_opcode].execute_opcode(cpu);
+	log_instruction(cpu, clv_opcode);
 
 	ck_assert_str_eq("CLV", cpu->instruction); // no space for implied address mode
 }
@@ -6237,9 +6371,11 @@ START_TEST (log_cmp)
 	                         , reverse_opcode_lut(&ins, INDX)
 	                         , reverse_opcode_lut(&ins, INDY)};
 
-	isa_info[cmp_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[8] = { "CMP #$44", "CMP $33", "CMP $71,X", "CMP $1234"
+	                          , "CMP $1234,X", "CMP $1234,Y", "CMP ($80,X)", "CMP ($80),Y"};
+	log_instruction(cpu, cmp_opcodes[_i]);
 
-	ck_assert_str_eq("CMP ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6250,9 +6386,10 @@ START_TEST (log_cpx)
 	                         , reverse_opcode_lut(&ins, ZP)
 	                         , reverse_opcode_lut(&ins, ABS)};
 
-	isa_info[cpx_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[3] = {"CPX #$44", "CPX $33", "CPX $1234"};
+	log_instruction(cpu, cpx_opcodes[_i]);
 
-	ck_assert_str_eq("CPX ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6263,9 +6400,10 @@ START_TEST (log_cpy)
 	                         , reverse_opcode_lut(&ins, ZP)
 	                         , reverse_opcode_lut(&ins, ABS)};
 
-	isa_info[cpy_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[3] = {"CPY #$44", "CPY $33", "CPY $1234"};
+	log_instruction(cpu, cpy_opcodes[_i]);
 
-	ck_assert_str_eq("CPY ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6277,9 +6415,10 @@ START_TEST (log_dec)
 	                         , reverse_opcode_lut(&ins, ABS)
 	                         , reverse_opcode_lut(&ins, ABSX)};
 
-	isa_info[dec_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[4] = {"DEC $33", "DEC $71,X", "DEC $1234", "DEC $1234,X"};
+	log_instruction(cpu, dec_opcodes[_i]);
 
-	ck_assert_str_eq("DEC ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6288,9 +6427,9 @@ START_TEST (log_dex)
 	char ins[4] = "DEX";
 	uint8_t dex_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[dex_opcode].execute_opcode(cpu);
+	log_instruction(cpu, dex_opcode);
 
-	ck_assert_str_eq("DEX ", cpu->instruction);
+	ck_assert_str_eq("DEX", cpu->instruction);
 }
 END_TEST
 
@@ -6299,9 +6438,9 @@ START_TEST (log_dey)
 	char ins[4] = "DEY";
 	uint8_t dey_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[dey_opcode].execute_opcode(cpu);
+	log_instruction(cpu, dey_opcode);
 
-	ck_assert_str_eq("DEY ", cpu->instruction);
+	ck_assert_str_eq("DEY", cpu->instruction);
 }
 END_TEST
 
@@ -6317,9 +6456,11 @@ START_TEST (log_eor)
 	                         , reverse_opcode_lut(&ins, INDX)
 	                         , reverse_opcode_lut(&ins, INDY)};
 
-	isa_info[eor_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[8] = { "EOR #$44", "EOR $33", "EOR $71,X", "EOR $1234"
+	                          , "EOR $1234,X", "EOR $1234,Y", "EOR ($80,X)", "EOR ($80),Y"};
+	log_instruction(cpu, eor_opcodes[_i]);
 
-	ck_assert_str_eq("EOR ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6331,9 +6472,10 @@ START_TEST (log_inc)
 	                         , reverse_opcode_lut(&ins, ABS)
 	                         , reverse_opcode_lut(&ins, ABSX)};
 
-	isa_info[inc_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[4] = {"INC $33", "INC $71,X", "INC $1234", "INC $1234,X"};
+	log_instruction(cpu, inc_opcodes[_i]);
 
-	ck_assert_str_eq("INC ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 
 START_TEST (log_inx)
@@ -6341,9 +6483,9 @@ START_TEST (log_inx)
 	char ins[4] = "INX";
 	uint8_t inx_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[inx_opcode].execute_opcode(cpu);
+	log_instruction(cpu, inx_opcode);
 
-	ck_assert_str_eq("INX ", cpu->instruction);
+	ck_assert_str_eq("INX", cpu->instruction);
 }
 END_TEST
 
@@ -6352,9 +6494,9 @@ START_TEST (log_iny)
 	char ins[4] = "INY";
 	uint8_t iny_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[iny_opcode].execute_opcode(cpu);
+	log_instruction(cpu, iny_opcode);
 
-	ck_assert_str_eq("INY ", cpu->instruction);
+	ck_assert_str_eq("INY", cpu->instruction);
 }
 END_TEST
 
@@ -6364,9 +6506,10 @@ START_TEST (log_jmp)
 	uint8_t jmp_opcodes[2] = { reverse_opcode_lut(&ins, ABS)
 	                         , reverse_opcode_lut(&ins, IND)};
 
-	isa_info[jmp_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[2] = {"JMP $1234", "JMP ($1234)"};
+	log_instruction(cpu, jmp_opcodes[_i]);
 
-	ck_assert_str_eq("JMP ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6375,9 +6518,9 @@ START_TEST (log_jsr)
 	char ins[4] = "JSR";
 	uint8_t jsr_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[jsr_opcode].execute_opcode(cpu);
+	log_instruction(cpu, jsr_opcode);
 
-	ck_assert_str_eq("JSR ", cpu->instruction);
+	ck_assert_str_eq("JSR $1234", cpu->instruction);
 }
 END_TEST
 
@@ -6393,9 +6536,11 @@ START_TEST (log_lda)
 	                         , reverse_opcode_lut(&ins, INDX)
 	                         , reverse_opcode_lut(&ins, INDY)};
 
-	isa_info[lda_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[8] = { "LDA #$44", "LDA $33", "LDA $71,X", "LDA $1234"
+	                          , "LDA $1234,X", "LDA $1234,Y", "LDA ($80,X)", "LDA ($80),Y"};
+	log_instruction(cpu, lda_opcodes[_i]);
 
-	ck_assert_str_eq("LDA ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6408,9 +6553,10 @@ START_TEST (log_ldx)
 	                         , reverse_opcode_lut(&ins, ABS)
 	                         , reverse_opcode_lut(&ins, ABSY)};
 
-	isa_info[ldx_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[5] = {"LDX #$44", "LDX $33", "LDX $71,Y", "LDX $1234", "LDX $1234,Y"};
+	log_instruction(cpu, ldx_opcodes[_i]);
 
-	ck_assert_str_eq("LDX ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6423,9 +6569,10 @@ START_TEST (log_ldy)
 	                         , reverse_opcode_lut(&ins, ABS)
 	                         , reverse_opcode_lut(&ins, ABSX)};
 
-	isa_info[ldy_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[5] = {"LDY #$44", "LDY $33", "LDY $71,X", "LDY $1234", "LDY $1234,X"};
+	log_instruction(cpu, ldy_opcodes[_i]);
 
-	ck_assert_str_eq("LDY ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6438,9 +6585,10 @@ START_TEST (log_lsr)
 	                         , reverse_opcode_lut(&ins, ABS)
 	                         , reverse_opcode_lut(&ins, ABSX)};
 
-	isa_info[lsr_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[5] = {"LSR A", "LSR $33", "LSR $71,X", "LSR $1234", "LSR $1234,X"};
+	log_instruction(cpu, lsr_opcodes[_i]);
 
-	ck_assert_str_eq("LSR ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6449,9 +6597,9 @@ START_TEST (log_nop)
 	char ins[4] = "NOP";
 	uint8_t nop_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[nop_opcode].execute_opcode(cpu);
+	log_instruction(cpu, nop_opcode);
 
-	ck_assert_str_eq("NOP ", cpu->instruction);
+	ck_assert_str_eq("NOP", cpu->instruction);
 }
 END_TEST
 
@@ -6467,9 +6615,11 @@ START_TEST (log_ora)
 	                         , reverse_opcode_lut(&ins, INDX)
 	                         , reverse_opcode_lut(&ins, INDY)};
 
-	isa_info[ora_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[8] = { "ORA #$44", "ORA $33", "ORA $71,X", "ORA $1234"
+	                          , "ORA $1234,X", "ORA $1234,Y", "ORA ($80,X)", "ORA ($80),Y"};
+	log_instruction(cpu, ora_opcodes[_i]);
 
-	ck_assert_str_eq("ORA ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6478,9 +6628,9 @@ START_TEST (log_pha)
 	char ins[4] = "PHA";
 	uint8_t pha_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[pha_opcode].execute_opcode(cpu);
+	log_instruction(cpu, pha_opcode);
 
-	ck_assert_str_eq("PHA ", cpu->instruction);
+	ck_assert_str_eq("PHA", cpu->instruction);
 }
 END_TEST
 
@@ -6489,9 +6639,9 @@ START_TEST (log_php)
 	char ins[4] = "PHP";
 	uint8_t php_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[php_opcode].execute_opcode(cpu);
+	log_instruction(cpu, php_opcode);
 
-	ck_assert_str_eq("PHP ", cpu->instruction);
+	ck_assert_str_eq("PHP", cpu->instruction);
 }
 END_TEST
 
@@ -6500,9 +6650,9 @@ START_TEST (log_pla)
 	char ins[4] = "PLA";
 	uint8_t pla_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[pla_opcode].execute_opcode(cpu);
+	log_instruction(cpu, pla_opcode);
 
-	ck_assert_str_eq("PLA ", cpu->instruction);
+	ck_assert_str_eq("PLA", cpu->instruction);
 }
 END_TEST
 
@@ -6511,9 +6661,9 @@ START_TEST (log_plp)
 	char ins[4] = "PLP";
 	uint8_t plp_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[plp_opcode].execute_opcode(cpu);
+	log_instruction(cpu, plp_opcode);
 
-	ck_assert_str_eq("PLP ", cpu->instruction);
+	ck_assert_str_eq("PLP", cpu->instruction);
 }
 END_TEST
 
@@ -6526,9 +6676,10 @@ START_TEST (log_rol)
 	                         , reverse_opcode_lut(&ins, ABS)
 	                         , reverse_opcode_lut(&ins, ABSX)};
 
-	isa_info[rol_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[5] = {"ROL A", "ROL $33", "ROL $71,X", "ROL $1234", "ROL $1234,X"};
+	log_instruction(cpu, rol_opcodes[_i]);
 
-	ck_assert_str_eq("ROL ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6541,9 +6692,10 @@ START_TEST (log_ror)
 	                         , reverse_opcode_lut(&ins, ABS)
 	                         , reverse_opcode_lut(&ins, ABSX)};
 
-	isa_info[ror_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[5] = {"ROR A", "ROR $33", "ROR $71,X", "ROR $1234", "ROR $1234,X"};
+	log_instruction(cpu, ror_opcodes[_i]);
 
-	ck_assert_str_eq("ROR ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6552,7 +6704,7 @@ START_TEST (log_rti)
 	char ins[4] = "RTI";
 	uint8_t rti_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[rti_opcode].execute_opcode(cpu);
+	log_instruction(cpu, rti_opcode);
 
 	ck_assert_str_eq("RTI", cpu->instruction); // no extra space for this instruction
 }
@@ -6563,7 +6715,7 @@ START_TEST (log_rts)
 	char ins[4] = "RTS";
 	uint8_t rts_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[rts_opcode].execute_opcode(cpu);
+	log_instruction(cpu, rts_opcode);
 
 	ck_assert_str_eq("RTS", cpu->instruction); // no extra space for this instruction
 }
@@ -6581,9 +6733,11 @@ START_TEST (log_sbc)
 	                         , reverse_opcode_lut(&ins, INDX)
 	                         , reverse_opcode_lut(&ins, INDY)};
 
-	isa_info[sbc_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[8] = { "SBC #$44", "SBC $33", "SBC $71,X", "SBC $1234"
+	                          , "SBC $1234,X", "SBC $1234,Y", "SBC ($80,X)", "SBC ($80),Y"};
+	log_instruction(cpu, sbc_opcodes[_i]);
 
-	ck_assert_str_eq("SBC ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6592,9 +6746,9 @@ START_TEST (log_sec)
 	char ins[4] = "SEC";
 	uint8_t sec_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[sec_opcode].execute_opcode(cpu);
+	log_instruction(cpu, sec_opcode);
 
-	ck_assert_str_eq("SEC ", cpu->instruction);
+	ck_assert_str_eq("SEC", cpu->instruction);
 }
 END_TEST
 
@@ -6603,9 +6757,9 @@ START_TEST (log_sed)
 	char ins[4] = "SED";
 	uint8_t sed_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[sed_opcode].execute_opcode(cpu);
+	log_instruction(cpu, sed_opcode);
 
-	ck_assert_str_eq("SED ", cpu->instruction);
+	ck_assert_str_eq("SED", cpu->instruction);
 }
 END_TEST
 
@@ -6614,9 +6768,9 @@ START_TEST (log_sei)
 	char ins[4] = "SEI";
 	uint8_t sei_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[sei_opcode].execute_opcode(cpu);
+	log_instruction(cpu, sei_opcode);
 
-	ck_assert_str_eq("SEI ", cpu->instruction);
+	ck_assert_str_eq("SEI", cpu->instruction);
 }
 END_TEST
 
@@ -6631,9 +6785,11 @@ START_TEST (log_sta)
 	                         , reverse_opcode_lut(&ins, INDX)
 	                         , reverse_opcode_lut(&ins, INDY)};
 
-	isa_info[sta_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[7] = { "STA $33", "STA $71,X", "STA $1234", "STA $1234,X"
+	                          , "STA $1234,Y", "STA ($80,X)", "STA ($80),Y"};
+	log_instruction(cpu, sta_opcodes[_i]);
 
-	ck_assert_str_eq("STA ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6644,9 +6800,10 @@ START_TEST (log_stx)
 	                         , reverse_opcode_lut(&ins, ZPY)
 	                         , reverse_opcode_lut(&ins, ABS)};
 
-	isa_info[stx_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[3] = {"STX $33", "STX $71,Y", "STX $1234"};
+	log_instruction(cpu, stx_opcodes[_i]);
 
-	ck_assert_str_eq("STX ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6657,9 +6814,10 @@ START_TEST (log_sty)
 	                         , reverse_opcode_lut(&ins, ZPX)
 	                         , reverse_opcode_lut(&ins, ABS)};
 
-	isa_info[sty_opcodes[_i]].execute_opcode(cpu);
+	const char* expected[3] = {"STY $33", "STY $71,X", "STY $1234"};
+	log_instruction(cpu, sty_opcodes[_i]);
 
-	ck_assert_str_eq("STY ", cpu->instruction);
+	ck_assert_str_eq(expected[_i], cpu->instruction);
 }
 END_TEST
 
@@ -6668,9 +6826,9 @@ START_TEST (log_tax)
 	char ins[4] = "TAX";
 	uint8_t tax_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[tax_opcode].execute_opcode(cpu);
+	log_instruction(cpu, tax_opcode);
 
-	ck_assert_str_eq("TAX ", cpu->instruction);
+	ck_assert_str_eq("TAX", cpu->instruction);
 }
 END_TEST
 
@@ -6679,9 +6837,9 @@ START_TEST (log_tay)
 	char ins[4] = "TAY";
 	uint8_t tay_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[tay_opcode].execute_opcode(cpu);
+	log_instruction(cpu, tay_opcode);
 
-	ck_assert_str_eq("TAY ", cpu->instruction);
+	ck_assert_str_eq("TAY", cpu->instruction);
 }
 END_TEST
 
@@ -6690,9 +6848,9 @@ START_TEST (log_tsx)
 	char ins[4] = "TSX";
 	uint8_t tsx_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[tsx_opcode].execute_opcode(cpu);
+	log_instruction(cpu, tsx_opcode);
 
-	ck_assert_str_eq("TSX ", cpu->instruction);
+	ck_assert_str_eq("TSX", cpu->instruction);
 }
 END_TEST
 
@@ -6701,9 +6859,9 @@ START_TEST (log_txa)
 	char ins[4] = "TXA";
 	uint8_t txa_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[txa_opcode].execute_opcode(cpu);
+	log_instruction(cpu, txa_opcode);
 
-	ck_assert_str_eq("TXA ", cpu->instruction);
+	ck_assert_str_eq("TXA", cpu->instruction);
 }
 END_TEST
 
@@ -6712,9 +6870,9 @@ START_TEST (log_txs)
 	char ins[4] = "TXS";
 	uint8_t txs_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[txs_opcode].execute_opcode(cpu);
+	log_instruction(cpu, txs_opcode);
 
-	ck_assert_str_eq("TXS ", cpu->instruction);
+	ck_assert_str_eq("TXS", cpu->instruction);
 }
 END_TEST
 
@@ -6723,9 +6881,9 @@ START_TEST (log_tya)
 	char ins[4] = "TYA";
 	uint8_t tya_opcode  = reverse_opcode_lut(&ins, IMP);
 
-	isa_info[tya_opcode].execute_opcode(cpu);
+	log_instruction(cpu, tya_opcode);
 
-	ck_assert_str_eq("TYA ", cpu->instruction);
+	ck_assert_str_eq("TYA", cpu->instruction);
 }
 END_TEST
 
@@ -7026,7 +7184,606 @@ START_TEST (log_jsr_data)
 }
 END_TEST
 
+START_TEST (log_complete_instruction)
+{
+	char ins[4] = "LDA";
+	uint8_t opcode = reverse_opcode_lut(&ins, IMM);
+
+	cpu->opcode = opcode;
+	cpu->PC = 0x9022;
+	cpu->mem[cpu->PC] = 0xC0; // immediate byte
+
+	run_logic_cycle_by_cycle(cpu, isa_info[opcode].decode_opcode
+	                        , isa_info[opcode].max_cycles - 1, EXECUTE);
+	isa_info[opcode].execute_opcode(cpu);
+	set_cpu_disassembler_trace(cpu, cpu->instruction, cpu->append_int, cpu->end);
+
+	ck_assert_str_eq("LDA #$C0", cpu->instruction);
+}
+END_TEST
+
+START_TEST (log_not_built_when_executing)
+{
+	char ins[4] = "LDA";
+	uint8_t opcode = reverse_opcode_lut(&ins, IMM);
+	strcpy(cpu->instruction, "untouched");
+
+	cpu->PC = 0x9022;
+	run_logic_cycle_by_cycle(cpu, isa_info[opcode].decode_opcode
+	                        , isa_info[opcode].max_cycles - 1, EXECUTE);
+	isa_info[opcode].execute_opcode(cpu);
+
+	ck_assert_str_eq("untouched", cpu->instruction);
+}
+END_TEST
+
+START_TEST (log_hardware_interrupts)
+{
+	const char* names[3] = {"DMA", "IRQ", "NMI"}; // order of hardware_interrupts[]
+	cpu->cpu_ppu_io = cpu_ppu_io_allocator();
+	cpu_ppu_io_init(cpu->cpu_ppu_io);
+	cpu->cpu_ppu_io->nmi_cycles_left = 0; // first cycle of each is a no-op
+	cpu->instruction_cycles_remaining = 0;
+
+	hardware_interrupts[_i](cpu);
+	set_cpu_disassembler_trace(cpu, cpu->instruction, cpu->append_int, cpu->end);
+
+	ck_assert_str_eq(names[_i], cpu->instruction);
+	free(cpu->cpu_ppu_io);
+}
+END_TEST
+
+
+
+/* Instruction stepping (cpu_step_instruction()) vs clock_cpu()
+ */
+Cpu6502* cycle_cpu; // reference cpu, clocked cycle by cycle
+CpuPpuShare* step_cpu_ppu;
+CpuPpuShare* cycle_cpu_ppu;
+
+void step_mode_setup(void)
+{
+	setup();
+	cycle_cpu = cpu_allocator();
+	step_cpu_ppu = cpu_ppu_io_allocator();
+	cycle_cpu_ppu = cpu_ppu_io_allocator();
+
+	if (!cycle_cpu || !step_cpu_ppu || !cycle_cpu_ppu) {
+		// fail, lack of memory
+		ck_abort_msg("Failed to allocate memory to cpu or cpu/ppu structs");
+	}
+
+	cpu_ppu_io_init(step_cpu_ppu);
+	cpu_ppu_io_init(cycle_cpu_ppu);
+	cpu_init(cpu, 0x0600, step_cpu_ppu, NULL);
+	cpu_init(cycle_cpu, 0x0600, cycle_cpu_ppu, NULL);
+}
+
+void step_mode_teardown(void)
+{
+	free(cycle_cpu_ppu);
+	free(step_cpu_ppu);
+	free(cycle_cpu);
+	teardown();
+}
+
+static unsigned clock_cpu_one_instruction(Cpu6502* cpu)
+{
+	unsigned start_cycle = cpu->cycle;
+
+	cpu->trigger_trace_logger = false;
+	while (!cpu->trigger_trace_logger) {
+		clock_cpu(cpu);
+	}
+
+	return cpu->cycle - start_cycle;
+}
+
+// same program/data for both cpus, the program runs from $0600
+static void load_step_mode_program(const uint8_t* program, size_t len)
+{
+	memcpy(&cpu->mem[0x0600], program, len);
+	memcpy(&cycle_cpu->mem[0x0600], program, len);
+}
+
+static void ck_assert_cpus_match(const Cpu6502* step, const Cpu6502* reference)
+{
+	ck_assert_uint_eq(reference->cycle, step->cycle);
+	ck_assert_uint_eq(reference->PC, step->PC);
+	ck_assert_uint_eq(reference->A, step->A);
+	ck_assert_uint_eq(reference->X, step->X);
+	ck_assert_uint_eq(reference->Y, step->Y);
+	ck_assert_uint_eq(reference->P, step->P);
+	ck_assert_uint_eq(reference->stack, step->stack);
+	ck_assert_uint_eq(reference->instruction_state, step->instruction_state);
+	ck_assert_int_eq(0, memcmp(reference->mem, step->mem, 0x0800));
+}
+
+START_TEST (step_instruction_matches_clock_cpu)
+{
+	const uint8_t program[] = {
+		0xA2, 0x05,             // $0600: LDX #$05
+		0xA9, 0x10,             // $0602: LDA #$10
+		0x85, 0x20,             // $0604: STA $20
+		0x9D, 0xF0, 0x02,       // $0606: STA $02F0,X
+		0xBD, 0xFE, 0x02,       // $0609: LDA $02FE,X (page cross)
+		0x1D, 0x00, 0x03,       // $060C: ORA $0300,X
+		0xF6, 0x20,             // $060F: INC $20,X
+		0x0E, 0x00, 0x03,       // $0611: ASL $0300
+		0xA0, 0x03,             // $0614: LDY #$03
+		0xB1, 0x20,             // $0616: LDA ($20),Y
+		0xA1, 0x1B,             // $0618: LDA ($1B,X)
+		0x48,                   // $061A: PHA
+		0x20, 0x30, 0x06,       // $061B: JSR $0630
+		0x68,                   // $061E: PLA
+		0x88,                   // $061F: DEY
+		0xD0, 0xFD,             // $0620: BNE $061F
+		0xB6, 0x1E,             // $0622: LDX $1E,Y
+		0x4C, 0xF0, 0x06,       // $0624: JMP $06F0
+	};
+	load_step_mode_program(program, sizeof(program));
+	// $0630: INX, RTS
+	cpu->mem[0x0630] = cycle_cpu->mem[0x0630] = 0xE8;
+	cpu->mem[0x0631] = cycle_cpu->mem[0x0631] = 0x60;
+	// $06F0: CLC, BCC $0713 (page cross)
+	cpu->mem[0x06F0] = cycle_cpu->mem[0x06F0] = 0x18;
+	cpu->mem[0x06F1] = cycle_cpu->mem[0x06F1] = 0x90;
+	cpu->mem[0x06F2] = cycle_cpu->mem[0x06F2] = 0x20;
+	// $0713: JMP $0713
+	cpu->mem[0x0713] = cycle_cpu->mem[0x0713] = 0x4C;
+	cpu->mem[0x0714] = cycle_cpu->mem[0x0714] = 0x13;
+	cpu->mem[0x0715] = cycle_cpu->mem[0x0715] = 0x07;
+
+	for (int i = 0; i < 32; i++) {
+		unsigned reference_cycles = clock_cpu_one_instruction(cycle_cpu);
+
+		ck_assert_uint_eq(reference_cycles, cpu_step_instruction(cpu));
+		ck_assert_cpus_match(cpu, cycle_cpu);
+	}
+	ck_assert_uint_eq(0x0713, cpu->PC);
+}
+END_TEST
+
+START_TEST (step_instruction_cycle_count)
+{
+	// Each instruction is followed by a page cross/no page cross variant
+	const uint8_t program[] = {
+		0xBD, 0xF0, 0x02,       // LDA $02F0,X (4 cycles)
+		0xBD, 0xFF, 0x02,       // LDA $02FF,X (5 cycles)
+		0x9D, 0xF0, 0x02,       // STA $02F0,X (5 cycles)
+		0xFE, 0xF0, 0x02,       // INC $02F0,X (7 cycles)
+		0x20, 0x20, 0x06,       // JSR $0620 (6 cycles)
+	};
+	const unsigned expected_cycles[] = { 4, 5, 5, 7, 6, 6 };
+	load_step_mode_program(program, sizeof(program));
+	cpu->mem[0x0620] = 0x60; // RTS (6 cycles)
+	cpu->X = 0x01;
+
+	for (size_t i = 0; i < sizeof(expected_cycles) / sizeof(expected_cycles[0]); i++) {
+		ck_assert_uint_eq(expected_cycles[i], cpu_step_instruction(cpu));
+	}
+	ck_assert_uint_eq(0x060F, cpu->PC);
+}
+END_TEST
+
+START_TEST (step_instruction_services_nmi)
+{
+	cpu->mem[NMI_VECTOR] = cycle_cpu->mem[NMI_VECTOR] = 0x00;
+	cpu->mem[NMI_VECTOR + 1] = cycle_cpu->mem[NMI_VECTOR + 1] = 0x07;
+	cpu->process_interrupt = cycle_cpu->process_interrupt = true;
+	step_cpu_ppu->nmi_pending = cycle_cpu_ppu->nmi_pending = true;
+
+	unsigned reference_cycles = clock_cpu_one_instruction(cycle_cpu);
+
+	ck_assert_uint_eq(7, reference_cycles);
+	ck_assert_uint_eq(7, cpu_step_instruction(cpu));
+	ck_assert_uint_eq(0x0700, cpu->PC);
+	ck_assert_cpus_match(cpu, cycle_cpu);
+}
+END_TEST
+
+/* Every legal opcode, the first 256 runs index with a page cross and
+ * branch on the clear flags, the rest don't cross and branch on set flags
+ */
+START_TEST (step_instruction_each_opcode_matches_clock_cpu)
+{
+	uint8_t opcode = _i & 0xFF;
+	bool page_cross = _i < 256;
+	if (!isa_info[opcode].max_cycles) {
+		return; // bad opcodes are covered by step_instruction_jammed_cpu_makes_progress
+	}
+
+	const uint8_t program[] = { opcode, 0xF8, 0x02 }; // $02F8 or $F8, branches go back to $05FA
+	load_step_mode_program(program, sizeof(program));
+	Cpu6502* cpus[] = { cpu, cycle_cpu };
+	for (int i = 0; i < 2; i++) {
+		cpus[i]->X = cpus[i]->Y = page_cross ? 0x10 : 0x01;
+		cpus[i]->P = page_cross ? 0x24 : 0xE7;
+		cpus[i]->mem[0x0008] = 0x40; // ($F8,X) with X = $10
+		cpus[i]->mem[0x0009] = 0x03;
+		cpus[i]->mem[0x00F8] = 0xF8; // ($F8),Y
+		cpus[i]->mem[0x00F9] = 0x03;
+		cpus[i]->mem[0x02F8] = 0x81; // JMP ($02F8) target and operand
+		cpus[i]->mem[0x02F9] = 0x07;
+		cpus[i]->mem[0x01FE] = 0x34; // RTS/RTI return address
+		cpus[i]->mem[0x01FF] = 0x12;
+		cpus[i]->stack = 0xFC;
+	}
+
+	unsigned reference_cycles = clock_cpu_one_instruction(cycle_cpu);
+
+	ck_assert_uint_eq(reference_cycles, cpu_step_instruction(cpu));
+	ck_assert_cpus_match(cpu, cycle_cpu);
+	ck_assert_uint_eq(cycle_cpu->address_mode, cpu->address_mode);
+	ck_assert_uint_eq(cycle_cpu->target_addr, cpu->target_addr);
+	ck_assert_uint_eq(cycle_cpu->address_bus, cpu->address_bus);
+	ck_assert_uint_eq(cycle_cpu->data_bus, cpu->data_bus);
+	ck_assert_uint_eq(cycle_cpu->instruction_cycles_remaining, cpu->instruction_cycles_remaining);
+}
+END_TEST
+
+/* FUSED_OPCODES is kept apart from isa_info, a legal opcode missing from it
+ * still passes step_instruction_each_opcode_matches_clock_cpu (through the
+ * isa_info fallback) so check the fused table covers exactly the legal opcodes
+ */
+START_TEST (step_instruction_fused_handler_for_each_legal_opcode)
+{
+	uint8_t opcode = _i;
+#ifdef CNES_FUSED_CPU
+	bool legal = isa_info[opcode].max_cycles;
+#else
+	bool legal = false;
+#endif
+	ck_assert_uint_eq(cpu_fused_opcode(opcode), legal);
+}
+END_TEST
+
+START_TEST (step_instruction_jammed_cpu_makes_progress)
+{
+	cpu->mem[0x0600] = 0x02; // bad opcode, never leaves the decode state
+
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(DECODE, cpu->instruction_state);
+	ck_assert_uint_eq(1, cpu_step_instruction(cpu));
+}
+END_TEST
+
+/* Block cache: two 16 KiB PRG banks, bank 0 is mapped to $8000 and $C000
+ */
+uint8_t* block_cache_prg_rom;
+BlockCache* block_cache;
+
+void block_cache_setup(void)
+{
+	step_mode_setup();
+	block_cache_prg_rom = calloc(2, 16 * KiB);
+	block_cache = block_cache_allocator();
+	CartMemory prg_rom = { block_cache_prg_rom, 32 * KiB };
+	if (!block_cache_prg_rom || !block_cache || block_cache_init(block_cache, &prg_rom)) {
+		ck_abort_msg("Failed to allocate memory to the block cache");
+	}
+
+	cpu_map_pages(cpu, 0x8000, 16 * KiB, block_cache_prg_rom, NULL);
+	cpu_map_pages(cpu, 0xC000, 16 * KiB, block_cache_prg_rom, NULL);
+	cpu_map_pages(cycle_cpu, 0x8000, 16 * KiB, block_cache_prg_rom, NULL);
+	cpu_map_pages(cycle_cpu, 0xC000, 16 * KiB, block_cache_prg_rom, NULL);
+	cpu->PC = cycle_cpu->PC = 0x8000;
+	cpu_attach_block_cache(cpu, block_cache);
+}
+
+void block_cache_teardown(void)
+{
+	block_cache_free(block_cache);
+	free(block_cache_prg_rom);
+	step_mode_teardown();
+}
+
+START_TEST (block_cache_matches_clock_cpu)
+{
+	const uint8_t program[] = {
+		0xA2, 0x03,             // $8000: LDX #$03
+		0xBD, 0xFE, 0x02,       // $8002: LDA $02FE,X (page cross)
+		0x95, 0x20,             // $8005: STA $20,X
+		0x6C, 0x10, 0x80,       // $8007: JMP ($8010)
+		0x00, 0x00, 0x00,
+		0x00, 0x00, 0x00,
+		0x20, 0x80,             // $8010: $8020
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xCA,                   // $8020: DEX
+		0xD0, 0xDF,             // $8021: BNE $8002
+		0x4C, 0x23, 0x80,       // $8023: JMP $8023
+	};
+	memcpy(block_cache_prg_rom, program, sizeof(program));
 
+	for (int i = 0; i < 24; i++) {
+		unsigned reference_cycles = clock_cpu_one_instruction(cycle_cpu);
+
+		ck_assert_uint_eq(reference_cycles, cpu_step_instruction(cpu));
+		ck_assert_cpus_match(cpu, cycle_cpu);
+		ck_assert_uint_eq(cycle_cpu->data_bus, cpu->data_bus);
+	}
+	ck_assert_uint_eq(0x8023, cpu->PC);
+}
+END_TEST
+
+START_TEST (block_cache_decodes_whole_blocks)
+{
+	const uint8_t program[] = {
+		0xA9, 0x01,             // $8000: LDA #$01
+		0x8D, 0x00, 0x02,       // $8002: STA $0200
+		0xD0, 0xF9,             // $8005: BNE $8000 (ends the block)
+		0xEA,                   // $8007: NOP
+	};
+	memcpy(block_cache_prg_rom, program, sizeof(program));
+
+	const struct DecodedInstruction* lda = block_cache_next(block_cache, cpu);
+	ck_assert_ptr_ne(lda, NULL);
+	ck_assert_uint_eq(0xA9, lda->opcode);
+	ck_assert_uint_eq(0x01, lda->operand_lo);
+	ck_assert_uint_eq(2, lda->length);
+	ck_assert(!lda->ends_block);
+
+	// the rest of the block was decoded with the first instruction
+	const struct DecodedInstruction* sta = lda + lda->length;
+	const struct DecodedInstruction* bne = sta + sta->length;
+	ck_assert_uint_eq(0x8D, sta->opcode);
+	ck_assert_uint_eq(0x00, sta->operand_lo);
+	ck_assert_uint_eq(0x02, sta->operand_hi);
+	ck_assert_uint_eq(0xD0, bne->opcode);
+	ck_assert(bne->ends_block);
+	ck_assert_uint_eq(0, bne[bne->length].length); // NOP is in the next block
+}
+END_TEST
+
+START_TEST (block_cache_follows_bank_switch)
+{
+	block_cache_prg_rom[0x0000] = 0xA9; // bank 0, $8000: LDA #$11
+	block_cache_prg_rom[0x0001] = 0x11;
+	block_cache_prg_rom[0x4000] = 0xA9; // bank 1, $8000: LDA #$22
+	block_cache_prg_rom[0x4001] = 0x22;
+
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(0x11, cpu->A);
+
+	cpu_map_pages(cpu, 0x8000, 16 * KiB, block_cache_prg_rom + 16 * KiB, NULL);
+	cpu->PC = 0x8000;
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(0x22, cpu->A);
+}
+END_TEST
+
+START_TEST (block_cache_skips_ram)
+{
+	cpu->PC = 0x0600;
+	cpu->mem[0x0600] = 0xA9; // LDA #$11
+	cpu->mem[0x0601] = 0x11;
+	ck_assert_ptr_eq(NULL, block_cache_next(block_cache, cpu));
+
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(0x11, cpu->A);
+
+	// self modifying code is picked up
+	cpu->mem[0x0601] = 0x22;
+	cpu->PC = 0x0600;
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(0x22, cpu->A);
+}
+END_TEST
+
+/* Recompiler: same PRG ROM layout as the block cache tests, blocks are
+ * compiled on their first run and checked against the interpreter (verify)
+ */
+uint8_t* jit_prg_rom;
+Jit* jit;
+
+void jit_setup(void)
+{
+	step_mode_setup();
+	jit_prg_rom = calloc(2, 16 * KiB);
+	if (!jit_prg_rom) {
+		ck_abort_msg("Failed to allocate memory to the JIT PRG ROM");
+	}
+
+	cpu_map_pages(cpu, 0x8000, 16 * KiB, jit_prg_rom, NULL);
+	cpu_map_pages(cpu, 0xC000, 16 * KiB, jit_prg_rom, NULL);
+	cpu_map_pages(cycle_cpu, 0x8000, 16 * KiB, jit_prg_rom, NULL);
+	cpu_map_pages(cycle_cpu, 0xC000, 16 * KiB, jit_prg_rom, NULL);
+	cpu->PC = cycle_cpu->PC = 0x8000;
+
+	jit = NULL;
+	if (jit_supported()) {
+		jit = jit_allocator();
+		CartMemory prg_rom = { jit_prg_rom, 32 * KiB };
+		if (!jit || jit_init(jit, &prg_rom, true)) {
+			ck_abort_msg("Failed to initialise the JIT");
+		}
+		jit->hot_runs = 0;
+		cpu_attach_jit(cpu, jit);
+	}
+}
+
+void jit_teardown(void)
+{
+	jit_free(jit);
+	free(jit_prg_rom);
+	step_mode_teardown();
+}
+
+// runs the reference cpu up to the same cycle, blocks step many instructions at once
+static void clock_cpu_to_cycle_of(Cpu6502* reference, const Cpu6502* step)
+{
+	while (reference->cycle < step->cycle) {
+		clock_cpu_one_instruction(reference);
+	}
+}
+
+/* Every legal opcode as a one instruction block, set up like step_instruction_each_opcode_matches_clock_cpu
+ */
+START_TEST (jit_each_opcode_matches_clock_cpu)
+{
+	uint8_t opcode = _i & 0xFF;
+	bool page_cross = _i < 256;
+	if (!jit || !isa_info[opcode].max_cycles) {
+		return;
+	}
+
+	jit_prg_rom[0] = opcode;
+	jit_prg_rom[1] = 0xF8; // $02F8 or $F8, branches go back to $7FFB
+	jit_prg_rom[2] = 0x02; // bad opcode, ends 2 byte instruction blocks
+	if (cpu_instruction_length(opcode) == 1) {
+		jit_prg_rom[1] = 0x00; // BRK
+	}
+	Cpu6502* cpus[] = { cpu, cycle_cpu };
+	for (int i = 0; i < 2; i++) {
+		cpus[i]->X = cpus[i]->Y = page_cross ? 0x10 : 0x01;
+		cpus[i]->P = page_cross ? 0x24 : 0xE7;
+		cpus[i]->mem[0x0008] = 0x40; // ($F8,X) with X = $10
+		cpus[i]->mem[0x0009] = 0x03;
+		cpus[i]->mem[0x00F8] = 0xF8; // ($F8),Y
+		cpus[i]->mem[0x00F9] = 0x03;
+		cpus[i]->mem[0x02F8] = 0x81; // JMP ($02F8) target and operand
+		cpus[i]->mem[0x02F9] = 0x07;
+		cpus[i]->mem[0x01FE] = 0x34; // RTS/RTI return address
+		cpus[i]->mem[0x01FF] = 0x12;
+		cpus[i]->stack = 0xFC;
+	}
+
+	unsigned reference_cycles = clock_cpu_one_instruction(cycle_cpu);
+
+	ck_assert_uint_eq(reference_cycles, cpu_step_instruction(cpu));
+	ck_assert_cpus_match(cpu, cycle_cpu);
+	ck_assert_uint_eq(cycle_cpu->data_bus, cpu->data_bus);
+	ck_assert_uint_eq(cycle_cpu->opcode, cpu->opcode);
+	// BRK/RTI stay with the interpreter, RTS leaves the block as it returns to $3400 (I/O)
+	bool interpreted = (opcode == 0x00) || (opcode == 0x40) || (opcode == 0x60);
+	ck_assert_uint_eq(interpreted ? 0 : 1, jit->instructions);
+	ck_assert_uint_eq(0, jit->mismatches);
+}
+END_TEST
+
+START_TEST (jit_matches_clock_cpu)
+{
+	if (!jit) {
+		return;
+	}
+
+	const uint8_t program[] = {
+		0xA2, 0x08,             // $8000: LDX #$08
+		0xA9, 0x7F,             // $8002: LDA #$7F
+		0x18,                   // $8004: CLC
+		0x7D, 0xFC, 0x02,       // $8005: ADC $02FC,X (page cross for X >= 4)
+		0x95, 0x20,             // $8008: STA $20,X
+		0x36, 0x20,             // $800A: ROL $20,X
+		0xE9, 0x10,             // $800C: SBC #$10
+		0xC5, 0x21,             // $800E: CMP $21
+		0x48,                   // $8010: PHA
+		0x28,                   // $8011: PLP
+		0x20, 0x30, 0x80,       // $8012: JSR $8030
+		0xCA,                   // $8015: DEX
+		0xD0, 0xEA,             // $8016: BNE $8002
+		0x4C, 0x18, 0x80,       // $8018: JMP $8018
+	};
+	const uint8_t subroutine[] = {
+		0xFE, 0x00, 0x03,       // $8030: INC $0300,X
+		0xA0, 0x02,             // $8033: LDY #$02
+		0x51, 0x40,             // $8035: EOR ($40),Y
+		0x60,                   // $8037: RTS
+	};
+	memcpy(jit_prg_rom, program, sizeof(program));
+	memcpy(&jit_prg_rom[0x30], subroutine, sizeof(subroutine));
+	cpu->mem[0x0041] = cycle_cpu->mem[0x0041] = 0x03; // ($40) = $0300
+
+	for (int i = 0; (i < 100) && (cpu->PC != 0x8018); i++) {
+		cpu_step_instruction(cpu);
+		clock_cpu_to_cycle_of(cycle_cpu, cpu);
+
+		ck_assert_cpus_match(cpu, cycle_cpu);
+		ck_assert_uint_eq(cycle_cpu->data_bus, cpu->data_bus);
+	}
+	ck_assert_uint_eq(0x8018, cpu->PC);
+	ck_assert_uint_ne(0, jit->blocks_compiled);
+	ck_assert_uint_eq(0, jit->mismatches);
+}
+END_TEST
+
+START_TEST (jit_exits_at_io_pages)
+{
+	if (!jit) {
+		return;
+	}
+
+	uint8_t host_page[CPU_PAGE_SIZE] = {0};
+	cpu_map_pages(cpu, 0x4F00, sizeof(host_page), host_page, host_page);
+	cpu_map_io_pages(cpu, 0x5000, 0x1000, test_io_read, test_io_write);
+	const uint8_t program[] = {
+		0xA2, 0x10,             // $8000: LDX #$10
+		0xA9, 0x42,             // $8002: LDA #$42
+		0x8D, 0x00, 0x50,       // $8004: STA $5000 (never compiled)
+		0xE8,                   // $8007: INX
+		0x9D, 0xF0, 0x4F,       // $8008: STA $4FF0,X (I/O at run time)
+		0x4C, 0x0B, 0x80,       // $800B: JMP $800B
+	};
+	memcpy(jit_prg_rom, program, sizeof(program));
+
+	// the first block stops before the static I/O access
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(0x8004, cpu->PC);
+	ck_assert_uint_eq(2, jit->instructions);
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(0x5000, io_handler_addr);
+	ck_assert_uint_eq(0x42, io_handler_val);
+
+	// the second leaves the block before the store, the interpreter does it
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(0x8008, cpu->PC);
+	ck_assert_uint_eq(0x11, cpu->X);
+	ck_assert_uint_eq(3, jit->instructions);
+	ck_assert_uint_eq(0x5000, io_handler_addr);
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(0x5001, io_handler_addr);
+	ck_assert_uint_eq(0x800B, cpu->PC);
+	ck_assert_uint_eq(0, jit->mismatches);
+}
+END_TEST
+
+START_TEST (jit_follows_bank_switch)
+{
+	if (!jit) {
+		return;
+	}
+
+	jit_prg_rom[0x0000] = 0xA9; // bank 0, $8000: LDA #$11
+	jit_prg_rom[0x0001] = 0x11;
+	jit_prg_rom[0x4000] = 0xA9; // bank 1, $8000: LDA #$22
+	jit_prg_rom[0x4001] = 0x22;
+
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(0x11, cpu->A);
+
+	cpu_map_pages(cpu, 0x8000, 16 * KiB, jit_prg_rom + 16 * KiB, NULL);
+	cpu->PC = 0x8000;
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(0x22, cpu->A);
+	ck_assert_uint_eq(2, jit->blocks_compiled);
+}
+END_TEST
+
+START_TEST (jit_skips_ram)
+{
+	if (!jit) {
+		return;
+	}
+
+	cpu->PC = 0x0600;
+	cpu->mem[0x0600] = 0xA9; // LDA #$11
+	cpu->mem[0x0601] = 0x11;
+
+	cpu_step_instruction(cpu);
+	ck_assert_uint_eq(0x11, cpu->A);
+	ck_assert_uint_eq(0, jit->blocks_compiled);
+	ck_assert_uint_eq(0, jit->instructions);
+}
+END_TEST
 
 Suite* cpu_master_suite(void)
 {
@@ -7058,6 +7815,7 @@ Suite* cpu_memory_access_suite(void)
 	TCase* tc_cpu_writes;
 	TCase* tc_cpu_stack_op;
 	TCase* tc_cpu_open_bus;
+	TCase* tc_cpu_memory_map;
 
 	s = suite_create("Cpu Memory Access Tests (RAM/Stack etc.)");
 
@@ -7112,6 +7870,13 @@ Suite* cpu_memory_access_suite(void)
 	tcase_add_test(tc_cpu_open_bus, open_bus_reads_absx_rmw_t3_dummy_read);
 	tcase_add_test(tc_cpu_open_bus, open_bus_reads_absx_rmw_t4_indexed_read);
 	suite_add_tcase(s, tc_cpu_open_bus);
+	tc_cpu_memory_map = tcase_create("Cpu Memory Map");
+	tcase_add_checked_fixture(tc_cpu_memory_map, mapper_setup, mapper_teardown);
+	tcase_add_test(tc_cpu_memory_map, memory_map_direct_pages);
+	tcase_add_test(tc_cpu_memory_map, memory_map_read_only_pages);
+	tcase_add_test(tc_cpu_memory_map, memory_map_io_pages);
+	tcase_add_test(tc_cpu_memory_map, oam_dma_skips_io_read_handlers);
+	suite_add_tcase(s, tc_cpu_memory_map);
 
 	return s;
 }
@@ -7144,6 +7909,7 @@ Suite* cpu_address_mode_final_address_suite(void)
 {
 	Suite* s;
 	TCase* tc_address_modes;
+	TCase* tc_address_modes_stepping;
 
 	s = suite_create("Cpu Address Modes Final Address Tests");
 
@@ -7174,6 +7940,33 @@ Suite* cpu_address_mode_final_address_suite(void)
 	tcase_add_test(tc_address_modes, addr_mode_indy_read_store_page_cross);
 	tcase_add_test(tc_address_modes, addr_mode_indy_read_store_STx_no_page_cross);
 	suite_add_tcase(s, tc_address_modes);
+	tc_address_modes_stepping = tcase_create("Address Modes Correct Address (Instruction Stepping)");
+	tcase_add_checked_fixture(tc_address_modes_stepping, instruction_step_setup, teardown);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_imm);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_abs_read_store);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_abs_rmw);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_abs_jmp);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_absx_read_store);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_absx_read_store_page_cross);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_absx_read_store_STx_no_page_cross);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_absx_rmw);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_absy_read_store);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_absy_read_store_page_cross);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_absy_read_store_STx_no_page_cross);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_zp_read_store);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_zp_rmw);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_zpx_read_store);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_zpx_read_store_page_cross);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_zpx_rmw);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_zpy_read_store);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_zpy_read_store_page_cross);
+	tcase_add_test(tc_address_modes_stepping, ind_jmp);
+	tcase_add_test(tc_address_modes_stepping, ind_jmp_bug);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_indx_read_store);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_indy_read_store);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_indy_read_store_page_cross);
+	tcase_add_test(tc_address_modes_stepping, addr_mode_indy_read_store_STx_no_page_cross);
+	suite_add_tcase(s, tc_address_modes_stepping);
 
 	return s;
 }
@@ -7184,6 +7977,9 @@ Suite* cpu_branch_address_suite(void)
 	TCase* tc_branch_not_taken_addr;
 	TCase* tc_branch_taken_addr;
 	TCase* tc_branch_take_page_cross;
+	TCase* tc_branch_not_taken_addr_stepping;
+	TCase* tc_branch_taken_addr_stepping;
+	TCase* tc_branch_take_page_cross_stepping;
 
 	s = suite_create("Branch Address Tests");
 
@@ -7220,6 +8016,39 @@ Suite* cpu_branch_address_suite(void)
 	tcase_add_test(tc_branch_take_page_cross, bvc_take_page_cross_correct_addr);
 	tcase_add_test(tc_branch_take_page_cross, bvs_take_page_cross_correct_addr);
 	suite_add_tcase(s, tc_branch_take_page_cross);
+	tc_branch_not_taken_addr_stepping = tcase_create("Branch Not Taken Correct Address (Instruction Stepping)");
+	tcase_add_checked_fixture(tc_branch_not_taken_addr_stepping, instruction_step_setup, teardown);
+	tcase_add_test(tc_branch_not_taken_addr_stepping, bcc_not_taken_correct_addr);
+	tcase_add_test(tc_branch_not_taken_addr_stepping, bcs_not_taken_correct_addr);
+	tcase_add_test(tc_branch_not_taken_addr_stepping, beq_not_taken_correct_addr);
+	tcase_add_test(tc_branch_not_taken_addr_stepping, bmi_not_taken_correct_addr);
+	tcase_add_test(tc_branch_not_taken_addr_stepping, bne_not_taken_correct_addr);
+	tcase_add_test(tc_branch_not_taken_addr_stepping, bpl_not_taken_correct_addr);
+	tcase_add_test(tc_branch_not_taken_addr_stepping, bvc_not_taken_correct_addr);
+	tcase_add_test(tc_branch_not_taken_addr_stepping, bvs_not_taken_correct_addr);
+	suite_add_tcase(s, tc_branch_not_taken_addr_stepping);
+	tc_branch_taken_addr_stepping = tcase_create("Branch Taken Correct Address (Instruction Stepping)");
+	tcase_add_checked_fixture(tc_branch_taken_addr_stepping, instruction_step_setup, teardown);
+	tcase_add_test(tc_branch_taken_addr_stepping, bcc_taken_correct_addr);
+	tcase_add_test(tc_branch_taken_addr_stepping, bcs_taken_correct_addr);
+	tcase_add_test(tc_branch_taken_addr_stepping, beq_taken_correct_addr);
+	tcase_add_test(tc_branch_taken_addr_stepping, bmi_taken_correct_addr);
+	tcase_add_test(tc_branch_taken_addr_stepping, bne_taken_correct_addr);
+	tcase_add_test(tc_branch_taken_addr_stepping, bpl_taken_correct_addr);
+	tcase_add_test(tc_branch_taken_addr_stepping, bvc_taken_correct_addr);
+	tcase_add_test(tc_branch_taken_addr_stepping, bvs_taken_correct_addr);
+	suite_add_tcase(s, tc_branch_taken_addr_stepping);
+	tc_branch_take_page_cross_stepping = tcase_create("Branch Taken Correct Page Cross Address (Instruction Stepping)");
+	tcase_add_checked_fixture(tc_branch_take_page_cross_stepping, instruction_step_setup, teardown);
+	tcase_add_test(tc_branch_take_page_cross_stepping, bcc_take_page_cross_correct_addr);
+	tcase_add_test(tc_branch_take_page_cross_stepping, bcs_take_page_cross_correct_addr);
+	tcase_add_test(tc_branch_take_page_cross_stepping, beq_take_page_cross_correct_addr);
+	tcase_add_test(tc_branch_take_page_cross_stepping, bmi_take_page_cross_correct_addr);
+	tcase_add_test(tc_branch_take_page_cross_stepping, bne_take_page_cross_correct_addr);
+	tcase_add_test(tc_branch_take_page_cross_stepping, bpl_take_page_cross_correct_addr);
+	tcase_add_test(tc_branch_take_page_cross_stepping, bvc_take_page_cross_correct_addr);
+	tcase_add_test(tc_branch_take_page_cross_stepping, bvs_take_page_cross_correct_addr);
+	suite_add_tcase(s, tc_branch_take_page_cross_stepping);
 
 	return s;
 }
@@ -7585,7 +8414,48 @@ Suite* cpu_trace_logger_suite(void)
 	tcase_add_loop_test(tc_cpu_address_mode, log_zpx_data, 0, 3);
 	tcase_add_loop_test(tc_cpu_address_mode, log_zpy_data, 0, 2);
 	tcase_add_test(tc_cpu_address_mode, log_jsr_data);
+	tcase_add_test(tc_cpu_address_mode, log_complete_instruction);
+	tcase_add_test(tc_cpu_address_mode, log_not_built_when_executing);
+	tcase_add_loop_test(tc_cpu_address_mode, log_hardware_interrupts, 0, 3);
 	suite_add_tcase(s, tc_cpu_address_mode);
 
 	return s;
 }
+
+Suite* cpu_instruction_stepping_suite(void)
+{
+	Suite* s;
+	TCase* tc_step_instruction;
+	TCase* tc_block_cache;
+	TCase* tc_jit;
+
+	s = suite_create("Cpu Instruction Stepping Tests");
+
+	tc_step_instruction = tcase_create("Instruction Stepping Matches Cycle-By-Cycle Execution");
+	tcase_add_checked_fixture(tc_step_instruction, step_mode_setup, step_mode_teardown);
+	tcase_add_test(tc_step_instruction, step_instruction_matches_clock_cpu);
+	tcase_add_test(tc_step_instruction, step_instruction_cycle_count);
+	tcase_add_test(tc_step_instruction, step_instruction_services_nmi);
+	tcase_add_test(tc_step_instruction, step_instruction_jammed_cpu_makes_progress);
+	tcase_add_loop_test(tc_step_instruction, step_instruction_each_opcode_matches_clock_cpu, 0, 512);
+	tcase_add_loop_test(tc_step_instruction, step_instruction_fused_handler_for_each_legal_opcode, 0, 256);
+	suite_add_tcase(s, tc_step_instruction);
+	tc_block_cache = tcase_create("Predecoded PRG ROM Block Cache");
+	tcase_add_checked_fixture(tc_block_cache, block_cache_setup, block_cache_teardown);
+	tcase_add_test(tc_block_cache, block_cache_matches_clock_cpu);
+	tcase_add_test(tc_block_cache, block_cache_decodes_whole_blocks);
+	tcase_add_test(tc_block_cache, block_cache_follows_bank_switch);
+	tcase_add_test(tc_block_cache, block_cache_skips_ram);
+	suite_add_tcase(s, tc_block_cache);
+
+	tc_jit = tcase_create("x86-64 Block Recompiler");
+	tcase_add_checked_fixture(tc_jit, jit_setup, jit_teardown);
+	tcase_add_loop_test(tc_jit, jit_each_opcode_matches_clock_cpu, 0, 512);
+	tcase_add_test(tc_jit, jit_matches_clock_cpu);
+	tcase_add_test(tc_jit, jit_exits_at_io_pages);
+	tcase_add_test(tc_jit, jit_follows_bank_switch);
+	tcase_add_test(tc_jit, jit_skips_ram);
+	suite_add_tcase(s, tc_jit);
+
+	return s;
+}
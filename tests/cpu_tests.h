@@ -11,5 +11,6 @@ Suite* cpu_single_cycle_suite(void);
 Suite* cpu_isa_suite(void);
 Suite* cpu_hardware_interrupts_suite(void);
 Suite* cpu_trace_logger_suite(void);
+Suite* cpu_instruction_stepping_suite(void);
 
 #endif /* __CPU_TESTS__ */
@@ -43,6 +43,7 @@ static void cpu_setup(void)
 		// malloc fails
 		ck_abort_msg("Failed to allocate memory to cpu struct");
 	}
+	cpu_default_memory_map(mp_cpu);
 }
 
 static void cpu_teardown(void)
@@ -57,6 +58,10 @@ static void cpu_mapper_setup(void)
 		// malloc fails
 		ck_abort_msg("Failed to allocate memory to cpu/mapper struct");
 	}
+	// MMC1 serial port starts empty
+	cpu_mapper_tester->mmc1_write_count = 0;
+	cpu_mapper_tester->mmc1_shift_reg = 0;
+	cpu_mapper_tester->mmc1_write_cycle = 0;
 }
 
 static void cpu_mapper_teardown(void)
@@ -144,7 +149,6 @@ START_TEST (mapper_000_prg_rom_banks)
 	mp_cart->prg_rom.data = prg_window;
 	mp_cart->chr_rom.size = 0;
 	// Mirror prg_banks into arrays so we can check the result
-	// as the prg_rom.data is free'd by the mapper_000() function
 	uint8_t prg_array_1[16 * KiB] = {0}; // 1st 16K bank
 	uint8_t prg_array_2[16 * KiB] = {0}; // 2nd 16K bank
 
@@ -157,9 +161,12 @@ START_TEST (mapper_000_prg_rom_banks)
 	init_mapper(mp_cart, mp_cpu, mp_ppu);
 
 
-	ck_assert_mem_eq(&mp_cpu->mem[0x8000], &prg_array_1[0], 16 * KiB);
-	ck_assert_mem_eq(&mp_cpu->mem[0xC000], &prg_array_2[0], 16 * KiB);
-	// prg rom free'ing is handled by mapper 0 function
+	ck_assert_mem_eq(mp_cpu->read_page[0x80], &prg_array_1[0], 16 * KiB);
+	ck_assert_mem_eq(mp_cpu->read_page[0xC0], &prg_array_2[0], 16 * KiB);
+	// PRG ROM is mapped in place, not copied
+	ck_assert_ptr_eq(prg_window, mp_cpu->read_page[0x80]);
+	ck_assert_ptr_eq(prg_window + (_i ? 16 * KiB : 0), mp_cpu->read_page[0xC0]);
+	free(prg_window);
 }
 
 START_TEST (mapper_000_chr_rom_banks)
@@ -172,8 +179,7 @@ START_TEST (mapper_000_chr_rom_banks)
 	uint8_t* chr_window = calloc(8 * KiB, sizeof(uint8_t));
 	mp_cart->chr_rom.data = chr_window;
 	mp_cart->chr_rom.size = 8 * KiB; // chr data is always 8K for mapper 0
-	// Mirror prg_banks into arrays so we can check the result
-	// as the prg_rom.data is free'd by the mapper_000() function
+	// Mirror chr_banks into arrays so we can check the result
 	uint8_t chr_array_1[4 * KiB] = {0};
 	uint8_t chr_array_2[4 * KiB] = {0};
 	// Need to set prg data too otherwise we get segfaults (prg data is parsed before chr)
@@ -196,7 +202,7 @@ START_TEST (mapper_000_chr_rom_banks)
 	ck_assert_mem_eq(&mp_ppu->vram.pattern_table_4k[0x0000], &chr_array_2[0], 4 * KiB);
 
 	free(chr_window); // must manually free chr rom
-	// prg rom free'ing is handled by mapper 0 function
+	free(prg_window);
 }
 
 START_TEST (mapper_000_unmapped_open_bus_reads)
@@ -268,6 +274,70 @@ START_TEST (mapper_001_five_writes_selects_reg)
 	ck_assert_uint_eq(cpu_mapper_tester->chr_bank_size, chr_bank_size[_i]);
 }
 
+START_TEST (mapper_001_adjacent_write_ignored_past_32_bit_cycles)
+{
+	// a long session, the cpu clock crosses 2^32 cycles mid sequence
+	cpu_mapper_tester->mapper_number = 1;
+	cpu_mapper_tester->prg_rom_bank_size = 16; // changing this through MMC1 reg
+	cpu_mapper_tester->chr_bank_size = 4; // changing this through MMC1 reg
+	mp_cpu->cycle = (1ULL << 32) - 11;
+	uint16_t ctrl_reg = 0x9000; // $8000 to $9FFF
+
+	for (int i = 0; i < 3; ++i) {
+		mapper_write(mp_cpu, ctrl_reg, 0x00); // 3 writes (buffer: xx000)
+		mp_cpu->cycle += 5;
+	}
+	mp_cpu->cycle -= 4; // 2^32
+	mapper_write(mp_cpu, ctrl_reg, 0x01); // adjacent to the last write, ignored
+	for (int i = 0; i < 2; ++i) {
+		mp_cpu->cycle += 5;
+		mapper_write(mp_cpu, ctrl_reg, 0x00); // (buffer: 00000)
+	}
+
+	ck_assert_uint_gt(mp_cpu->cycle, UINT32_MAX);
+	ck_assert_uint_eq(cpu_mapper_tester->prg_rom_bank_size, 32);
+	ck_assert_uint_eq(cpu_mapper_tester->chr_bank_size, 8);
+}
+
+START_TEST (mapper_001_serial_port_is_per_instance)
+{
+	// Two consoles, their serial writes are interleaved
+	CpuMapperShare second_mapper = *cpu_mapper_tester;
+	cpu_mapper_tester->mapper_number = 1;
+	cpu_mapper_tester->prg_rom_bank_size = 16;
+	cpu_mapper_tester->chr_bank_size = 4;
+	second_mapper.mapper_number = 1;
+	second_mapper.prg_rom_bank_size = 32;
+	second_mapper.chr_bank_size = 8;
+	mp_cpu->cycle = 13;
+	uint16_t ctrl_reg = 0x9000; // $8000 to $9FFF
+
+	// 4 of 5 writes to the 1st console (buffer: x0000)
+	for (int i = 0; i < 4; ++i) {
+		mapper_write(mp_cpu, ctrl_reg, 0x00);
+		mp_cpu->cycle += 5;
+	}
+
+	// all 5 writes to the 2nd console (buffer: 11000)
+	mp_cpu->cpu_mapper_io = &second_mapper;
+	uint8_t second_writes[5] = {0x00, 0x00, 0x00, 0x01, 0x01};
+	for (int i = 0; i < 5; ++i) {
+		mapper_write(mp_cpu, ctrl_reg, second_writes[i]);
+		mp_cpu->cycle += 5;
+	}
+	ck_assert_uint_eq(second_mapper.prg_rom_bank_size, 16);
+	ck_assert_uint_eq(second_mapper.chr_bank_size, 4);
+	// 1st console is still waiting on its 5th write
+	ck_assert_uint_eq(cpu_mapper_tester->prg_rom_bank_size, 16);
+	ck_assert_uint_eq(cpu_mapper_tester->chr_bank_size, 4);
+
+	// last write to the 1st console (buffer: 00000)
+	mp_cpu->cpu_mapper_io = cpu_mapper_tester;
+	mapper_write(mp_cpu, ctrl_reg, 0x00);
+	ck_assert_uint_eq(cpu_mapper_tester->prg_rom_bank_size, 32);
+	ck_assert_uint_eq(cpu_mapper_tester->chr_bank_size, 8);
+}
+
 START_TEST (mapper_001_reset_cancels_five_writes)
 {
 	cpu_mapper_tester->mapper_number = 1;
@@ -962,7 +1032,7 @@ START_TEST (mapper_001_reg3_prg_bank_select_32k)
 	mp_cpu->cycle += 5;
 
 
-	ck_assert_mem_eq(&mp_cpu->mem[0x8000]
+	ck_assert_mem_eq(mp_cpu->read_page[0x80]
 	                , prg_window + (bank_select >> 1) * 32 * KiB
 	                , 32 * KiB);
 	free(prg_window);
@@ -1004,11 +1074,11 @@ START_TEST (mapper_001_reg3_prg_lo_bank_select_16k)
 
 
 	// First prg rom bank is swappable
-	ck_assert_mem_eq(&mp_cpu->mem[0x8000]
+	ck_assert_mem_eq(mp_cpu->read_page[0x80]
 	                , prg_window + bank_select * 16 * KiB
 	                , 16 * KiB);
 	// Last prg rom bank is fixed to the last 16K prg bank
-	ck_assert_mem_eq(&mp_cpu->mem[0xC000]
+	ck_assert_mem_eq(mp_cpu->read_page[0xC0]
 	                , prg_window + (total_banks - 1) * 16 * KiB
 	                , 16 * KiB);
 	free(prg_window);
@@ -1049,11 +1119,11 @@ START_TEST (mapper_001_reg3_prg_hi_bank_select_16k)
 
 
 	// First prg rom bank is fixed to the first 16K bank
-	ck_assert_mem_eq(&mp_cpu->mem[0x8000]
+	ck_assert_mem_eq(mp_cpu->read_page[0x80]
 	                , prg_window
 	                , 16 * KiB);
 	// Last prg rom bank is swappable
-	ck_assert_mem_eq(&mp_cpu->mem[0xC000]
+	ck_assert_mem_eq(mp_cpu->read_page[0xC0]
 	                , prg_window + bank_select * 16 * KiB
 	                , 16 * KiB);
 	free(prg_window);
@@ -1089,7 +1159,7 @@ START_TEST (mapper_001_reg3_prg_bank_select_32k_ignore_high_bits)
 	mp_cpu->cycle += 5;
 
 
-	ck_assert_mem_eq(&mp_cpu->mem[0x8000]
+	ck_assert_mem_eq(mp_cpu->read_page[0x80]
 	                , prg_window + ((bank_select & 0x07) >> 1) * 32 * KiB
 	                , 32 * KiB);
 	free(prg_window);
@@ -1131,11 +1201,11 @@ START_TEST (mapper_001_reg3_prg_lo_bank_select_16k_ignore_high_bits)
 
 
 	// First prg rom bank is swappable, only lowest 2 bits are used in 64K ROM
-	ck_assert_mem_eq(&mp_cpu->mem[0x8000]
+	ck_assert_mem_eq(mp_cpu->read_page[0x80]
 	                , prg_window + (bank_select & 0x03) * 16 * KiB
 	                , 16 * KiB);
 	// Last prg rom bank is fixed to the last 16K prg bank
-	ck_assert_mem_eq(&mp_cpu->mem[0xC000]
+	ck_assert_mem_eq(mp_cpu->read_page[0xC0]
 	                , prg_window + (total_banks - 1) * 16 * KiB
 	                , 16 * KiB);
 	free(prg_window);
@@ -1176,11 +1246,11 @@ START_TEST (mapper_001_reg3_prg_hi_bank_select_16k_ignore_high_bits)
 
 
 	// First prg rom bank is fixed to the first 16K bank
-	ck_assert_mem_eq(&mp_cpu->mem[0x8000]
+	ck_assert_mem_eq(mp_cpu->read_page[0x80]
 	                , prg_window
 	                , 16 * KiB);
 	// Last prg rom bank is swappable, only lowest 3 bits are used in 128K ROM
-	ck_assert_mem_eq(&mp_cpu->mem[0xC000]
+	ck_assert_mem_eq(mp_cpu->read_page[0xC0]
 	                , prg_window + (bank_select & 0x07) * 16 * KiB
 	                , 16 * KiB);
 	free(prg_window);
@@ -1225,6 +1295,14 @@ START_TEST (mapper_001_reg3_prg_ram_enable_bit)
 
 
 	ck_assert_uint_eq(cpu_mapper_tester->enable_prg_ram, expected_val[_i]);
+	// enabled PRG RAM is mapped directly, otherwise reads/writes go via the mapper
+	if (expected_val[_i]) {
+		ck_assert_ptr_eq(&mp_cpu->mem[0x6000], mp_cpu->read_page[0x60]);
+		ck_assert_ptr_eq(&mp_cpu->mem[0x7F00], mp_cpu->write_page[0x7F]);
+	} else {
+		ck_assert_ptr_eq(NULL, mp_cpu->read_page[0x60]);
+		ck_assert_ptr_eq(NULL, mp_cpu->write_page[0x7F]);
+	}
 
 	free(prg_window);
 }
@@ -1326,6 +1404,8 @@ Suite* mapper_001_suite(void)
 	tcase_add_checked_fixture(tc_mmc1_registers, setup, teardown);
 	tcase_add_test(tc_mmc1_registers, mapper_001_last_write_selects_reg);
 	tcase_add_loop_test(tc_mmc1_registers, mapper_001_five_writes_selects_reg, 0, 5);
+	tcase_add_test(tc_mmc1_registers, mapper_001_adjacent_write_ignored_past_32_bit_cycles);
+	tcase_add_test(tc_mmc1_registers, mapper_001_serial_port_is_per_instance);
 	tcase_add_loop_test(tc_mmc1_registers, mapper_001_reset_cancels_five_writes, 0, 5);
 	tcase_add_loop_test(tc_mmc1_registers, mapper_001_reset_requires_five_more_writes, 0, 5);
 	suite_add_tcase(s, tc_mmc1_registers);
@@ -4,6 +4,7 @@
 
 #include "ppu.h"
 #include "cpu_ppu_interface.h"
+#include "compositor.h"
 #include "bits_and_bytes.h"
 
 // Disable ASan for specific tests, apply to globals or function declarations
@@ -19,7 +20,9 @@ Ppu2C02* ppu;
 CpuPpuShare* cpu_ppu;
 struct PpuMemoryMap* vram;
 uint32_t pixel_buffer[256 * 240];
-ATTRIBUTE_NO_SANITIZE_ADDRESS uint32_t pixel_buffer_ignores_asan[256 * 240];
+// Padded past the 256x240 frame so the out of bounds write below stays in this
+// test's memory (it used to land in ppu.c's global framebuffers)
+ATTRIBUTE_NO_SANITIZE_ADDRESS uint32_t pixel_buffer_ignores_asan[256 * 240 + 256 * 4];
 
 static void setup(void)
 {
@@ -30,7 +33,7 @@ static void setup(void)
 		ck_abort_msg("Failed to allocate memory to ppu struct");
 	}
 
-	if (ppu_init(ppu, cpu_ppu)) {
+	if (cpu_ppu_io_init(cpu_ppu) || ppu_init(ppu, cpu_ppu)) {
 		ck_abort_msg("Failed to initialise the ppu struct");
 	}
 
@@ -2127,6 +2130,198 @@ START_TEST (sprite_priority_behind_bkg)
 	ck_assert_uint_eq(ppu->current_pixel.output_col, 7);
 }
 
+START_TEST (quiet_dots_stop_before_cpu_visible_events)
+{
+	const struct { uint32_t scanline; uint16_t cycle; unsigned dots; } positions[] = {
+		{ 0, 0, 240 * 341 + 339 },
+		{ 239, 340, 340 },
+		{ 240, 338, 0 }, // status clear and NMI lookahead up next
+		{ 241, 4, 0 }, // NMI can still be cancelled
+		{ 241, 10, 20 * 341 + 339 - 10 },
+		{ 242, 0, 19 * 341 + 339 },
+		{ 261, 338, 1 },
+		{ 261, 340, 0 }, // next frame
+	};
+
+	for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); i++) {
+		ppu->scanline = positions[i].scanline;
+		ppu->cycle = positions[i].cycle;
+		ck_assert_uint_eq(positions[i].dots, ppu_quiet_dots(ppu));
+	}
+}
+
+START_TEST (idle_dots_cover_vblank_and_rendering_off)
+{
+	const struct { uint32_t scanline; uint16_t cycle; uint8_t mask; unsigned dots; } positions[] = {
+		{ 0, 0, 0x18, 0 }, // rendering
+		{ 241, 3, 0x18, 0 }, // NMI can still be cancelled
+		{ 241, 4, 0x18, 19 * 341 + 340 - 4 },
+		{ 260, 340, 0x18, 0 }, // pre-render line next
+		{ 0, 0, 0x00, 239 * 341 + 340 },
+		{ 239, 340, 0x00, 0 }, // frame output next
+		{ 240, 0, 0x00, 338 },
+		{ 240, 338, 0x00, 0 }, // status clear and NMI lookahead next
+		{ 261, 0, 0x00, 0 },
+		{ 261, 1, 0x00, 337 },
+		{ 261, 338, 0x00, 0 }, // odd frame skip next
+	};
+	ppu->warmup_count = 3;
+	events_cancel(&cpu_ppu->events, EVENT_VBLANK);
+
+	for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); i++) {
+		ppu->scanline = positions[i].scanline;
+		ppu->cycle = positions[i].cycle;
+		cpu_ppu->ppu_mask = positions[i].mask;
+		ck_assert_uint_eq(positions[i].dots, ppu_idle_dots(ppu));
+	}
+
+	// stops short of a sprite 0 hit and the next event
+	ppu->scanline = 0;
+	ppu->cycle = 0;
+	cpu_ppu->ppu_mask = 0x00;
+	ppu->l_sl = 100;
+	ppu->l_cl = 50;
+	ck_assert_uint_eq(100 * 341 + 49, ppu_idle_dots(ppu));
+	events_schedule(&cpu_ppu->events, EVENT_PPU_WRITE, cpu_ppu->events.now + 10);
+	ck_assert_uint_eq(9, ppu_idle_dots(ppu));
+}
+
+START_TEST (dot_actions_follow_scanline_timing)
+{
+	const struct { uint32_t scanline; uint16_t cycle; uint32_t actions; } dots[] = {
+		{ 0, 0, 0 }, // idle
+		{ 0, 1, DOT_PIXEL | DOT_BG_AT_RELOAD | DOT_BG_NT_FETCH | DOT_SPRITE_OAM_CLEAR },
+		{ 10, 8, DOT_PIXEL | DOT_BG_AT_RELOAD | DOT_BG_SHIFT_RELOAD | DOT_INC_HORZ | DOT_SPRITE_OAM_CLEAR },
+		{ 100, 65, DOT_PIXEL | DOT_BG_AT_RELOAD | DOT_BG_NT_FETCH | DOT_SPRITE_EVAL },
+		{ 239, 256, DOT_PIXEL | DOT_BG_AT_RELOAD | DOT_BG_SHIFT_RELOAD | DOT_INC_HORZ | DOT_INC_VERT
+		            | DOT_SPRITE_EVAL },
+		{ 0, 257, DOT_HORZ_COPY },
+		{ 0, 258, DOT_SPRITE_ADDR },
+		{ 0, 263, DOT_SPRITE_PT_HI_FETCH },
+		{ 0, 320, DOT_SPRITE_BLANK },
+		{ 0, 322, DOT_BG_AT_FILL },
+		{ 0, 327, DOT_BG_PT_HI_FETCH | DOT_BG_SHIFT_PREFETCH },
+		{ 0, 337, 0 },
+		{ 240, 0, DOT_FRAME_DONE },
+		{ 240, 339, DOT_CLEAR_STATUS },
+		{ 240, 340, DOT_NMI_LOOKAHEAD },
+		{ 241, 1, 0 }, // VBlank and the NMI are events
+		{ 250, 8, 0 },
+		{ 261, 0, DOT_CLEAR_SPRITE_HIT | DOT_SPRITE_RESET },
+		{ 261, 1, DOT_CLEAR_STATUS_FLAGS | DOT_SPRITE_ZERO_RESET | DOT_SPRITE_RESET | DOT_BG_NT_FETCH },
+		{ 261, 8, DOT_INC_HORZ | DOT_SPRITE_RESET },
+		{ 261, 280, DOT_VERT_COPY | DOT_SPRITE_RESET },
+		{ 261, 336, DOT_INC_HORZ | DOT_SPRITE_RESET },
+	};
+
+	for (size_t i = 0; i < sizeof(dots) / sizeof(dots[0]); i++) {
+		ck_assert_uint_eq(dots[i].actions, ppu_dot_actions(dots[i].scanline, dots[i].cycle));
+	}
+}
+START_TEST (chr_rows_follow_chr_writes)
+{
+	uint8_t* chr = calloc(8 * KiB, 1);
+	struct ChrRow* rows = malloc((8 * KiB / 2) * sizeof(struct ChrRow));
+	uint8_t* pattern_tables[2] = { ppu->vram.pattern_table_0k, ppu->vram.pattern_table_4k };
+	if (!chr || !rows) {
+		ck_abort_msg("Failed to allocate memory for the CHR data");
+	}
+	chr[0x1012] = 0x81; // tile 1 row 2 of the 2nd pattern table
+	chr[0x101A] = 0xC0;
+	ppu_decode_chr(rows, chr, 8 * KiB);
+	ppu->vram.pattern_table_0k = chr;
+	ppu->vram.pattern_table_4k = chr + 4 * KiB;
+
+	// decoded the same with or without the cache
+	struct ChrRow uncached = ppu_chr_row(&ppu->vram, 0x1012);
+	ppu_attach_chr_rows(&ppu->vram, chr, 8 * KiB, rows);
+	struct ChrRow cached = ppu_chr_row(&ppu->vram, 0x1012);
+	ck_assert_uint_eq(0x400B, cached.normal); // pixels 3, 2, 0, 0, 0, 0, 0, 1
+	ck_assert_uint_eq(0xE001, cached.flipped);
+	ck_assert_uint_eq(uncached.normal, cached.normal);
+	ck_assert_uint_eq(uncached.flipped, cached.flipped);
+
+	// CHR RAM writes update the row, through either plane
+	write_to_ppu_vram(&ppu->vram, 0x101A, 0x00);
+	ck_assert_uint_eq(0x4001, ppu_chr_row(&ppu->vram, 0x1012).normal);
+	write_to_ppu_vram(&ppu->vram, 0x0007, 0xFF);
+	ck_assert_uint_eq(0x5555, ppu_chr_row(&ppu->vram, 0x0007).normal);
+
+	ppu->vram.pattern_table_0k = pattern_tables[0];
+	ppu->vram.pattern_table_4k = pattern_tables[1];
+	free(rows);
+	free(chr);
+}
+START_TEST (composite_scanline_matches_per_pixel_path)
+{
+	uint8_t bg[COMPOSITOR_WIDTH];
+	uint8_t sprite[COMPOSITOR_WIDTH];
+	uint32_t colours[COMPOSITOR_COLOURS];
+	uint32_t simd[COMPOSITOR_WIDTH];
+	uint32_t scalar[COMPOSITOR_WIDTH];
+	srand(_i + 1);
+	for (unsigned x = 0; x < COMPOSITOR_WIDTH; x++) {
+		bg[x] = (uint8_t) (rand() & 0x0F);
+		if (!(bg[x] & 0x03)) { bg[x] = 0; } // transparent
+		sprite[x] = (uint8_t) (0x10 | (rand() & 0x0F));
+		if (!(sprite[x] & 0x03)) { sprite[x] = 0; }
+		sprite[x] |= (rand() & 0x01) ? SPRITE_LINE_BEHIND : 0;
+	}
+
+	// palette offsets as the colours, output is the offset get_pixel() picks
+	for (unsigned i = 0; i < COMPOSITOR_COLOURS; i++) {
+		colours[i] = i;
+	}
+	composite_scanline_scalar(scalar, bg, sprite, colours);
+	for (unsigned x = 0; x < COMPOSITOR_WIDTH; x++) {
+		struct CurrentPixel px = {
+			.bkg_pattern_index = bg[x] & 0x03, .bkg_col = bg[x],
+			.sprite_pattern_index = sprite[x] & 0x03, .sprite_col = sprite[x] & SPRITE_LINE_OFFSET,
+		};
+		get_pixel(&px, !(sprite[x] & SPRITE_LINE_BEHIND));
+		ck_assert_uint_eq(px.output_col, scalar[x]);
+	}
+
+	// the SIMD versions look up every byte of the colour
+	for (unsigned i = 0; i < COMPOSITOR_COLOURS; i++) {
+		colours[i] = 0xFF000000 | (uint32_t) (rand() & 0xFFFFFF);
+	}
+	composite_scanline_scalar(scalar, bg, sprite, colours);
+	composite_scanline(simd, bg, sprite, colours);
+	ck_assert_mem_eq(simd, scalar, sizeof(scalar));
+}
+
+START_TEST (sprite_line_matches_get_sprite_pixel)
+{
+	// overlapping sprites, some not yet in range, some part way through
+	srand(_i + 1);
+	for (int i = 7; i >= 0; i--) {
+		ppu->sprite_x_counter[i] = (uint8_t) (rand() & 0xFF);
+		ppu->sprite_pt_hi_shift_reg[i] = (uint8_t) (rand() & 0xFF);
+		ppu->sprite_pt_lo_shift_reg[i] = (uint8_t) (rand() & 0xFF);
+		ppu->sprite_at_latches[i] = (uint8_t) (rand() & 0x23);
+	}
+	for (unsigned i = 0; i < 32; i++) {
+		write_to_ppu_vram(&ppu->vram, 0x3F00 + i, (uint8_t) i);
+	}
+	ppu->cpu_ppu_io->ppu_mask = 0x14; // sprites shown in the left 8 pixels too
+
+	unsigned first = 1 + _i * 30;
+	render_sprite_line(ppu, first);
+
+	for (ppu->cycle = first; ppu->cycle <= 256; ppu->cycle++) {
+		uint8_t entry = ppu->sprite_line[ppu->cycle - 1];
+		uint8_t colour_reference = 0x00;
+		get_sprite_pixel(ppu, &colour_reference);
+		ck_assert_uint_eq(entry & 0x03, ppu->current_pixel.sprite_pattern_index);
+		if (ppu->current_pixel.sprite_pattern_index) {
+			ck_assert_uint_eq(entry & SPRITE_LINE_OFFSET, ppu->current_pixel.sprite_col);
+			ck_assert_uint_eq(!(entry & SPRITE_LINE_BEHIND)
+			                 , sprite_is_front_priority(ppu, ppu->current_pixel.scanline_sprite));
+		}
+	}
+}
+
 
 Suite* ppu_master_suite(void)
 {
@@ -2208,6 +2403,10 @@ Suite* ppu_rendering_suite(void)
 	TCase* tc_sprite_evaluation;
 	TCase* tc_sprite_rendering;
 	TCase* tc_bkg_sprite_priority;
+	TCase* tc_quiet_dots;
+	TCase* tc_dot_actions;
+	TCase* tc_chr_rows;
+	TCase* tc_compositor;
 
 	s = suite_create("Ppu Rendering Related Tests");
 	tc_bkg_rendering = tcase_create("Background Rendering Tests");
@@ -2269,6 +2468,7 @@ Suite* ppu_rendering_suite(void)
 	tcase_add_test(tc_sprite_rendering, sprite_renders_highest_priority_sprite);
 	tcase_add_test(tc_sprite_rendering, sprite_renders_highest_priority_non_transparent_sprite);
 	tcase_add_loop_test(tc_sprite_rendering, sprite_renders_left_masking, 0, 9);
+	tcase_add_loop_test(tc_sprite_rendering, sprite_line_matches_get_sprite_pixel, 0, 8);
 	tcase_add_loop_test(tc_sprite_rendering, sprite_renders_enabled_disabled, 0, 8);
 	suite_add_tcase(s, tc_sprite_rendering);
 	tc_bkg_sprite_priority = tcase_create("Background vs Sprite Rendering Tests");
@@ -2280,5 +2480,21 @@ Suite* ppu_rendering_suite(void)
 	tcase_add_test(tc_bkg_sprite_priority, sprite_priority_behind_bkg);
 	suite_add_tcase(s, tc_bkg_sprite_priority);
 
+	tc_quiet_dots = tcase_create("Dots Without Cpu Visible Events");
+	tcase_add_checked_fixture(tc_quiet_dots, setup, teardown);
+	tcase_add_test(tc_quiet_dots, quiet_dots_stop_before_cpu_visible_events);
+	tcase_add_test(tc_quiet_dots, idle_dots_cover_vblank_and_rendering_off);
+	suite_add_tcase(s, tc_quiet_dots);
+	tc_dot_actions = tcase_create("Per Dot Actions");
+	tcase_add_test(tc_dot_actions, dot_actions_follow_scanline_timing);
+	suite_add_tcase(s, tc_dot_actions);
+	tc_chr_rows = tcase_create("CHR Row Cache");
+	tcase_add_checked_fixture(tc_chr_rows, setup, teardown);
+	tcase_add_test(tc_chr_rows, chr_rows_follow_chr_writes);
+	suite_add_tcase(s, tc_chr_rows);
+	tc_compositor = tcase_create("Scanline Compositor");
+	tcase_add_loop_test(tc_compositor, composite_scanline_matches_per_pixel_path, 0, 4);
+	suite_add_tcase(s, tc_compositor);
+
 	return s;
 }
@@ -5,6 +5,7 @@
 #include "cpu_ppu_interface_tests.h"
 #include "mappers_tests.h"
 #include "util_tests.h"
+#include "cnes_tests.h"
 
 int main(void)
 {
@@ -29,6 +30,7 @@ int main(void)
 	srunner_add_suite(sr, cpu_isa_suite());
 	srunner_add_suite(sr, cpu_hardware_interrupts_suite());
 	srunner_add_suite(sr, cpu_trace_logger_suite());
+	srunner_add_suite(sr, cpu_instruction_stepping_suite());
 
 	srunner_run_all(sr, CK_NORMAL);
 	number_failed += srunner_ntests_failed(sr);
@@ -62,5 +64,13 @@ int main(void)
 	number_failed += srunner_ntests_failed(sr);
 	srunner_free(sr);
 
+	// libcnes tests
+	sr = srunner_create(cnes_master_suite());
+	srunner_add_suite(sr, cnes_api_suite());
+
+	srunner_run_all(sr, CK_NORMAL);
+	number_failed += srunner_ntests_failed(sr);
+	srunner_free(sr);
+
 	return (number_failed == 0) ? 0 : 1;
 }